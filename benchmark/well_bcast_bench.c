@@ -0,0 +1,277 @@
+/*	well_bcast_bench.c
+
+One producer, N consumers which must ALL see every block:
+	- 'b': one broadcast well, one cursor per consumer
+	- 'c': the producer copies every block into N separate wells
+*/
+
+#include <well_bcast.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+static int kill_flag = 0;
+static size_t rx_thread_cnt = 3;
+static size_t batch = 32;
+static size_t blk_size = 64;
+
+static struct well_bcast bc;
+static struct well *wells = NULL;	/* mode 'c' */
+
+
+/*	timer()
+*/
+void *timer(void *arg)
+{
+	sleep((size_t)arg);
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+
+/*	bcast_tx()
+*/
+void *bcast_tx(void *arg)
+{
+	size_t tally = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_bcast_reserve(&bc, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			memset(well_access(pos, j, &bc.well), (int)(tally + j), blk_size);
+		well_bcast_publish(&bc, res);
+		tally += res;
+	}
+	return (void *)tally;
+}
+
+
+/*	bcast_rx()
+*/
+void *bcast_rx(void *arg)
+{
+	size_t id = (size_t)arg;
+	size_t sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_bcast_read(&bc, id, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += *(unsigned char *)well_access(pos, j, &bc.well);
+		well_bcast_done(&bc, id, res);
+	}
+	well_bcast_leave(&bc, id);
+	return (void *)sum;
+}
+
+
+/*	copy_tx()
+Write a batch of blocks once, then copy it into every well.
+*/
+void *copy_tx(void *arg)
+{
+	size_t tally = 0;
+	char *stage = malloc(blk_size * batch);
+	if (!stage)
+		return NULL;
+
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		for (size_t j=0; j < batch; j++)
+			memset(stage + j * blk_size, (int)(tally + j), blk_size);
+
+		for (size_t i=0; i < rx_thread_cnt; i++) {
+			for (size_t done=0, res=0; done < batch; done += res) {
+				size_t pos;
+				while (!(res = well_reserve(&wells[i].tx, &pos, batch - done))) {
+					if (__atomic_load_n(&kill_flag, __ATOMIC_RELAXED))
+						goto out;
+					FAIL_DO();
+				}
+				for (size_t j=0; j < res; j++)
+					memcpy(well_access(pos, j, &wells[i]), stage + (done + j) * blk_size, blk_size);
+				well_release_single(&wells[i].rx, res);
+			}
+		}
+		tally += batch;
+	}
+out:
+	free(stage);
+	return (void *)tally;
+}
+
+
+/*	copy_rx()
+*/
+void *copy_rx(void *arg)
+{
+	struct well *buf = &wells[(size_t)arg];
+	size_t sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf->rx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += *(unsigned char *)well_access(pos, j, buf);
+		well_release_single(&buf->tx, res);
+	}
+	return (void *)sum;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark fan-out to several consumers: broadcast well against copying.\n\
+\n\
+Options:\n\
+-m, --mode <b|c>	:	'b' broadcast well; 'c' copy into one well per consumer.\n\
+-x, --consumers <n>	:	Consumer threads (default 3).\n\
+-z, --size <bytes>	:	Block size (default 64).\n\
+-c, --count <blocks>	:	Blocks in each buffer (default 1024).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "consumers",	required_argument,	0,	'x'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'b';
+	size_t blk_cnt = 1024, seconds = 5;
+	pthread_t *rx = NULL;
+	size_t started = 0, inited = 0;
+	pthread_t tx;
+	int tx_started = 0;
+
+	while ((opt = getopt_long(argc, argv, "m:x:z:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'b' && mode != 'c', "invalid mode '%s'", optarg);
+				break;
+
+			case 'x':
+				opt = sscanf(optarg, "%zu", &rx_thread_cnt);
+				Z_die_if(opt != 1 || !rx_thread_cnt, "invalid consumers '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(!(rx = calloc(rx_thread_cnt, sizeof(pthread_t))), "");
+	if (mode == 'b') {
+		Z_die_if(well_params(blk_size, blk_cnt, &bc.well), "");
+		Z_die_if(
+			well_bcast_init(&bc, malloc(well_size(&bc.well)), rx_thread_cnt)
+			, "size %zu", well_size(&bc.well));
+		inited = 1;
+	} else {
+		Z_die_if(posix_memalign((void **)&wells, _Alignof(struct well),
+				rx_thread_cnt * sizeof(struct well)), "");
+		for (; inited < rx_thread_cnt; inited++) {
+			Z_die_if(well_params(blk_size, blk_cnt, &wells[inited]), "");
+			Z_die_if(
+				well_init(&wells[inited], malloc(well_size(&wells[inited])))
+				, "size %zu", well_size(&wells[inited]));
+		}
+	}
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		for (; started < rx_thread_cnt; started++) {
+			Z_die_if(pthread_create(&rx[started], NULL,
+				mode == 'b' ? bcast_rx : copy_rx, (void *)started), "");
+		}
+		Z_die_if(pthread_create(&tx, NULL, mode == 'b' ? bcast_tx : copy_tx, NULL), "");
+		tx_started = 1;
+
+		pthread_t tmr;
+		Z_die_if(pthread_create(&tmr, NULL, timer, (void *)seconds), "");
+		pthread_join(tmr, NULL);
+
+		void *ret;
+		pthread_join(tx, &ret);
+		tx_started = 0;
+		tally = (size_t)ret;
+		for (; started; started--)
+			pthread_join(rx[started-1], NULL);
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; consumers %zu; blk_size %zu; blk_count %zu; delivered %zu\n",
+		mode, rx_thread_cnt, blk_size, blk_cnt, tally * rx_thread_cnt);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	if (tx_started)
+		pthread_join(tx, NULL);
+	while (started)
+		pthread_join(rx[--started], NULL);
+	free(rx);
+	if (mode == 'b' && inited) {
+		well_bcast_deinit(&bc);
+		free(well_mem(&bc.well));
+	}
+	if (mode == 'c' && wells) {
+		while (inited) {
+			well_deinit(&wells[--inited]);
+			free(well_mem(&wells[inited]));
+		}
+		free(wells);
+	}
+	return err_cnt;
+}
@@ -1,4 +1,5 @@
 #include <well.h>
+#include <well_lease.h>
 #include <well_fail.h>
 
 #include <zed_dbg.h>
@@ -7,12 +8,16 @@
 #include <getopt.h>
 #include <nonlibc.h> /* timing */
 
-#include <unistd.h> /* sleep() */
+#include <unistd.h> /* sleep(), usleep() */
 
 
 static size_t waits = 0; /* how many times did threads wait? */
 static int kill_flag = 0;
 
+/* multi-release through leases (-l) */
+static int leases = 0;
+static struct well_leases tx_leases, rx_leases;
+
 /* thread tracking */
 typedef struct {
 	void *(*func)(void *args);
@@ -86,9 +91,20 @@ void *tx_multi(void* arg)
 	struct well *buf = arg;
 	size_t tally = 0;
 	size_t pos;
+	struct well_lease *me = leases ? well_lease_join(&tx_leases) : NULL;
 
 	/* loop on TX */
 	while (!__atomic_load_n(&kill_flag, __ATOMIC_CONSUME)) {
+		if (me) {
+			if (!well_lease_reserve(&tx_leases, me, &pos, 1)) {
+				FAIL_DO();
+				continue;
+			}
+			WELL_DEREF(size_t, pos, 0, buf) = tally++;
+			while (!well_lease_release(&tx_leases, me))
+				FAIL_DO();
+			continue;
+		}
 		if (!well_reserve(&buf->tx, &pos, 1)) {
 			FAIL_DO();
 			continue;
@@ -130,8 +146,20 @@ void *rx_multi(void* arg)
 	struct well *buf = arg;
 	size_t tally = 0;
 	size_t pos;
+	struct well_lease *me = leases ? well_lease_join(&rx_leases) : NULL;
 
 	while (!__atomic_load_n(&kill_flag, __ATOMIC_CONSUME)) {
+		if (me) {
+			if (!well_lease_reserve(&rx_leases, me, &pos, 1)) {
+				FAIL_DO();
+				continue;
+			}
+			consume( WELL_DEREF(size_t, pos, 0, buf) );
+			tally++;
+			while (!well_lease_release(&rx_leases, me))
+				FAIL_DO();
+			continue;
+		}
 		if (!well_reserve(&buf->rx, &pos, 1)) {
 			FAIL_DO();
 			continue;
@@ -166,6 +194,8 @@ Options:\n\
 -t, --threads	:	Number of thread PAIRS doing I/O on the buffer.\n\
 			The special value '0' indicates a single thread\n\
 				alternately write/reading on the same buffer.\n\
+-l, --leases	:	Multi-release through leases (well_lease.h),\n\
+				with a watchdog ticking every millisecond.\n\
 -s, --seconds	:	Number of seconds to run benchmark.\n\
 -h, --help	:	Print this message and exit.\n",
 		pgm_name);
@@ -188,12 +218,13 @@ int main(int argc, char **argv)
 	int opt = 0;
 	static struct option long_options[] = {
 		{ "threads",	required_argument,	0,	't'},
+		{ "leases",	no_argument,		0,	'l'},
 		{ "seconds",	required_argument,	0,	's'},
 		{ "help",	no_argument,		0,	'h'}
 	};
 
 	size_t pairs = 0, seconds = 5;
-	while ((opt = getopt_long(argc, argv, "t:s:h", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "t:ls:h", long_options, NULL)) != -1) {
 		switch(opt)
 		{
 			case 't':
@@ -201,6 +232,10 @@ int main(int argc, char **argv)
 				Z_die_if(opt != 1, "invalid pairs '%s'", optarg);
 				break;
 
+			case 'l':
+				leases = 1;
+				break;
+
 			case 's':
 				opt = sscanf(optarg, "%zu", &seconds);
 				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
@@ -232,6 +267,11 @@ int main(int argc, char **argv)
 	Z_die_if(
 		well_init(&buf, malloc(well_size(&buf)))
 		, "size %zu", well_size(&buf));
+	if (leases) {
+		/* nobody dies here: a ttl of 1s never fires */
+		Z_die_if(well_leases_init(&tx_leases, &buf, &buf.tx, &buf.rx, pairs, 1000), "");
+		Z_die_if(well_leases_init(&rx_leases, &buf, &buf.rx, &buf.tx, pairs, 1000), "");
+	}
 
 	/* assign thread functions */
 	if (exec_threads == 1) {
@@ -254,7 +294,16 @@ int main(int argc, char **argv)
 						threads[t].func, &buf)
 			, "");
 
-		sleep(seconds);
+		if (leases) {
+			/* this thread is also the watchdog */
+			for (size_t i=0; i < seconds * 1000; i++) {
+				usleep(1000);
+				well_lease_watch(&tx_leases);
+				well_lease_watch(&rx_leases);
+			}
+		} else {
+			sleep(seconds);
+		}
 		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELEASE);
 
 		size_t tally =0;
@@ -275,6 +324,8 @@ int main(int argc, char **argv)
 		nlc_timing_cpu(t), nlc_timing_wall(t));
 
 out:
+	well_leases_deinit(&tx_leases);
+	well_leases_deinit(&rx_leases);
 	well_deinit(&buf);
 	free(well_mem(&buf));
 	free(threads);
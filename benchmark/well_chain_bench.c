@@ -0,0 +1,262 @@
+/*	well_chain_bench.c
+
+One producer, one consumer:
+	- 'w': a single well; a slow consumer pushes back on the producer
+	- 'c': a chain of segments of the same size; bursts grow the chain
+With '-p', the consumer pauses now and then (a burst, from the producer's view).
+*/
+
+#include <well_chain.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep(), usleep() */
+
+
+static int kill_flag = 0;
+static size_t batch = 32;
+static size_t blk_size = 64;
+static size_t pause_us = 0;
+
+static struct well buf;			/* mode 'w' */
+static struct well_chain chain;		/* mode 'c' */
+static size_t max_segs = 0;
+
+
+/*	well_tx()
+returns producer stalls
+*/
+void *well_tx(void *arg)
+{
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.tx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++, i++)
+			memset(well_access(pos, j, &buf), (int)i, blk_size);
+		well_release_single(&buf.rx, res);
+	}
+	return (void *)wait_count;
+}
+
+
+/*	chain_tx()
+returns producer stalls
+*/
+void *chain_tx(void *arg)
+{
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		struct well *seg;
+		size_t pos, res;
+		if (!(res = well_chain_reserve(&chain, &seg, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++, i++)
+			memset(well_access(pos, j, seg), (int)i, blk_size);
+		well_chain_release(&chain, seg, res);
+
+		size_t segs = well_chain_segments(&chain);
+		if (segs > max_segs)
+			max_segs = segs;
+	}
+	return (void *)wait_count;
+}
+
+
+/*	rx_pause()
+*/
+static void rx_pause(size_t *since)
+{
+	if (pause_us && *since >= 1000000) {
+		usleep(pause_us);
+		*since = 0;
+	}
+}
+
+
+/*	well_rx()
+*/
+void *well_rx(void *arg)
+{
+	size_t tally = 0, since = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			(*(unsigned char *)well_access(pos, j, &buf))++;
+		well_release_single(&buf.tx, res);
+		tally += res;
+		since += res;
+		rx_pause(&since);
+	}
+	return (void *)tally;
+}
+
+
+/*	chain_rx()
+*/
+void *chain_rx(void *arg)
+{
+	size_t tally = 0, since = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		struct well *seg;
+		size_t pos, res;
+		if (!(res = well_chain_take(&chain, &seg, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			(*(unsigned char *)well_access(pos, j, seg))++;
+		well_chain_done(&chain, seg, res);
+		tally += res;
+		since += res;
+		rx_pause(&since);
+	}
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark an unbounded chain of segments against a single well.\n\
+\n\
+Options:\n\
+-m, --mode <w|c>	:	'w' single well; 'c' chain of segments.\n\
+-p, --pause <usec>	:	Consumer pauses this long every 1M blocks (default 0).\n\
+-z, --size <bytes>	:	Block size (default 64).\n\
+-c, --count <blocks>	:	Blocks in the well, or in each segment (default 1024).\n\
+-k, --keep <segs>	:	Spare segments kept by the chain (default 2).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "pause",	required_argument,	0,	'p'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "keep",	required_argument,	0,	'k'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'w';
+	size_t blk_cnt = 1024, keep = 2, seconds = 5;
+	pthread_t tx, rx;
+	int tx_started = 0, rx_started = 0, inited = 0;
+
+	while ((opt = getopt_long(argc, argv, "m:p:z:c:k:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'w' && mode != 'c', "invalid mode '%s'", optarg);
+				break;
+
+			case 'p':
+				opt = sscanf(optarg, "%zu", &pause_us);
+				Z_die_if(opt != 1, "invalid pause '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1 || !blk_size, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 'k':
+				opt = sscanf(optarg, "%zu", &keep);
+				Z_die_if(opt != 1 || !keep, "invalid keep '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	if (mode == 'w') {
+		Z_die_if(well_params(blk_size, blk_cnt, &buf), "");
+		Z_die_if(well_init(&buf, malloc(well_size(&buf))), "size %zu", well_size(&buf));
+	} else {
+		Z_die_if(well_chain_init(&chain, blk_size, blk_cnt, keep), "");
+	}
+	inited = 1;
+
+	size_t tally = 0, stalls = 0;
+	nlc_timing_start(t);
+		Z_die_if(pthread_create(&rx, NULL, mode == 'w' ? well_rx : chain_rx, NULL), "");
+		rx_started = 1;
+		Z_die_if(pthread_create(&tx, NULL, mode == 'w' ? well_tx : chain_tx, NULL), "");
+		tx_started = 1;
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+
+		void *ret;
+		pthread_join(tx, &ret);
+		tx_started = 0;
+		stalls = (size_t)ret;
+		pthread_join(rx, &ret);
+		rx_started = 0;
+		tally = (size_t)ret;
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; pause %zuus; blk_size %zu; blk_count %zu; producer stalls %zu",
+		mode, pause_us, blk_size, blk_cnt, stalls);
+	if (mode == 'c')
+		printf("; segments max %zu, at end %zu", max_segs, well_chain_segments(&chain));
+	printf("\ncpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	if (tx_started)
+		pthread_join(tx, NULL);
+	if (rx_started)
+		pthread_join(rx, NULL);
+	if (inited && mode == 'w') {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	} else if (inited) {
+		well_chain_deinit(&chain);
+	}
+	return err_cnt;
+}
@@ -0,0 +1,250 @@
+/*	well_copy_bench.c
+
+Copying blocks in and out of a well:
+	- 'm': memcpy() into each segment of the reservation
+	- 'c': well_copy_in()/_out(), streaming from the default threshold
+	- 'n': well_copy_in()/_out(), always streaming
+-p adds prefetch of the next reservation on both sides.
+The consumer also reads a working set of its own after each block (-w),
+	which is what the producer's and consumer's copies compete with.
+*/
+
+#include <well_copy.h>
+#include <well_iov.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+#define SRC_BLKS 16	/* producer cycles through this many source blocks */
+
+static int kill_flag = 0;
+static char mode = 'c';
+static int prefetch = 0;
+static size_t blk_size = 4096;
+static size_t ws_size = 1024 * 1024;
+
+static struct well buf;
+
+
+/*	copy()
+*/
+static void copy(size_t pos, void *mem, size_t len, int in)
+{
+	if (mode != 'm') {
+		if (in)
+			well_copy_in(&buf, pos, mem, len);
+		else
+			well_copy_out(&buf, pos, mem, len);
+		return;
+	}
+	struct iovec iov[2];
+	int n = well_iov(&buf, pos, len / blk_size, iov);
+	for (int i=0; i < n; i++) {
+		if (in)
+			memcpy(iov[i].iov_base, mem, iov[i].iov_len);
+		else
+			memcpy(mem, iov[i].iov_base, iov[i].iov_len);
+		mem = (char *)mem + iov[i].iov_len;
+	}
+}
+
+
+/*	producer()
+*/
+void *producer(void *arg)
+{
+	char *src = malloc(blk_size * SRC_BLKS);
+	if (!src)
+		return NULL;
+	memset(src, 0x5a, blk_size * SRC_BLKS);
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		size_t pos;
+		if (!well_reserve(&buf.tx, &pos, 1)) {
+			FAIL_DO();
+			continue;
+		}
+		if (prefetch)
+			well_prefetch_next(&buf, &buf.tx, blk_size, 1);
+		copy(pos, src + (i++ % SRC_BLKS) * blk_size, blk_size, 1);
+		well_release_single(&buf.rx, 1);
+	}
+	free(src);
+	return NULL;
+}
+
+
+/*	consumer()
+*/
+void *consumer(void *arg)
+{
+	size_t tally = 0;
+	uint64_t sum = 0;
+	char *dst = malloc(blk_size);
+	uint64_t *ws = calloc(1, ws_size + sizeof(uint64_t));
+	while (dst && ws && !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos;
+		if (!well_reserve(&buf.rx, &pos, 1)) {
+			FAIL_DO();
+			continue;
+		}
+		if (prefetch)
+			well_prefetch_next(&buf, &buf.rx, blk_size, 0);
+		copy(pos, dst, blk_size, 0);
+		well_release_single(&buf.tx, 1);
+		tally++;
+
+		/* touch the working set: a line for every line copied */
+		size_t lines = ws_size / 64;
+		for (size_t j=0; j < blk_size / 64 && lines; j++)
+			sum += ws[((tally * 131 + j) % lines) * 8];
+		sum += dst[0];
+	}
+	free(dst);
+	free(ws);
+	/* keep 'sum' */
+	if (sum == 1)
+		tally++;
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark bulk copies into and out of well blocks.\n\
+\n\
+Options:\n\
+-m, --mode <m|c|n>	:	'm' memcpy(); 'c' well_copy; 'n' well_copy, always streaming.\n\
+-z, --blk-size <n>	:	Block size in bytes (default 4096).\n\
+-c, --count <n>		:	Blocks (default: 8 MiB worth, at least 4).\n\
+-w, --working-set <n>	:	Consumer's own working set, bytes (default 1 MiB).\n\
+-p, --prefetch		:	Prefetch the next reservation on both sides.\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "blk-size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "working-set",required_argument,	0,	'w'},
+		{ "prefetch",	no_argument,		0,	'p'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t count = 0, seconds = 5;
+	int started = 0;
+	pthread_t prod, cons;
+
+	while ((opt = getopt_long(argc, argv, "m:z:c:w:ps:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'm' && mode != 'c' && mode != 'n',
+					"invalid mode '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1 || blk_size < 64, "invalid blk-size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &count);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 'w':
+				opt = sscanf(optarg, "%zu", &ws_size);
+				Z_die_if(opt != 1, "invalid working-set '%s'", optarg);
+				break;
+
+			case 'p':
+				prefetch = 1;
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+	if (!count)
+		count = 8 * 1024 * 1024 / blk_size;
+	if (count < 4)
+		count = 4;
+	if (mode == 'n')
+		well_copy_set_nt_min(0);
+
+	Z_die_if(well_params(blk_size, count, &buf), "");
+	Z_die_if(
+		well_init(&buf, malloc(well_size(&buf)))
+		, "size %zu", well_size(&buf));
+	/* fault the buffer in: measure copies, not page faults */
+	memset(well_mem(&buf), 0, well_size(&buf));
+	blk_size = well_blk_size(&buf);
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		Z_die_if(pthread_create(&cons, NULL, consumer, NULL), "");
+		started++;
+		Z_die_if(pthread_create(&prod, NULL, producer, NULL), "");
+		started++;
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+		pthread_join(prod, NULL);
+		void *ret;
+		pthread_join(cons, &ret);
+		tally = (size_t)ret;
+		started = 0;
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; kernel %s; blk_size %zu; count %zu; prefetch %d; MiB/s %.1lf\n",
+		mode, well_copy_isa(), blk_size, well_blk_count(&buf), prefetch,
+		(double)tally * blk_size / (1024 * 1024) / nlc_timing_wall(t));
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	if (started > 1)
+		pthread_join(prod, NULL);
+	if (started)
+		pthread_join(cons, NULL);
+	if (well_mem(&buf)) {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	}
+	return err_cnt;
+}
@@ -0,0 +1,236 @@
+/*	well_coro_bench.cpp
+
+One producer thread, many consumers reading batches off one well:
+	- 'c': consumers are coroutines (well_coro.hpp), suspended while
+		the well is empty, on a pool of -w threads (0: a single-threaded
+		loop on one thread)
+	- 's': one thread per consumer, spinning with FAIL_DO()
+Cost shows as throughput against CPU time: spinning consumers burn
+	a thread each whether or not there is work.
+*/
+
+extern "C" {
+#include <zed_dbg.h>
+#include <well_fail.h>
+#include <nonlibc.h> /* timing */
+}
+#include <well_coro.hpp>
+
+#include <stdlib.h>
+#include <string.h> /* memset() */
+#include <getopt.h>
+#include <unistd.h> /* sleep() */
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+static int kill_flag = 0;
+static char mode = 'c';
+static size_t rx_cnt = 4;	/* consumers */
+static size_t workers = 1;	/* 'c': pool threads; 0 for a loop */
+static size_t batch = 16;
+
+static struct well buf;
+static well_coro::channel *ch = NULL;
+
+struct counter {
+	size_t		n;
+} __attribute__((aligned(WELL_LINE)));
+static struct counter *got = NULL;	/* per consumer */
+
+
+/*	consumer()
+*/
+well_coro::task consumer(size_t c)
+{
+	size_t sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		well_coro::reservation r = co_await ch->rx.reserve(batch);
+		for (size_t j=0; j < r.count; j++)
+			sum += WELL_DEREF(size_t, r.pos, j, &buf);
+		co_await ch->tx.release(r);
+		__atomic_store_n(&got[c].n, got[c].n + r.count, __ATOMIC_RELAXED);
+	}
+	/* keep 'sum' */
+	__asm__ volatile("" :: "r"(sum));
+}
+
+
+/*	spin_consumer()
+*/
+void spin_consumer(size_t c)
+{
+	size_t sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += WELL_DEREF(size_t, pos, j, &buf);
+		while (!well_release_multi(&buf.tx, res, pos))
+			FAIL_DO();
+		__atomic_store_n(&got[c].n, got[c].n + res, __ATOMIC_RELAXED);
+	}
+	__asm__ volatile("" :: "r"(sum));
+}
+
+
+/*	producer()
+Runs until 'running' says every consumer is gone:
+	a suspended coroutine only notices 'kill_flag' once it gets blocks.
+*/
+void producer(std::atomic<size_t> *running)
+{
+	for (size_t i=0; running->load(std::memory_order_relaxed); ) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.tx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, &buf) = i++;
+		ch->rx.release_single(res);
+	}
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark consumers on one well: coroutines suspending against threads spinning.\n\
+\n\
+Options:\n\
+-m, --mode <c|s>	:	'c' coroutines; 's' one spinning thread each.\n\
+-x, --consumers <n>	:	Consumers (default 4).\n\
+-w, --workers <n>	:	'c': pool threads, 0 for a single-threaded loop (default 1).\n\
+-b, --batch <n>		:	Blocks per reservation (default 16).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "consumers",	required_argument,	0,	'x'},
+		{ "workers",	required_argument,	0,	'w'},
+		{ "batch",	required_argument,	0,	'b'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t seconds = 5;
+	size_t tally = 0;
+	well_coro::loop loop;
+	well_coro::pool pool;
+	std::atomic<size_t> spinning{0};
+	std::thread prod, loop_thread;
+	std::vector<std::thread> rx;
+
+	while ((opt = getopt_long(argc, argv, "m:x:w:b:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'c' && mode != 's', "invalid mode '%s'", optarg);
+				break;
+
+			case 'x':
+				opt = sscanf(optarg, "%zu", &rx_cnt);
+				Z_die_if(opt != 1 || !rx_cnt, "invalid consumers '%s'", optarg);
+				break;
+
+			case 'w':
+				opt = sscanf(optarg, "%zu", &workers);
+				Z_die_if(opt != 1, "invalid workers '%s'", optarg);
+				break;
+
+			case 'b':
+				opt = sscanf(optarg, "%zu", &batch);
+				Z_die_if(opt != 1 || !batch, "invalid batch '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_params(sizeof(size_t), 1024, &buf), "");
+	Z_die_if(well_init(&buf, malloc(well_size(&buf))), "");
+	ch = new well_coro::channel(&buf);
+	Z_die_if(posix_memalign((void **)&got, alignof(struct counter),
+			rx_cnt * sizeof(struct counter)), "");
+	memset(got, 0x0, rx_cnt * sizeof(struct counter));
+	if (mode == 'c' && workers)
+		Z_die_if(pool.init(workers), "");
+
+	{
+	nlc_timing_start(t);
+		if (mode == 'c') {
+			well_coro::executor &ex = workers
+				? static_cast<well_coro::executor &>(pool) : loop;
+			for (size_t c=0; c < rx_cnt; c++)
+				well_coro::spawn(ex, consumer(c));
+			prod = std::thread(producer, &ex.live);
+			if (!workers)
+				loop_thread = std::thread([&loop]() { loop.run(); });
+		} else {
+			spinning = rx_cnt;
+			prod = std::thread(producer, &spinning);
+			for (size_t c=0; c < rx_cnt; c++)
+				rx.emplace_back(spin_consumer, c);
+		}
+
+		/* this thread is the timer */
+		sleep(seconds);
+		for (size_t c=0; c < rx_cnt; c++)
+			tally += __atomic_load_n(&got[c].n, __ATOMIC_RELAXED);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+
+		for (std::thread &r : rx)
+			r.join();
+		spinning = 0;
+		if (loop_thread.joinable())
+			loop_thread.join();
+		else if (mode == 'c')
+			pool.join();
+		prod.join();
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; consumers %zu; workers %zu; batch %zu\n",
+		mode, rx_cnt, mode == 'c' ? workers : rx_cnt, batch);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+	}
+
+out:
+	delete ch;
+	free(got);
+	if (well_mem(&buf)) {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	}
+	return err_cnt;
+}
@@ -0,0 +1,188 @@
+/*	well_dur_bench.c
+
+Durable messages per second against the flush interval:
+	one producer and one consumer on a durable well, with a flusher
+	thread group-committing every 'interval' microseconds.
+Every message counted has been on disk before it was consumed.
+*/
+
+#include <well_dur.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h> /* snprintf() */
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h>
+
+
+static int kill_flag = 0;
+static size_t batch = 64;
+
+static struct well_dur dw;
+
+
+/*	producer()
+*/
+void *producer(void *arg)
+{
+	struct well *buf = well_dur_well(&dw);
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		size_t pos, res;
+		if (!(res = well_dur_reserve(&dw, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++, i++)
+			memset(well_access(pos, j, buf), (int)i, well_blk_size(buf));
+		well_dur_submit(&dw, res);
+	}
+	return NULL;
+}
+
+
+/*	consumer()
+*/
+void *consumer(void *arg)
+{
+	struct well *buf = well_dur_well(&dw);
+	size_t tally = 0, sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_dur_read(&dw, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += *(unsigned char *)well_access(pos, j, buf);
+		well_dur_done(&dw, res);
+		tally += res;
+	}
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark durable messages/sec through a file-backed well against the flush interval.\n\
+\n\
+Options:\n\
+-i, --interval <us>	:	Group commit every <us> microseconds; 0: continuously (default 1000).\n\
+-d, --dir <path>	:	Directory for the (deleted on exit) file (default '.').\n\
+-z, --size <bytes>	:	Block size (default 64).\n\
+-c, --count <blocks>	:	Blocks in buffer (default 65536).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "interval",	required_argument,	0,	'i'},
+		{ "dir",	required_argument,	0,	'd'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	long interval = 1000;
+	const char *dir = ".";
+	size_t blk_size = 64, blk_cnt = 65536, seconds = 5;
+	char path[4096];
+	int fd = -1, open = 0, started = 0;
+	pthread_t prod, cons;
+
+	while ((opt = getopt_long(argc, argv, "i:d:z:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'i':
+				opt = sscanf(optarg, "%ld", &interval);
+				Z_die_if(opt != 1 || interval < 0, "invalid interval '%s'", optarg);
+				break;
+
+			case 'd':
+				dir = optarg;
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	snprintf(path, sizeof(path), "%s/well_dur_bench.XXXXXX", dir);
+	Z_die_if((fd = mkstemp(path)) == -1, "%s", path);
+	unlink(path);
+	Z_die_if(well_dur_open(&dw, fd, blk_size, blk_cnt), "");
+	open = 1;
+	Z_die_if(well_dur_start(&dw, interval), "");
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		Z_die_if(pthread_create(&cons, NULL, consumer, NULL), "");
+		started++;
+		Z_die_if(pthread_create(&prod, NULL, producer, NULL), "");
+		started++;
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+		pthread_join(prod, NULL);
+		void *ret;
+		pthread_join(cons, &ret);
+		tally = (size_t)ret;
+		started = 0;
+	nlc_timing_stop(t);
+
+	well_dur_stop(&dw);
+	printf("operations %zu\n", tally);
+	printf("interval %ldus; blk_size %zu; blk_count %zu; commits %zu; blocks/commit %zu\n",
+		interval, well_blk_size(well_dur_well(&dw)), well_blk_count(well_dur_well(&dw)),
+		dw.commits, dw.commits ? tally / dw.commits : 0);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	if (started > 1)
+		pthread_join(prod, NULL);
+	if (started)
+		pthread_join(cons, NULL);
+	if (open)
+		well_dur_close(&dw);
+	if (fd != -1)
+		close(fd);
+	return err_cnt;
+}
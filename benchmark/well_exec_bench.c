@@ -0,0 +1,319 @@
+/*	well_exec_bench.c
+
+Fine-grained tasks (default 1us of spinning each) through a thread pool:
+	- 'w': work-stealing executor on wells (well_exec.h)
+	- 'm': one shared queue under a mutex, idle workers on a condvar
+Tasks come either from submitter threads outside the pool (-x),
+	or with -r from the tasks themselves: each resubmits itself,
+	so the pool is never starved by its submitters.
+*/
+
+#include <well_exec.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h> /* memset() */
+#include <pthread.h>
+#include <getopt.h>
+#include <time.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+static int kill_flag = 0;
+static char mode = 'w';
+static size_t thread_cnt = 4;
+static size_t tx_thread_cnt = 1;
+static size_t task_ns = 1000;
+static int resubmit = 0;
+static size_t lane_tasks = 256;
+static size_t batch = 16;
+
+static size_t spins = 0;	/* per task: calibrated */
+
+static struct well_exec ex;
+
+/* mode 'm' */
+struct counter {
+	size_t		n;
+} __attribute__((aligned(WELL_LINE)));
+
+static pthread_mutex_t q_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t q_cond = PTHREAD_COND_INITIALIZER;
+static struct well_task *q = NULL;
+static size_t q_cap, q_head = 0, q_tail = 0, q_waiters = 0;
+static int q_stop = 0;
+static struct counter *q_ran = NULL;
+
+
+/*	spin()
+*/
+static void spin(size_t n)
+{
+	for (size_t i=0; i < n; i++)
+		__asm__ volatile("" ::: "memory");
+}
+
+
+/*	calibrate()
+Spins per 'task_ns'.
+*/
+static size_t calibrate()
+{
+	const size_t probe = 10000000;
+	struct timespec a, b;
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	spin(probe);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	double ns = (b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec);
+	return (size_t)(probe * task_ns / ns) + 1;
+}
+
+
+/*	q_submit()
+returns 0 on success; 1 if the queue is full
+*/
+static int q_submit(void (*fn)(void *arg), void *arg)
+{
+	pthread_mutex_lock(&q_lock);
+	if (q_tail - q_head == q_cap) {
+		pthread_mutex_unlock(&q_lock);
+		return 1;
+	}
+	q[q_tail++ % q_cap] = (struct well_task){ .fn = fn, .arg = arg };
+	if (q_waiters)
+		pthread_cond_signal(&q_cond);
+	pthread_mutex_unlock(&q_lock);
+	return 0;
+}
+
+
+/*	q_worker()
+*/
+void *q_worker(void *arg)
+{
+	struct counter *ran = arg;
+	for (;;) {
+		pthread_mutex_lock(&q_lock);
+		while (q_head == q_tail && !q_stop) {
+			q_waiters++;
+			pthread_cond_wait(&q_cond, &q_lock);
+			q_waiters--;
+		}
+		if (q_head == q_tail) {
+			pthread_mutex_unlock(&q_lock);
+			break;
+		}
+		struct well_task t = q[q_head++ % q_cap];
+		pthread_mutex_unlock(&q_lock);
+
+		t.fn(t.arg);
+		__atomic_store_n(&ran->n, ran->n + 1, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+
+/*	submit()
+*/
+static int submit(void (*fn)(void *arg), void *arg)
+{
+	if (mode == 'w')
+		return well_exec_submit(&ex, fn, arg);
+	return q_submit(fn, arg);
+}
+
+
+/*	task()
+*/
+void task(void *arg)
+{
+	spin(spins);
+	/* the number of tasks in flight never changes: never full */
+	if (resubmit && !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED))
+		while (submit(task, arg))
+			FAIL_DO();
+}
+
+
+/*	tx_thread()
+*/
+void *tx_thread(void *arg)
+{
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		if (submit(task, NULL))
+			FAIL_DO();
+	}
+	return NULL;
+}
+
+
+/*	done()
+Tasks run so far.
+*/
+static size_t done()
+{
+	if (mode == 'w')
+		return well_exec_done(&ex);
+	size_t n = 0;
+	for (size_t i=0; i < thread_cnt; i++)
+		n += __atomic_load_n(&q_ran[i].n, __ATOMIC_RELAXED);
+	return n;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark a thread pool on fine-grained tasks: wells against mutex+condvar.\n\
+\n\
+Options:\n\
+-m, --mode <w|m>	:	'w' work-stealing wells; 'm' mutex and condvar.\n\
+-t, --threads <n>	:	Workers (default 4).\n\
+-x, --submitters <n>	:	Threads submitting from outside (default 1).\n\
+-u, --task-ns <ns>	:	Spin per task (default 1000).\n\
+-r, --resubmit		:	Tasks resubmit themselves; no submitter threads.\n\
+-c, --lane <n>		:	Tasks queued per worker (default 256).\n\
+-b, --batch <n>		:	Tasks a worker takes at a time, 'w' (default 16).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "threads",	required_argument,	0,	't'},
+		{ "submitters",	required_argument,	0,	'x'},
+		{ "task-ns",	required_argument,	0,	'u'},
+		{ "resubmit",	no_argument,		0,	'r'},
+		{ "lane",	required_argument,	0,	'c'},
+		{ "batch",	required_argument,	0,	'b'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t seconds = 5, tx_started = 0, q_started = 0;
+	int ex_inited = 0;
+	pthread_t tx[64], *q_threads = NULL;
+
+	while ((opt = getopt_long(argc, argv, "m:t:x:u:rc:b:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'w' && mode != 'm', "invalid mode '%s'", optarg);
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &thread_cnt);
+				Z_die_if(opt != 1 || !thread_cnt, "invalid threads '%s'", optarg);
+				break;
+
+			case 'x':
+				opt = sscanf(optarg, "%zu", &tx_thread_cnt);
+				Z_die_if(opt != 1 || !tx_thread_cnt || tx_thread_cnt > 64,
+					"invalid submitters '%s'", optarg);
+				break;
+
+			case 'u':
+				opt = sscanf(optarg, "%zu", &task_ns);
+				Z_die_if(opt != 1, "invalid task-ns '%s'", optarg);
+				break;
+
+			case 'r':
+				resubmit = 1;
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &lane_tasks);
+				Z_die_if(opt != 1 || !lane_tasks, "invalid lane '%s'", optarg);
+				break;
+
+			case 'b':
+				opt = sscanf(optarg, "%zu", &batch);
+				Z_die_if(opt != 1 || !batch, "invalid batch '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+	spins = calibrate();
+
+	if (mode == 'w') {
+		Z_die_if(well_exec_init(&ex, thread_cnt, lane_tasks, batch), "");
+		ex_inited = 1;
+	} else {
+		/* as many tasks in flight as the wells hold */
+		q_cap = lane_tasks * thread_cnt;
+		Z_die_if(!(q = calloc(q_cap, sizeof(struct well_task))), "");
+		Z_die_if(posix_memalign((void **)&q_ran, _Alignof(struct counter),
+				thread_cnt * sizeof(struct counter)), "");
+		memset(q_ran, 0x0, thread_cnt * sizeof(struct counter));
+		Z_die_if(!(q_threads = calloc(thread_cnt, sizeof(pthread_t))), "");
+		for (; q_started < thread_cnt; q_started++)
+			Z_die_if(pthread_create(&q_threads[q_started], NULL,
+					q_worker, &q_ran[q_started]), "");
+	}
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		if (resubmit) {
+			/* a few tasks per worker keep every lane busy */
+			for (size_t i=0; i < thread_cnt * 4; i++)
+				Z_die_if(submit(task, NULL), "");
+		} else {
+			for (; tx_started < tx_thread_cnt; tx_started++)
+				Z_die_if(pthread_create(&tx[tx_started], NULL, tx_thread, NULL), "");
+		}
+
+		/* this thread is the timer */
+		sleep(seconds);
+		tally = done();
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; workers %zu; %s; task %zuns\n",
+		mode, thread_cnt, resubmit ? "resubmitting" : "submitters", task_ns);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	if (ex_inited)
+		well_exec_deinit(&ex);
+	pthread_mutex_lock(&q_lock);
+	q_stop = 1;
+	pthread_cond_broadcast(&q_cond);
+	pthread_mutex_unlock(&q_lock);
+	while (q_started)
+		pthread_join(q_threads[--q_started], NULL);
+	free(q_threads);
+	free(q_ran);
+	free(q);
+	return err_cnt;
+}
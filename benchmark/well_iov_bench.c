@@ -0,0 +1,219 @@
+/*	well_iov_bench.c
+
+Compare one syscall per block against one readv() per reservation
+	when ingesting a stream (a pipe) into a well.
+*/
+
+#include <well_iov.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep(), read() */
+#include <signal.h>
+
+
+static int kill_flag = 0;
+static int fds[2] = { -1, -1 };
+static size_t blk_size = 4096;
+
+
+/*	feeder()
+Keep the pipe full until the read end is closed
+	(NOT until 'kill_flag', which could leave the reader blocked in read()).
+*/
+void *feeder(void *arg)
+{
+	size_t len = blk_size * 16;
+	char *src = malloc(len);
+	if (!src)
+		return NULL;
+	memset(src, 0x42, len);
+
+	while (write(fds[1], src, len) > 0)
+		;
+	free(src);
+	return NULL;
+}
+
+
+/*	timer()
+*/
+void *timer(void *arg)
+{
+	sleep((size_t)arg);
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+
+/*	drain()
+Stand-in consumer: hand everything on 'rx' straight back to 'tx'.
+*/
+static void drain(struct well *buf)
+{
+	size_t pos, res;
+	if ((res = well_reserve(&buf->rx, &pos, -1)))
+		well_release_single(&buf->tx, res);
+}
+
+
+/*	per_block()
+One read() per block.
+*/
+static size_t per_block(struct well *buf)
+{
+	size_t tally = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf->tx, &pos, -1))) {
+			drain(buf);
+			continue;
+		}
+		for (size_t i=0; i < res; i++) {
+			char *blk = well_access(pos, i, buf);
+			for (size_t done = 0; done < blk_size; ) {
+				ssize_t ret = read(fds[0], blk + done, blk_size - done);
+				if (ret <= 0)
+					return tally;
+				done += ret;
+			}
+		}
+		well_release_single(&buf->rx, res);
+		tally += res;
+		drain(buf);
+	}
+	return tally;
+}
+
+
+/*	batched()
+One readv() per reservation.
+*/
+static size_t batched(struct well *buf)
+{
+	size_t tally = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		ssize_t ret = well_readv_into(buf, fds[0], -1);
+		if (ret > 0)
+			tally += ret;
+		else if (!ret || errno != EAGAIN)
+			break;
+		drain(buf);
+	}
+	return tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark ingesting a pipe into a well.\n\
+\n\
+Options:\n\
+-m, --mode <b|v>	:	'b' read() per block; 'v' readv() per reservation.\n\
+-z, --size <bytes>	:	Block size (default 4096).\n\
+-c, --count <blocks>	:	Blocks in buffer (default 64).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'v';
+	size_t blk_cnt = 64, seconds = 5;
+	pthread_t feed;
+	int feeding = 0;
+	struct well buf = { {0} };
+
+	while ((opt = getopt_long(argc, argv, "m:z:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'b' && mode != 'v', "invalid mode '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(
+		well_params(blk_size, blk_cnt, &buf)
+		, "");
+	blk_size = well_blk_size(&buf);
+	Z_die_if(
+		well_init(&buf, malloc(well_size(&buf)))
+		, "size %zu", well_size(&buf));
+
+	/* feeder gets EPIPE, not a signal, when we close the read end */
+	signal(SIGPIPE, SIG_IGN);
+	Z_die_if(pipe(fds), "");
+	Z_die_if(pthread_create(&feed, NULL, feeder, NULL), "");
+	feeding = 1;
+
+	/* reader runs on this thread: checks the flag between syscalls */
+	nlc_timing_start(t);
+		pthread_t tmr;
+		Z_die_if(pthread_create(&tmr, NULL, timer, (void *)seconds), "");
+		size_t tally = mode == 'b' ? per_block(&buf) : batched(&buf);
+	nlc_timing_stop(t);
+	pthread_join(tmr, NULL);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; blk_size %zu; blk_count %zu; MiB %zu\n",
+		mode, blk_size, well_blk_count(&buf), (tally * blk_size) >> 20);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	if (feeding) {
+		close(fds[0]);
+		pthread_join(feed, NULL);
+		close(fds[1]);
+	}
+	well_deinit(&buf);
+	free(well_mem(&buf));
+	return err_cnt;
+}
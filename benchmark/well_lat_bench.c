@@ -0,0 +1,268 @@
+/*	well_lat_bench.c
+
+Per-thread reserve latency under producer contention, fair mode or not:
+	the time from a producer's first reserve attempt until it gets a block,
+	retries (FAIL_DO()) included.
+Reports percentiles over all reservations (log2 buckets: upper bounds),
+	each thread's worst case (a wait still unfinished at the end counts),
+	and how evenly reservations were spread.
+*/
+
+#include <well.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <time.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+#define BUCKETS 64	/* bucket 'b': latencies below 2^b ns */
+
+struct lat {
+	size_t		ops;
+	uint64_t	max_ns;
+	size_t		hist[BUCKETS];
+} __attribute__((aligned(WELL_LINE)));
+
+static int kill_flag = 0;
+static size_t tx_thread_cnt = 16;
+static size_t rx_thread_cnt = 1;
+static struct well buf;
+static struct lat *lats = NULL;
+
+
+/*	now_ns()
+*/
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/*	producer()
+*/
+void *producer(void *arg)
+{
+	struct lat *lat = &lats[(size_t)arg];
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos;
+		uint64_t start = now_ns();
+		while (!well_reserve(&buf.tx, &pos, 1)) {
+			if (__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+				/* still waiting counts towards the worst case */
+				if (now_ns() - start > lat->max_ns)
+					lat->max_ns = now_ns() - start;
+				return NULL;
+			}
+			FAIL_DO();
+		}
+		uint64_t ns = now_ns() - start;
+
+		lat->ops++;
+		lat->hist[ns ? 64 - __builtin_clzll(ns) : 0]++;
+		if (ns > lat->max_ns)
+			lat->max_ns = ns;
+
+		WELL_DEREF(size_t, pos, 0, &buf) = ns;
+		if (tx_thread_cnt == 1) {
+			well_release_single(&buf.rx, 1);
+		} else {
+			while (!well_release_multi(&buf.rx, 1, pos))
+				FAIL_DO();
+		}
+	}
+	return NULL;
+}
+
+
+/*	consumer()
+*/
+void *consumer(void *arg)
+{
+	size_t sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, 16))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += WELL_DEREF(size_t, pos, j, &buf);
+		if (rx_thread_cnt == 1) {
+			well_release_single(&buf.tx, res);
+		} else {
+			while (!well_release_multi(&buf.tx, res, pos))
+				FAIL_DO();
+		}
+	}
+	return (void *)sum;
+}
+
+
+/*	percentile()
+returns upper bound (ns) of the bucket holding percentile 'p'
+*/
+static uint64_t percentile(const size_t *hist, size_t total, double p)
+{
+	size_t want = (size_t)(total * p / 100), seen = 0;
+	for (int b=0; b < BUCKETS; b++) {
+		seen += hist[b];
+		if (seen > want)
+			return 1ULL << b;
+	}
+	return UINT64_MAX;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark reserve latency per producer thread, fair mode against not.\n\
+\n\
+Options:\n\
+-f, --fair		:	Fair mode (well_fair()).\n\
+-t, --producers <n>	:	Producer threads (default 16).\n\
+-x, --consumers <n>	:	Consumer threads (default 1).\n\
+-c, --count <n>		:	Blocks (default 256).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "fair",	no_argument,		0,	'f'},
+		{ "producers",	required_argument,	0,	't'},
+		{ "consumers",	required_argument,	0,	'x'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t count = 256, seconds = 5;
+	int fair = 0;
+	pthread_t tx[256], rx[64];
+	size_t tx_started = 0, rx_started = 0;
+
+	while ((opt = getopt_long(argc, argv, "ft:x:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'f':
+				fair = 1;
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &tx_thread_cnt);
+				Z_die_if(opt != 1 || !tx_thread_cnt || tx_thread_cnt > 256,
+					"invalid producers '%s'", optarg);
+				break;
+
+			case 'x':
+				opt = sscanf(optarg, "%zu", &rx_thread_cnt);
+				Z_die_if(opt != 1 || !rx_thread_cnt || rx_thread_cnt > 64,
+					"invalid consumers '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &count);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(posix_memalign((void **)&lats, _Alignof(struct lat),
+			tx_thread_cnt * sizeof(struct lat)), "");
+	memset(lats, 0, tx_thread_cnt * sizeof(struct lat));
+	Z_die_if(well_params(sizeof(size_t), count, &buf), "");
+	Z_die_if(
+		well_init(&buf, malloc(well_size(&buf)))
+		, "size %zu", well_size(&buf));
+	well_fair(&buf, fair);
+
+	nlc_timing_start(t);
+		for (; rx_started < rx_thread_cnt; rx_started++)
+			Z_die_if(pthread_create(&rx[rx_started], NULL, consumer, NULL), "");
+		for (; tx_started < tx_thread_cnt; tx_started++)
+			Z_die_if(pthread_create(&tx[tx_started], NULL, producer,
+				(void *)tx_started), "");
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+		for (; tx_started; tx_started--)
+			pthread_join(tx[tx_started-1], NULL);
+		for (; rx_started; rx_started--)
+			pthread_join(rx[rx_started-1], NULL);
+	nlc_timing_stop(t);
+
+	size_t hist[BUCKETS] = { 0 };
+	size_t total = 0, ops_min = SIZE_MAX, ops_max = 0;
+	uint64_t worst = 0, best_worst = UINT64_MAX;
+	for (size_t i=0; i < tx_thread_cnt; i++) {
+		total += lats[i].ops;
+		for (int b=0; b < BUCKETS; b++)
+			hist[b] += lats[i].hist[b];
+		if (lats[i].ops < ops_min)
+			ops_min = lats[i].ops;
+		if (lats[i].ops > ops_max)
+			ops_max = lats[i].ops;
+		if (lats[i].max_ns > worst)
+			worst = lats[i].max_ns;
+		if (lats[i].max_ns < best_worst)
+			best_worst = lats[i].max_ns;
+	}
+
+	printf("operations %zu\n", total);
+	printf("fair %d; producers %zu; consumers %zu; count %zu\n",
+		fair, tx_thread_cnt, rx_thread_cnt, count);
+	printf("reserve ns: p50 <%lu; p99 <%lu; p99.99 <%lu; max %lu\n",
+		(unsigned long)percentile(hist, total, 50),
+		(unsigned long)percentile(hist, total, 99),
+		(unsigned long)percentile(hist, total, 99.99),
+		(unsigned long)worst);
+	printf("per-thread worst ns: %lu..%lu; per-thread ops: %zu..%zu\n",
+		(unsigned long)best_worst, (unsigned long)worst, ops_min, ops_max);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	while (rx_started)
+		pthread_join(rx[--rx_started], NULL);
+	if (well_mem(&buf)) {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	}
+	free(lats);
+	return err_cnt;
+}
@@ -0,0 +1,231 @@
+/*	well_layout_bench.c
+
+Measure the cost of the control-block layout selected at build time.
+
+Many small wells are allocated back-to-back in one array (as a program
+	running one well per connection would).
+Each thread pair drives its own subset of wells; so the only sharing
+	between pairs is whatever FALSE sharing the layout allows between
+	neighbouring control blocks.
+*/
+
+#include <well.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h> /* memset() */
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+static size_t waits = 0; /* how many times did threads wait? */
+static int kill_flag = 0;
+
+static size_t well_cnt = 1024;
+static size_t pairs = 1;
+static struct well *wells = NULL;
+
+/* thread tracking */
+typedef struct {
+	void *(*func)(void *args);
+	pthread_t thread;
+	size_t idx;	/* which pair this thread belongs to */
+} a_thread;
+a_thread *threads = NULL;
+
+
+/*	consume
+Force the compiler to deference 'consume' right here, right now.
+*/
+static inline void consume(size_t consume)
+{
+	asm volatile ( "" : : [c] "r" (consume) : "memory" );
+}
+
+
+/*	tx_thread()
+Round-robin over wells 'idx', 'idx + pairs', 'idx + 2*pairs' ...
+*/
+void *tx_thread(void* arg)
+{
+	a_thread *me = arg;
+	size_t tally = 0;
+	size_t pos;
+
+	for (size_t i = me->idx; !__atomic_load_n(&kill_flag, __ATOMIC_CONSUME); ) {
+		struct well *buf = &wells[i];
+		if (!well_reserve(&buf->tx, &pos, 1)) {
+			FAIL_DO();
+			continue;
+		}
+		WELL_DEREF(size_t, pos, 0, buf) = tally++;
+		well_release_single(&buf->rx, 1);
+
+		if ((i += pairs) >= well_cnt)
+			i = me->idx;
+	}
+
+	__atomic_fetch_add(&waits, wait_count, __ATOMIC_RELAXED);
+	return (void *)tally;
+}
+
+/*	rx_thread()
+*/
+void *rx_thread(void* arg)
+{
+	a_thread *me = arg;
+	size_t tally = 0;
+	size_t pos;
+
+	for (size_t i = me->idx; !__atomic_load_n(&kill_flag, __ATOMIC_CONSUME); ) {
+		struct well *buf = &wells[i];
+		if (!well_reserve(&buf->rx, &pos, 1)) {
+			FAIL_DO();
+			continue;
+		}
+		consume( WELL_DEREF(size_t, pos, 0, buf) );
+		tally++;
+		well_release_single(&buf->tx, 1);
+
+		if ((i += pairs) >= well_cnt)
+			i = me->idx;
+	}
+
+	__atomic_fetch_add(&waits, wait_count, __ATOMIC_RELAXED);
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark the memory layout of 'struct well'.\n\
+\n\
+Notes:\n\
+- Block size is fixed at sizeof(size_t), 4 blocks per well.\n\
+- Wells are contiguous in memory: neighbours may falsely share.\n\
+\n\
+Options:\n\
+-w, --wells	:	Number of wells (default 1024).\n\
+-t, --threads	:	Number of thread PAIRS; each pair has its own wells.\n\
+-s, --seconds	:	Number of seconds to run benchmark.\n\
+-h, --help	:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "wells",	required_argument,	0,	'w'},
+		{ "threads",	required_argument,	0,	't'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t seconds = 5;
+	while ((opt = getopt_long(argc, argv, "w:t:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'w':
+				opt = sscanf(optarg, "%zu", &well_cnt);
+				Z_die_if(opt != 1, "invalid wells '%s'", optarg);
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &pairs);
+				Z_die_if(opt != 1, "invalid pairs '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+	Z_die_if(!pairs || pairs > well_cnt,
+		"%zu pairs for %zu wells", pairs, well_cnt);
+
+	size_t exec_threads = pairs * 2;
+	Z_die_if(!(
+		threads = malloc(sizeof(a_thread) * exec_threads)
+		), "malloc %zu", sizeof(a_thread) * exec_threads)
+
+	/* wells are one contiguous array, aligned as the layout requires */
+	Z_die_if(posix_memalign((void **)&wells, _Alignof(struct well),
+				sizeof(struct well) * well_cnt)
+		, "%zu wells", well_cnt);
+	memset(wells, 0x0, sizeof(struct well) * well_cnt);
+	for (size_t i=0; i < well_cnt; i++) {
+		Z_die_if(
+			well_params(sizeof(size_t), 4, &wells[i])
+			, "");
+		Z_die_if(
+			well_init(&wells[i], malloc(well_size(&wells[i])))
+			, "size %zu", well_size(&wells[i]));
+	}
+
+	for (size_t i=0; i < pairs; i++) {
+		threads[i*2] = (a_thread){ .func = tx_thread, .idx = i };
+		threads[i*2+1] = (a_thread){ .func = rx_thread, .idx = i };
+	}
+
+	/* run, dos, run */
+	nlc_timing_start(t);
+		for (size_t t=0; t < exec_threads; t++)
+			Z_die_if(
+				pthread_create(&threads[t].thread, NULL,
+						threads[t].func, &threads[t])
+			, "");
+
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELEASE);
+
+		size_t tally =0;
+		for (size_t t=0; t < exec_threads; t++) {
+			void *temp;
+			Z_die_if(
+				pthread_join(threads[t].thread, &temp)
+				, "");
+			tally += (size_t)temp;
+		}
+	nlc_timing_stop(t);
+
+	/* print stats */
+	printf("operations %zu\n", tally);
+	printf("thread pairs %zu\n", pairs);
+	printf("layout %d; sizeof(struct well) %zu; wells %zu; footprint %zu\n",
+		WELL_LAYOUT, sizeof(struct well), well_cnt,
+		sizeof(struct well) * well_cnt);
+	printf("waits: %zu\n", waits);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	if (wells) {
+		for (size_t i=0; i < well_cnt; i++) {
+			well_deinit(&wells[i]);
+			free(well_mem(&wells[i]));
+		}
+	}
+	free(wells);
+	free(threads);
+	return err_cnt;
+}
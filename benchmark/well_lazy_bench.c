@@ -0,0 +1,219 @@
+/*	well_lazy_bench.c
+
+Bursty traffic through a large, lazily committed well:
+	the producer writes a burst, then pauses; one consumer drains it.
+	- 'l': lazy commit only; pages stay committed once touched
+	- 't': the helper trims the well whenever it goes idle (MADV_DONTNEED)
+	- 'f': as 't', with MADV_FREE
+Reports throughput and the well's resident memory, sampled as it runs.
+*/
+
+#include <well_lazy.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* usleep() */
+
+
+static int kill_flag = 0;
+static size_t burst = 100000;
+static size_t pause_us = 20000;
+static size_t batch = 64;
+
+static struct well buf;
+
+
+/*	producer()
+*/
+void *producer(void *arg)
+{
+	size_t tally = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		for (size_t done=0, res=0; done < burst; done += res) {
+			size_t pos;
+			size_t want = burst - done < batch ? burst - done : batch;
+			while (!(res = well_reserve(&buf.tx, &pos, want))) {
+				if (__atomic_load_n(&kill_flag, __ATOMIC_RELAXED))
+					goto out;
+				FAIL_DO();
+			}
+			for (size_t j=0; j < res; j++)
+				memset(well_access(pos, j, &buf), (int)(tally + j), well_blk_size(&buf));
+			well_release_single(&buf.rx, res);
+			tally += res;
+		}
+		if (pause_us)
+			usleep(pause_us);
+	}
+out:
+	return (void *)tally;
+}
+
+
+/*	consumer()
+*/
+void *consumer(void *arg)
+{
+	size_t sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += *(unsigned char *)well_access(pos, j, &buf);
+		well_release_single(&buf.tx, res);
+	}
+	return (void *)sum;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark bursty traffic through a lazily committed well, with and without trimming.\n\
+\n\
+Options:\n\
+-m, --mode <l|t|f>	:	'l' lazy commit only; 't' trim when idle; 'f' trim with MADV_FREE.\n\
+-b, --burst <blocks>	:	Blocks per burst (default 100000).\n\
+-p, --pause <us>	:	Pause between bursts (default 20000).\n\
+-i, --interval <ms>	:	Helper interval (default 5).\n\
+-z, --size <bytes>	:	Block size (default 64).\n\
+-c, --count <blocks>	:	Blocks in buffer (default 1048576).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "burst",	required_argument,	0,	'b'},
+		{ "pause",	required_argument,	0,	'p'},
+		{ "interval",	required_argument,	0,	'i'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'l';
+	long interval = 5;
+	size_t blk_size = 64, blk_cnt = 1 << 20, seconds = 5;
+	struct well_lazy lz = { 0 };
+	int inited = 0, started = 0;
+	pthread_t prod, cons;
+
+	while ((opt = getopt_long(argc, argv, "m:b:p:i:z:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'l' && mode != 't' && mode != 'f',
+					"invalid mode '%s'", optarg);
+				break;
+
+			case 'b':
+				opt = sscanf(optarg, "%zu", &burst);
+				Z_die_if(opt != 1 || !burst, "invalid burst '%s'", optarg);
+				break;
+
+			case 'p':
+				opt = sscanf(optarg, "%zu", &pause_us);
+				Z_die_if(opt != 1, "invalid pause '%s'", optarg);
+				break;
+
+			case 'i':
+				opt = sscanf(optarg, "%ld", &interval);
+				Z_die_if(opt != 1 || interval < 1, "invalid interval '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_params(blk_size, blk_cnt, &buf), "");
+	Z_die_if(well_lazy_init(&buf), "size %zu", well_size(&buf));
+	inited = 1;
+	if (mode != 'l')
+		Z_die_if(well_lazy_start(&lz, &buf, interval, 0, mode == 'f' ? WELL_LAZY_FREE : 0), "");
+
+	size_t tally = 0, samples = 0, rss_sum = 0, rss_max = 0;
+	nlc_timing_start(t);
+		Z_die_if(pthread_create(&cons, NULL, consumer, NULL), "");
+		started++;
+		Z_die_if(pthread_create(&prod, NULL, producer, NULL), "");
+		started++;
+
+		/* this thread is the timer: sample RSS every 100ms meanwhile */
+		for (; samples < seconds * 10; samples++) {
+			usleep(100000);
+			size_t rss = well_lazy_resident(&buf);
+			rss_sum += rss;
+			if (rss > rss_max)
+				rss_max = rss;
+		}
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+
+		void *ret;
+		pthread_join(prod, &ret);
+		tally = (size_t)ret;
+		pthread_join(cons, NULL);
+		started = 0;
+	nlc_timing_stop(t);
+
+	well_lazy_stop(&lz);
+	printf("operations %zu\n", tally);
+	printf("mode %c; blk_size %zu; blk_count %zu; burst %zu; pause %zuus; MiB %zu\n",
+		mode, blk_size, blk_cnt, burst, pause_us, well_size(&buf) >> 20);
+	printf("resident KiB: mean %zu; max %zu; trims %zu\n",
+		samples ? (rss_sum / samples) >> 10 : 0, rss_max >> 10, lz.trims);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	if (started > 1)
+		pthread_join(prod, NULL);
+	if (started)
+		pthread_join(cons, NULL);
+	well_lazy_stop(&lz);
+	if (inited)
+		well_lazy_deinit(&buf);
+	return err_cnt;
+}
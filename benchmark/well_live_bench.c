@@ -0,0 +1,258 @@
+/*	well_live_bench.c
+
+Cost of being resizable: producers and consumers on
+	- 'w': a plain well
+	- 'l': a resizable well; with '-r', resized every so often
+*/
+
+#include <well_live.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* usleep() */
+
+
+static int kill_flag = 0;
+static size_t batch = 32;
+static size_t blk_size = 64;
+
+static struct well buf;		/* mode 'w' */
+static struct well_live lw;	/* mode 'l' */
+
+
+/*	well_tx()
+*/
+void *well_tx(void *arg)
+{
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.tx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++, i++)
+			memset(well_access(pos, j, &buf), (int)i, blk_size);
+		while (!well_release_multi(&buf.rx, res, pos))
+			FAIL_DO();
+	}
+	return NULL;
+}
+
+
+/*	well_rx()
+*/
+void *well_rx(void *arg)
+{
+	size_t tally = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			(*(unsigned char *)well_access(pos, j, &buf))++;
+		while (!well_release_multi(&buf.tx, res, pos))
+			FAIL_DO();
+		tally += res;
+	}
+	return (void *)tally;
+}
+
+
+/*	live_tx()
+*/
+void *live_tx(void *arg)
+{
+	struct well_live_local *me = well_live_join(&lw);
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		struct well *b;
+		size_t pos, res;
+		if (!(res = well_live_write(&lw, me, &b, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++, i++)
+			memset(well_access(pos, j, b), (int)i, blk_size);
+		while (!well_live_publish(me, b, res, pos))
+			FAIL_DO();
+	}
+	return NULL;
+}
+
+
+/*	live_rx()
+*/
+void *live_rx(void *arg)
+{
+	struct well_live_local *me = well_live_join(&lw);
+	size_t tally = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		struct well *b;
+		size_t pos, res;
+		if (!(res = well_live_read(&lw, me, &b, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			(*(unsigned char *)well_access(pos, j, b))++;
+		while (!well_live_done(me, b, res, pos))
+			FAIL_DO();
+		tally += res;
+	}
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark a resizable well against a plain one.\n\
+\n\
+Options:\n\
+-m, --mode <w|l>	:	'w' plain well; 'l' resizable well.\n\
+-t, --threads <n>	:	Producers, and as many consumers (default 1).\n\
+-r, --resize <ms>	:	Resize every <ms> milliseconds (default 0: never).\n\
+-z, --size <bytes>	:	Block size (default 64).\n\
+-c, --count <blocks>	:	Blocks in buffer (default 1024); resizes alternate with half.\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "threads",	required_argument,	0,	't'},
+		{ "resize",	required_argument,	0,	'r'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'w';
+	size_t thread_cnt = 1, resize_ms = 0, blk_cnt = 1024, seconds = 5;
+	pthread_t *tx = NULL, *rx = NULL;
+	size_t tx_started = 0, rx_started = 0, resizes = 0;
+	int inited = 0;
+
+	while ((opt = getopt_long(argc, argv, "m:t:r:z:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'w' && mode != 'l', "invalid mode '%s'", optarg);
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &thread_cnt);
+				Z_die_if(opt != 1 || !thread_cnt, "invalid threads '%s'", optarg);
+				break;
+
+			case 'r':
+				opt = sscanf(optarg, "%zu", &resize_ms);
+				Z_die_if(opt != 1, "invalid resize '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1 || !blk_size, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1 || blk_cnt < 2, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(!(tx = calloc(thread_cnt, sizeof(pthread_t))), "");
+	Z_die_if(!(rx = calloc(thread_cnt, sizeof(pthread_t))), "");
+	if (mode == 'w') {
+		Z_die_if(well_params(blk_size, blk_cnt, &buf), "");
+		Z_die_if(well_init(&buf, malloc(well_size(&buf))), "size %zu", well_size(&buf));
+	} else {
+		Z_die_if(well_live_init(&lw, blk_size, blk_cnt, 2 * thread_cnt), "");
+	}
+	inited = 1;
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		for (; rx_started < thread_cnt; rx_started++) {
+			Z_die_if(pthread_create(&rx[rx_started], NULL,
+				mode == 'w' ? well_rx : live_rx, NULL), "");
+		}
+		for (; tx_started < thread_cnt; tx_started++) {
+			Z_die_if(pthread_create(&tx[tx_started], NULL,
+				mode == 'w' ? well_tx : live_tx, NULL), "");
+		}
+
+		/* this thread is the timer, and the resizer */
+		if (mode == 'l' && resize_ms) {
+			for (size_t ms=0; ms < seconds * 1000; ms += resize_ms) {
+				usleep(resize_ms * 1000);
+				Z_die_if(well_resize(&lw, resizes++ & 1 ? blk_cnt : blk_cnt / 2), "");
+			}
+		} else {
+			sleep(seconds);
+		}
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+
+		for (; tx_started; tx_started--)
+			pthread_join(tx[tx_started-1], NULL);
+		for (; rx_started; rx_started--) {
+			void *ret;
+			pthread_join(rx[rx_started-1], &ret);
+			tally += (size_t)ret;
+		}
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; threads %zu+%zu; blk_size %zu; blk_count %zu; resizes %zu\n",
+		mode, thread_cnt, thread_cnt, blk_size, blk_cnt, resizes);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	while (rx_started)
+		pthread_join(rx[--rx_started], NULL);
+	free(tx);
+	free(rx);
+	if (inited && mode == 'w') {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	} else if (inited) {
+		well_live_deinit(&lw);
+	}
+	return err_cnt;
+}
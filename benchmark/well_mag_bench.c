@@ -0,0 +1,235 @@
+/*	well_mag_bench.c
+
+Compare per-thread magazines against the bare reserve/release API
+	with many threads contending on each side of a buffer.
+
+Every operation is a single block: the worst case for the bare API,
+	which contends on the shared side for every block.
+*/
+
+#include <well_mag.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+static size_t waits = 0; /* how many times did threads wait? */
+static int kill_flag = 0;
+static size_t batch = 0; /* 0 == bare API */
+
+/* thread tracking */
+typedef struct {
+	void *(*func)(void *args);
+	pthread_t thread;
+} a_thread;
+a_thread *threads = NULL;
+
+
+/*	consume
+Force the compiler to deference 'consume' right here, right now.
+*/
+static inline void consume(size_t consume)
+{
+	asm volatile ( "" : : [c] "r" (consume) : "memory" );
+}
+
+
+/*	io_bare()
+*/
+static inline size_t io_bare(	struct well *buf,
+				struct well_sym *get,
+				struct well_sym *put)
+{
+	size_t tally = 0;
+	size_t pos;
+
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_CONSUME)) {
+		if (!well_reserve(get, &pos, 1)) {
+			FAIL_DO();
+			continue;
+		}
+		consume( WELL_DEREF(size_t, pos, 0, buf) = tally++ );
+		while (!well_release_multi(put, 1, pos))
+			FAIL_DO();
+	}
+
+	__atomic_fetch_add(&waits, wait_count, __ATOMIC_RELAXED);
+	return tally;
+}
+
+/*	io_mag()
+*/
+static inline size_t io_mag(	struct well *buf,
+				struct well_sym *get,
+				struct well_sym *put)
+{
+	size_t tally = 0;
+	size_t pos;
+
+	struct well_mag mag;
+	if (well_mag_init(&mag, buf, get, put, batch))
+		return 0;
+
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_CONSUME)) {
+		if (!well_mag_reserve(&mag, &pos, 1)) {
+			FAIL_DO();
+			continue;
+		}
+		consume( WELL_DEREF(size_t, pos, 0, buf) = tally++ );
+		well_mag_release(&mag, 1);
+	}
+	well_mag_deinit(&mag);
+
+	__atomic_fetch_add(&waits, wait_count, __ATOMIC_RELAXED);
+	return tally;
+}
+
+
+void *tx_bare(void* arg)
+{
+	struct well *buf = arg;
+	return (void *)io_bare(buf, &buf->tx, &buf->rx);
+}
+void *rx_bare(void* arg)
+{
+	struct well *buf = arg;
+	return (void *)io_bare(buf, &buf->rx, &buf->tx);
+}
+void *tx_mag(void* arg)
+{
+	struct well *buf = arg;
+	return (void *)io_mag(buf, &buf->tx, &buf->rx);
+}
+void *rx_mag(void* arg)
+{
+	struct well *buf = arg;
+	return (void *)io_mag(buf, &buf->rx, &buf->tx);
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark per-thread magazines against the bare MemoryWell API.\n\
+\n\
+Notes:\n\
+- Block size is fixed at sizeof(size_t)\n\
+- Buffer is fixed at 'batch * threads * 4' blocks (at least 1024)\n\
+- Every operation reserves and releases exactly 1 block.\n\
+\n\
+Options:\n\
+-t, --threads	:	Number of thread PAIRS doing I/O on the buffer.\n\
+-b, --batch	:	Blocks claimed by each magazine; 0 uses the bare API.\n\
+-s, --seconds	:	Number of seconds to run benchmark.\n\
+-h, --help	:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "threads",	required_argument,	0,	't'},
+		{ "batch",	required_argument,	0,	'b'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t pairs = 1, seconds = 5;
+	while ((opt = getopt_long(argc, argv, "t:b:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 't':
+				opt = sscanf(optarg, "%zu", &pairs);
+				Z_die_if(opt != 1, "invalid pairs '%s'", optarg);
+				break;
+
+			case 'b':
+				opt = sscanf(optarg, "%zu", &batch);
+				Z_die_if(opt != 1, "invalid batch '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+	Z_die_if(!pairs, "need at least 1 thread pair");
+
+	size_t exec_threads = pairs * 2;
+	Z_die_if(!(
+		threads = malloc(sizeof(a_thread) * exec_threads)
+		), "malloc %zu", sizeof(a_thread) * exec_threads)
+
+	/* create buffer */
+	size_t blk_cnt = (batch ? batch : 1) * exec_threads * 4;
+	if (blk_cnt < 1024)
+		blk_cnt = 1024;
+	struct well buf = { {0} };
+	Z_die_if(
+		well_params(sizeof(size_t), blk_cnt, &buf)
+		, "");
+	Z_die_if(
+		well_init(&buf, malloc(well_size(&buf)))
+		, "size %zu", well_size(&buf));
+
+	for (size_t i=0; i < pairs; i++) {
+		threads[i*2].func = batch ? tx_mag : tx_bare;
+		threads[i*2+1].func = batch ? rx_mag : rx_bare;
+	}
+
+	/* run, dos, run */
+	nlc_timing_start(t);
+		for (size_t t=0; t < exec_threads; t++)
+			Z_die_if(
+				pthread_create(&threads[t].thread, NULL,
+						threads[t].func, &buf)
+			, "");
+
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELEASE);
+
+		size_t tally =0;
+		for (size_t t=0; t < exec_threads; t++) {
+			void *temp;
+			Z_die_if(
+				pthread_join(threads[t].thread, &temp)
+				, "");
+			tally += (size_t)temp;
+		}
+	nlc_timing_stop(t);
+
+	/* print stats */
+	printf("operations %zu\n", tally);
+	printf("thread pairs %zu\n", pairs);
+	printf("batch %zu; blk_count %zu\n", batch, well_blk_count(&buf));
+	printf("waits: %zu\n", waits);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	well_deinit(&buf);
+	free(well_mem(&buf));
+	free(threads);
+	return err_cnt;
+}
@@ -0,0 +1,214 @@
+/*	well_mmap_bench.c
+
+Scan a file in parallel: workers count one byte value in every block.
+Compare mapping the file into the well (no copy)
+	against read() into the well with well_readv_into().
+*/
+
+#include <well_mmap.h>
+#include <well_iov.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h>
+
+
+static struct well buf = { {0} };
+static struct well_mmap wm;
+static int feeding = 1;		/* feeder has not yet hit EOF */
+static size_t batch = 16;
+
+
+/*	worker()
+*/
+void *worker(void *arg)
+{
+	size_t tally = 0;
+	for (;;) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, batch))) {
+			if (!__atomic_load_n(&feeding, __ATOMIC_ACQUIRE)
+					&& !__atomic_load_n(&buf.rx.avail, __ATOMIC_ACQUIRE))
+				break;
+			FAIL_DO();
+			continue;
+		}
+
+		for (size_t i=0; i < res; i++) {
+			const unsigned char *blk = well_access(pos, i, &buf);
+			for (size_t j=0; j < well_blk_size(&buf); j++)
+				tally += blk[j] == '\n';
+		}
+
+		while (!well_release_multi(&buf.tx, res, pos))
+			FAIL_DO();
+	}
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark a parallel scan of a file through a well.\n\
+\n\
+Options:\n\
+-m, --mode <m|r>	:	'm' map the file into the well; 'r' read() into it.\n\
+-t, --threads <n>	:	Worker threads (default 2).\n\
+-l, --length <MiB>	:	Size of file to scan (default 256).\n\
+-z, --size <bytes>	:	Block size (default 65536).\n\
+-c, --count <blocks>	:	Blocks in the window (default 64).\n\
+-d, --drop		:	Drop scanned pages from the page cache.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "threads",	required_argument,	0,	't'},
+		{ "length",	required_argument,	0,	'l'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "drop",	no_argument,		0,	'd'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'm';
+	int flags = 0;
+	size_t thread_cnt = 2, mib = 256, blk_size = 65536, blk_cnt = 64;
+	int fd = -1;
+	char *data = NULL;
+	pthread_t *threads = NULL;
+	size_t started = 0;
+
+	/* '-s' accepted and ignored: the benchmark is one pass over the file */
+	while ((opt = getopt_long(argc, argv, "m:t:l:z:c:ds:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'm' && mode != 'r', "invalid mode '%s'", optarg);
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &thread_cnt);
+				Z_die_if(opt != 1 || !thread_cnt, "invalid threads '%s'", optarg);
+				break;
+
+			case 'l':
+				opt = sscanf(optarg, "%zu", &mib);
+				Z_die_if(opt != 1 || !mib, "invalid length '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 'd':
+				flags |= WELL_MMAP_DROP;
+				break;
+
+			case 's':
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	/* file: one '\n' every 64 bytes */
+	char name[] = "/tmp/well_mmap_XXXXXX";
+	Z_die_if((fd = mkstemp(name)) == -1, "");
+	unlink(name);
+	Z_die_if(!(data = malloc(1 << 20)), "");
+	memset(data, 'x', 1 << 20);
+	for (size_t i=63; i < 1 << 20; i += 64)
+		data[i] = '\n';
+	for (size_t i=0; i < mib; i++)
+		Z_die_if(write(fd, data, 1 << 20) != 1 << 20, "");
+	free(data);
+	data = NULL;
+
+	Z_die_if(well_params(blk_size, blk_cnt, &buf), "");
+	if (mode == 'm') {
+		Z_die_if(well_mmap_init(&wm, &buf, fd, flags), "");
+	} else {
+		Z_die_if(
+			well_init(&buf, malloc(well_size(&buf)))
+			, "size %zu", well_size(&buf));
+		Z_die_if(lseek(fd, 0, SEEK_SET), "");
+	}
+	Z_die_if(!(threads = calloc(thread_cnt, sizeof(pthread_t))), "");
+
+	size_t blocks = 0, lines = 0;
+	nlc_timing_start(t);
+		for (; started < thread_cnt; started++)
+			Z_die_if(pthread_create(&threads[started], NULL, worker, NULL), "");
+
+		ssize_t ret;
+		while ((ret = mode == 'm'
+					? well_mmap_feed(&wm, batch)
+					: well_readv_into(&buf, fd, batch))) {
+			if (ret > 0) {
+				blocks += ret;
+			} else if (errno == EAGAIN) {
+				FAIL_DO();
+			} else {
+				break;
+			}
+		}
+		__atomic_store_n(&feeding, 0, __ATOMIC_RELEASE);
+
+		for (; started; started--) {
+			void *tally;
+			pthread_join(threads[started-1], &tally);
+			lines += (size_t)tally;
+		}
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", blocks);
+	printf("mode %c; workers %zu; blk_size %zu; blk_count %zu; MiB %zu; lines %zu\n",
+		mode, thread_cnt, well_blk_size(&buf), well_blk_count(&buf), mib, lines);
+	printf("cpu time %.4lfs; wall time %.4lfs; %.1lf MiB/s\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t), mib / nlc_timing_wall(t));
+
+out:
+	while (started)
+		pthread_join(threads[--started], NULL);
+	free(threads);
+	if (mode == 'm') {
+		well_mmap_deinit(&wm);
+	} else {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	}
+	if (fd != -1)
+		close(fd);
+	return err_cnt;
+}
@@ -0,0 +1,315 @@
+/*	well_part_bench.c
+
+Keyed records (default 500ns of spinning each to process) which must be
+	processed in order per key:
+	- 'p': a router partitions them by key (well_part.h) over -x lanes,
+		one consumer thread each
+	- 's': a single consumer takes them straight off the input well,
+		the only way to keep order without partitioning
+Keys are uniform over -k keys; with -H that percentage of records carries
+	one hot key instead, which one consumer at most can process.
+*/
+
+#include <well_part.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h> /* memset() */
+#include <stddef.h> /* offsetof() */
+#include <pthread.h>
+#include <getopt.h>
+#include <time.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+static int kill_flag = 0;
+static char mode = 'p';
+static size_t rx_cnt = 4;	/* consumers */
+static size_t key_cnt = 4096;
+static size_t hot_pct = 0;
+static size_t rec_ns = 500;
+static size_t lane_blocks = 256;
+
+static size_t spins = 0;	/* per record: calibrated */
+
+struct record {
+	uint32_t	key;
+	uint32_t	pad;
+	size_t		val;
+};
+
+struct counter {
+	size_t		n;
+} __attribute__((aligned(WELL_LINE)));
+
+static struct well in;
+static struct well_part part;
+static struct counter *got = NULL;	/* per consumer */
+
+
+/*	spin()
+*/
+static void spin(size_t n)
+{
+	for (size_t i=0; i < n; i++)
+		__asm__ volatile("" ::: "memory");
+}
+
+
+/*	calibrate()
+Spins per 'rec_ns'.
+*/
+static size_t calibrate()
+{
+	const size_t probe = 10000000;
+	struct timespec a, b;
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	spin(probe);
+	clock_gettime(CLOCK_MONOTONIC, &b);
+	double ns = (b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec);
+	return (size_t)(probe * rec_ns / ns) + 1;
+}
+
+
+/*	tx_thread()
+*/
+void *tx_thread(void *arg)
+{
+	uint64_t rnd = 0x9e3779b97f4a7c15;
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		size_t pos, res;
+		if (!(res = well_reserve(&in.tx, &pos, 64))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			rnd ^= rnd << 13; rnd ^= rnd >> 7; rnd ^= rnd << 17;
+			struct record *r = well_access(pos, j, &in);
+			r->key = rnd % 100 < hot_pct ? 0 : rnd % key_cnt;
+			r->val = i++;
+		}
+		/* the only producer */
+		well_release_single(&in.rx, res);
+	}
+	return NULL;
+}
+
+
+/*	router()
+*/
+void *router(void *arg)
+{
+	size_t pos = 0, held = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		if (!held && !(held = well_reserve(&in.rx, &pos, 256))) {
+			FAIL_DO();
+			continue;
+		}
+		size_t res = well_part_route(&part, &in, pos, held);
+		if (!res) {
+			FAIL_DO();
+			continue;
+		}
+		well_release_single(&in.tx, res);
+		pos += res;
+		held -= res;
+	}
+	return NULL;
+}
+
+
+/*	rx_thread()
+'p': drains lane 'arg'; 's': drains 'in'.
+*/
+void *rx_thread(void *arg)
+{
+	size_t c = (size_t)arg;
+	struct well *buf = mode == 'p' ? well_part_well(&part, c) : &in;
+	size_t sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (mode == 'p')
+			res = well_part_reserve(&part, c, &pos, 16);
+		else
+			res = well_reserve(&buf->rx, &pos, 16);
+		if (!res) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			sum += ((struct record *)well_access(pos, j, buf))->val;
+			spin(spins);
+		}
+		if (mode == 'p')
+			well_part_release(&part, c, res);
+		else
+			well_release_single(&buf->tx, res);
+		__atomic_store_n(&got[c].n, got[c].n + res, __ATOMIC_RELAXED);
+	}
+	/* keep 'sum' */
+	__asm__ volatile("" :: "r"(sum));
+	return NULL;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark in-order-per-key processing: partitioned over lanes against one consumer.\n\
+\n\
+Options:\n\
+-m, --mode <p|s>	:	'p' partitioned by key; 's' a single consumer.\n\
+-x, --consumers <n>	:	'p': lanes, one consumer each (default 4).\n\
+-k, --keys <n>		:	Distinct keys (default 4096).\n\
+-H, --hot <pct>		:	Percentage of records on one hot key (default 0).\n\
+-u, --nsec <n>		:	Nanoseconds of work per record (default 500).\n\
+-c, --lane-blocks <n>	:	'p': blocks per lane (default 256).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "consumers",	required_argument,	0,	'x'},
+		{ "keys",	required_argument,	0,	'k'},
+		{ "hot",	required_argument,	0,	'H'},
+		{ "nsec",	required_argument,	0,	'u'},
+		{ "lane-blocks", required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t seconds = 5;
+	size_t tally = 0;
+	pthread_t tx, rt, *rx = NULL;
+	size_t rx_started = 0;
+	int tx_started = 0, rt_started = 0, part_inited = 0;
+
+	while ((opt = getopt_long(argc, argv, "m:x:k:H:u:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'p' && mode != 's', "invalid mode '%s'", optarg);
+				break;
+
+			case 'x':
+				opt = sscanf(optarg, "%zu", &rx_cnt);
+				Z_die_if(opt != 1 || !rx_cnt, "invalid consumers '%s'", optarg);
+				break;
+
+			case 'k':
+				opt = sscanf(optarg, "%zu", &key_cnt);
+				Z_die_if(opt != 1 || !key_cnt || key_cnt > UINT32_MAX, "invalid keys '%s'", optarg);
+				break;
+
+			case 'H':
+				opt = sscanf(optarg, "%zu", &hot_pct);
+				Z_die_if(opt != 1 || hot_pct > 100, "invalid hot '%s'", optarg);
+				break;
+
+			case 'u':
+				opt = sscanf(optarg, "%zu", &rec_ns);
+				Z_die_if(opt != 1, "invalid nsec '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &lane_blocks);
+				Z_die_if(opt != 1 || !lane_blocks, "invalid lane blocks '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+	if (mode == 's')
+		rx_cnt = 1;
+	if (rec_ns)
+		spins = calibrate();
+
+	Z_die_if(well_params(sizeof(struct record), 4096, &in), "");
+	Z_die_if(well_init(&in, malloc(well_size(&in))), "");
+	if (mode == 'p') {
+		Z_die_if(well_part_init(&part, rx_cnt, lane_blocks, sizeof(struct record),
+				offsetof(struct record, key), sizeof(uint32_t)), "");
+		part_inited = 1;
+	}
+	Z_die_if(!(rx = calloc(rx_cnt, sizeof(pthread_t))), "");
+	Z_die_if(posix_memalign((void **)&got, _Alignof(struct counter),
+			rx_cnt * sizeof(struct counter)), "");
+	memset(got, 0x0, rx_cnt * sizeof(struct counter));
+
+	{
+	nlc_timing_start(t);
+		for (; rx_started < rx_cnt; rx_started++)
+			Z_die_if(pthread_create(&rx[rx_started], NULL, rx_thread, (void *)rx_started), "");
+		if (mode == 'p') {
+			Z_die_if(pthread_create(&rt, NULL, router, NULL), "");
+			rt_started = 1;
+		}
+		Z_die_if(pthread_create(&tx, NULL, tx_thread, NULL), "");
+		tx_started = 1;
+
+		/* this thread is the timer */
+		sleep(seconds);
+		for (size_t c=0; c < rx_cnt; c++)
+			tally += __atomic_load_n(&got[c].n, __ATOMIC_RELAXED);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+
+		pthread_join(tx, NULL);
+		tx_started = 0;
+		if (rt_started)
+			pthread_join(rt, NULL);
+		rt_started = 0;
+		while (rx_started)
+			pthread_join(rx[--rx_started], NULL);
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; consumers %zu; keys %zu; hot %zu%%; %zuns per record; buckets moved %zu\n",
+		mode, rx_cnt, key_cnt, hot_pct, rec_ns, part_inited ? part.moved : 0);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+	}
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	if (tx_started)
+		pthread_join(tx, NULL);
+	if (rt_started)
+		pthread_join(rt, NULL);
+	while (rx_started)
+		pthread_join(rx[--rx_started], NULL);
+	if (part_inited)
+		well_part_deinit(&part);
+	if (well_mem(&in)) {
+		well_deinit(&in);
+		free(well_mem(&in));
+	}
+	free(rx);
+	free(got);
+	return err_cnt;
+}
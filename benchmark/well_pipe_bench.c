@@ -0,0 +1,239 @@
+/*	well_pipe_bench.c
+
+K stages, one thread each, every middle stage touching every block:
+	- 'p': one pipe; blocks processed in place
+	- 'c': a chain of K-1 wells; each middle stage copies into the next well
+*/
+
+#include <well_pipe.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+static int kill_flag = 0;
+static size_t stage_cnt = 4;
+static size_t batch = 32;
+static size_t blk_size = 64;
+
+static struct well_pipe wp;
+static struct well *wells = NULL;	/* mode 'c' */
+
+
+/*	pipe_stage()
+*/
+void *pipe_stage(void *arg)
+{
+	size_t stage = (size_t)arg;
+	size_t tally = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_pipe_reserve(&wp, stage, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			if (!stage)
+				memset(well_access(pos, j, &wp.well), (int)(tally + j), blk_size);
+			else
+				(*(unsigned char *)well_access(pos, j, &wp.well))++;
+		}
+		well_pipe_release_single(&wp, stage, res);
+		tally += res;
+	}
+	return (void *)tally;
+}
+
+
+/*	chain_stage()
+Stage 's' reads from well 's-1' and copies into well 's'.
+*/
+void *chain_stage(void *arg)
+{
+	size_t stage = (size_t)arg;
+	struct well *in = stage ? &wells[stage - 1] : NULL;
+	struct well *out = stage < stage_cnt - 1 ? &wells[stage] : NULL;
+	size_t tally = 0;
+
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t in_pos = 0, out_pos = 0, res = batch;
+		/* room to write into first: we are the only writer to 'out',
+			so an unused tail can always be unreserved
+		*/
+		if (out && !(res = well_reserve(&out->tx, &out_pos, res))) {
+			FAIL_DO();
+			continue;
+		}
+		if (in) {
+			size_t got = well_reserve(&in->rx, &in_pos, res);
+			if (out && got < res && !well_unreserve(&out->tx, out_pos + got, res - got))
+				Z_log(Z_err, "lost %zu blocks", res - got);
+			if (!(res = got)) {
+				FAIL_DO();
+				continue;
+			}
+		}
+
+		for (size_t j=0; j < res; j++) {
+			if (!in) {
+				memset(well_access(out_pos, j, out), (int)(tally + j), blk_size);
+			} else if (out) {
+				memcpy(well_access(out_pos, j, out), well_access(in_pos, j, in), blk_size);
+				(*(unsigned char *)well_access(out_pos, j, out))++;
+			}
+		}
+
+		if (in)
+			well_release_single(&in->tx, res);
+		if (out)
+			well_release_single(&out->rx, res);
+		tally += res;
+	}
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark a K-stage pipeline: one pipe in place against a chain of wells.\n\
+\n\
+Options:\n\
+-m, --mode <p|c>	:	'p' one pipe; 'c' chain of wells, copying between them.\n\
+-k, --stages <n>	:	Stages, including producer and final consumer (default 4).\n\
+-z, --size <bytes>	:	Block size (default 64).\n\
+-c, --count <blocks>	:	Blocks in each buffer (default 1024).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "stages",	required_argument,	0,	'k'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'p';
+	size_t blk_cnt = 1024, seconds = 5;
+	pthread_t *threads = NULL;
+	size_t started = 0, inited = 0;
+
+	while ((opt = getopt_long(argc, argv, "m:k:z:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'p' && mode != 'c', "invalid mode '%s'", optarg);
+				break;
+
+			case 'k':
+				opt = sscanf(optarg, "%zu", &stage_cnt);
+				Z_die_if(opt != 1 || stage_cnt < 2, "invalid stages '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1 || !blk_size, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(!(threads = calloc(stage_cnt, sizeof(pthread_t))), "");
+	if (mode == 'p') {
+		Z_die_if(well_params(blk_size, blk_cnt, &wp.well), "");
+		Z_die_if(
+			well_pipe_init(&wp, malloc(well_size(&wp.well)), stage_cnt)
+			, "size %zu", well_size(&wp.well));
+		inited = 1;
+	} else {
+		Z_die_if(posix_memalign((void **)&wells, _Alignof(struct well),
+				(stage_cnt - 1) * sizeof(struct well)), "");
+		for (; inited < stage_cnt - 1; inited++) {
+			Z_die_if(well_params(blk_size, blk_cnt, &wells[inited]), "");
+			Z_die_if(
+				well_init(&wells[inited], malloc(well_size(&wells[inited])))
+				, "size %zu", well_size(&wells[inited]));
+		}
+	}
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		for (; started < stage_cnt; started++) {
+			Z_die_if(pthread_create(&threads[started], NULL,
+				mode == 'p' ? pipe_stage : chain_stage, (void *)started), "");
+		}
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+
+		for (; started; started--) {
+			void *ret;
+			pthread_join(threads[started-1], &ret);
+			/* blocks which made it all the way through */
+			if (started == stage_cnt)
+				tally = (size_t)ret;
+		}
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; stages %zu; blk_size %zu; blk_count %zu; MiB %zu\n",
+		mode, stage_cnt, blk_size, blk_cnt, (tally * blk_size) >> 20);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	while (started)
+		pthread_join(threads[--started], NULL);
+	free(threads);
+	if (mode == 'p' && inited) {
+		well_pipe_deinit(&wp);
+		free(well_mem(&wp.well));
+	}
+	if (mode == 'c' && wells) {
+		while (inited) {
+			well_deinit(&wells[--inited]);
+			free(well_mem(&wells[inited]));
+		}
+		free(wells);
+	}
+	return err_cnt;
+}
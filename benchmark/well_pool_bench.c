@@ -0,0 +1,291 @@
+/*	well_pool_bench.c
+
+Producers allocate and fill objects, consumers free them:
+	every object is freed on a different thread than allocated it.
+Objects travel from producers to consumers through a plain well of pointers.
+Allocators:
+	- 'c': well pool, with per-thread caches
+	- 'p': well pool, no caches
+	- 'm': malloc()/free()
+	- 'f': free list under a mutex
+*/
+
+#include <well_pool.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+static int kill_flag = 0;
+static char mode = 'c';
+static size_t obj_size = 64;
+static size_t batch = 32;
+
+static struct well_pool pool;
+static struct well queue;
+
+/* mode 'f' */
+struct node {
+	struct node	*next;
+};
+static pthread_mutex_t fl_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct node *fl_head = NULL;
+static void *fl_slab = NULL;
+
+
+/*	obj_get()
+*/
+static void *obj_get(struct well_pool_cache *cache)
+{
+	switch (mode) {
+	case 'c':
+		return well_pool_cache_get(cache);
+	case 'p':
+		return well_pool_get(&pool);
+	case 'm':
+		return malloc(obj_size);
+	default:
+		pthread_mutex_lock(&fl_lock);
+		struct node *n = fl_head;
+		if (n)
+			fl_head = n->next;
+		pthread_mutex_unlock(&fl_lock);
+		return n;
+	}
+}
+
+
+/*	obj_put()
+*/
+static void obj_put(struct well_pool_cache *cache, void *obj)
+{
+	switch (mode) {
+	case 'c':
+		well_pool_cache_put(cache, obj);
+		break;
+	case 'p':
+		well_pool_put(&pool, obj);
+		break;
+	case 'm':
+		free(obj);
+		break;
+	default:
+		pthread_mutex_lock(&fl_lock);
+		((struct node *)obj)->next = fl_head;
+		fl_head = obj;
+		pthread_mutex_unlock(&fl_lock);
+	}
+}
+
+
+/*	producer()
+*/
+void *producer(void *arg)
+{
+	struct well_pool_cache cache;
+	if (mode == 'c' && well_pool_cache_init(&cache, &pool, batch))
+		return NULL;
+
+	size_t tally = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		void *obj = obj_get(&cache);
+		if (!obj) {
+			FAIL_DO();
+			continue;
+		}
+		memset(obj, (int)tally, obj_size);
+
+		size_t pos;
+		while (!well_reserve(&queue.tx, &pos, 1)) {
+			if (__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+				obj_put(&cache, obj);
+				goto out;
+			}
+			FAIL_DO();
+		}
+		WELL_DEREF(void *, pos, 0, &queue) = obj;
+		while (!well_release_multi(&queue.rx, 1, pos))
+			FAIL_DO();
+		tally++;
+	}
+out:
+	if (mode == 'c')
+		well_pool_cache_deinit(&cache);
+	return (void *)tally;
+}
+
+
+/*	consumer()
+*/
+void *consumer(void *arg)
+{
+	struct well_pool_cache cache;
+	if (mode == 'c' && well_pool_cache_init(&cache, &pool, batch))
+		return NULL;
+
+	size_t sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos;
+		if (!well_reserve(&queue.rx, &pos, 1)) {
+			FAIL_DO();
+			continue;
+		}
+		void *obj = WELL_DEREF(void *, pos, 0, &queue);
+		while (!well_release_multi(&queue.tx, 1, pos))
+			FAIL_DO();
+		sum += *(unsigned char *)obj;
+		obj_put(&cache, obj);
+	}
+	if (mode == 'c')
+		well_pool_cache_deinit(&cache);
+	return (void *)sum;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark cross-thread alloc/free: well pool against malloc and a locked free list.\n\
+\n\
+Options:\n\
+-m, --mode <c|p|m|f>	:	'c' pool + caches; 'p' pool; 'm' malloc; 'f' mutex free list.\n\
+-t, --threads <n>	:	Producers, and as many consumers (default 1).\n\
+-z, --size <bytes>	:	Object size (default 64).\n\
+-b, --batch <objs>	:	Cache batch (default 32).\n\
+-n, --objects <n>	:	Objects in pool or free list (default 4096).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "threads",	required_argument,	0,	't'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "batch",	required_argument,	0,	'b'},
+		{ "objects",	required_argument,	0,	'n'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t thread_cnt = 1, obj_cnt = 4096, seconds = 5;
+	pthread_t *tx = NULL, *rx = NULL;
+	size_t tx_started = 0, rx_started = 0;
+	int pool_inited = 0, queue_inited = 0;
+
+	while ((opt = getopt_long(argc, argv, "m:t:z:b:n:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(!strchr("cpmf", mode), "invalid mode '%s'", optarg);
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &thread_cnt);
+				Z_die_if(opt != 1 || !thread_cnt, "invalid threads '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &obj_size);
+				Z_die_if(opt != 1 || obj_size < sizeof(struct node),
+					"invalid size '%s'", optarg);
+				break;
+
+			case 'b':
+				opt = sscanf(optarg, "%zu", &batch);
+				Z_die_if(opt != 1 || !batch, "invalid batch '%s'", optarg);
+				break;
+
+			case 'n':
+				opt = sscanf(optarg, "%zu", &obj_cnt);
+				Z_die_if(opt != 1 || !obj_cnt, "invalid objects '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(!(tx = calloc(thread_cnt, sizeof(pthread_t))), "");
+	Z_die_if(!(rx = calloc(thread_cnt, sizeof(pthread_t))), "");
+	if (mode == 'c' || mode == 'p') {
+		Z_die_if(well_pool_init(&pool, obj_size, obj_cnt), "");
+		pool_inited = 1;
+	} else if (mode == 'f') {
+		Z_die_if(!(fl_slab = malloc(obj_size * obj_cnt)), "");
+		for (size_t i=0; i < obj_cnt; i++)
+			obj_put(NULL, (char *)fl_slab + i * obj_size);
+	}
+	Z_die_if(well_params(sizeof(void *), 256, &queue), "");
+	Z_die_if(well_init(&queue, malloc(well_size(&queue))), "");
+	queue_inited = 1;
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		for (; rx_started < thread_cnt; rx_started++)
+			Z_die_if(pthread_create(&rx[rx_started], NULL, consumer, NULL), "");
+		for (; tx_started < thread_cnt; tx_started++)
+			Z_die_if(pthread_create(&tx[tx_started], NULL, producer, NULL), "");
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+		for (; tx_started; tx_started--) {
+			void *ret;
+			pthread_join(tx[tx_started-1], &ret);
+			tally += (size_t)ret;
+		}
+		for (; rx_started; rx_started--)
+			pthread_join(rx[rx_started-1], NULL);
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; threads %zu+%zu; obj_size %zu; batch %zu; objects %zu\n",
+		mode, thread_cnt, thread_cnt, obj_size, batch, obj_cnt);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	while (rx_started)
+		pthread_join(rx[--rx_started], NULL);
+	free(tx);
+	free(rx);
+	/* mode 'm': objects still queued are leaked, harmlessly */
+	if (queue_inited) {
+		well_deinit(&queue);
+		free(well_mem(&queue));
+	}
+	if (pool_inited)
+		well_pool_deinit(&pool);
+	free(fl_slab);
+	return err_cnt;
+}
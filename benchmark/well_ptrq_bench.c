@@ -0,0 +1,259 @@
+/*	well_ptrq_bench.c
+
+Handing off pointers to already-allocated objects:
+	- 'p': a pointer queue (well_ptrq.h)
+	- 'w': a well with 'blk_size = sizeof(void *)'
+*/
+
+#include <well_ptrq.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+#define OBJ_CNT 4096	/* objects per producer, handed out in a loop */
+
+static int kill_flag = 0;
+static char mode = 'p';
+static size_t tx_thread_cnt = 1;
+static size_t rx_thread_cnt = 1;
+static size_t batch = 16;
+
+static struct well_ptrq q;
+static struct well buf;
+static size_t *objs = NULL;
+
+
+/*	tx_ptrq()
+*/
+void *tx_ptrq(void *arg)
+{
+	size_t *mine = objs + (size_t)arg * OBJ_CNT;
+	void *ptrs[batch];
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		for (size_t j=0; j < batch; j++)
+			ptrs[j] = &mine[(i + j) % OBJ_CNT];
+		size_t res = well_ptrq_push(&q, ptrs, batch);
+		if (!res) {
+			FAIL_DO();
+			continue;
+		}
+		i += res;
+	}
+	return NULL;
+}
+
+
+/*	rx_ptrq()
+*/
+void *rx_ptrq(void *arg)
+{
+	size_t tally = 0, sum = 0;
+	void *ptrs[batch];
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t res = well_ptrq_pop(&q, ptrs, batch);
+		if (!res) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += *(size_t *)ptrs[j];
+		tally += res;
+	}
+	return (void *)tally;
+}
+
+
+/*	tx_well()
+*/
+void *tx_well(void *arg)
+{
+	size_t *mine = objs + (size_t)arg * OBJ_CNT;
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); ) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.tx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(void *, pos, j, &buf) = &mine[(i + j) % OBJ_CNT];
+		if (tx_thread_cnt == 1) {
+			well_release_single(&buf.rx, res);
+		} else {
+			while (!well_release_multi(&buf.rx, res, pos))
+				FAIL_DO();
+		}
+		i += res;
+	}
+	return NULL;
+}
+
+
+/*	rx_well()
+*/
+void *rx_well(void *arg)
+{
+	size_t tally = 0, sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, batch))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += *WELL_DEREF(size_t *, pos, j, &buf);
+		if (rx_thread_cnt == 1) {
+			well_release_single(&buf.tx, res);
+		} else {
+			while (!well_release_multi(&buf.tx, res, pos))
+				FAIL_DO();
+		}
+		tally += res;
+	}
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark pointer handoff: pointer queue against a well of pointer-sized blocks.\n\
+\n\
+Options:\n\
+-m, --mode <p|w>	:	'p' pointer queue; 'w' well with blk_size sizeof(void *).\n\
+-t, --producers <n>	:	Producer threads (default 1).\n\
+-x, --consumers <n>	:	Consumer threads (default 1).\n\
+-b, --batch <n>		:	Pointers per push/pop (default 16).\n\
+-c, --count <n>		:	Slots (default 1024).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "producers",	required_argument,	0,	't'},
+		{ "consumers",	required_argument,	0,	'x'},
+		{ "batch",	required_argument,	0,	'b'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t count = 1024, seconds = 5;
+	pthread_t tx[64], rx[64];
+	size_t tx_started = 0, rx_started = 0;
+	int inited = 0;
+
+	while ((opt = getopt_long(argc, argv, "m:t:x:b:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'p' && mode != 'w', "invalid mode '%s'", optarg);
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &tx_thread_cnt);
+				Z_die_if(opt != 1 || !tx_thread_cnt || tx_thread_cnt > 64,
+					"invalid producers '%s'", optarg);
+				break;
+
+			case 'x':
+				opt = sscanf(optarg, "%zu", &rx_thread_cnt);
+				Z_die_if(opt != 1 || !rx_thread_cnt || rx_thread_cnt > 64,
+					"invalid consumers '%s'", optarg);
+				break;
+
+			case 'b':
+				opt = sscanf(optarg, "%zu", &batch);
+				Z_die_if(opt != 1 || !batch, "invalid batch '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &count);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(!(objs = calloc(tx_thread_cnt * OBJ_CNT, sizeof(size_t))), "");
+	if (mode == 'p') {
+		Z_die_if(well_ptrq_init(&q, count), "");
+	} else {
+		Z_die_if(well_params(sizeof(void *), count, &buf), "");
+		Z_die_if(
+			well_init(&buf, malloc(well_size(&buf)))
+			, "size %zu", well_size(&buf));
+	}
+	inited = 1;
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		for (; rx_started < rx_thread_cnt; rx_started++)
+			Z_die_if(pthread_create(&rx[rx_started], NULL,
+				mode == 'p' ? rx_ptrq : rx_well, NULL), "");
+		for (; tx_started < tx_thread_cnt; tx_started++)
+			Z_die_if(pthread_create(&tx[tx_started], NULL,
+				mode == 'p' ? tx_ptrq : tx_well, (void *)tx_started), "");
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+		for (; tx_started; tx_started--)
+			pthread_join(tx[tx_started-1], NULL);
+		for (; rx_started; rx_started--) {
+			void *ret;
+			pthread_join(rx[rx_started-1], &ret);
+			tally += (size_t)ret;
+		}
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; producers %zu; consumers %zu; batch %zu; count %zu\n",
+		mode, tx_thread_cnt, rx_thread_cnt, batch, count);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	while (rx_started)
+		pthread_join(rx[--rx_started], NULL);
+	if (inited && mode == 'p')
+		well_ptrq_deinit(&q);
+	if (inited && mode == 'w') {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	}
+	free(objs);
+	return err_cnt;
+}
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+'''well_py_bench.py
+
+Blocks/sec handed from one Python process to another:
+    - 'w': a well (python/memorywell.c); the producer copies each batch
+        into its reservation, the consumer reads it in place
+    - 'q': multiprocessing.Queue, one bytes object per batch
+The consumer looks at the first byte of every block either way.
+'''
+
+import argparse
+import multiprocessing as mp
+import os
+import queue
+import time
+import memorywell as mw
+
+
+def tx_well(w, stop, payload):
+    while not stop.is_set():
+        r = w.reserve(mw.TX, len(payload) // w.blk_size, timeout=0.1)
+        if r is None:
+            continue
+        i = 0
+        for seg in r.segments:
+            seg[:] = payload[i:i + len(seg)]
+            i += len(seg)
+        r.release()
+
+
+def rx_well(w, batch, seconds):
+    tally = 0
+    blk = w.blk_size
+    end = time.monotonic() + seconds
+    while time.monotonic() < end:
+        r = w.reserve(mw.RX, batch, timeout=0.1)
+        if r is None:
+            continue
+        for seg in r.segments:
+            tally += len(seg[::blk])
+        r.release()
+    return tally
+
+
+def tx_queue(q, stop, payload):
+    q.cancel_join_thread()
+    while not stop.is_set():
+        try:
+            q.put(payload, timeout=0.1)
+        except queue.Full:
+            pass
+
+
+def rx_queue(q, blk, seconds):
+    tally = 0
+    end = time.monotonic() + seconds
+    while time.monotonic() < end:
+        try:
+            item = q.get(timeout=0.1)
+        except queue.Empty:
+            continue
+        tally += len(memoryview(item)[::blk])
+    return tally
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Benchmark Python handoff between processes: well against multiprocessing.Queue.')
+    parser.add_argument('-m', '--mode', choices=[ 'w', 'q' ], default='w',
+                        help="'w' well; 'q' multiprocessing.Queue")
+    parser.add_argument('-z', '--blk-size', type=int, default=64,
+                        help='bytes per block (default 64)')
+    parser.add_argument('-b', '--batch', type=int, default=64,
+                        help='blocks per reservation or queue item (default 64)')
+    parser.add_argument('-c', '--count', type=int, default=4096,
+                        help='blocks in flight at most (default 4096)')
+    parser.add_argument('-s', '--seconds', type=int, default=5,
+                        help='number of seconds to run benchmark')
+    args = parser.parse_args()
+
+    ctx = mp.get_context('fork')
+    stop = ctx.Event()
+    payload = bytes(args.blk_size * args.batch)
+    if args.mode == 'w':
+        w = mw.Well(args.blk_size, args.count)
+        tx = ctx.Process(target=tx_well, args=(w, stop, payload))
+    else:
+        q = ctx.Queue(maxsize=max(1, args.count // args.batch))
+        tx = ctx.Process(target=tx_queue, args=(q, stop, payload))
+
+    cpu, wall = time.process_time(), time.monotonic()
+    tx.start()
+    if args.mode == 'w':
+        tally = rx_well(w, args.batch, args.seconds)
+    else:
+        tally = rx_queue(q, args.blk_size, args.seconds)
+    stop.set()
+    tx.join()
+    cpu, wall = time.process_time() - cpu, time.monotonic() - wall
+
+    print('operations %d' % tally)
+    print('mode %s; blk_size %d; batch %d; count %d; blocks/sec %.0f'
+          % (args.mode, args.blk_size, args.batch, args.count, tally / wall))
+    print('cpu time %.4fs; wall time %.4fs' % (cpu, wall))
+
+
+if __name__ == '__main__':
+    main()
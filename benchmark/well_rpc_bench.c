@@ -0,0 +1,359 @@
+/*	well_rpc_bench.c
+
+Round-trip latency of a call from several clients to a pool of servers:
+	- 'r': one rpc well; the response overwrites the request in place
+	- 'q': a well of pointers to heap-allocated requests;
+		the server flags completion inside the allocation
+*/
+
+#include <well_rpc.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+#define SAMPLES_MAX (1 << 20)
+
+static int kill_flag = 0;
+static int clients_left = 0;
+static int use_wait = 0;
+static size_t blk_size = 64;
+
+static struct well_rpc rpc;	/* mode 'r' */
+static struct well queue;	/* mode 'q' */
+
+struct request {
+	int	done;
+	char	data[];
+};
+
+struct samples {
+	size_t	cnt;
+	long	*ns;
+};
+
+
+/*	now_ns()
+*/
+static long now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+
+/*	record()
+*/
+static void record(struct samples *smp, long start)
+{
+	long ns = now_ns() - start;
+	if (smp->cnt < SAMPLES_MAX)
+		smp->ns[smp->cnt] = ns;
+	smp->cnt++;
+}
+
+
+/*	rpc_server()
+*/
+void *rpc_server(void *arg)
+{
+	while (__atomic_load_n(&clients_left, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_rpc_serve(&rpc, &pos, 16))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			(*(unsigned char *)well_access(pos, j, &rpc.well))++;
+		well_rpc_respond(&rpc, pos, res);
+	}
+	return NULL;
+}
+
+
+/*	rpc_client()
+*/
+void *rpc_client(void *arg)
+{
+	struct samples *smp = arg;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		long start = now_ns();
+		size_t pos;
+		while (!well_rpc_reserve(&rpc, &pos, 1))
+			FAIL_DO();
+		memset(well_access(pos, 0, &rpc.well), (int)smp->cnt, blk_size);
+		while (!well_rpc_submit_multi(&rpc, 1, pos))
+			FAIL_DO();
+
+		if (use_wait) {
+			well_rpc_wait(&rpc, pos, 1, -1);
+		} else {
+			while (!well_rpc_ready(&rpc, pos, 1))
+				FAIL_DO();
+		}
+		if (*(unsigned char *)well_access(pos, 0, &rpc.well) != (unsigned char)(smp->cnt + 1))
+			Z_log(Z_err, "bad response");
+		well_rpc_finish(&rpc, pos, 1);
+		record(smp, start);
+	}
+	__atomic_sub_fetch(&clients_left, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+
+/*	queue_server()
+*/
+void *queue_server(void *arg)
+{
+	while (__atomic_load_n(&clients_left, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&queue.rx, &pos, 16))) {
+			FAIL_DO();
+			continue;
+		}
+		struct request *reqs[16];
+		for (size_t j=0; j < res; j++)
+			reqs[j] = WELL_DEREF(struct request *, pos, j, &queue);
+		while (!well_release_multi(&queue.tx, res, pos))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++) {
+			reqs[j]->data[0]++;
+			__atomic_store_n(&reqs[j]->done, 1, __ATOMIC_RELEASE);
+		}
+	}
+	return NULL;
+}
+
+
+/*	queue_client()
+*/
+void *queue_client(void *arg)
+{
+	struct samples *smp = arg;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		long start = now_ns();
+		struct request *req = malloc(sizeof(*req) + blk_size);
+		if (!req)
+			break;
+		req->done = 0;
+		memset(req->data, (int)smp->cnt, blk_size);
+
+		size_t pos;
+		while (!well_reserve(&queue.tx, &pos, 1))
+			FAIL_DO();
+		WELL_DEREF(struct request *, pos, 0, &queue) = req;
+		while (!well_release_multi(&queue.rx, 1, pos))
+			FAIL_DO();
+
+		while (!__atomic_load_n(&req->done, __ATOMIC_ACQUIRE))
+			FAIL_DO();
+		if ((unsigned char)req->data[0] != (unsigned char)(smp->cnt + 1))
+			Z_log(Z_err, "bad response");
+		free(req);
+		record(smp, start);
+	}
+	__atomic_sub_fetch(&clients_left, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+
+/*	cmp_long()
+*/
+static int cmp_long(const void *a, const void *b)
+{
+	long x = *(const long *)a, y = *(const long *)b;
+	return (x > y) - (x < y);
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark request/response round trips: rpc well against queue + heap requests.\n\
+\n\
+Options:\n\
+-m, --mode <r|q>	:	'r' rpc well; 'q' queue of pointers to heap requests.\n\
+-x, --clients <n>	:	Client threads (default 2).\n\
+-t, --servers <n>	:	Server threads (default 1).\n\
+-w, --wait		:	Clients sleep in well_rpc_wait() instead of polling ('r').\n\
+-z, --size <bytes>	:	Request size (default 64).\n\
+-c, --count <blocks>	:	Blocks in buffer (default 256).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "clients",	required_argument,	0,	'x'},
+		{ "servers",	required_argument,	0,	't'},
+		{ "wait",	no_argument,		0,	'w'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'r';
+	size_t client_cnt = 2, server_cnt = 1;
+	size_t blk_cnt = 256, seconds = 5;
+	pthread_t *cl = NULL, *sv = NULL;
+	struct samples *smp = NULL;
+	size_t cl_started = 0, sv_started = 0;
+	int inited = 0;
+	long *all = NULL;
+
+	while ((opt = getopt_long(argc, argv, "m:x:t:wz:c:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'r' && mode != 'q', "invalid mode '%s'", optarg);
+				break;
+
+			case 'x':
+				opt = sscanf(optarg, "%zu", &client_cnt);
+				Z_die_if(opt != 1 || !client_cnt, "invalid clients '%s'", optarg);
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &server_cnt);
+				Z_die_if(opt != 1 || !server_cnt, "invalid servers '%s'", optarg);
+				break;
+
+			case 'w':
+				use_wait = 1;
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1 || !blk_size, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(!(cl = calloc(client_cnt, sizeof(pthread_t))), "");
+	Z_die_if(!(sv = calloc(server_cnt, sizeof(pthread_t))), "");
+	Z_die_if(!(smp = calloc(client_cnt, sizeof(struct samples))), "");
+	for (size_t i=0; i < client_cnt; i++)
+		Z_die_if(!(smp[i].ns = malloc(SAMPLES_MAX * sizeof(long))), "");
+
+	if (mode == 'r') {
+		Z_die_if(well_params(blk_size, blk_cnt, &rpc.well), "");
+		Z_die_if(
+			well_rpc_init(&rpc, malloc(well_size(&rpc.well)))
+			, "size %zu", well_size(&rpc.well));
+	} else {
+		Z_die_if(well_params(sizeof(struct request *), blk_cnt, &queue), "");
+		Z_die_if(
+			well_init(&queue, malloc(well_size(&queue)))
+			, "size %zu", well_size(&queue));
+	}
+	inited = 1;
+
+	clients_left = client_cnt;
+	nlc_timing_start(t);
+		for (; sv_started < server_cnt; sv_started++) {
+			Z_die_if(pthread_create(&sv[sv_started], NULL,
+				mode == 'r' ? rpc_server : queue_server, NULL), "");
+		}
+		for (; cl_started < client_cnt; cl_started++) {
+			Z_die_if(pthread_create(&cl[cl_started], NULL,
+				mode == 'r' ? rpc_client : queue_client, &smp[cl_started]), "");
+		}
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+		for (; cl_started; cl_started--)
+			pthread_join(cl[cl_started-1], NULL);
+		for (; sv_started; sv_started--)
+			pthread_join(sv[sv_started-1], NULL);
+	nlc_timing_stop(t);
+
+	size_t calls = 0, kept = 0;
+	for (size_t i=0; i < client_cnt; i++) {
+		calls += smp[i].cnt;
+		kept += smp[i].cnt < SAMPLES_MAX ? smp[i].cnt : SAMPLES_MAX;
+	}
+	Z_die_if(!(all = malloc((kept + 1) * sizeof(long))), "");
+	size_t n = 0;
+	double sum = 0;
+	for (size_t i=0; i < client_cnt; i++) {
+		for (size_t j=0; j < smp[i].cnt && j < SAMPLES_MAX; j++, n++) {
+			all[n] = smp[i].ns[j];
+			sum += all[n];
+		}
+	}
+	qsort(all, n, sizeof(long), cmp_long);
+
+	printf("operations %zu\n", calls);
+	printf("mode %c%s; clients %zu; servers %zu; blk_size %zu; blk_count %zu\n",
+		mode, use_wait && mode == 'r' ? " (wait)" : "",
+		client_cnt, server_cnt, blk_size, blk_cnt);
+	if (n) {
+		printf("round trip ns: mean %.0lf; p50 %ld; p99 %ld; max %ld\n",
+			sum / n, all[n / 2], all[n * 99 / 100], all[n - 1]);
+	}
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	while (cl_started)
+		pthread_join(cl[--cl_started], NULL);
+	__atomic_store_n(&clients_left, 0, __ATOMIC_RELAXED);
+	while (sv_started)
+		pthread_join(sv[--sv_started], NULL);
+	free(all);
+	if (smp) {
+		for (size_t i=0; i < client_cnt; i++)
+			free(smp[i].ns);
+		free(smp);
+	}
+	free(cl);
+	free(sv);
+	if (inited && mode == 'r') {
+		well_rpc_deinit(&rpc);
+		free(well_mem(&rpc.well));
+	} else if (inited) {
+		well_deinit(&queue);
+		free(well_mem(&queue));
+	}
+	return err_cnt;
+}
@@ -0,0 +1,231 @@
+/*	well_set_bench.c
+
+One consumer servicing many mostly idle wells (default 10000, 16 active):
+	- 'p': poll well_reserve() on every well, pass after pass
+	- 's': a well_set, retrying with FAIL_DO() when nothing is ready
+	- 'w': a well_set, parking in well_set_wait() when nothing is ready
+One producer writes to the active wells in turn, optionally pausing
+	between messages (-i), so the consumer's own CPU time shows what
+	it costs to wait for sparse traffic.
+*/
+
+#include <well_set.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <time.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep() */
+
+
+static int kill_flag = 0;
+static char mode = 's';
+static size_t well_cnt = 10000;
+static size_t active = 16;
+static size_t pause_us = 0;
+
+static struct well_set set;
+static struct well *wells = NULL;
+static size_t *ids = NULL;
+static double rx_cpu = 0;
+
+
+/*	producer()
+*/
+void *producer(void *arg)
+{
+	size_t stride = well_cnt / active;
+	for (size_t i=0; !__atomic_load_n(&kill_flag, __ATOMIC_RELAXED); i++) {
+		size_t w = (i % active) * stride;
+		size_t pos;
+		if (!well_reserve(&wells[w].tx, &pos, 1)) {
+			FAIL_DO();
+			continue;
+		}
+		WELL_DEREF(size_t, pos, 0, &wells[w]) = i;
+		if (mode == 'p')
+			well_release_single(&wells[w].rx, 1);
+		else
+			well_set_release(&set, ids[w], 1);
+		if (pause_us)
+			usleep(pause_us);
+	}
+	return NULL;
+}
+
+
+/*	consumer()
+*/
+void *consumer(void *arg)
+{
+	size_t tally = 0, sum = 0;
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (mode == 'p') {
+			for (size_t w=0; w < well_cnt; w++) {
+				if (!(res = well_reserve(&wells[w].rx, &pos, 16)))
+					continue;
+				for (size_t j=0; j < res; j++)
+					sum += WELL_DEREF(size_t, pos, j, &wells[w]);
+				well_release_single(&wells[w].tx, res);
+				tally += res;
+			}
+			continue;
+		}
+
+		size_t id;
+		if (!(res = well_set_reserve(&set, &id, &pos, 16))) {
+			if (mode == 'w') {
+				well_set_wait(&set, 10000000);
+			} else {
+				FAIL_DO();
+			}
+			continue;
+		}
+		struct well *buf = well_set_well(&set, id);
+		for (size_t j=0; j < res; j++)
+			sum += WELL_DEREF(size_t, pos, j, buf);
+		well_release_single(&buf->tx, res);
+		tally += res;
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	rx_cpu = ts.tv_sec + ts.tv_nsec / 1e9;
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark one consumer over many mostly idle wells: wait set against polling.\n\
+\n\
+Options:\n\
+-m, --mode <p|s|w>	:	'p' poll every well; 's' set, spin; 'w' set, park.\n\
+-n, --wells <n>		:	Wells (default 10000).\n\
+-a, --active <n>	:	Wells the producer writes to (default 16).\n\
+-i, --pause <us>	:	Producer pause between messages (default 0).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "wells",	required_argument,	0,	'n'},
+		{ "active",	required_argument,	0,	'a'},
+		{ "pause",	required_argument,	0,	'i'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	size_t seconds = 5, inited = 0;
+	int set_inited = 0, started = 0;
+	pthread_t prod, cons;
+
+	while ((opt = getopt_long(argc, argv, "m:n:a:i:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'p' && mode != 's' && mode != 'w',
+					"invalid mode '%s'", optarg);
+				break;
+
+			case 'n':
+				opt = sscanf(optarg, "%zu", &well_cnt);
+				Z_die_if(opt != 1 || !well_cnt, "invalid wells '%s'", optarg);
+				break;
+
+			case 'a':
+				opt = sscanf(optarg, "%zu", &active);
+				Z_die_if(opt != 1 || !active, "invalid active '%s'", optarg);
+				break;
+
+			case 'i':
+				opt = sscanf(optarg, "%zu", &pause_us);
+				Z_die_if(opt != 1, "invalid pause '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+	Z_die_if(active > well_cnt, "more active wells than wells");
+
+	Z_die_if(posix_memalign((void **)&wells, _Alignof(struct well),
+			well_cnt * sizeof(struct well)), "");
+	Z_die_if(!(ids = calloc(well_cnt, sizeof(size_t))), "");
+	Z_die_if(well_set_init(&set, well_cnt), "");
+	set_inited = 1;
+	for (; inited < well_cnt; inited++) {
+		Z_die_if(well_params(sizeof(size_t), 64, &wells[inited]), "");
+		Z_die_if(
+			well_init(&wells[inited], malloc(well_size(&wells[inited])))
+			, "");
+		Z_die_if(well_set_add(&set, &wells[inited], &ids[inited]), "");
+	}
+
+	size_t tally = 0;
+	nlc_timing_start(t);
+		Z_die_if(pthread_create(&cons, NULL, consumer, NULL), "");
+		started++;
+		Z_die_if(pthread_create(&prod, NULL, producer, NULL), "");
+		started++;
+
+		/* this thread is the timer */
+		sleep(seconds);
+		__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+		/* a parked consumer wakes within its timeout */
+		pthread_join(prod, NULL);
+		void *ret;
+		pthread_join(cons, &ret);
+		tally = (size_t)ret;
+		started = 0;
+	nlc_timing_stop(t);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; wells %zu; active %zu; pause %zuus; consumer cpu %.4lfs\n",
+		mode, well_cnt, active, pause_us, rx_cpu);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	if (started > 1)
+		pthread_join(prod, NULL);
+	if (started)
+		pthread_join(cons, NULL);
+	if (set_inited)
+		well_set_deinit(&set);
+	while (inited) {
+		well_deinit(&wells[--inited]);
+		free(well_mem(&wells[inited]));
+	}
+	free(wells);
+	free(ids);
+	return err_cnt;
+}
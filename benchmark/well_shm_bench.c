@@ -0,0 +1,239 @@
+/*	well_shm_bench.c
+
+IPC throughput of a well in shared memory:
+	one producer and one consumer, either as two PROCESSES (-p)
+	or as two threads of one process, on the same kind of segment.
+*/
+
+#define _GNU_SOURCE /* memfd_create() */
+#include <well_shm.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+
+/* shared between processes: anonymous MAP_SHARED page */
+struct control {
+	int		kill_flag;
+	size_t		consumed;
+};
+
+static struct control *ctl = NULL;
+static int use_futex = 0;
+static size_t batch = 64;
+static int fd = -1;
+
+
+/*	wait_on()
+*/
+static void wait_on(struct well *buf, struct well_sym *sym)
+{
+	if (use_futex) {
+		well_shm_wait(buf, sym, 1000000);
+	} else {
+		FAIL_DO();
+	}
+}
+
+
+/*	producer()
+*/
+void *producer(void *arg)
+{
+	struct well *buf = arg;
+	for (size_t i=0; !__atomic_load_n(&ctl->kill_flag, __ATOMIC_RELAXED); ) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf->tx, &pos, batch))) {
+			wait_on(buf, &buf->tx);
+			continue;
+		}
+		for (size_t j=0; j < res; j++, i++)
+			WELL_DEREF(size_t, pos, j, buf) = i;
+		well_release_single(&buf->rx, res);
+		if (use_futex)
+			well_shm_wake(buf, &buf->rx);
+	}
+	return NULL;
+}
+
+
+/*	consumer()
+Attaches its own mapping of the segment.
+*/
+void *consumer(void *arg)
+{
+	struct well *buf = well_shm_attach(fd);
+	if (!buf)
+		return NULL;
+
+	size_t tally = 0, sum = 0;
+	while (!__atomic_load_n(&ctl->kill_flag, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf->rx, &pos, batch))) {
+			wait_on(buf, &buf->rx);
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			sum += WELL_DEREF(size_t, pos, j, buf);
+		well_release_single(&buf->tx, res);
+		if (use_futex)
+			well_shm_wake(buf, &buf->tx);
+		tally += res;
+	}
+
+	__atomic_store_n(&ctl->consumed, tally, __ATOMIC_RELEASE);
+	well_shm_detach(buf);
+	return (void *)sum;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark a well in shared memory between two processes or two threads.\n\
+\n\
+Options:\n\
+-p, --processes		:	Consumer is a separate process (default: thread).\n\
+-f, --futex		:	Wait with well_shm_wait() instead of FAIL_DO().\n\
+-z, --size <bytes>	:	Block size (default 64).\n\
+-c, --count <blocks>	:	Blocks in buffer (default 1024).\n\
+-b, --batch <blocks>	:	Max blocks per reservation (default 64).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "processes",	no_argument,		0,	'p'},
+		{ "futex",	no_argument,		0,	'f'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "batch",	required_argument,	0,	'b'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	int procs = 0;
+	size_t blk_size = 64, blk_cnt = 1024, seconds = 5;
+	struct well *buf = NULL;
+	pid_t pid = -1;
+	pthread_t cons;
+	int consuming = 0;
+
+	while ((opt = getopt_long(argc, argv, "pfz:c:b:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'p':
+				procs = 1;
+				break;
+
+			case 'f':
+				use_futex = 1;
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1 || blk_size < sizeof(size_t), "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 'b':
+				opt = sscanf(optarg, "%zu", &batch);
+				Z_die_if(opt != 1 || !batch, "invalid batch '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	ctl = mmap(NULL, sizeof(*ctl), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	Z_die_if(ctl == MAP_FAILED, "");
+	Z_die_if((fd = memfd_create("well_shm_bench", 0)) == -1, "");
+	Z_die_if(!(buf = well_shm_create(fd, blk_size, blk_cnt)), "");
+
+	nlc_timing_start(t);
+		if (procs) {
+			Z_die_if((pid = fork()) < 0, "");
+			if (!pid) {
+				consumer(NULL);
+				_exit(0);
+			}
+		} else {
+			Z_die_if(pthread_create(&cons, NULL, consumer, NULL), "");
+			consuming = 1;
+		}
+
+		/* this thread is the timer */
+		pthread_t prod;
+		Z_die_if(pthread_create(&prod, NULL, producer, buf), "");
+		sleep(seconds);
+		__atomic_store_n(&ctl->kill_flag, 1, __ATOMIC_RELAXED);
+		pthread_join(prod, NULL);
+
+		if (procs) {
+			waitpid(pid, NULL, 0);
+			pid = -1;
+		} else {
+			pthread_join(cons, NULL);
+			consuming = 0;
+		}
+	nlc_timing_stop(t);
+
+	size_t ops = __atomic_load_n(&ctl->consumed, __ATOMIC_ACQUIRE);
+	printf("operations %zu\n", ops);
+	printf("%s; wait %s; blk_size %zu; blk_count %zu; batch %zu; MiB %zu\n",
+		procs ? "processes" : "threads", use_futex ? "futex" : "fail method",
+		well_blk_size(buf), well_blk_count(buf), batch,
+		(ops * well_blk_size(buf)) >> 20);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	if (ctl && ctl != MAP_FAILED)
+		__atomic_store_n(&ctl->kill_flag, 1, __ATOMIC_RELAXED);
+	if (pid > 0)
+		waitpid(pid, NULL, 0);
+	if (consuming)
+		pthread_join(cons, NULL);
+	if (buf) {
+		well_deinit(buf);
+		well_shm_detach(buf);
+	}
+	if (fd != -1)
+		close(fd);
+	return err_cnt;
+}
@@ -0,0 +1,320 @@
+/*	well_uring_bench.c
+
+Compare io_uring ingest/drain against one readv()/writev() per reservation:
+	- copying a file through a well (default)
+	- ingesting a pipe (-p)
+*/
+
+#include <well_uring.h>
+#include <well_iov.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+#include <unistd.h> /* sleep(), read() */
+#include <signal.h>
+
+
+static int kill_flag = 0;
+static size_t blk_size = 4096;
+static unsigned int depth = 8;
+
+
+/*	feeder()
+Keep the pipe full until the read end is closed.
+*/
+void *feeder(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+	size_t len = blk_size * 16;
+	char *src = malloc(len);
+	if (!src)
+		return NULL;
+	memset(src, 0x42, len);
+
+	while (write(fd, src, len) > 0)
+		;
+	free(src);
+	return NULL;
+}
+
+
+/*	timer()
+*/
+void *timer(void *arg)
+{
+	sleep((size_t)arg);
+	__atomic_store_n(&kill_flag, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+
+/*	drain()
+Stand-in consumer: hand everything on 'rx' straight back to 'tx'.
+*/
+static void drain(struct well *buf)
+{
+	size_t pos, res;
+	if ((res = well_reserve(&buf->rx, &pos, -1)))
+		well_release_single(&buf->tx, res);
+}
+
+
+/*	copy_v()
+One pass over 'src' with readv()/writev().
+*/
+static size_t copy_v(struct well *buf, int src, int dst)
+{
+	size_t tally = 0;
+	ssize_t ret;
+	lseek(src, 0, SEEK_SET);
+	lseek(dst, 0, SEEK_SET);
+
+	while ((ret = well_readv_into(buf, src, -1))) {
+		if (ret < 0 && errno != EAGAIN)
+			break;
+		while ((ret = well_writev_from(buf, dst, -1)) > 0)
+			tally += ret;
+	}
+	while ((ret = well_writev_from(buf, dst, -1)) > 0)
+		tally += ret;
+	return tally;
+}
+
+
+/*	copy_u()
+One pass over 'src' with an io_uring pump on each side.
+*/
+static size_t copy_u(struct well *buf, int src, int dst)
+{
+	size_t tally = 0;
+	struct well_uring in, out;
+	if (well_uring_ingest_init(&in, buf, src, 0, depth, 0))
+		return 0;
+	if (well_uring_drain_init(&out, buf, dst, 0, depth, 0)) {
+		well_uring_deinit(&in);
+		return 0;
+	}
+
+	int in_done = 0;
+	for (;;) {
+		ssize_t ret;
+		if (!in_done) {
+			if (!(ret = well_uring_pump(&in, 0)))
+				in_done = 1;
+			else if (ret < 0 && errno != EAGAIN)
+				break;
+		}
+		ret = well_uring_pump(&out, in_done);
+		if (ret > 0)
+			tally += ret;
+		else if (errno != EAGAIN || (in_done && buf->tx.avail == well_blk_count(buf)))
+			break;
+	}
+
+	well_uring_deinit(&in);
+	well_uring_deinit(&out);
+	return tally;
+}
+
+
+/*	ingest()
+Read the pipe until 'kill_flag'.
+*/
+static size_t ingest(struct well *buf, int fd, char mode)
+{
+	size_t tally = 0;
+	struct well_uring in;
+	if (mode == 'u' && well_uring_ingest_init(&in, buf, fd, -1, depth, 0))
+		return 0;
+
+	while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+		ssize_t ret = mode == 'u'
+			? well_uring_pump(&in, 1)
+			: well_readv_into(buf, fd, -1);
+		if (ret > 0)
+			tally += ret;
+		else if (!ret || errno != EAGAIN)
+			break;
+		drain(buf);
+	}
+
+	if (mode == 'u')
+		well_uring_deinit(&in);
+	return tally;
+}
+
+
+/*	tmp_fd()
+*/
+static int tmp_fd()
+{
+	char name[] = "/tmp/well_uring_XXXXXX";
+	int fd = mkstemp(name);
+	if (fd != -1)
+		unlink(name);
+	return fd;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Benchmark io_uring against readv()/writev() for moving data through a well.\n\
+\n\
+Options:\n\
+-m, --mode <v|u>	:	'v' readv()/writev() per reservation; 'u' io_uring.\n\
+-p, --pipe		:	Ingest a pipe instead of copying a file.\n\
+-l, --length <MiB>	:	Size of file to copy (default 64).\n\
+-z, --size <bytes>	:	Block size (default 4096).\n\
+-c, --count <blocks>	:	Blocks in buffer (default 256).\n\
+-d, --depth <ops>	:	io_uring operations in flight (default 8).\n\
+-s, --seconds		:	Number of seconds to run benchmark.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "mode",	required_argument,	0,	'm'},
+		{ "pipe",	no_argument,		0,	'p'},
+		{ "length",	required_argument,	0,	'l'},
+		{ "size",	required_argument,	0,	'z'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "depth",	required_argument,	0,	'd'},
+		{ "seconds",	required_argument,	0,	's'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	char mode = 'u';
+	int is_pipe = 0;
+	size_t blk_cnt = 256, seconds = 5, mib = 64;
+	int fds[2] = { -1, -1 };
+	char *data = NULL;
+	pthread_t feed;
+	int feeding = 0;
+	struct well buf = { {0} };
+
+	while ((opt = getopt_long(argc, argv, "m:pl:z:c:d:s:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'm':
+				mode = optarg[0];
+				Z_die_if(mode != 'v' && mode != 'u', "invalid mode '%s'", optarg);
+				break;
+
+			case 'p':
+				is_pipe = 1;
+				break;
+
+			case 'l':
+				opt = sscanf(optarg, "%zu", &mib);
+				Z_die_if(opt != 1 || !mib, "invalid length '%s'", optarg);
+				break;
+
+			case 'z':
+				opt = sscanf(optarg, "%zu", &blk_size);
+				Z_die_if(opt != 1, "invalid size '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid count '%s'", optarg);
+				break;
+
+			case 'd':
+				opt = sscanf(optarg, "%u", &depth);
+				Z_die_if(opt != 1 || !depth, "invalid depth '%s'", optarg);
+				break;
+
+			case 's':
+				opt = sscanf(optarg, "%zu", &seconds);
+				Z_die_if(opt != 1, "invalid seconds '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(
+		well_params(blk_size, blk_cnt, &buf)
+		, "");
+	blk_size = well_blk_size(&buf);
+	Z_die_if(
+		well_init(&buf, malloc(well_size(&buf)))
+		, "size %zu", well_size(&buf));
+
+	if (is_pipe) {
+		/* feeder gets EPIPE, not a signal, when we close the read end */
+		signal(SIGPIPE, SIG_IGN);
+		Z_die_if(pipe(fds), "");
+		Z_die_if(pthread_create(&feed, NULL, feeder, (void *)(intptr_t)fds[1]), "");
+		feeding = 1;
+	} else {
+		size_t len = mib << 20;
+		Z_die_if((fds[0] = tmp_fd()) == -1, "");
+		Z_die_if((fds[1] = tmp_fd()) == -1, "");
+		Z_die_if(!(data = malloc(len)), "");
+		memset(data, 0x42, len);
+		Z_die_if(write(fds[0], data, len) != (ssize_t)len, "");
+	}
+
+	nlc_timing_start(t);
+		pthread_t tmr;
+		Z_die_if(pthread_create(&tmr, NULL, timer, (void *)seconds), "");
+		size_t tally = 0;
+		if (is_pipe) {
+			tally = ingest(&buf, fds[0], mode);
+		} else {
+			while (!__atomic_load_n(&kill_flag, __ATOMIC_RELAXED)) {
+				size_t pass = mode == 'u'
+					? copy_u(&buf, fds[0], fds[1])
+					: copy_v(&buf, fds[0], fds[1]);
+				Z_die_if(!pass, "copy failed");
+				tally += pass;
+			}
+		}
+	nlc_timing_stop(t);
+	pthread_join(tmr, NULL);
+
+	printf("operations %zu\n", tally);
+	printf("mode %c; %s; blk_size %zu; blk_count %zu; depth %u; MiB %zu\n",
+		mode, is_pipe ? "pipe" : "file copy", blk_size, well_blk_count(&buf),
+		depth, (tally * blk_size) >> 20);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	if (feeding) {
+		close(fds[0]);
+		pthread_join(feed, NULL);
+		close(fds[1]);
+	} else {
+		if (fds[0] != -1)
+			close(fds[0]);
+		if (fds[1] != -1)
+			close(fds[1]);
+	}
+	free(data);
+	well_deinit(&buf);
+	free(well_mem(&buf));
+	return err_cnt;
+}
@@ -12,9 +12,17 @@
 /*	well_const
 Data which should not change after initializiation; goes on it's own
 	cache line so it's never invalid.
+
+The buffer is located by its offset from the 'struct well' itself rather than
+	by an absolute pointer, so that a well and its buffer placed in one shared
+	memory segment work at whatever address each process maps it
+	(see well_shm.h).
+The flip side: an initialized 'struct well' must NOT be moved or copied.
 */
 struct well_const {
-	void		*buf;
+	size_t		mem_offt;	/* buffer address minus 'struct well' address;
+						0 if not initialized
+					*/
 	size_t		overflow;	/* Used for quick masking of `pos` variables.
 					It's also `buf_sz -1`, and is used
 						in lieu of a dedicated `buf_sz` variable.
@@ -24,18 +32,85 @@ struct well_const {
 };
 
 
+/*
+	control-block layout
+*/
+#ifndef WELL_LAYOUT
+/* because some unices have big mutices */
+#if (WELL_TECHNIQUE == WELL_DO_MTX)
+	#define WELL_LAYOUT WELL_LAYOUT_PACKED
+#else
+	#define WELL_LAYOUT WELL_LAYOUT_PAD64
+#endif
+#endif
+
+/*	WELL_LINE
+The false-sharing granularity assumed by the layout.
+PAD128 works in PAIRS of lines: the adjacent-line prefetcher on many
+	x86 parts pulls in the 128B-aligned "buddy" of every line it fetches,
+	which re-introduces false sharing between neighbouring 64B lines.
+*/
+#if (WELL_LAYOUT == WELL_LAYOUT_PAD128)
+	#define WELL_LINE (NLC_CACHE_LINE * 2)
+#else
+	#define WELL_LINE NLC_CACHE_LINE
+#endif
+
+#if (WELL_LAYOUT == WELL_LAYOUT_PACKED)
+	#define WELL_ALIGN_
+	#define WELL_SPLIT_
+#elif (WELL_LAYOUT == WELL_LAYOUT_PAD64 || WELL_LAYOUT == WELL_LAYOUT_PAD128)
+	#define WELL_ALIGN_ __attribute__((aligned(WELL_LINE)))
+	#define WELL_SPLIT_
+#elif (WELL_LAYOUT == WELL_LAYOUT_SPLIT)
+	#define WELL_ALIGN_ __attribute__((aligned(WELL_LINE)))
+	#define WELL_SPLIT_ WELL_ALIGN_
+#else
+#error "well layout unknown"
+#endif
+
+
+/*	well_fc_slot
+FC technique: one request published to a side's combiner.
+Own line each, so a thread polling its slot does not disturb the others.
+A side's WELL_FC_SLOTS slots live outside 'struct well_sym', which only
+	locates them: the control block keeps its size and layout.
+*/
+#if (WELL_TECHNIQUE == WELL_DO_FC)
+#ifndef WELL_FC_SLOTS
+	#define WELL_FC_SLOTS 32
+#endif
+struct well_fc_slot {
+	int		state;		/* FREE, BUSY, PENDING, DONE */
+	int		op;
+	size_t		count;
+	size_t		pos;		/* in: res_pos, out: reservation pos */
+	size_t		ret;
+} __attribute__((aligned(NLC_CACHE_LINE)));
+#endif
+
+
 /*	well_sym
 One (symmetrical) half of a circular buffer.
 All counts are in BLOCKS, not bytes.
+
+In the SPLIT layout 'pos' (touched only by reservers on this side)
+	sits on a different line from 'avail' (touched by both sides).
 */
 struct well_sym {
-	size_t		pos;	/* head/tail of buffer */
-	size_t		avail;	/* can be reserved */
+	size_t		pos	WELL_SPLIT_;	/* head/tail of buffer */
+	size_t		avail	WELL_SPLIT_;	/* can be reserved */
 
 	/*
 		multi-read or multi-write contention
 	*/
 	size_t		release_pos;	/* pos of earliest release */
+	/*
+		fair mode (well_fair()): reservers served in arrival order
+	*/
+	size_t		ticket;		/* next ticket to hand out */
+	size_t		serving;	/* ticket whose turn it is */
+	int		fair;
 	/*
 		locking
 	*/
@@ -43,34 +118,30 @@ struct well_sym {
 	pthread_mutex_t lock;
 #elif (WELL_TECHNIQUE == WELL_DO_SPL)
 	char		lock;
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	char		lock;		/* held by the combiner */
+	char		fc_own;		/* slots allocated by well_sym_init() */
+	unsigned	fc_hi;		/* slots above this never used: not scanned */
+	ptrdiff_t	fc_offt;	/* slots address minus 'well_sym' address */
 #endif
 };
 
 
 
-/* because some unices have big mutices */
-#if (WELL_TECHNIQUE == WELL_DO_MTX)
-	struct well {
-		struct well_const	ct;
-		struct well_sym		tx;
-		struct well_sym		rx;
-	};
+/*	well
+A circular buffer.
 
-
-/* try and avoid false sharing by splitting cache lines */
-#else
-	struct well {
-		/* cache line 1: all the unchanging stuff that is never invalidated */
-		struct well_const	ct;
-		unsigned char		pad_ln1[NLC_CACHE_LINE - sizeof(struct well_const)];
-		/* cache line 2: tx side */
-		struct well_sym		tx;
-		unsigned char		pad_ln2[NLC_CACHE_LINE - sizeof(struct well_sym)];
-		/* cache line 3: rx side */
-		struct well_sym		rx;
-		unsigned char		pad_ln3[NLC_CACHE_LINE - sizeof(struct well_sym)];
-	};
-#endif
+Unless the layout is PACKED, each of the 3 members starts on its own
+	WELL_LINE so that the unchanging 'ct' is never invalidated
+	and the 'tx' and 'rx' sides do not falsely share.
+Callers allocating a 'struct well' on the heap should use an allocator
+	which honors _Alignof(struct well) (e.g. posix_memalign()).
+*/
+struct well {
+	struct well_const	ct	WELL_ALIGN_;
+	struct well_sym		tx	WELL_ALIGN_;
+	struct well_sym		rx	WELL_ALIGN_;
+};
 
 
 /*	well_size()
@@ -116,7 +187,7 @@ Both are inefficient.
 NLC_INLINE void *well_access(size_t pos, size_t i, const struct well *buf)
 {
 	size_t offt = (pos + i) << buf->ct.blk_shift;
-	return buf->ct.buf + (offt & buf->ct.overflow);
+	return (void *)((uintptr_t)buf + buf->ct.mem_offt + (offt & buf->ct.overflow));
 }
 
 /*	WELL_DEREF()
@@ -135,9 +206,11 @@ DANGER: never use this function to access data inside the buffer;
 This function exists so caller can stash their pointer inside
 	'struct well' without knowing the internals.
 */
-NLC_INLINE void *well_mem(struct well *buf)
+NLC_INLINE void *well_mem(const struct well *buf)
 {
-	return buf->ct.buf;
+	if (!buf->ct.mem_offt)
+		return NULL;
+	return (void *)((uintptr_t)buf + buf->ct.mem_offt);
 }
 
 
@@ -151,8 +224,25 @@ NLC_PUBLIC int	well_params(	size_t		blk_size,
 NLC_PUBLIC int	well_init(	struct well	*buf,
 				void		*mem);
 
+NLC_PUBLIC int	well_init_pshared(struct well	*buf,
+				void		*mem,
+				int		pshared);
+
 NLC_PUBLIC void	well_deinit(	struct well	*buf);
 
+NLC_PUBLIC int	well_sym_init(	struct well_sym	*sym,
+				int		pshared);
+
+NLC_PUBLIC void	well_sym_deinit(struct well_sym	*sym);
+
+#if (WELL_TECHNIQUE == WELL_DO_FC)
+NLC_PUBLIC void	well_sym_fc_place(struct well_sym	*sym,
+				struct well_fc_slot	*slots);
+#endif
+
+NLC_PUBLIC void	well_fair(	struct well	*buf,
+				int		fair);
+
 /*
 	reserve
 */
@@ -161,10 +251,20 @@ NLC_PUBLIC __attribute__((warn_unused_result))
 				size_t		*out_pos,
 				size_t		max_count);
 
+NLC_PUBLIC __attribute__((warn_unused_result))
+	size_t well_reserve_exact(struct well_sym *from,
+				size_t		*out_pos,
+				size_t		count);
+
+NLC_PUBLIC __attribute__((warn_unused_result))
+	size_t well_unreserve(	struct well_sym	*from,
+				size_t		pos,
+				size_t		count);
+
 /*
 	release
 */
-NLC_PUBLIC void	well_release_single(	struct well_sym	*to,
+NLC_PUBLIC size_t	well_release_single(	struct well_sym	*to,
 					size_t		count);
 
 NLC_PUBLIC __attribute__((warn_unused_result))
@@ -0,0 +1,117 @@
+#ifndef well_bcast_h_
+#define well_bcast_h_
+
+/*	well_bcast.h
+
+Broadcast (fan-out): EVERY consumer sees EVERY block,
+	in the style of a disruptor ring.
+
+Producers use the 'tx' side exactly as usual:
+	reserve with well_bcast_reserve(), write, then publish with
+	well_bcast_publish() (one producer) or well_bcast_publish_multi() (several).
+Publishing releases to 'rx' as usual; since no one reserves from 'rx',
+	'rx.avail' simply counts every block ever published.
+
+Each consumer has its own read cursor on its own cache line,
+	and reads independently, in batches of any size:
+	well_bcast_read() then well_bcast_done().
+A slot is only reusable once the SLOWEST consumer is done with it:
+	producers reclaim slots when they run out (well_bcast_reclaim()).
+
+Consumers are fixed at init and are numbered 0 to 'consumers'-1;
+	each must be used by ONE thread at a time.
+A consumer which stops reading must call well_bcast_leave(),
+	or it will eventually stall every producer.
+*/
+
+#include <well.h>
+
+
+/*	well_cursor
+A consumer's next block to read.
+Always on its own line, whatever the layout: it is written on every read.
+*/
+struct well_cursor {
+	size_t		pos	__attribute__((aligned(WELL_LINE)));
+};
+
+
+struct well_bcast {
+	struct well		well;
+	size_t			reclaimed	__attribute__((aligned(WELL_LINE)));
+	size_t			cnt;
+	struct well_cursor	*cursors;
+};
+
+
+#define WELL_CURSOR_GONE ((size_t)-1)
+
+
+NLC_PUBLIC int		well_bcast_init(	struct well_bcast	*bc,
+						void			*mem,
+						size_t			consumers);
+
+NLC_PUBLIC void		well_bcast_deinit(	struct well_bcast	*bc);
+
+NLC_PUBLIC size_t	well_bcast_reclaim(	struct well_bcast	*bc);
+
+NLC_PUBLIC void		well_bcast_leave(	struct well_bcast	*bc,
+						size_t			id);
+
+
+/*	well_bcast_reserve()
+As well_reserve() on 'tx': reclaims slots from consumers if none are free.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_bcast_reserve(struct well_bcast *bc, size_t *out_pos, size_t max_count)
+{
+	size_t res = well_reserve(&bc->well.tx, out_pos, max_count);
+	if (!res && well_bcast_reclaim(bc))
+		res = well_reserve(&bc->well.tx, out_pos, max_count);
+	return res;
+}
+
+/*	well_bcast_publish()
+Make 'count' blocks visible to all consumers. Single producer only.
+*/
+NLC_INLINE void well_bcast_publish(struct well_bcast *bc, size_t count)
+{
+	well_release_single(&bc->well.rx, count);
+}
+
+/*	well_bcast_publish_multi()
+As well_bcast_publish() for several producers: see well_release_multi().
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_bcast_publish_multi(struct well_bcast *bc, size_t count, size_t res_pos)
+{
+	return well_release_multi(&bc->well.rx, count, res_pos);
+}
+
+
+/*	well_bcast_read()
+Blocks published but not yet read by consumer 'id':
+	up to 'max_count' of them, starting at '*out_pos'.
+Use well_access() on '&bc->well' as usual.
+
+returns number of blocks readable (0 if none).
+*/
+NLC_INLINE size_t well_bcast_read(struct well_bcast *bc, size_t id,
+					size_t *out_pos, size_t max_count)
+{
+	size_t pos = bc->cursors[id].pos;
+	size_t count = __atomic_load_n(&bc->well.rx.avail, __ATOMIC_ACQUIRE) - pos;
+	*out_pos = pos;
+	return count < max_count ? count : max_count;
+}
+
+/*	well_bcast_done()
+Consumer 'id' is finished with the next 'count' blocks.
+*/
+NLC_INLINE void well_bcast_done(struct well_bcast *bc, size_t id, size_t count)
+{
+	__atomic_store_n(&bc->cursors[id].pos, bc->cursors[id].pos + count, __ATOMIC_RELEASE);
+}
+
+
+#endif /* well_bcast_h_ */
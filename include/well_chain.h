@@ -0,0 +1,145 @@
+#ifndef well_chain_h_
+#define well_chain_h_
+
+/*	well_chain.h
+
+Unbounded queue: a chain of wells ("segments") of one size.
+
+While the consumer keeps up, the chain is a single segment used as an
+	ordinary well: the fast path is one well_reserve() and one release.
+When the producer finds its segment full it links a new one and carries on
+	there, so a burst grows the queue instead of pushing back on the producer.
+The consumer drains each segment in turn, then follows the link.
+Drained segments are recycled to the producer through a small well of
+	pointers ('spare'), so steady state allocates nothing;
+	once 'spare' is full, drained segments are freed:
+	memory shrinks back when the burst ends.
+
+ONE producer thread and ONE consumer thread per chain
+	(e.g. one chain per network thread).
+Both release in the order they reserve, as with well_release_single().
+Always access blocks through the 'struct well' returned with each reservation.
+*/
+
+#include <well.h>
+
+
+/*	well_seg
+The producer publishes 'next' only once it has released everything it
+	reserved in this segment: the consumer never leaves a segment early.
+*/
+struct well_seg {
+	struct well		well;
+	struct well_seg		*next	__attribute__((aligned(WELL_LINE)));
+	/* producer only */
+	struct well_seg		*succ;		/* 'next', before it is published */
+	size_t			pending;	/* reserved but not yet released */
+};
+
+
+struct well_chain {
+	size_t			blk_size;
+	size_t			blk_cnt;
+	struct well		spare;		/* drained segments: consumer to producer */
+	/* producer */
+	struct well_seg		*tail	__attribute__((aligned(WELL_LINE)));
+	size_t			grown;		/* segments ever allocated */
+	/* consumer */
+	struct well_seg		*head	__attribute__((aligned(WELL_LINE)));
+	struct well_seg		*first;		/* oldest segment not yet recycled */
+	size_t			freed;		/* segments ever freed */
+};
+
+
+NLC_PUBLIC int			well_chain_init(	struct well_chain	*chain,
+								size_t			blk_size,
+								size_t			blk_cnt,
+								size_t			keep);
+
+NLC_PUBLIC void			well_chain_deinit(	struct well_chain	*chain);
+
+NLC_PUBLIC struct well_seg	*well_chain_grow(	struct well_chain	*chain);
+
+NLC_PUBLIC struct well_seg	*well_chain_advance(	struct well_chain	*chain);
+
+NLC_PUBLIC void			well_chain_retire(	struct well_chain	*chain);
+
+
+/*	well_chain_segments()
+Segments currently allocated (approximate while in use).
+*/
+NLC_INLINE size_t well_chain_segments(const struct well_chain *chain)
+{
+	return __atomic_load_n(&chain->grown, __ATOMIC_RELAXED)
+		- __atomic_load_n(&chain->freed, __ATOMIC_RELAXED);
+}
+
+
+/*	well_chain_reserve()
+Producer: as well_reserve() on 'tx', growing the chain if the tail is full.
+Writes the segment the blocks are in to '*out_buf'.
+
+returns number of blocks reserved; 0 only if a new segment could not be allocated.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_chain_reserve(struct well_chain *chain, struct well **out_buf,
+					size_t *out_pos, size_t max_count)
+{
+	struct well_seg *seg = chain->tail;
+	size_t res = well_reserve(&seg->well.tx, out_pos, max_count);
+	if (!res) {
+		if (!(seg = well_chain_grow(chain)))
+			return 0;
+		res = well_reserve(&seg->well.tx, out_pos, max_count);
+	}
+	seg->pending += res;
+	*out_buf = &seg->well;
+	return res;
+}
+
+/*	well_chain_release()
+Producer: publish 'count' blocks reserved in 'buf'.
+*/
+NLC_INLINE void well_chain_release(struct well_chain *chain, struct well *buf, size_t count)
+{
+	struct well_seg *seg = (struct well_seg *)buf;
+	well_release_single(&buf->rx, count);
+	seg->pending -= count;
+	if (seg != chain->tail && !seg->pending)
+		__atomic_store_n(&seg->next, seg->succ, __ATOMIC_RELEASE);
+}
+
+
+/*	well_chain_take()
+Consumer: as well_reserve() on 'rx', moving on to the next segment
+	once the current one is drained.
+Writes the segment the blocks are in to '*out_buf'.
+
+returns number of blocks reserved; 0 if the queue is empty.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_chain_take(struct well_chain *chain, struct well **out_buf,
+					size_t *out_pos, size_t max_count)
+{
+	struct well_seg *seg = chain->head;
+	size_t res;
+	while (!(res = well_reserve(&seg->well.rx, out_pos, max_count))) {
+		if (!(seg = well_chain_advance(chain)))
+			return 0;
+	}
+	*out_buf = &seg->well;
+	return res;
+}
+
+/*	well_chain_done()
+Consumer: finished with 'count' blocks taken from 'buf'.
+*/
+NLC_INLINE void well_chain_done(struct well_chain *chain, struct well *buf, size_t count)
+{
+	well_release_single(&buf->tx, count);
+	if (chain->first != chain->head)
+		well_chain_retire(chain);
+}
+
+
+#endif /* well_chain_h_ */
@@ -0,0 +1,57 @@
+#ifndef well_copy_h_
+#define well_copy_h_
+
+/*	well_copy.h
+
+Bulk copies into and out of reservations, for large blocks.
+
+well_copy_in() and well_copy_out() copy 'len' bytes to or from the blocks
+	of a reservation starting at 'pos', across the wrap if need be.
+Copies of at least well_copy_nt_min() bytes use non-temporal (streaming)
+	stores: they go to memory without evicting the copier's cache,
+	which the producer does not need the data in, and the consumer's
+	working set is not pushed out by data it only passes through.
+Smaller copies use memcpy().
+The kernel is picked once at runtime from what the CPU supports:
+	AVX-512, AVX2, SSE2, or memcpy() alone on other architectures
+	(see well_copy_isa()).
+Streaming stores are weakly ordered: both functions end with a store fence,
+	so a release right after them publishes the data as usual.
+
+Prefetching: the NEXT reservation from a side starts at that side's 'pos'.
+	A producer can call well_prefetch_next(&buf->tx, ..., 1) before
+	filling its current blocks, a consumer well_prefetch_next(&buf->rx, ...)
+	before processing its own.
+*/
+
+#include <well.h>
+
+
+NLC_PUBLIC void		well_copy_in(	struct well	*buf,
+					size_t		pos,
+					const void	*src,
+					size_t		len);
+
+NLC_PUBLIC void		well_copy_out(	const struct well *buf,
+					size_t		pos,
+					void		*dst,
+					size_t		len);
+
+NLC_PUBLIC size_t	well_copy_nt_min(void);
+
+NLC_PUBLIC void		well_copy_set_nt_min(size_t	bytes);
+
+NLC_PUBLIC const char	*well_copy_isa(void);
+
+NLC_PUBLIC void		well_prefetch(	const struct well *buf,
+					size_t		pos,
+					size_t		len,
+					int		for_write);
+
+NLC_PUBLIC void		well_prefetch_next(const struct well *buf,
+					struct well_sym	*from,
+					size_t		len,
+					int		for_write);
+
+
+#endif /* well_copy_h_ */
@@ -0,0 +1,428 @@
+#ifndef well_coro_hpp_
+#define well_coro_hpp_
+
+/*	well_coro.hpp
+
+C++20 coroutine awaitables on a well: a coroutine which cannot reserve
+	(side empty or full) or cannot release yet (an earlier reservation
+	is still outstanding) suspends, and is resumed on its executor
+	by the release which may let it through.
+No thread blocks, and no await allocates: each waiting awaiter sits
+	on an intrusive list of its side, inside the coroutine frame.
+
+	well_coro::channel ch(&buf);
+	well_coro::reservation r = co_await ch.tx.reserve(16);
+	...write blocks [r.pos, r.pos + r.count)...
+	co_await ch.rx.release(r);
+
+Every side keeps a lock-free stack of parked awaiters.
+A release to a side wakes all of them (they retry, and park again
+	if they lose): a release costs one fence and one load of that
+	list when nobody is waiting.
+No wakeup is lost: an awaiter pushes itself BEFORE checking the side again,
+	a release updates the side BEFORE checking the list.
+
+Coroutines are 'well_coro::task's, started with spawn() on an executor:
+	- 'loop': single-threaded, runs on the thread calling run();
+	- 'pool': a work-stealing pool (well_exec.h) of some threads.
+Any thread may release (and so wake coroutines), coroutine or not.
+
+RULES:
+	- reserve and release on a side only through its 'side'
+		(or call wake() after releasing behind its back).
+	- a parked coroutine waits for the other side of the well:
+		if nobody ever releases there, it never resumes.
+*/
+
+extern "C" {
+#include <well.h>
+#include <well_exec.h>
+}
+#include <atomic>
+#include <coroutine>
+#include <exception> /* std::terminate() */
+#include <thread> /* std::this_thread::yield() */
+
+
+namespace well_coro {
+
+
+/*	work
+Something an executor runs.
+Intrusive: posting it allocates nothing.
+*/
+struct work {
+	work		*next = nullptr;
+	void		(*run)(work *w) = nullptr;
+};
+
+
+/*	executor
+*/
+class executor {
+public:
+	virtual void		post(work *w) = 0;
+	std::atomic<size_t>	live{0};	/* coroutines spawned, not finished */
+
+protected:
+	~executor() = default;
+};
+
+
+/*	loop
+Single-threaded executor: everything runs inside run(),
+	on the calling thread; other threads may post to it.
+*/
+class loop : public executor {
+	std::atomic<work *>	incoming_{nullptr};
+
+public:
+	void post(work *w) override
+	{
+		work *head = incoming_.load(std::memory_order_relaxed);
+		do {
+			w->next = head;
+		} while (!incoming_.compare_exchange_weak(head, w,
+				std::memory_order_release, std::memory_order_relaxed));
+		if (!head)
+			incoming_.notify_one();
+	}
+
+	/*	run()
+	Run until every coroutine spawned on the loop has finished:
+		spawn at least one first.
+	*/
+	void run()
+	{
+		while (live.load(std::memory_order_acquire)) {
+			work *w = incoming_.exchange(nullptr, std::memory_order_acquire);
+			if (!w) {
+				incoming_.wait(nullptr, std::memory_order_acquire);
+				continue;
+			}
+			/* posted last first: run in posting order */
+			work *fifo = nullptr;
+			while (w) {
+				work *n = w->next;
+				w->next = fifo;
+				fifo = w;
+				w = n;
+			}
+			while (fifo) {
+				work *n = fifo->next;
+				fifo->run(fifo);
+				fifo = n;
+			}
+		}
+	}
+};
+
+
+/*	pool
+Multi-threaded executor on a work-stealing pool (well_exec.h).
+*/
+class pool : public executor {
+	struct well_exec	ex_ {};
+
+	static void run_(void *arg)
+	{
+		work *w = static_cast<work *>(arg);
+		w->run(w);
+	}
+
+public:
+	/*	init()
+	returns 0 on success
+	*/
+	int init(size_t threads, size_t lane_tasks = 256, size_t batch = 16)
+	{
+		return well_exec_init(&ex_, threads, lane_tasks, batch);
+	}
+
+	~pool()
+	{
+		well_exec_deinit(&ex_);
+	}
+
+	void post(work *w) override
+	{
+		/* a full pool drains without us */
+		while (well_exec_submit(&ex_, run_, w))
+			std::this_thread::yield();
+	}
+
+	/*	join()
+	Wait until every coroutine spawned on the pool has finished.
+	*/
+	void join()
+	{
+		for (size_t n; (n = live.load(std::memory_order_acquire)); )
+			live.wait(n, std::memory_order_acquire);
+	}
+};
+
+
+/*	task
+A coroutine which runs on an executor once spawn()ed,
+	and frees itself when done.
+*/
+struct task {
+	struct promise_type : work {
+		executor	*exec = nullptr;
+
+		task get_return_object()
+		{
+			return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+		}
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept
+		{
+			if (exec->live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				exec->live.notify_all();
+			return {};
+		}
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	std::coroutine_handle<promise_type>	h;
+};
+
+
+/*	spawn()
+Start 't' on 'ex'.
+*/
+inline void spawn(executor &ex, task t)
+{
+	task::promise_type &p = t.h.promise();
+	p.exec = &ex;
+	p.run = [](work *w) {
+		auto *p = static_cast<task::promise_type *>(w);
+		std::coroutine_handle<task::promise_type>::from_promise(*p).resume();
+	};
+	ex.live.fetch_add(1, std::memory_order_relaxed);
+	ex.post(&p);
+}
+
+
+struct reservation {
+	size_t		pos;
+	size_t		count;
+};
+
+
+/*	waiter
+A suspended awaiter: on its side's list while parked,
+	on its executor's queue while being retried.
+*/
+struct waiter : work {
+	waiter			*link = nullptr;
+	std::coroutine_handle<>	h;
+	executor		*exec = nullptr;
+};
+
+
+/*	side
+One side of a well ('tx' or 'rx'), and the coroutines waiting on it.
+*/
+class side {
+	struct well_sym		*sym_;
+	std::atomic<waiter *>	waiters_{nullptr};
+
+	void push_(waiter *w)
+	{
+		waiter *head = waiters_.load(std::memory_order_relaxed);
+		do {
+			w->link = head;
+		} while (!waiters_.compare_exchange_weak(head, w,
+				std::memory_order_release, std::memory_order_relaxed));
+		/* pairs with the fence in wake() */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+public:
+	class reserve_op;
+	class release_op;
+
+	explicit side(struct well_sym *sym) : sym_(sym) {}
+	struct well_sym *sym() { return sym_; }
+
+	/*	park_reserve()
+	Wait for blocks to reserve.
+	'w' may be resumed as soon as it is pushed: never touched after.
+	*/
+	void park_reserve(waiter *w)
+	{
+		push_(w);
+		if (__atomic_load_n(&sym_->avail, __ATOMIC_RELAXED))
+			wake_all();
+	}
+
+	/*	park_release()
+	Wait for 'release_pos' to reach 'pos'.
+	*/
+	void park_release(waiter *w, size_t pos)
+	{
+		push_(w);
+		if (__atomic_load_n(&sym_->release_pos, __ATOMIC_RELAXED) == pos)
+			wake_all();
+	}
+
+	/*	wake_all()
+	Have every parked coroutine retry.
+	*/
+	void wake_all()
+	{
+		waiter *w = waiters_.exchange(nullptr, std::memory_order_acquire);
+		while (w) {
+			waiter *n = w->link;
+			w->exec->post(w);
+			w = n;
+		}
+	}
+
+	/*	wake()
+	After a release to this side: cheap if nobody waits.
+	*/
+	void wake()
+	{
+		/* pairs with the fence in push_() */
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters_.load(std::memory_order_relaxed))
+			wake_all();
+	}
+
+	reserve_op reserve(size_t max_count);
+	release_op release(size_t count, size_t pos);
+	release_op release(reservation r);
+
+	/*	release_single()
+	As well_release_single(): the only thread releasing to this side.
+	returns previous 'avail'
+	*/
+	size_t release_single(size_t count)
+	{
+		size_t prev = well_release_single(sym_, count);
+		wake();
+		return prev;
+	}
+};
+
+
+/*	side::reserve_op
+co_await: as well_reserve(), suspending until it succeeds.
+*/
+class side::reserve_op : waiter {
+	side		&s_;
+	size_t		max_;
+	reservation	res_ {};
+
+	bool try_()
+	{
+		res_.count = well_reserve(s_.sym(), &res_.pos, max_);
+		return res_.count;
+	}
+
+	static void retry_(work *w)
+	{
+		auto *op = static_cast<reserve_op *>(w);
+		if (op->try_())
+			op->h.resume();
+		else
+			op->s_.park_reserve(op);
+	}
+
+public:
+	reserve_op(side &s, size_t max_count) : s_(s), max_(max_count) {}
+
+	/* nothing to wait for */
+	bool await_ready() { return !max_ || try_(); }
+
+	template <class P>
+	void await_suspend(std::coroutine_handle<P> h)
+	{
+		this->h = h;
+		exec = h.promise().exec;
+		run = retry_;
+		s_.park_reserve(this);
+	}
+
+	reservation await_resume() { return res_; }
+};
+
+
+/*	side::release_op
+co_await: as well_release_multi(), suspending until every earlier
+	reservation has been released.
+*/
+class side::release_op : waiter {
+	side		&s_;
+	size_t		count_;
+	size_t		pos_;
+
+	bool try_()
+	{
+		if (!well_release_multi(s_.sym(), count_, pos_))
+			return false;
+		s_.wake();
+		return true;
+	}
+
+	static void retry_(work *w)
+	{
+		auto *op = static_cast<release_op *>(w);
+		if (op->try_())
+			op->h.resume();
+		else
+			op->s_.park_release(op, op->pos_);
+	}
+
+public:
+	release_op(side &s, size_t count, size_t pos) : s_(s), count_(count), pos_(pos) {}
+
+	bool await_ready() { return !count_ || try_(); }
+
+	template <class P>
+	void await_suspend(std::coroutine_handle<P> h)
+	{
+		this->h = h;
+		exec = h.promise().exec;
+		run = retry_;
+		s_.park_release(this, pos_);
+	}
+
+	void await_resume() {}
+};
+
+
+inline side::reserve_op side::reserve(size_t max_count)
+{
+	return reserve_op(*this, max_count);
+}
+
+inline side::release_op side::release(size_t count, size_t pos)
+{
+	return release_op(*this, count, pos);
+}
+
+inline side::release_op side::release(reservation r)
+{
+	return release_op(*this, r.count, r.pos);
+}
+
+
+/*	channel
+Both sides of an initialized well.
+*/
+class channel {
+public:
+	side		tx;
+	side		rx;
+
+	explicit channel(struct well *buf) : tx(&buf->tx), rx(&buf->rx) {}
+};
+
+
+} /* namespace well_coro */
+
+#endif /* well_coro_hpp_ */
@@ -0,0 +1,175 @@
+#ifndef well_dur_h_
+#define well_dur_h_
+
+/*	well_dur.h
+
+A durable well: a queue kept in a file which survives the process
+	(and, as far as the disk honours msync(), the machine) crashing.
+
+The file holds a header and the buffer itself:
+	[ struct well_dur_hdr | (page-aligned) buffer ]
+The header holds only two positions, in global block numbers:
+	'head'	first block not yet consumed
+	'tail'	first block not yet written
+Everything else - locks, 'avail' counts, the 'struct well' - lives in the
+	process and is rebuilt from these two on open (well_dur_open()).
+
+Internally this is a 4-stage pipe (see well_pipe.h) over the file mapping:
+	0: free		producers reserve, write, then submit
+	1: written	not yet on disk
+	2: durable	consumers read, then mark done
+	3: done		consumed, but not yet recorded on disk
+One COMMITTER (well_dur_commit(), or a flusher thread: well_dur_start())
+	takes everything in stages 1 and 3 as a group, syncs the data,
+	then records the new 'head' and 'tail' in the header with a second sync.
+Only then are written blocks shown to consumers, and consumed blocks
+	given back to producers: a slot is never overwritten before the
+	header says it is free, and consumers only ever see durable data.
+
+Consumers may see a block again after a crash if it was consumed but
+	not yet committed: delivery is at-least-once.
+
+The header keeps two records, written alternately, each with a sequence
+	number and checksum: a torn header write loses at most the commit
+	in progress, never the one before it.
+
+The file format is specific to the block geometry but not to the technique,
+	layout or address: any build of the library can recover any file.
+*/
+
+#include <well_pipe.h>
+#include <stdint.h>
+#include <pthread.h>
+
+
+#define WELL_DUR_MAGIC		0x72756477	/* "wdur" */
+#define WELL_DUR_VERSION	1
+
+
+/*	well_dur_rec
+One committed state. Each record has a sector to itself.
+*/
+struct well_dur_rec {
+	uint64_t	seq;		/* 0: never written */
+	uint64_t	head;
+	uint64_t	tail;
+	uint64_t	sum;		/* checksum of the above */
+} __attribute__((aligned(512)));
+
+/*	well_dur_hdr
+At the start of the file.
+*/
+struct well_dur_hdr {
+	uint32_t		magic;
+	uint32_t		version;
+	uint64_t		blk_size;
+	uint64_t		blk_count;
+	struct well_dur_rec	rec[2];
+};
+
+
+struct well_dur {
+	struct well_pipe	pipe;
+	struct well_dur_hdr	*hdr;		/* start of the mapping */
+	size_t			map_size;
+	int			fd;
+	/* written by the committer only */
+	uint64_t		seq;
+	size_t			head;
+	size_t			tail;		/* see well_dur_durable() */
+	size_t			commits;
+	/* flusher thread */
+	long			interval_us;
+	int			kill_flag;
+	int			running;
+	pthread_t		flusher;
+};
+
+
+NLC_PUBLIC int		well_dur_open(		struct well_dur	*dw,
+							int		fd,
+							size_t		blk_size,
+							size_t		blk_cnt);
+
+NLC_PUBLIC void		well_dur_close(		struct well_dur	*dw);
+
+NLC_PUBLIC size_t	well_dur_commit(	struct well_dur	*dw);
+
+NLC_PUBLIC int		well_dur_start(		struct well_dur	*dw,
+							long		interval_us);
+
+NLC_PUBLIC void		well_dur_stop(		struct well_dur	*dw);
+
+
+/*	well_dur_well()
+The well to use with well_access() and friends.
+*/
+NLC_INLINE struct well *well_dur_well(struct well_dur *dw)
+{
+	return &dw->pipe.well;
+}
+
+/*	well_dur_reserve()
+As well_reserve() on 'tx': free blocks to write.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_dur_reserve(struct well_dur *dw, size_t *out_pos, size_t max_count)
+{
+	return well_pipe_reserve(&dw->pipe, 0, out_pos, max_count);
+}
+
+/*	well_dur_submit()
+Hand 'count' written blocks to the committer. Single producer only.
+*/
+NLC_INLINE void well_dur_submit(struct well_dur *dw, size_t count)
+{
+	well_pipe_release_single(&dw->pipe, 0, count);
+}
+
+/*	well_dur_submit_multi()
+As well_dur_submit() for several producers: see well_release_multi().
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_dur_submit_multi(struct well_dur *dw, size_t count, size_t res_pos)
+{
+	return well_pipe_release_multi(&dw->pipe, 0, count, res_pos);
+}
+
+/*	well_dur_durable()
+Every block before this position is on disk: a producer whose
+	reservation at 'pos' of 'count' blocks ends at or before it is safe.
+*/
+NLC_INLINE size_t well_dur_durable(struct well_dur *dw)
+{
+	return __atomic_load_n(&dw->tail, __ATOMIC_ACQUIRE);
+}
+
+/*	well_dur_read()
+As well_reserve() on 'rx': durable blocks to consume.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_dur_read(struct well_dur *dw, size_t *out_pos, size_t max_count)
+{
+	return well_pipe_reserve(&dw->pipe, 2, out_pos, max_count);
+}
+
+/*	well_dur_done()
+Finished with 'count' blocks: they are gone once the next commit records it.
+Single consumer only.
+*/
+NLC_INLINE void well_dur_done(struct well_dur *dw, size_t count)
+{
+	well_pipe_release_single(&dw->pipe, 2, count);
+}
+
+/*	well_dur_done_multi()
+As well_dur_done() for several consumers: see well_release_multi().
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_dur_done_multi(struct well_dur *dw, size_t count, size_t res_pos)
+{
+	return well_pipe_release_multi(&dw->pipe, 2, count, res_pos);
+}
+
+
+#endif /* well_dur_h_ */
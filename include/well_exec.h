@@ -0,0 +1,87 @@
+#ifndef well_exec_h_
+#define well_exec_h_
+
+/*	well_exec.h
+
+Work-stealing task executor: a thread pool whose queues are wells.
+
+Each worker owns a lane: a well of task descriptors (struct well_task).
+A worker takes up to 'batch' tasks at a time from 'rx' of its own lane,
+	copies them out and gives the blocks straight back to 'tx',
+	then runs them.
+An idle worker steals from 'rx' of the other lanes in the same way:
+	at most half of what a victim holds, at most 'batch' at a time.
+Since owners and thieves all reserve on 'rx', and every submitter reserves
+	on 'tx', both sides release with well_release_multi().
+
+Submitters outside the pool (well_exec_submit()) sample two lanes and
+	push to the one holding fewer tasks; a task submitting more work
+	pushes to its own worker's lane, where it is likely still in cache,
+	and other workers steal it if they run dry.
+
+Workers with nothing to run or steal park on a futex,
+	as in well_set_wait(): a submitter pays one fence and one load
+	of a shared line to find out whether anyone needs waking.
+
+RULES:
+	- the pool is fixed in size: a full pool refuses tasks (retry,
+		or run the work inline if submitting from a task).
+	- tasks run in no particular order.
+*/
+
+#include <well.h>
+#include <pthread.h>
+#include <stdint.h>
+
+
+/*	well_task
+One block in a lane.
+*/
+struct well_task {
+	void		(*fn)(void *arg);
+	void		*arg;
+};
+
+
+struct well_exec;
+
+struct well_exec_lane {
+	struct well		buf;
+	struct well_exec	*ex;
+	size_t			id;
+	pthread_t		thread;
+	struct well_task	*tasks;		/* taken, being run */
+	/* written by the owning worker only */
+	size_t			run		__attribute__((aligned(WELL_LINE)));
+	size_t			stolen;		/* of those, taken from other lanes */
+	size_t			parked;		/* times it went to sleep */
+};
+
+
+struct well_exec {
+	struct well_exec_lane	*lanes;
+	size_t			lane_cnt;
+	size_t			batch;
+	size_t			started;	/* workers */
+	int			stop;
+	/* parked workers */
+	uint32_t		seq		__attribute__((aligned(WELL_LINE)));
+	uint32_t		idle;
+};
+
+
+NLC_PUBLIC int		well_exec_init(		struct well_exec	*ex,
+							size_t			threads,
+							size_t			lane_tasks,
+							size_t			batch);
+
+NLC_PUBLIC void		well_exec_deinit(	struct well_exec	*ex);
+
+NLC_PUBLIC int		well_exec_submit(	struct well_exec	*ex,
+							void			(*fn)(void *arg),
+							void			*arg);
+
+NLC_PUBLIC size_t	well_exec_done(	struct well_exec	*ex);
+
+
+#endif /* well_exec_h_ */
@@ -11,22 +11,28 @@ TODO:
 */
 
 #include <stddef.h> /* size_t */
+#include <well_trace.h>
 __thread size_t wait_count = 0;
 
+/* USDT probe 'fail' (see well_trace.h), as an expression:
+	FAIL_DO() may be a bare 'if'.
+*/
+#define FAIL_PROBE_() ({ WELL_PROBE1(fail, wait_count); })
+
 
 /* Warning: unsafe for high thread counts! */
 #if (FAIL_METHOD == WELL_FAIL_SPIN || FAIL_METHOD == COUNT)
-	#define FAIL_DO() { wait_count++; }
+	#define FAIL_DO() { FAIL_PROBE_(); wait_count++; }
 
 
 #elif (FAIL_METHOD == WELL_FAIL_YIELD) /* OS X scheduler seems to dislike yield() */
-	#define FAIL_DO() { wait_count++; sched_yield(); }
+	#define FAIL_DO() { FAIL_PROBE_(); wait_count++; sched_yield(); }
 
 
 /* Warning: this is horrifyingly slow on OS X */
 #elif (FAIL_METHOD == WELL_FAIL_SLEEP)
 	#include <time.h>
-	#define FAIL_DO() { wait_count++; usleep(1); }
+	#define FAIL_DO() { FAIL_PROBE_(); wait_count++; usleep(1); }
 
 
 #elif (FAIL_METHOD == WELL_FAIL_SIGNAL)
@@ -35,7 +41,7 @@ __thread size_t wait_count = 0;
 
 #elif (FAIL_METHOD == WELL_FAIL_BOUNDED)
 	/* spin only 8 iterations, then yield() */
-	#define FAIL_DO() if (!(++wait_count & 0x7)) { sched_yield(); }
+	#define FAIL_DO() if (FAIL_PROBE_(), !(++wait_count & 0x7)) { sched_yield(); }
 
 
 #else
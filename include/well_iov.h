@@ -0,0 +1,63 @@
+#ifndef well_iov_h_
+#define well_iov_h_
+
+/*	well_iov.h
+
+Scatter-gather export of reservations, for zero-copy I/O.
+
+The buffer is one contiguous region of memory, so any reservation is
+	at most TWO contiguous segments: split only where it wraps
+	past the end of the buffer.
+*/
+
+#include <well.h>
+#include <sys/uio.h> /* struct iovec */
+#include <sys/types.h> /* ssize_t */
+
+
+/*	well_iov()
+Describe 'count' blocks starting at 'pos' as the minimal iovec array.
+'iov' must have room for 2 entries; 'count' must not exceed well_blk_count().
+
+returns number of entries written into 'iov' (0, 1 or 2).
+*/
+NLC_INLINE int well_iov(const struct well	*buf,
+			size_t			pos,
+			size_t			count,
+			struct iovec		iov[2])
+{
+	if (!count)
+		return 0;
+
+	size_t offt = (pos << buf->ct.blk_shift) & buf->ct.overflow;
+	size_t len = count << buf->ct.blk_shift;
+	size_t tail = well_size(buf) - offt;
+
+	iov[0].iov_base = well_mem(buf) + offt;
+	if (len <= tail) {
+		iov[0].iov_len = len;
+		return 1;
+	}
+	iov[0].iov_len = tail;
+	iov[1].iov_base = well_mem(buf);
+	iov[1].iov_len = len - tail;
+	return 2;
+}
+
+
+/*
+	syscall helpers.
+These assume the caller is the ONLY thread on the side being reserved
+	from (one reader per fd, one writer per fd), and so release
+	with well_release_single().
+*/
+NLC_PUBLIC ssize_t	well_readv_into(struct well	*buf,
+					int		fd,
+					size_t		max_count);
+
+NLC_PUBLIC ssize_t	well_writev_from(struct well	*buf,
+					int		fd,
+					size_t		max_count);
+
+
+#endif /* well_iov_h_ */
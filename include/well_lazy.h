@@ -0,0 +1,77 @@
+#ifndef well_lazy_h_
+#define well_lazy_h_
+
+/*	well_lazy.h
+
+Large, sparsely used wells which only cost the memory they actually touch.
+
+well_lazy_init() maps the buffer as address space only (MAP_NORESERVE):
+	the kernel commits a page the first time the ring frontier writes to it,
+	so a well sized for the worst burst costs nothing until the burst comes.
+
+Once a burst has drained, the pages stay committed.
+well_lazy_trim() hands them back (MADV_DONTNEED, or MADV_FREE with
+	WELL_LAZY_FREE), keeping only the 'keep' blocks producers will write next.
+It never races live reservations: it only acts when the well is EMPTY,
+	by reserving every block from 'tx' at once (well_reserve_exact()),
+	so no one else holds or can obtain a block while pages are released.
+Producers which try to reserve during a trim simply fail and retry,
+	as they would on a full well.
+If the well is not empty, the trim does nothing.
+
+A helper thread (well_lazy_start()) does this at the lowest scheduling
+	priority: every 'interval_ms' it looks at 'tx', and trims once the
+	well has stayed idle for a whole interval.
+
+Note that a ring touches every page on each lap: under steady traffic,
+	however low the occupancy, RSS is the whole buffer.
+Trimming pays off across IDLE periods; trimming too eagerly turns every
+	lap into page faults (see benchmark/well_lazy_bench.c).
+
+Linux only.
+*/
+
+#include <well.h>
+#include <pthread.h>
+
+
+/*	flags
+*/
+#define WELL_LAZY_FREE	0x1	/* MADV_FREE: cheaper, but pages only leave RSS
+					under memory pressure
+				*/
+
+
+struct well_lazy {
+	struct well	*buf;
+	size_t		keep;		/* blocks ahead of 'tx' left committed */
+	int		flags;
+	long		interval_ms;
+	size_t		released;	/* bytes handed back, over all trims */
+	size_t		trims;
+	int		kill_flag;
+	int		running;
+	pthread_t	helper;
+};
+
+
+NLC_PUBLIC int		well_lazy_init(		struct well	*buf);
+
+NLC_PUBLIC void		well_lazy_deinit(	struct well	*buf);
+
+NLC_PUBLIC size_t	well_lazy_trim(		struct well	*buf,
+						size_t		keep,
+						int		flags);
+
+NLC_PUBLIC size_t	well_lazy_resident(	const struct well *buf);
+
+NLC_PUBLIC int		well_lazy_start(	struct well_lazy *lz,
+						struct well	*buf,
+						long		interval_ms,
+						size_t		keep,
+						int		flags);
+
+NLC_PUBLIC void		well_lazy_stop(		struct well_lazy *lz);
+
+
+#endif /* well_lazy_h_ */
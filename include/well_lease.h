@@ -0,0 +1,165 @@
+#ifndef well_lease_h_
+#define well_lease_h_
+
+/*	well_lease.h
+
+Recovery of reservations abandoned on a side with several threads
+	(see "impasse" in docs/overview.md): a thread which dies or hangs while
+	holding a reservation stops every later well_release_multi() on that side.
+
+Each thread reserves and releases through a lease: its reservation
+	('pos', 'count') recorded on its own cache line.
+A watchdog calls well_lease_watch() at a steady rate (a "tick").
+If 'release_pos' on the side has not moved for 'ttl' ticks while blocks
+	are outstanding, the reservation holding it up is revoked and released
+	on its owner's behalf; a poison callback (well_leases_poison()) may
+	first mark its blocks so the other side can tell them apart.
+A reservation made with a plain well_reserve() which never got its lease
+	recorded (its thread died in between) is released all the same:
+	the blocks between 'release_pos' and the next recorded reservation.
+The owner of a revoked lease, if alive, gets WELL_LEASE_REVOKED from
+	well_lease_release(): its blocks are gone, its work is lost.
+
+The clock starts when a reservation starts holding the side up,
+	not when it was made: 'ttl' ticks must exceed the longest a healthy
+	thread keeps a reservation at the head of the side.
+
+RULES:
+	- every thread reserving on 'from' uses a lease (well_lease_join()).
+	- one watchdog thread per well_leases.
+	- a hung thread which resumes after being revoked may still write its
+		blocks, now someone else's: revocation is for threads which
+		are dead or will check WELL_LEASE_REVOKED before touching them.
+*/
+
+#include <well.h>
+
+
+#define WELL_LEASE_REVOKED	SIZE_MAX
+
+/* lease states: low bits of 'tag' */
+#define WELL_LEASE_FREE		0	/* also: released intact by the watchdog */
+#define WELL_LEASE_HELD		1
+#define WELL_LEASE_RELEASING	2
+#define WELL_LEASE_GONE		3	/* revoked, owner not told yet */
+
+#define WELL_LEASE_STATE_(tag)	((tag) & 0x3)
+#define WELL_LEASE_SEQ_(tag)	((tag) & ~(size_t)0x3)
+
+
+/*	well_lease
+One thread's reservation.
+'tag' is (reservation number << 2 | state): the watchdog revokes with a CAS
+	on it, which fails if the owner moved on to another reservation.
+*/
+struct well_lease {
+	size_t		tag;
+	size_t		pos;
+	size_t		count;
+} __attribute__((aligned(WELL_LINE)));
+
+
+struct well_leases {
+	struct well		*buf;
+	struct well_sym		*from;		/* reserve from */
+	struct well_sym		*to;		/* release to */
+	size_t			ttl;		/* ticks */
+	size_t			lease_cnt;
+	size_t			joined;
+	struct well_lease	*leases;
+	void			(*poison)(struct well *buf, size_t pos, size_t count, void *ctx);
+	void			*ctx;
+
+	/* watchdog only */
+	size_t			tick;
+	size_t			stuck_pos;	/* 'release_pos' as last seen */
+	size_t			stuck_since;	/* tick it was first seen */
+	size_t			revoked;	/* reservations released by the watchdog, ever */
+};
+
+
+NLC_PUBLIC int			well_leases_init(	struct well_leases	*ls,
+								struct well		*buf,
+								struct well_sym		*from,
+								struct well_sym		*to,
+								size_t			max_threads,
+								size_t			ttl);
+
+NLC_PUBLIC void			well_leases_deinit(	struct well_leases	*ls);
+
+NLC_PUBLIC void			well_leases_poison(	struct well_leases	*ls,
+								void (*poison)(struct well *buf,
+										size_t pos,
+										size_t count,
+										void *ctx),
+								void			*ctx);
+
+NLC_PUBLIC struct well_lease	*well_lease_join(	struct well_leases	*ls);
+
+NLC_PUBLIC size_t		well_lease_watch(	struct well_leases	*ls);
+
+
+/*	well_lease_reserve()
+As well_reserve() on 'from', recording the reservation in 'l'.
+'l' must not hold a reservation already.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_lease_reserve(struct well_leases *ls, struct well_lease *l,
+				size_t *out_pos, size_t max_count)
+{
+	size_t res = well_reserve(ls->from, out_pos, max_count);
+	if (res) {
+		size_t tag = __atomic_load_n(&l->tag, __ATOMIC_RELAXED);
+		__atomic_store_n(&l->pos, *out_pos, __ATOMIC_RELAXED);
+		__atomic_store_n(&l->count, res, __ATOMIC_RELAXED);
+		__atomic_store_n(&l->tag, WELL_LEASE_SEQ_(tag) + 4 + WELL_LEASE_HELD,
+				__ATOMIC_RELEASE);
+	}
+	return res;
+}
+
+/*	well_lease_release()
+As well_release_multi() to 'to' of the reservation held in 'l'.
+
+returns the block count on success,
+	0 if an earlier reservation is still outstanding (retry),
+	WELL_LEASE_REVOKED if the watchdog released the blocks instead;
+	'l' is free again in the first and last cases.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_lease_release(struct well_leases *ls, struct well_lease *l)
+{
+	size_t tag = __atomic_load_n(&l->tag, __ATOMIC_ACQUIRE);
+	size_t seq = WELL_LEASE_SEQ_(tag);
+	size_t held = seq + WELL_LEASE_HELD;
+	if (!__atomic_compare_exchange_n(&l->tag, &held, seq + WELL_LEASE_RELEASING,
+					0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+		goto revoked;
+
+	size_t pos = l->pos, count = l->count;
+	size_t ret = well_release_multi(ls->to, count, pos);
+	if (ret) {
+		__atomic_store_n(&l->tag, seq + WELL_LEASE_FREE, __ATOMIC_RELEASE);
+		return ret;
+	}
+	/* released behind our back: intact if the watchdog took it over from us
+		while RELEASING (tag then FREE), else we were as good as dead
+	*/
+	if ((ptrdiff_t)(__atomic_load_n(&ls->to->release_pos, __ATOMIC_ACQUIRE) - pos) > 0) {
+		if (__atomic_load_n(&l->tag, __ATOMIC_ACQUIRE) == seq + WELL_LEASE_FREE)
+			return count;
+		goto revoked;
+	}
+	size_t releasing = seq + WELL_LEASE_RELEASING;
+	if (!__atomic_compare_exchange_n(&l->tag, &releasing, seq + WELL_LEASE_HELD,
+					0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		return count; /* the watchdog is releasing it for us, intact */
+	return 0;
+
+revoked:
+	__atomic_store_n(&l->tag, seq + WELL_LEASE_FREE, __ATOMIC_RELEASE);
+	return WELL_LEASE_REVOKED;
+}
+
+
+#endif /* well_lease_h_ */
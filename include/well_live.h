@@ -0,0 +1,180 @@
+#ifndef well_live_h_
+#define well_live_h_
+
+/*	well_live.h
+
+A well which can be resized while producers and consumers keep running
+	(well_resize()): size it for today's load, not for the day's peak.
+
+The buffer lives in a "generation": an ordinary well plus a link to its successor.
+A resize starts a new generation and hands over in two steps:
+	- producers: new reservations go to the new generation,
+		while reservations already made in the old one are released there.
+	- consumers: once the old generation is drained, they move on.
+Nothing is copied: data stays in the generation it was written to,
+	and is all read before anything in the next one: ordering is preserved.
+The old generation is freed once no thread is left in it.
+
+To know who is still in a generation, each thread "joins" the well once and
+	announces the generation it is working in, with a plain store
+	to its own cache line; the resizer pairs this with membarrier()
+	so the hot path needs no fence (where membarrier() is unavailable,
+	a fence is issued instead).
+
+RULES:
+	- every producer and consumer thread needs its own 'well_live_local'
+		(well_live_join()).
+	- a thread holds at most ONE reservation per side at a time.
+	- releases always use well_release_multi() semantics: retry on failure.
+	- never call well_resize() while holding a reservation.
+*/
+
+#include <well.h>
+#include <pthread.h>
+
+
+struct well_gen {
+	struct well		well;
+	struct well_gen		*next	__attribute__((aligned(WELL_LINE)));
+	int			tx_done;	/* no producer left: 'rx.release_pos' is final */
+};
+
+
+/*	well_live_local
+The generation a thread is working in, on each side; NULL if none.
+*/
+struct well_live_local {
+	struct well_gen		*tx	__attribute__((aligned(WELL_LINE)));
+	struct well_gen		*rx;
+};
+
+
+struct well_live {
+	struct well_gen		*tx_gen		__attribute__((aligned(WELL_LINE)));
+	struct well_gen		*rx_gen		__attribute__((aligned(WELL_LINE)));
+	size_t			blk_size	__attribute__((aligned(WELL_LINE)));
+	int			fence;		/* membarrier() unavailable */
+	size_t			local_cnt;
+	size_t			joined;
+	struct well_live_local	*locals;
+	pthread_mutex_t		resize_lock;
+};
+
+
+NLC_PUBLIC int				well_live_init(		struct well_live	*lw,
+									size_t			blk_size,
+									size_t			blk_cnt,
+									size_t			max_threads);
+
+NLC_PUBLIC void				well_live_deinit(	struct well_live	*lw);
+
+NLC_PUBLIC struct well_live_local	*well_live_join(	struct well_live	*lw);
+
+NLC_PUBLIC int				well_resize(		struct well_live	*lw,
+									size_t			blk_cnt);
+
+NLC_PUBLIC struct well_gen		*well_live_advance(	struct well_live	*lw,
+									struct well_gen		*gen);
+
+NLC_PUBLIC size_t			well_live_blk_count(	struct well_live	*lw);
+
+
+/*	well_live_announce_()
+Publish '*slot' = 'gen' before reading anything which decides whether 'gen'
+	is still current.
+*/
+NLC_INLINE void well_live_announce_(struct well_live *lw, struct well_gen **slot,
+					struct well_gen *gen)
+{
+	__atomic_store_n(slot, gen, __ATOMIC_RELAXED);
+	if (lw->fence)
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	else
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+
+/*	well_live_write()
+Producer: as well_reserve() on 'tx' of the current generation.
+Writes the well the blocks are in to '*out_buf'.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_live_write(struct well_live *lw, struct well_live_local *me,
+				struct well **out_buf, size_t *out_pos, size_t max_count)
+{
+	struct well_gen *gen = __atomic_load_n(&lw->tx_gen, __ATOMIC_ACQUIRE);
+	for (;;) {
+		/* once announced, 'gen' is not freed under us as long as it was current */
+		well_live_announce_(lw, &me->tx, gen);
+		struct well_gen *cur = __atomic_load_n(&lw->tx_gen, __ATOMIC_ACQUIRE);
+		if (cur == gen)
+			break;
+		gen = cur;
+	}
+
+	size_t res = well_reserve(&gen->well.tx, out_pos, max_count);
+	if (!res)
+		__atomic_store_n(&me->tx, NULL, __ATOMIC_RELEASE);
+	*out_buf = &gen->well;
+	return res;
+}
+
+/*	well_live_publish()
+Producer: as well_release_multi() to 'rx' of 'buf'.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_live_publish(struct well_live_local *me,
+				struct well *buf, size_t count, size_t res_pos)
+{
+	size_t ret = well_release_multi(&buf->rx, count, res_pos);
+	if (ret)
+		__atomic_store_n(&me->tx, NULL, __ATOMIC_RELEASE);
+	return ret;
+}
+
+
+/*	well_live_read()
+Consumer: as well_reserve() on 'rx', moving on to the next generation
+	once the current one is drained.
+Writes the well the blocks are in to '*out_buf'.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_live_read(struct well_live *lw, struct well_live_local *me,
+				struct well **out_buf, size_t *out_pos, size_t max_count)
+{
+	struct well_gen *gen = __atomic_load_n(&lw->rx_gen, __ATOMIC_ACQUIRE);
+	for (;;) {
+		well_live_announce_(lw, &me->rx, gen);
+		struct well_gen *cur = __atomic_load_n(&lw->rx_gen, __ATOMIC_ACQUIRE);
+		if (cur != gen) {
+			gen = cur;
+			continue;
+		}
+
+		size_t res = well_reserve(&gen->well.rx, out_pos, max_count);
+		if (res) {
+			*out_buf = &gen->well;
+			return res;
+		}
+		if (!(gen = well_live_advance(lw, gen)))
+			break;
+	}
+	__atomic_store_n(&me->rx, NULL, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/*	well_live_done()
+Consumer: as well_release_multi() to 'tx' of 'buf'.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_live_done(struct well_live_local *me,
+				struct well *buf, size_t count, size_t res_pos)
+{
+	size_t ret = well_release_multi(&buf->tx, count, res_pos);
+	if (ret)
+		__atomic_store_n(&me->rx, NULL, __ATOMIC_RELEASE);
+	return ret;
+}
+
+
+#endif /* well_live_h_ */
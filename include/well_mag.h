@@ -0,0 +1,104 @@
+#ifndef well_mag_h_
+#define well_mag_h_
+
+/*	well_mag.h
+
+Per-thread reservation "magazines".
+
+A magazine claims a large range of blocks from one side of a well with a single
+	well_reserve(), then hands out small reservations from that range
+	locally: no atomics, no shared cache lines.
+Completed blocks are published to the other side with well_release_multi(),
+	so the ordering guarantees of release_pos are preserved.
+
+A magazine belongs to exactly ONE thread; declare it on that thread's stack
+	or as a '__thread' variable.
+
+RULES:
+	- local reservations must be released (well_mag_release()) in the
+		order they were made.
+	- an exhausted magazine will not refill until every block handed out
+		has been released and published.
+	- other magazines cannot publish PAST the range this magazine holds:
+		a thread going idle must call well_mag_flush() (or well_mag_publish()
+		for lower latency) or it will stall every other thread on that side.
+	- call well_mag_deinit() before thread exit.
+*/
+
+#include <well.h>
+
+
+/*	well_mag
+All values are 'pos' values (i.e. block counts) on the 'from' side:
+	base <= done <= cur <= end
+*/
+struct well_mag {
+	struct well	*buf;
+	struct well_sym	*from;		/* claim from this side */
+	struct well_sym	*to;		/* publish to this side */
+	size_t		batch;		/* how many blocks to claim at once */
+
+	size_t		base;		/* first block not yet published */
+	size_t		done;		/* first block not yet released locally */
+	size_t		cur;		/* first block not yet handed out */
+	size_t		end;		/* end of claimed range */
+
+	/* Called on each block which must be passed to 'to' unused
+		because it could not be given back to 'from'.
+	NULL (the default) zeroes the block.
+	*/
+	void		(*pad)(void *blk, size_t blk_size);
+};
+
+
+NLC_PUBLIC int		well_mag_init(	struct well_mag	*mag,
+					struct well	*buf,
+					struct well_sym	*from,
+					struct well_sym	*to,
+					size_t		batch);
+
+NLC_PUBLIC void		well_mag_deinit(struct well_mag	*mag);
+
+NLC_PUBLIC size_t	well_mag_refill(struct well_mag	*mag);
+
+NLC_PUBLIC size_t	well_mag_publish(struct well_mag *mag);
+
+NLC_PUBLIC __attribute__((warn_unused_result))
+	int		well_mag_flush(struct well_mag	*mag);
+
+
+/*	well_mag_reserve()
+Reserve up to 'max_count' blocks from the magazine;
+	as well_reserve(), but with no contention unless the magazine is empty.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_mag_reserve(struct well_mag	*mag,
+				size_t		*out_pos,
+				size_t		max_count)
+{
+	size_t left = mag->end - mag->cur;
+	if (!left && !(left = well_mag_refill(mag)))
+		return 0;
+
+	if (max_count > left)
+		max_count = left;
+	*out_pos = mag->cur;
+	mag->cur += max_count;
+	return max_count;
+}
+
+/*	well_mag_release()
+Release the oldest 'count' locally reserved blocks.
+Blocks are published once the entire claimed range is released;
+	use well_mag_publish() to publish earlier.
+*/
+NLC_INLINE void well_mag_release(struct well_mag	*mag,
+				size_t			count)
+{
+	mag->done += count;
+	if (mag->done == mag->end)
+		well_mag_publish(mag);
+}
+
+
+#endif /* well_mag_h_ */
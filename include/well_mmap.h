@@ -0,0 +1,87 @@
+#ifndef well_mmap_h_
+#define well_mmap_h_
+
+/*	well_mmap.h
+
+Stream a file through a well WITHOUT copying it:
+	the well's memory is a window of address space, and each block
+	is the file itself, mapped in place.
+
+One FEEDER thread calls well_mmap_feed(): it reserves free slots from 'tx',
+	maps the next blocks of the file into them, asks the kernel to start
+	reading them (MADV_WILLNEED) and releases them to 'rx'.
+Any number of WORKER threads reserve from 'rx', read the blocks,
+	and release them back to 'tx' (well_release_multi() if more than one).
+When a slot comes round again, mapping the next part of the file over it
+	drops the old pages from the process; with WELL_MMAP_DROP they are
+	also dropped from the page cache, so files much larger than RAM
+	can be scanned without evicting everything else.
+
+Workers are finished once well_mmap_done() AND nothing is left on 'rx'.
+
+Blocks are numbered from the start of the file: a block's 'pos' on 'rx'
+	IS its block index (see well_mmap_offset()).
+The final partial block is zero-padded, as with well_readv_into().
+
+'blk_size' must be a multiple of the page size.
+*/
+
+#include <well.h>
+#include <sys/types.h> /* off_t, ssize_t */
+
+
+/*	flags
+*/
+#define WELL_MMAP_DROP	0x1	/* drop file pages from the page cache once consumed */
+
+
+struct well_mmap {
+	struct well	*buf;
+	int		fd;
+	int		flags;
+	size_t		file_size;	/* bytes */
+	size_t		next;		/* next block of the file to map */
+	size_t		blk_total;	/* blocks in the file, counting a partial one */
+};
+
+
+NLC_PUBLIC int		well_mmap_init(	struct well_mmap	*wm,
+					struct well		*buf,
+					int			fd,
+					int			flags);
+
+NLC_PUBLIC void		well_mmap_deinit(struct well_mmap	*wm);
+
+NLC_PUBLIC ssize_t	well_mmap_feed(	struct well_mmap	*wm,
+					size_t			max_count);
+
+
+/*	well_mmap_offset()
+File offset of block 'i' of a reservation at 'pos' on 'rx'.
+*/
+NLC_INLINE off_t well_mmap_offset(const struct well_mmap *wm, size_t pos, size_t i)
+{
+	return (off_t)((pos + i) << wm->buf->ct.blk_shift);
+}
+
+/*	well_mmap_len()
+Number of bytes of file data in block 'i' of a reservation at 'pos':
+	blk_size for all but the final block of the file.
+*/
+NLC_INLINE size_t well_mmap_len(const struct well_mmap *wm, size_t pos, size_t i)
+{
+	size_t off = (pos + i) << wm->buf->ct.blk_shift;
+	size_t left = wm->file_size - off;
+	return left < well_blk_size(wm->buf) ? left : well_blk_size(wm->buf);
+}
+
+/*	well_mmap_done()
+The whole file has been fed into the well.
+*/
+NLC_INLINE int well_mmap_done(const struct well_mmap *wm)
+{
+	return __atomic_load_n(&wm->next, __ATOMIC_ACQUIRE) == wm->blk_total;
+}
+
+
+#endif /* well_mmap_h_ */
@@ -0,0 +1,117 @@
+#ifndef well_part_h_
+#define well_part_h_
+
+/*	well_part.h
+
+Key-partitioned consumption: several consumers, yet blocks with the same
+	key are processed one at a time, in the order they were sent.
+
+A single router hashes a key field of each block into one of K lanes:
+	wells each drained by exactly ONE consumer thread.
+Routing is batched (well_part_route()): the router takes a reservation
+	off an input well (which may have any number of producers),
+	sorts it by lane, and moves each lane's share with one reserve,
+	one copy loop and one release.
+
+Keys hash into buckets (64 per lane); a bucket table maps buckets to lanes.
+Hot keys:
+	- a full lane does not hold up the others: what does not fit goes
+		to a backlog for that lane, in order, ahead of anything newer
+		(well_part_route() stops only once that backlog is full too);
+	- a lane deeper than 'hot' blocks sheds its other buckets to the
+		least loaded lane, each as soon as it is quiescent (every block
+		of it released by the consumer), so order is never broken:
+		a key too hot for one lane ends up with a lane to itself.
+One key never spans two consumers at once: a hot key is limited to the
+	speed of one consumer, by design.
+
+Consumers reserve from their lane and release through well_part_release(),
+	which counts blocks done: the router moves buckets by that count.
+*/
+
+#include <well.h>
+#include <stdint.h>
+
+
+struct well_part_lane {
+	struct well	buf;
+	size_t		done	__attribute__((aligned(WELL_LINE)));	/* released by the consumer, ever */
+	/* router only */
+	size_t		routed	__attribute__((aligned(WELL_LINE)));	/* ever, backlog included */
+	void		*backlog;	/* ring of 'backlog_cap' blocks */
+	size_t		bl_head;
+	size_t		bl_cnt;
+	size_t		room;		/* scratch, during a route */
+	size_t		n;
+	size_t		off;
+};
+
+
+struct well_part {
+	struct well_part_lane	*lanes;
+	size_t			lane_cnt;
+	size_t			blk_size;
+	size_t			key_offt;	/* of the key field in a block */
+	size_t			key_len;
+	size_t			backlog_cap;	/* blocks, per lane */
+	size_t			hot;		/* lane depth which sheds buckets */
+
+	/* router only */
+	size_t			bucket_mask;
+	uint32_t		*map;		/* bucket -> lane */
+	size_t			*last;		/* bucket -> 'routed' count of its latest block */
+	size_t			moved;		/* buckets moved, ever */
+	size_t			chunk;		/* blocks sorted at a time */
+	uint32_t		*lane_of;
+	uint32_t		*order;
+};
+
+
+NLC_PUBLIC int		well_part_init(		struct well_part	*part,
+							size_t			lane_cnt,
+							size_t			lane_blocks,
+							size_t			blk_size,
+							size_t			key_offt,
+							size_t			key_len);
+
+NLC_PUBLIC void		well_part_deinit(	struct well_part	*part);
+
+NLC_PUBLIC size_t	well_part_route(	struct well_part	*part,
+							struct well		*from,
+							size_t			pos,
+							size_t			count);
+
+NLC_PUBLIC size_t	well_part_flush(	struct well_part	*part);
+
+
+/*	well_part_well()
+The well of 'lane': access its blocks with well_access() or WELL_DEREF().
+*/
+NLC_INLINE struct well *well_part_well(struct well_part *part, size_t lane)
+{
+	return &part->lanes[lane].buf;
+}
+
+/*	well_part_reserve()
+As well_reserve() on 'rx' of 'lane': its consumer only.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_part_reserve(struct well_part *part, size_t lane,
+				size_t *out_pos, size_t max_count)
+{
+	return well_reserve(&part->lanes[lane].buf.rx, out_pos, max_count);
+}
+
+/*	well_part_release()
+Give back 'count' blocks of 'lane', done with: its consumer only.
+*/
+NLC_INLINE void well_part_release(struct well_part *part, size_t lane, size_t count)
+{
+	struct well_part_lane *l = &part->lanes[lane];
+	well_release_single(&l->buf.tx, count);
+	/* the router may move a bucket once this covers its last block */
+	__atomic_store_n(&l->done, l->done + count, __ATOMIC_RELEASE);
+}
+
+
+#endif /* well_part_h_ */
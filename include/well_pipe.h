@@ -0,0 +1,93 @@
+#ifndef well_pipe_h_
+#define well_pipe_h_
+
+/*	well_pipe.h
+
+A pipeline of K stages sharing ONE buffer: blocks are written once
+	and processed in place by every stage, with no copies between stages.
+
+A plain well is a ring with 2 sides: 'tx' releases to 'rx', 'rx' releases to 'tx'.
+A pipe generalizes this to K sides (stages) 0 to K-1:
+	blocks released by stage i become reservable by stage i+1,
+	and the last stage releases back to stage 0 (the producer).
+Every stage walks the same ring in the same order,
+	so a 'pos' from reserving on stage i is valid for release on stage i+1.
+
+Each stage is a 'struct well_sym' and obeys the usual rules:
+	one thread uses well_pipe_release_single(),
+	several threads use well_pipe_release_multi() - never both on one stage.
+Stage 0 is 'well.tx' and stage 1 is 'well.rx', so a 2-stage pipe IS a plain well,
+	and well_access() on '&wp->well' works as usual.
+*/
+
+#include <well.h>
+
+
+/*	well_stage
+Stages beyond the first two; each on its own line unless the layout is PACKED.
+*/
+struct well_stage {
+	struct well_sym		sym	WELL_ALIGN_;
+};
+
+
+struct well_pipe {
+	struct well		well;
+	size_t			cnt;	/* number of stages */
+	struct well_stage	*extra;	/* stages 2 to cnt-1 */
+};
+
+
+NLC_PUBLIC int		well_pipe_init(		struct well_pipe	*wp,
+							void			*mem,
+							size_t			stages);
+
+NLC_PUBLIC void		well_pipe_deinit(	struct well_pipe	*wp);
+
+
+/*	well_pipe_stage()
+The side of the ring which stage 'i' reserves from.
+*/
+NLC_INLINE struct well_sym *well_pipe_stage(struct well_pipe *wp, size_t i)
+{
+	if (i == 0)
+		return &wp->well.tx;
+	if (i == 1)
+		return &wp->well.rx;
+	return &wp->extra[i-2].sym;
+}
+
+/*	well_pipe_reserve()
+As well_reserve(): blocks which stage 'stage' may now work on.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_pipe_reserve(struct well_pipe *wp, size_t stage,
+					size_t *out_pos, size_t max_count)
+{
+	return well_reserve(well_pipe_stage(wp, stage), out_pos, max_count);
+}
+
+/*	well_pipe_release_single()
+Stage 'stage' is done with 'count' blocks: hand them to the next stage.
+ONLY if 'stage' is worked by a single thread.
+*/
+NLC_INLINE void well_pipe_release_single(struct well_pipe *wp, size_t stage, size_t count)
+{
+	size_t next = stage + 1 == wp->cnt ? 0 : stage + 1;
+	well_release_single(well_pipe_stage(wp, next), count);
+}
+
+/*	well_pipe_release_multi()
+As well_pipe_release_single() when several threads work 'stage':
+	see well_release_multi().
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_pipe_release_multi(struct well_pipe *wp, size_t stage,
+					size_t count, size_t res_pos)
+{
+	size_t next = stage + 1 == wp->cnt ? 0 : stage + 1;
+	return well_release_multi(well_pipe_stage(wp, next), count, res_pos);
+}
+
+
+#endif /* well_pipe_h_ */
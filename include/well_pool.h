@@ -0,0 +1,108 @@
+#ifndef well_pool_h_
+#define well_pool_h_
+
+/*	well_pool.h
+
+Fixed-size object pool, for objects allocated on one thread
+	and freed on another.
+
+Objects live in a slab allocated once at init.
+Free objects are tracked by a well of pointers ('ring') holding one block
+	per object: taking an object is a reserve from 'rx',
+	giving it back (from any thread) is a reserve on 'tx' and a release to 'rx'.
+Objects may be freed in any order: only pointers travel through the ring.
+
+Every operation on the ring can take or give many objects at once:
+	a per-thread cache (struct well_pool_cache) takes and returns objects
+	in batches, so most get/put calls touch no shared state at all.
+*/
+
+#include <well.h>
+
+
+struct well_pool {
+	struct well	ring;		/* pointers to free objects */
+	void		*slab;
+	size_t		obj_size;
+	size_t		obj_cnt;
+};
+
+
+/*	well_pool_cache
+Belongs to exactly ONE thread.
+Holds at most 2 * 'batch' objects: taken 'batch' at a time when empty,
+	returned 'batch' at a time when full.
+*/
+struct well_pool_cache {
+	struct well_pool	*pool;
+	size_t			batch;
+	size_t			cnt;
+	void			**objs;
+};
+
+
+NLC_PUBLIC int		well_pool_init(		struct well_pool	*pool,
+							size_t			obj_size,
+							size_t			obj_cnt);
+
+NLC_PUBLIC void		well_pool_deinit(	struct well_pool	*pool);
+
+NLC_PUBLIC size_t	well_pool_take(		struct well_pool	*pool,
+							void			**out,
+							size_t			max_count);
+
+NLC_PUBLIC void		well_pool_give(		struct well_pool	*pool,
+							void			**objs,
+							size_t			count);
+
+NLC_PUBLIC int		well_pool_cache_init(	struct well_pool_cache	*cache,
+							struct well_pool	*pool,
+							size_t			batch);
+
+NLC_PUBLIC void		well_pool_cache_deinit(	struct well_pool_cache	*cache);
+
+
+/*	well_pool_get()
+returns a free object; NULL if the pool is (momentarily) empty.
+*/
+NLC_INLINE void *well_pool_get(struct well_pool *pool)
+{
+	void *obj = NULL;
+	well_pool_take(pool, &obj, 1);
+	return obj;
+}
+
+/*	well_pool_put()
+Free 'obj': any thread, any order.
+*/
+NLC_INLINE void well_pool_put(struct well_pool *pool, void *obj)
+{
+	well_pool_give(pool, &obj, 1);
+}
+
+
+/*	well_pool_cache_get()
+As well_pool_get(), from the thread's cache.
+*/
+NLC_INLINE void *well_pool_cache_get(struct well_pool_cache *cache)
+{
+	if (!cache->cnt
+		&& !(cache->cnt = well_pool_take(cache->pool, cache->objs, cache->batch)))
+		return NULL;
+	return cache->objs[--cache->cnt];
+}
+
+/*	well_pool_cache_put()
+As well_pool_put(), into the thread's cache.
+*/
+NLC_INLINE void well_pool_cache_put(struct well_pool_cache *cache, void *obj)
+{
+	if (cache->cnt == 2 * cache->batch) {
+		cache->cnt -= cache->batch;
+		well_pool_give(cache->pool, &cache->objs[cache->cnt], cache->batch);
+	}
+	cache->objs[cache->cnt++] = obj;
+}
+
+
+#endif /* well_pool_h_ */
@@ -0,0 +1,142 @@
+#ifndef well_ptrq_h_
+#define well_ptrq_h_
+
+/*	well_ptrq.h
+
+A queue of POINTERS, for when the payload is already allocated and only
+	its address needs to change hands.
+
+A well moves blocks of any size, and pays for it with two counters per side
+	('pos' and 'avail') and in-order release among contending threads.
+A pointer fits in the slot itself, so each slot can carry its own state:
+	a sequence number saying which lap of the ring it is on and whether
+	it is full or empty.
+Putting pointers in and taking them out is then one CAS on the side's 'pos'
+	per BATCH, plus one store per slot: no 'avail' counters, and no
+	release ordering among contending threads.
+(A slot holding only a pointer, NULL when empty, cannot tell one lap from
+	the next once there are several producers: hence the sequence number.)
+
+Producers and consumers may each be any number of threads.
+Like a well, the queue never blocks: a push to a full queue or a pop from
+	an empty one returns 0, and the caller decides how to wait (FAIL_DO()).
+Layout follows 'struct well': the constant part, the producer side and the
+	consumer side each on their own WELL_LINE unless the layout is PACKED.
+The queue is lock-free whatever WELL_TECHNIQUE is.
+*/
+
+#include <well.h>
+
+
+/*	well_ptr_cell
+'seq' == lap position:		empty, a producer at 'seq' may fill it
+'seq' == lap position + 1:	full, a consumer at 'seq - 1' may empty it
+*/
+struct well_ptr_cell {
+	size_t		seq;
+	void		*ptr;
+};
+
+
+struct well_ptrq {
+	struct {
+		struct well_ptr_cell	*cells;
+		size_t			mask;		/* count - 1 */
+	} ct WELL_ALIGN_;
+	struct {
+		size_t			pos;
+	} tx WELL_ALIGN_;
+	struct {
+		size_t			pos;
+	} rx WELL_ALIGN_;
+};
+
+
+NLC_PUBLIC int		well_ptrq_init(		struct well_ptrq	*q,
+							size_t			count);
+
+NLC_PUBLIC void		well_ptrq_deinit(	struct well_ptrq	*q);
+
+
+/*	well_ptrq_count()
+Number of slots (a power of 2).
+*/
+NLC_INLINE size_t well_ptrq_count(const struct well_ptrq *q)
+{
+	return q->ct.mask + 1;
+}
+
+
+/*	well_ptrq_claim_()
+Claim up to 'max' consecutive slots on one side: those whose 'seq' is
+	'pos + i + offt' for the current side 'pos'.
+'offt' is 0 for producers (slot empty), 1 for consumers (slot full).
+
+returns number of slots claimed, starting at '*out_pos'.
+*/
+NLC_INLINE size_t well_ptrq_claim_(struct well_ptrq *q, size_t *side_pos,
+					size_t offt, size_t *out_pos, size_t max)
+{
+	size_t pos = __atomic_load_n(side_pos, __ATOMIC_RELAXED);
+	while (1) {
+		size_t n = 0;
+		for (; n < max; n++) {
+			struct well_ptr_cell *c = &q->ct.cells[(pos + n) & q->ct.mask];
+			if (__atomic_load_n(&c->seq, __ATOMIC_ACQUIRE) != pos + n + offt)
+				break;
+		}
+		if (!n) {
+			/* Not ready for us: either the ring is full (empty), or someone
+				else has claimed this slot already and 'pos' has moved on.
+			*/
+			size_t now = __atomic_load_n(side_pos, __ATOMIC_RELAXED);
+			if (now == pos)
+				return 0;
+			pos = now;
+			continue;
+		}
+		if (__atomic_compare_exchange_n(side_pos, &pos, pos + n,
+						1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			*out_pos = pos;
+			return n;
+		}
+	}
+}
+
+/*	well_ptrq_push()
+Enqueue up to 'count' pointers from 'ptrs', in order.
+
+returns number enqueued (0 if the queue is full).
+*/
+NLC_INLINE size_t well_ptrq_push(struct well_ptrq *q, void *const *ptrs, size_t count)
+{
+	size_t pos;
+	size_t n = well_ptrq_claim_(q, &q->tx.pos, 0, &pos, count);
+	for (size_t i=0; i < n; i++) {
+		struct well_ptr_cell *c = &q->ct.cells[(pos + i) & q->ct.mask];
+		c->ptr = ptrs[i];
+		__atomic_store_n(&c->seq, pos + i + 1, __ATOMIC_RELEASE);
+	}
+	return n;
+}
+
+/*	well_ptrq_pop()
+Dequeue up to 'max' pointers into 'out', in order.
+
+returns number dequeued (0 if the queue is empty).
+*/
+NLC_INLINE size_t well_ptrq_pop(struct well_ptrq *q, void **out, size_t max)
+{
+	size_t pos;
+	size_t n = well_ptrq_claim_(q, &q->rx.pos, 1, &pos, max);
+	for (size_t i=0; i < n; i++) {
+		struct well_ptr_cell *c = &q->ct.cells[(pos + i) & q->ct.mask];
+		out[i] = c->ptr;
+		/* empty for the producer one lap on */
+		__atomic_store_n(&c->seq, pos + i + q->ct.mask + 1, __ATOMIC_RELEASE);
+	}
+	return n;
+}
+
+
+#endif /* well_ptrq_h_ */
@@ -0,0 +1,125 @@
+#ifndef well_rpc_h_
+#define well_rpc_h_
+
+/*	well_rpc.h
+
+Request/response over ONE well, using its return path:
+	the response is written into the very blocks which carried the request.
+
+Clients reserve on 'tx' (well_rpc_reserve()), write a request and
+	submit it to 'rx' (well_rpc_submit() or well_rpc_submit_multi()).
+Servers reserve on 'rx' as usual (well_rpc_serve()), overwrite each request
+	with its response IN PLACE, then mark the blocks answered (well_rpc_respond()).
+Servers never release: they need no ordering among themselves.
+
+The client which submitted a request keeps its 'pos' and polls
+	(well_rpc_ready()) or sleeps (well_rpc_wait()) until it is answered,
+	reads the response, then gives the blocks back (well_rpc_finish()).
+Blocks return to 'tx' in ring order once their own client AND every client
+	before them have finished (well_rpc_reclaim()): so the ring, not the
+	response, is held up by a slow client.
+
+Every block carries a state word which includes its position in the stream,
+	so a state left over from the previous lap is never mistaken for a new one.
+*/
+
+#include <well.h>
+#include <stdint.h>
+
+
+struct well_rpc {
+	struct well	well;
+	size_t		reclaimed	__attribute__((aligned(WELL_LINE)));
+	size_t		*state;		/* one per block: (pos << 2) | WELL_RPC_* */
+	/* sleeping clients */
+	uint32_t	seq		__attribute__((aligned(WELL_LINE)));
+	uint32_t	waiters;
+};
+
+
+#define WELL_RPC_DONE		0x2	/* response written */
+#define WELL_RPC_RETIRED	0x3	/* client finished with it */
+
+
+NLC_PUBLIC int		well_rpc_init(		struct well_rpc	*rpc,
+							void		*mem);
+
+NLC_PUBLIC void		well_rpc_deinit(	struct well_rpc	*rpc);
+
+NLC_PUBLIC size_t	well_rpc_reclaim(	struct well_rpc	*rpc);
+
+NLC_PUBLIC void		well_rpc_respond(	struct well_rpc	*rpc,
+							size_t		pos,
+							size_t		count);
+
+NLC_PUBLIC void		well_rpc_finish(	struct well_rpc	*rpc,
+							size_t		pos,
+							size_t		count);
+
+NLC_PUBLIC int		well_rpc_wait(		struct well_rpc	*rpc,
+							size_t		pos,
+							size_t		count,
+							long		timeout_ns);
+
+
+/*	well_rpc_state_()
+*/
+NLC_INLINE size_t *well_rpc_state_(struct well_rpc *rpc, size_t pos)
+{
+	return &rpc->state[pos & (well_blk_count(&rpc->well) - 1)];
+}
+
+
+/*	well_rpc_reserve()
+As well_reserve() on 'tx': reclaims finished blocks if none are free.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_rpc_reserve(struct well_rpc *rpc, size_t *out_pos, size_t max_count)
+{
+	size_t res = well_reserve(&rpc->well.tx, out_pos, max_count);
+	if (!res && well_rpc_reclaim(rpc))
+		res = well_reserve(&rpc->well.tx, out_pos, max_count);
+	return res;
+}
+
+/*	well_rpc_submit()
+Hand a request to the servers. Single client only.
+*/
+NLC_INLINE void well_rpc_submit(struct well_rpc *rpc, size_t count)
+{
+	well_release_single(&rpc->well.rx, count);
+}
+
+/*	well_rpc_submit_multi()
+As well_rpc_submit() for several clients: see well_release_multi().
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_rpc_submit_multi(struct well_rpc *rpc, size_t count, size_t res_pos)
+{
+	return well_release_multi(&rpc->well.rx, count, res_pos);
+}
+
+/*	well_rpc_serve()
+As well_reserve() on 'rx': requests to answer.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_rpc_serve(struct well_rpc *rpc, size_t *out_pos, size_t max_count)
+{
+	return well_reserve(&rpc->well.rx, out_pos, max_count);
+}
+
+/*	well_rpc_ready()
+returns 1 if all 'count' blocks from 'pos' have been answered; 0 otherwise.
+*/
+NLC_INLINE int well_rpc_ready(struct well_rpc *rpc, size_t pos, size_t count)
+{
+	for (size_t i=0; i < count; i++) {
+		if (__atomic_load_n(well_rpc_state_(rpc, pos + i), __ATOMIC_ACQUIRE)
+				!= (((pos + i) << 2) | WELL_RPC_DONE))
+			return 0;
+	}
+	return 1;
+}
+
+
+#endif /* well_rpc_h_ */
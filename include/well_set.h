@@ -0,0 +1,105 @@
+#ifndef well_set_h_
+#define well_set_h_
+
+/*	well_set.h
+
+Readiness across many wells: one consumer servicing thousands of wells
+	without polling each of them.
+
+Wells are registered with a set (well_set_add()), each getting an 'id'.
+The set keeps a READY bitmap: one bit per well, 512 wells to a cache line.
+A producer releases to 'rx' through the set (well_set_release()): when that
+	release takes 'rx' from EMPTY to non-empty, it sets the well's bit,
+	and wakes any consumer parked on the set.
+Releases to a non-empty 'rx' touch nothing but the well itself.
+
+Consumers call well_set_reserve(), which scans the bitmap (from where the
+	last scan stopped, so wells are served round-robin), clears a set bit,
+	and reserves from that well's 'rx' as usual; it sets the bit again if
+	it may have left blocks behind.
+Release back to the well's 'tx' as usual.
+When nothing is ready, consumers may park in well_set_wait().
+
+No wakeup is lost: a consumer clears a bit BEFORE reserving, and a producer
+	sets it AFTER releasing, so either the consumer sees the blocks or the
+	bit stays set.
+Spurious bits (a well marked ready which turns out to be empty) are harmless.
+
+Several consumer threads on one set may end up reserving from the same well:
+	they must then release with well_release_multi(), as for any well
+	with several consumers.
+*/
+
+#include <well.h>
+#include <stdint.h>
+
+
+struct well_set {
+	uint64_t	*bits;		/* ready bitmap, one bit per member */
+	struct well	**members;
+	size_t		cap;
+	size_t		cnt;
+	size_t		cursor	__attribute__((aligned(WELL_LINE)));	/* next id to scan */
+	/* parked consumers */
+	uint32_t	seq	__attribute__((aligned(WELL_LINE)));
+	uint32_t	waiters;
+};
+
+
+NLC_PUBLIC int		well_set_init(		struct well_set	*set,
+							size_t		capacity);
+
+NLC_PUBLIC void		well_set_deinit(	struct well_set	*set);
+
+NLC_PUBLIC int		well_set_add(		struct well_set	*set,
+							struct well	*buf,
+							size_t		*out_id);
+
+NLC_PUBLIC void		well_set_mark(		struct well_set	*set,
+							size_t		id);
+
+NLC_PUBLIC size_t	well_set_reserve(	struct well_set	*set,
+							size_t		*out_id,
+							size_t		*out_pos,
+							size_t		max_count);
+
+NLC_PUBLIC int		well_set_wait(		struct well_set	*set,
+							long		timeout_ns);
+
+
+/*	well_set_well()
+*/
+NLC_INLINE struct well *well_set_well(struct well_set *set, size_t id)
+{
+	return set->members[id];
+}
+
+/*	well_set_release()
+As well_release_single() to 'rx' of member 'id': a single producer on that well.
+*/
+NLC_INLINE void well_set_release(struct well_set *set, size_t id, size_t count)
+{
+	if (!well_release_single(&set->members[id]->rx, count))
+		well_set_mark(set, id);
+}
+
+/*	well_set_release_multi()
+As well_release_multi() to 'rx' of member 'id': several producers on that well.
+A multi release cannot tell whether it took 'rx' from empty, so it checks
+	the bit instead: one load of a shared line, and a fence.
+*/
+NLC_INLINE __attribute__((warn_unused_result))
+	size_t well_set_release_multi(struct well_set *set, size_t id,
+					size_t count, size_t res_pos)
+{
+	if (!well_release_multi(&set->members[id]->rx, count, res_pos))
+		return 0;
+	/* pairs with the clear in well_set_reserve() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!(__atomic_load_n(&set->bits[id >> 6], __ATOMIC_RELAXED) & (1ULL << (id & 63))))
+		well_set_mark(set, id);
+	return count;
+}
+
+
+#endif /* well_set_h_ */
@@ -0,0 +1,78 @@
+#ifndef well_shm_h_
+#define well_shm_h_
+
+/*	well_shm.h
+
+Wells shared between PROCESSES.
+
+A shared segment (shm_open(), memfd_create(), a file ...) holds a header,
+	the 'struct well' and the buffer itself:
+	[ struct well_shm | (page-aligned) buffer ]
+Blocks are located relative to the 'struct well' (see well_const),
+	so each process may map the segment at a different address.
+
+The creator sizes and initializes the segment with well_shm_create();
+	other processes then call well_shm_attach(), which refuses a segment
+	built by an incompatible library: different version, technique,
+	layout or 'struct well' size.
+Locks (MTX technique) are PTHREAD_PROCESS_SHARED and FC request slots
+	live in the header; lock-free techniques are lock-free across
+	processes just as across threads.
+
+Waiting: well_shm_wait() sleeps on a futex until the other side calls
+	well_shm_wake() after releasing (or a timeout expires);
+	the wake is a single atomic load unless someone is actually asleep.
+*/
+
+#include <well.h>
+#include <stdint.h>
+
+
+#define WELL_SHM_MAGIC		0x6c6c6577	/* "well" */
+#define WELL_SHM_VERSION	3	/* 2: fair-mode fields in well_sym; 3: FC slots in header */
+
+
+/*	well_shm
+Header at the start of a shared segment.
+*/
+struct well_shm {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	technique;
+	uint32_t	layout;
+	uint32_t	well_sz;	/* sizeof(struct well) of the creator */
+	uint32_t	ready;		/* set last, by the creator */
+	uint64_t	seg_size;	/* bytes in the whole segment */
+	uint64_t	blk_size;
+	uint64_t	blk_count;
+
+	uint32_t	seq[2];		/* futex words: tx, rx */
+	uint32_t	waiters[2];
+
+#if (WELL_TECHNIQUE == WELL_DO_FC)
+	struct well_fc_slot fc[2][WELL_FC_SLOTS];	/* requests: tx, rx */
+#endif
+	struct well	well;
+};
+
+
+NLC_PUBLIC size_t	well_shm_size(	size_t		blk_size,
+					size_t		blk_cnt);
+
+NLC_PUBLIC struct well	*well_shm_create(int		fd,
+					size_t		blk_size,
+					size_t		blk_cnt);
+
+NLC_PUBLIC struct well	*well_shm_attach(int		fd);
+
+NLC_PUBLIC void		well_shm_detach(struct well	*buf);
+
+NLC_PUBLIC int		well_shm_wait(	struct well	*buf,
+					struct well_sym	*from,
+					long		timeout_ns);
+
+NLC_PUBLIC void		well_shm_wake(	struct well	*buf,
+					struct well_sym	*to);
+
+
+#endif /* well_shm_h_ */
@@ -0,0 +1,40 @@
+#ifndef well_trace_h_
+#define well_trace_h_
+
+/*	well_trace.h
+
+USDT (statically defined) probes, provider 'memorywell',
+	built in with the meson option 'usdt' (needs <sys/sdt.h>).
+Each probe is one nop until a tracer (bpftrace, perf) attaches to it;
+	without the option they compile to nothing.
+
+Probes; a 'sym' is the address of a well's 'tx' or 'rx' (which side,
+	and of which well):
+	reserve		(sym, requested, granted, pos)	'pos' only if 'granted'
+	release_single	(sym, count, avail_before)
+	release_multi	(sym, count, res_pos, released)	'released' 0: retry
+	fail		(wait_count)			each FAIL_DO()
+
+'fail' fires in the caller's binary (FAIL_DO() is a macro), the others
+	in the library.
+See trace/ for bpftrace examples.
+*/
+
+#include <well_config.h>
+
+#ifdef WELL_USDT
+	#include <sys/sdt.h>
+	#define WELL_PROBE1(name, a) \
+		DTRACE_PROBE1(memorywell, name, a)
+	#define WELL_PROBE3(name, a, b, c) \
+		DTRACE_PROBE3(memorywell, name, a, b, c)
+	#define WELL_PROBE4(name, a, b, c, d) \
+		DTRACE_PROBE4(memorywell, name, a, b, c, d)
+#else
+	#define WELL_PROBE1(name, a)
+	#define WELL_PROBE3(name, a, b, c)
+	#define WELL_PROBE4(name, a, b, c, d)
+#endif
+
+
+#endif /* well_trace_h_ */
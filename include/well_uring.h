@@ -0,0 +1,99 @@
+#ifndef well_uring_h_
+#define well_uring_h_
+
+/*	well_uring.h
+
+io_uring-driven I/O straight into and out of a well.
+
+An INGEST pump reserves blocks from 'tx', submits reads from 'fd' into them
+	and releases them to 'rx' as reads complete.
+A DRAIN pump reserves blocks from 'rx', submits writes to 'fd' from them
+	and releases them back to 'tx' as writes complete.
+
+The well's memory is registered once as an io_uring fixed buffer:
+	no copies, no per-block syscalls, and up to 'depth' operations in flight.
+Operations may complete in any order; blocks are always released in order.
+After an error, only what was transferred before the first failed operation
+	is released: a drain pump leaves every block it did not write on 'rx'.
+
+Each pump must be the ONLY user of the side it reserves from
+	(it releases with well_release_single()).
+One ingest and one drain pump may share a well, e.g. to copy a file.
+
+Files ('off' >= 0) keep up to 'depth' operations in flight, each at its
+	own offset; an ingest pump reads until the first EOF.
+Streams such as pipes and sockets ('off' == -1) have no offset to order
+	concurrent operations by, so they keep ONE operation in flight.
+
+Blocks are the unit of transfer: a final partial block read at EOF
+	is zero-padded, exactly like well_readv_into().
+*/
+
+#include <well.h>
+#include <liburing.h>
+#include <sys/types.h> /* off_t, ssize_t */
+
+
+/*	well_uring_op
+One operation in flight: a contiguous run of blocks.
+*/
+struct well_uring_op {
+	size_t		pos;	/* reservation */
+	size_t		count;	/* blocks */
+	size_t		len;	/* bytes wanted */
+	size_t		done;	/* bytes transferred so far */
+	off_t		off;	/* file offset of first byte; -1 for streams */
+	int		busy;	/* submitted and not yet completed */
+};
+
+
+struct well_uring {
+	struct io_uring		ring;
+	struct well		*buf;
+	struct well_sym		*from;
+	struct well_sym		*to;
+	struct well_uring_op	*ops;	/* 'depth' slots, used in submission order */
+
+	int		fd;
+	int		is_write;
+	int		fixed;	/* well memory is a registered buffer */
+	int		eof;	/* ingest: no more data will be read */
+	int		err;	/* first error seen (errno value) */
+
+	off_t		off;	/* offset of next submission; -1 for streams */
+	size_t		chunk;	/* max blocks per operation */
+	unsigned int	depth;
+	size_t		head;	/* oldest op not yet released */
+	size_t		tail;	/* next op to submit */
+};
+
+
+NLC_PUBLIC int		well_uring_ingest_init(	struct well_uring	*wu,
+						struct well		*buf,
+						int			fd,
+						off_t			off,
+						unsigned int		depth,
+						size_t			chunk);
+
+NLC_PUBLIC int		well_uring_drain_init(	struct well_uring	*wu,
+						struct well		*buf,
+						int			fd,
+						off_t			off,
+						unsigned int		depth,
+						size_t			chunk);
+
+NLC_PUBLIC void		well_uring_deinit(	struct well_uring	*wu);
+
+NLC_PUBLIC ssize_t	well_uring_pump(	struct well_uring	*wu,
+						int			wait);
+
+/*	well_uring_inflight()
+Number of operations submitted but not yet released.
+*/
+NLC_INLINE size_t well_uring_inflight(const struct well_uring *wu)
+{
+	return wu->tail - wu->head;
+}
+
+
+#endif /* well_uring_h_ */
@@ -0,0 +1,498 @@
+/*	memorywell.c
+
+CPython extension: wells from Python, with zero-copy access to reservations.
+
+Every well lives in a shared segment (well_shm.h): a memfd of our own
+	unless a file descriptor is given, so the same object works between
+	threads, forked processes, or any process attaching the descriptor.
+
+	w = memorywell.Well(blk_size, blk_count)	# or Well(fd=...) to attach
+	r = w.reserve(memorywell.TX, 16, timeout=None)	# GIL released while waiting
+	for seg in r.segments:				# 1 or 2 memoryviews
+		numpy.frombuffer(seg, dtype=...)	# views blocks in place
+	r.release()					# to the other side
+
+A reservation is also a buffer object itself when it does not wrap,
+	and a context manager which releases on exit.
+As in C, views of a reservation must not be used after it is released,
+	and a reservation dropped without being released holds its blocks for good.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h> /* first: also defines _GNU_SOURCE */
+
+#include <well_shm.h>
+#include <well_iov.h>
+#include <sys/mman.h> /* memfd_create() */
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+
+
+/* longest sleep without looking at signals (ns) */
+#define WAIT_SLICE 100000000L
+
+enum { SIDE_TX = 0, SIDE_RX = 1 };
+
+
+/*	Well
+*/
+typedef struct {
+	PyObject_HEAD
+	struct well	*buf;
+	int		fd;	/* memfd we created; -1 if the caller's */
+} WellObject;
+
+/*	Reservation
+Blocks reserved from one side of a well, until released to the other.
+*/
+typedef struct {
+	PyObject_HEAD
+	WellObject	*well;	/* NULL once released */
+	int		side;	/* reserved from */
+	size_t		pos;
+	size_t		count;
+} ReservationObject;
+
+/*	Segment
+One contiguous piece of a reservation, exported as a buffer.
+*/
+typedef struct {
+	PyObject_HEAD
+	WellObject	*well;	/* keeps the mapping alive */
+	void		*mem;
+	Py_ssize_t	len;
+} SegmentObject;
+
+static PyTypeObject WellType;
+static PyTypeObject ReservationType;
+static PyTypeObject SegmentType;
+
+
+/*	sym_of()
+*/
+static struct well_sym *sym_of(struct well *buf, int side)
+{
+	return side == SIDE_TX ? &buf->tx : &buf->rx;
+}
+
+
+/*
+	Segment
+*/
+static void segment_dealloc(SegmentObject *self)
+{
+	Py_XDECREF(self->well);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int segment_getbuffer(SegmentObject *self, Py_buffer *view, int flags)
+{
+	return PyBuffer_FillInfo(view, (PyObject *)self, self->mem, self->len, 0, flags);
+}
+
+static PyBufferProcs segment_as_buffer = {
+	.bf_getbuffer = (getbufferproc)segment_getbuffer,
+};
+
+static PyTypeObject SegmentType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "memorywell._Segment",
+	.tp_basicsize = sizeof(SegmentObject),
+	.tp_dealloc = (destructor)segment_dealloc,
+	.tp_as_buffer = &segment_as_buffer,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+};
+
+
+/*
+	Reservation
+*/
+static void reservation_dealloc(ReservationObject *self)
+{
+	Py_XDECREF(self->well);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*	live()
+Sets an exception if 'self' was already released.
+*/
+static int live(ReservationObject *self)
+{
+	if (self->well)
+		return 1;
+	PyErr_SetString(PyExc_ValueError, "reservation already released");
+	return 0;
+}
+
+static int reservation_getbuffer(ReservationObject *self, Py_buffer *view, int flags)
+{
+	if (!live(self))
+		return -1;
+	struct iovec iov[2];
+	if (well_iov(self->well->buf, self->pos, self->count, iov) != 1) {
+		PyErr_SetString(PyExc_BufferError, "reservation wraps: use .segments");
+		return -1;
+	}
+	return PyBuffer_FillInfo(view, (PyObject *)self, iov[0].iov_base,
+				iov[0].iov_len, 0, flags);
+}
+
+static PyBufferProcs reservation_as_buffer = {
+	.bf_getbuffer = (getbufferproc)reservation_getbuffer,
+};
+
+/*	Reservation.segments
+*/
+static PyObject *reservation_segments(ReservationObject *self, void *closure)
+{
+	if (!live(self))
+		return NULL;
+	struct iovec iov[2];
+	int n = well_iov(self->well->buf, self->pos, self->count, iov);
+	PyObject *tup = PyTuple_New(n);
+	if (!tup)
+		return NULL;
+	for (int i=0; i < n; i++) {
+		SegmentObject *seg = PyObject_New(SegmentObject, &SegmentType);
+		if (!seg)
+			goto err;
+		Py_INCREF(self->well);
+		seg->well = self->well;
+		seg->mem = iov[i].iov_base;
+		seg->len = iov[i].iov_len;
+		PyObject *mv = PyMemoryView_FromObject((PyObject *)seg);
+		Py_DECREF(seg);
+		if (!mv)
+			goto err;
+		PyTuple_SET_ITEM(tup, i, mv);
+	}
+	return tup;
+err:
+	Py_DECREF(tup);
+	return NULL;
+}
+
+/*	Reservation.release(multi=False)
+Release to the other side and wake anyone waiting there.
+'multi' for a side with several threads or processes reserving from it:
+	waits (GIL released) for earlier reservations to be released first.
+*/
+static PyObject *reservation_release(ReservationObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = { "multi", NULL };
+	int multi = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", kwlist, &multi))
+		return NULL;
+	if (!live(self))
+		return NULL;
+
+	struct well *buf = self->well->buf;
+	struct well_sym *to = sym_of(buf, !self->side);
+	if (!multi) {
+		well_release_single(to, self->count);
+	} else if (!well_release_multi(to, self->count, self->pos)) {
+		Py_BEGIN_ALLOW_THREADS
+		while (!well_release_multi(to, self->count, self->pos))
+			sched_yield();
+		Py_END_ALLOW_THREADS
+	}
+	well_shm_wake(buf, to);
+
+	Py_CLEAR(self->well);
+	Py_RETURN_NONE;
+}
+
+static PyObject *reservation_enter(ReservationObject *self, PyObject *unused)
+{
+	if (!live(self))
+		return NULL;
+	Py_INCREF(self);
+	return (PyObject *)self;
+}
+
+static PyObject *reservation_exit(ReservationObject *self, PyObject *args)
+{
+	if (!self->well)
+		Py_RETURN_NONE;
+	PyObject *empty = PyTuple_New(0);
+	if (!empty)
+		return NULL;
+	PyObject *ret = reservation_release(self, empty, NULL);
+	Py_DECREF(empty);
+	if (!ret)
+		return NULL;
+	Py_DECREF(ret);
+	Py_RETURN_FALSE;
+}
+
+static PyObject *reservation_get_count(ReservationObject *self, void *closure)
+{
+	return PyLong_FromSize_t(self->count);
+}
+
+static PyObject *reservation_get_pos(ReservationObject *self, void *closure)
+{
+	return PyLong_FromSize_t(self->pos);
+}
+
+static PyObject *reservation_get_side(ReservationObject *self, void *closure)
+{
+	return PyLong_FromLong(self->side);
+}
+
+static PyMethodDef reservation_methods[] = {
+	{ "release", (PyCFunction)(void(*)(void))reservation_release,
+		METH_VARARGS | METH_KEYWORDS,
+		"release(multi=False): release to the other side of the well" },
+	{ "__enter__", (PyCFunction)reservation_enter, METH_NOARGS, NULL },
+	{ "__exit__", (PyCFunction)reservation_exit, METH_VARARGS, NULL },
+	{ NULL }
+};
+
+static PyGetSetDef reservation_getset[] = {
+	{ "segments", (getter)reservation_segments, NULL,
+		"the reserved blocks as 1 or 2 writable memoryviews", NULL },
+	{ "count", (getter)reservation_get_count, NULL, "blocks reserved", NULL },
+	{ "pos", (getter)reservation_get_pos, NULL, "position of the first block", NULL },
+	{ "side", (getter)reservation_get_side, NULL, "TX or RX: reserved from", NULL },
+	{ NULL }
+};
+
+static PyTypeObject ReservationType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "memorywell.Reservation",
+	.tp_basicsize = sizeof(ReservationObject),
+	.tp_dealloc = (destructor)reservation_dealloc,
+	.tp_as_buffer = &reservation_as_buffer,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "Blocks reserved from one side of a well.",
+	.tp_methods = reservation_methods,
+	.tp_getset = reservation_getset,
+};
+
+
+/*
+	Well
+*/
+
+/*	Well(blk_size=0, blk_count=0, fd=-1)
+No 'fd': a new well in a memfd of its own.
+'fd' and sizes: a new well in that (empty) file.
+'fd' alone: attach the well already in that file.
+*/
+static int well_obj_init(WellObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = { "blk_size", "blk_count", "fd", NULL };
+	Py_ssize_t blk_size = 0, blk_count = 0;
+	int fd = -1;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|nni", kwlist,
+					&blk_size, &blk_count, &fd))
+		return -1;
+	if (self->buf) {
+		PyErr_SetString(PyExc_RuntimeError, "Well already initialized");
+		return -1;
+	}
+	if (blk_size < 0 || blk_count < 0 || (fd < 0 && (!blk_size || !blk_count))) {
+		PyErr_SetString(PyExc_ValueError, "need blk_size and blk_count, or fd");
+		return -1;
+	}
+
+	if (fd < 0) {
+		if ((self->fd = memfd_create("memorywell", MFD_CLOEXEC)) < 0) {
+			PyErr_SetFromErrno(PyExc_OSError);
+			return -1;
+		}
+		fd = self->fd;
+	}
+	if (blk_size)
+		self->buf = well_shm_create(fd, blk_size, blk_count);
+	else
+		self->buf = well_shm_attach(fd);
+	if (!self->buf) {
+		PyErr_SetString(PyExc_OSError, "cannot create or attach well");
+		return -1;
+	}
+	return 0;
+}
+
+static PyObject *well_obj_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	WellObject *self = (WellObject *)type->tp_alloc(type, 0);
+	if (self) {
+		self->buf = NULL;
+		self->fd = -1;
+	}
+	return (PyObject *)self;
+}
+
+static void well_obj_dealloc(WellObject *self)
+{
+	well_shm_detach(self->buf);
+	if (self->fd >= 0)
+		close(self->fd);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*	ready()
+Sets an exception if 'self' was never initialized.
+*/
+static int ready(WellObject *self)
+{
+	if (self->buf)
+		return 1;
+	PyErr_SetString(PyExc_ValueError, "Well not initialized");
+	return 0;
+}
+
+/*	Well.reserve(side, max_count=1, timeout=0)
+'timeout' in seconds: 0 never waits, None waits forever.
+Waiting sleeps (well_shm_wait()) with the GIL released.
+
+returns a Reservation; None on timeout.
+*/
+static PyObject *well_obj_reserve(WellObject *self, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = { "side", "max_count", "timeout", NULL };
+	int side;
+	Py_ssize_t max_count = 1;
+	PyObject *timeout = NULL;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|nO", kwlist,
+					&side, &max_count, &timeout))
+		return NULL;
+	if (!ready(self))
+		return NULL;
+	if ((side != SIDE_TX && side != SIDE_RX) || max_count < 1) {
+		PyErr_SetString(PyExc_ValueError, "side must be TX or RX; max_count > 0");
+		return NULL;
+	}
+
+	int forever = (timeout == Py_None);
+	double secs = 0;
+	if (timeout && !forever) {
+		secs = PyFloat_AsDouble(timeout);
+		if (secs == -1 && PyErr_Occurred())
+			return NULL;
+	}
+	struct timespec now, end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_sec += (time_t)secs;
+	end.tv_nsec += (long)((secs - (time_t)secs) * 1e9);
+
+	/* before reserving: nothing to undo if this fails */
+	ReservationObject *r = PyObject_New(ReservationObject, &ReservationType);
+	if (!r)
+		return NULL;
+	r->well = NULL;
+
+	struct well *buf = self->buf;
+	struct well_sym *from = sym_of(buf, side);
+	size_t pos, res;
+	while (!(res = well_reserve(from, &pos, max_count))) {
+		long left = WAIT_SLICE;
+		if (!forever) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			left = (end.tv_sec - now.tv_sec) * 1000000000L
+				+ (end.tv_nsec - now.tv_nsec);
+			if (left <= 0) {
+				Py_DECREF(r);
+				Py_RETURN_NONE;
+			}
+			if (left > WAIT_SLICE)
+				left = WAIT_SLICE;
+		}
+		Py_BEGIN_ALLOW_THREADS
+		well_shm_wait(buf, from, left);
+		Py_END_ALLOW_THREADS
+		if (PyErr_CheckSignals()) {
+			Py_DECREF(r);
+			return NULL;
+		}
+	}
+
+	Py_INCREF(self);
+	r->well = self;
+	r->side = side;
+	r->pos = pos;
+	r->count = res;
+	return (PyObject *)r;
+}
+
+static PyObject *well_obj_get_blk_size(WellObject *self, void *closure)
+{
+	if (!ready(self))
+		return NULL;
+	return PyLong_FromSize_t(well_blk_size(self->buf));
+}
+
+static PyObject *well_obj_get_blk_count(WellObject *self, void *closure)
+{
+	if (!ready(self))
+		return NULL;
+	return PyLong_FromSize_t(well_blk_count(self->buf));
+}
+
+static PyObject *well_obj_get_fd(WellObject *self, void *closure)
+{
+	return PyLong_FromLong(self->fd);
+}
+
+static PyMethodDef well_obj_methods[] = {
+	{ "reserve", (PyCFunction)(void(*)(void))well_obj_reserve,
+		METH_VARARGS | METH_KEYWORDS,
+		"reserve(side, max_count=1, timeout=0): Reservation, or None" },
+	{ NULL }
+};
+
+static PyGetSetDef well_obj_getset[] = {
+	{ "blk_size", (getter)well_obj_get_blk_size, NULL, "bytes per block", NULL },
+	{ "blk_count", (getter)well_obj_get_blk_count, NULL, "blocks in the well", NULL },
+	{ "fd", (getter)well_obj_get_fd, NULL,
+		"memfd holding the well (-1 if the caller's): attach with Well(fd=...)", NULL },
+	{ NULL }
+};
+
+static PyTypeObject WellType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "memorywell.Well",
+	.tp_basicsize = sizeof(WellObject),
+	.tp_new = well_obj_new,
+	.tp_init = (initproc)well_obj_init,
+	.tp_dealloc = (destructor)well_obj_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	.tp_doc = "Well(blk_size=0, blk_count=0, fd=-1): a well in shared memory.",
+	.tp_methods = well_obj_methods,
+	.tp_getset = well_obj_getset,
+};
+
+
+/*
+	module
+*/
+static struct PyModuleDef memorywell_module = {
+	PyModuleDef_HEAD_INIT,
+	.m_name = "memorywell",
+	.m_doc = "Nonblocking circular buffers, with zero-copy reservations.",
+	.m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_memorywell(void)
+{
+	if (PyType_Ready(&WellType) || PyType_Ready(&ReservationType)
+			|| PyType_Ready(&SegmentType))
+		return NULL;
+	PyObject *m = PyModule_Create(&memorywell_module);
+	if (!m)
+		return NULL;
+	Py_INCREF(&WellType);
+	Py_INCREF(&ReservationType);
+	if (PyModule_AddObject(m, "Well", (PyObject *)&WellType)
+			|| PyModule_AddObject(m, "Reservation", (PyObject *)&ReservationType)
+			|| PyModule_AddIntConstant(m, "TX", SIDE_TX)
+			|| PyModule_AddIntConstant(m, "RX", SIDE_RX)) {
+		Py_DECREF(m);
+		return NULL;
+	}
+	return m;
+}
@@ -1,6 +1,9 @@
 #include <zed_dbg.h>
 #include <well.h>
 #include <nmath.h>
+#include <well_trace.h>
+#include <stdlib.h> /* posix_memalign() */
+#include <sched.h> /* sched_yield() */
 
 /*
 	compile-time sanity
@@ -31,6 +34,191 @@ NLC_ASSERT(size_t_is_atomic, __atomic_always_lock_free(sizeof(size_t), 0) == 1);
 	#define UNLOCK_(lock_ptr) \
 		__atomic_clear(lock_ptr, __ATOMIC_RELEASE)
 		//__atomic_exchange_n(lock_ptr, 0, __ATOMIC_RELEASE)
+
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	/* the combiner lock */
+	#define TRYLOCK_(lock_ptr) \
+		__atomic_test_and_set(lock_ptr, __ATOMIC_ACQUIRE)
+	#define LOCK_(lock_ptr) \
+		while (TRYLOCK_(lock_ptr)) \
+			sched_yield();
+	#define UNLOCK_(lock_ptr) \
+		__atomic_clear(lock_ptr, __ATOMIC_RELEASE)
+#endif
+
+
+
+#if (WELL_TECHNIQUE == WELL_DO_FC)
+/*
+	flat combining:
+	a thread publishes its request in a slot of the side it works on,
+	then either sees it served or takes the combiner lock and serves
+	every pending request itself, in one pass over the slots.
+	'avail', 'pos' and 'release_pos' are only ever touched by the combiner,
+	so the side's control lines stay in one cache instead of bouncing.
+*/
+enum { FC_FREE = 0, FC_BUSY, FC_PENDING, FC_DONE };
+enum { FC_RESERVE, FC_RESERVE_EXACT, FC_UNRESERVE, FC_RELEASE_SINGLE, FC_RELEASE_MULTI };
+
+/*	fc_slots_()
+The request slots of 'sym'.
+*/
+NLC_INLINE struct well_fc_slot *fc_slots_(struct well_sym *sym)
+{
+	return (struct well_fc_slot *)((uintptr_t)sym + sym->fc_offt);
+}
+
+static unsigned fc_next = 0;		/* hands out slot hints */
+static __thread unsigned fc_hint = 0;	/* this thread's first slot, +1 */
+
+
+/*	fc_apply_()
+Apply one request to 'sym'; caller is the combiner.
+returns what the public function making the request returns
+*/
+static size_t fc_apply_(struct well_sym *sym, int op, size_t count, size_t *pos)
+{
+	size_t prev;
+	switch (op) {
+	case FC_RESERVE:
+		if (!sym->avail)
+			return 0;
+		if (sym->avail < count)
+			count = sym->avail;
+		/* fall through */
+	case FC_RESERVE_EXACT:
+		if (sym->avail < count)
+			return 0;
+		sym->avail -= count;
+		*pos = sym->pos;
+		sym->pos += count;
+		return count;
+
+	case FC_UNRESERVE:
+		/* '*pos' is where the reservation ends */
+		if (sym->pos != *pos)
+			return 0;
+		sym->pos -= count;
+		sym->avail += count;
+		return count;
+
+	case FC_RELEASE_SINGLE:
+		prev = sym->avail;
+		sym->avail += count;
+		return prev;
+
+	case FC_RELEASE_MULTI:
+		if (sym->release_pos != *pos)
+			return 0;
+		sym->avail += count;
+		sym->release_pos += count;
+		return count;
+	}
+	return 0;
+}
+
+
+/*	fc_pass_()
+Serve every pending slot on 'sym'.
+An out-of-order multi-release is left pending unless this is the 'last' pass:
+	a release earlier in the batch may still make it in order.
+returns number of multi-releases applied
+*/
+static unsigned fc_pass_(struct well_sym *sym, int last)
+{
+	unsigned released = 0;
+	unsigned hi = __atomic_load_n(&sym->fc_hi, __ATOMIC_ACQUIRE);
+	for (unsigned i=0; i < hi; i++) {
+		struct well_fc_slot *slot = &fc_slots_(sym)[i];
+		if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != FC_PENDING)
+			continue;
+		size_t ret = fc_apply_(sym, slot->op, slot->count, &slot->pos);
+		if (slot->op == FC_RELEASE_MULTI) {
+			if (!ret && !last)
+				continue;
+			released += !!ret;
+		}
+		slot->ret = ret;
+		__atomic_store_n(&slot->state, FC_DONE, __ATOMIC_RELEASE);
+	}
+	return released;
+}
+
+/*	fc_combine_()
+Caller holds the combiner lock.
+Repeats passes while multi-releases are unblocking each other (bounded),
+	so ordered release comes for free; what remains out of order fails.
+*/
+static void fc_combine_(struct well_sym *sym)
+{
+	for (unsigned i=0; i < WELL_FC_SLOTS && fc_pass_(sym, 0); i++)
+		;
+	fc_pass_(sym, 1);
+}
+
+
+/*	fc_do_()
+Publish a request on 'sym' and wait until a combiner (maybe this thread)
+	has served it.
+Never fails spuriously, unlike TRYLOCK_() in MTX/SPL.
+returns the request's result; '*pos' is both input and output
+*/
+static size_t fc_do_(struct well_sym *sym, int op, size_t count, size_t *pos)
+{
+	/* nothing to combine: leave the slots alone */
+	if (!count)
+		return op == FC_RELEASE_SINGLE ? __atomic_load_n(&sym->avail, __ATOMIC_ACQUIRE) : 0;
+
+	if (!fc_hint)
+		fc_hint = __atomic_fetch_add(&fc_next, 1, __ATOMIC_RELAXED) % WELL_FC_SLOTS + 1;
+
+	struct well_fc_slot *slots = fc_slots_(sym);
+	struct well_fc_slot *slot = NULL;
+	unsigned idx = 0;
+	for (unsigned i=0; i < WELL_FC_SLOTS && !slot; i++) {
+		idx = (fc_hint - 1 + i) % WELL_FC_SLOTS;
+		int expect = FC_FREE;
+		if (__atomic_compare_exchange_n(&slots[idx].state, &expect, FC_BUSY,
+						0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			slot = &slots[idx];
+	}
+	/* make sure the combiner scans this far */
+	if (slot) {
+		unsigned hi = __atomic_load_n(&sym->fc_hi, __ATOMIC_RELAXED);
+		while (hi <= idx && !__atomic_compare_exchange_n(&sym->fc_hi, &hi, idx + 1,
+						1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			;
+	}
+
+	size_t ret;
+	if (!slot) {
+		/* more threads than slots: combine, serving ourselves first */
+		LOCK_(&sym->lock);
+			ret = fc_apply_(sym, op, count, pos);
+			fc_combine_(sym);
+		UNLOCK_(&sym->lock);
+		return ret;
+	}
+
+	slot->op = op;
+	slot->count = count;
+	slot->pos = *pos;
+	__atomic_store_n(&slot->state, FC_PENDING, __ATOMIC_RELEASE);
+
+	for (unsigned i=0; __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != FC_DONE; i++) {
+		if (!__atomic_load_n(&sym->lock, __ATOMIC_RELAXED) && !TRYLOCK_(&sym->lock)) {
+			fc_combine_(sym);
+			UNLOCK_(&sym->lock);
+		} else if (i >= 64) {
+			/* the combiner may not be running */
+			sched_yield();
+		}
+	}
+	ret = slot->ret;
+	*pos = slot->pos;
+	__atomic_store_n(&slot->state, FC_FREE, __ATOMIC_RELEASE);
+	return ret;
+}
 #endif
 
 
@@ -87,57 +275,164 @@ The reason for this more complicated initialization pattern is to allow
 returns 0 on success
 */
 int well_init(struct well *buf, void *mem)
+{
+	return well_init_pshared(buf, mem, 0);
+}
+
+
+/*	well_init_pshared()
+As well_init(); if 'pshared' then any locks are usable by
+	every process which maps 'buf' (PTHREAD_PROCESS_SHARED).
+Lock-free techniques need nothing extra.
+
+returns 0 on success
+*/
+int well_init_pshared(struct well *buf, void *mem, int pshared)
 {
 	int err_cnt = 0;
 	Z_die_if(!buf, "");
-	buf->tx.release_pos = buf->rx.release_pos = 0;
-
 	Z_die_if(!mem, "");
-	buf->ct.buf = mem;
+	buf->ct.mem_offt = (uintptr_t)mem - (uintptr_t)buf;
+
+	Z_die_if(well_sym_init(&buf->tx, pshared), "");
+	if (well_sym_init(&buf->rx, pshared)) {
+		well_sym_deinit(&buf->tx);
+		Z_die("");
+	}
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_deinit()
+*/
+void well_deinit(struct well *buf)
+{
+	well_sym_deinit(&buf->tx);
+	well_sym_deinit(&buf->rx);
+}
+
 
+/*	well_sym_init()
+Prepare the contention state (release position, lock) of one side.
+'pos' and 'avail' are left alone: well_params() sets them for 'tx' and 'rx'.
+Only needed directly by structures with more than two sides (see well_pipe.h).
+FC: the request slots are allocated here, unless 'pshared':
+	then they must have been placed with well_sym_fc_place() beforehand.
+
+returns 0 on success
+*/
+int well_sym_init(struct well_sym *sym, int pshared)
+{
+	int err_cnt = 0;
+	sym->release_pos = 0;
+	sym->ticket = sym->serving = 0;
+	sym->fair = 0;
 
 #if (WELL_TECHNIQUE == WELL_DO_MTX)
-	Z_die_if(pthread_mutex_init(&buf->tx.lock, NULL), "");
-	Z_die_if(pthread_mutex_init(&buf->rx.lock, NULL), "");
+	pthread_mutexattr_t attr;
+	Z_die_if(pthread_mutexattr_init(&attr), "");
+	if (pshared && pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED)) {
+		pthread_mutexattr_destroy(&attr);
+		Z_die("process-shared mutex not supported");
+	}
+	int ret = pthread_mutex_init(&sym->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	Z_die_if(ret, "");
+out:
 #elif (WELL_TECHNIQUE == WELL_DO_SPL)
-	buf->tx.lock = buf->rx.lock = 0;
+	sym->lock = 0;
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	sym->lock = 0;
+	sym->fc_hi = 0;
+	sym->fc_own = !pshared;
+	if (sym->fc_own) {
+		struct well_fc_slot *slots;
+		Z_die_if(posix_memalign((void **)&slots, _Alignof(struct well_fc_slot),
+				WELL_FC_SLOTS * sizeof(struct well_fc_slot)), "");
+		sym->fc_offt = (uintptr_t)slots - (uintptr_t)sym;
+	}
+	for (unsigned i=0; i < WELL_FC_SLOTS; i++)
+		fc_slots_(sym)[i].state = FC_FREE;
+out:
 #endif
 
-out:
 	return err_cnt;
 }
 
 
-/*	well_deinit()
+/*	well_sym_deinit()
 */
-void well_deinit(struct well *buf)
+void well_sym_deinit(struct well_sym *sym)
 {
 #if (WELL_TECHNIQUE == WELL_DO_MTX)
-	Z_die_if(pthread_mutex_destroy(&buf->tx.lock), "");
-	Z_die_if(pthread_mutex_destroy(&buf->rx.lock), "");
+	int err_cnt = 0;
+	Z_die_if(pthread_mutex_destroy(&sym->lock), "");
 out:
 	return;
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	if (sym->fc_own)
+		free(fc_slots_(sym));
+	sym->fc_own = 0;
 #endif
 }
 
 
+#if (WELL_TECHNIQUE == WELL_DO_FC)
+/*	well_sym_fc_place()
+FC: have 'sym' use 'slots' (WELL_FC_SLOTS of them, caller-owned) for requests,
+	instead of allocating its own.
+Required before a process-shared init: 'slots' must be in the shared
+	mapping too, at the same offset from 'sym' in every process.
+*/
+void well_sym_fc_place(struct well_sym *sym, struct well_fc_slot *slots)
+{
+	sym->fc_offt = (uintptr_t)slots - (uintptr_t)sym;
+}
+#endif
+
+
 
-/*	well_reserve()
-Reserve up to 'max_count' buffer blocks;
-	single OR multiple producers/consumers.
+/*	well_fair()
+Switch FAIR mode on or off for both sides of 'buf'; safe at any time.
+Unfair, a reserver may lose the race for 'avail' (or the lock) again and
+	again while others win.
+Fair, each well_reserve() call takes a ticket and waits its turn, so calls
+	are served in arrival order and a caller's wait is bounded by the
+	reservers ahead of it; a call finding no blocks still returns 0.
+	Under MTX/SPL, a caller whose turn it is waits for the lock:
+	it never fails spuriously while blocks are available.
+Costs a shared ticket counter and a handoff per call.
+*/
+void well_fair(struct well *buf, int fair)
+{
+	__atomic_store_n(&buf->tx.fair, !!fair, __ATOMIC_RELAXED);
+	__atomic_store_n(&buf->rx.fair, !!fair, __ATOMIC_RELAXED);
+}
 
-Returns number of slots reserved; writes an opaque
-	"position" variable into '*out_pos'.
-Use _access() with '*out_pos' to obtain valid pointers.
 
-On failure, returns 0 and '*out_pos' is garbage.
+/*	wait_turn_()
+Spin a little, then yield: the holder of the turn may not be running.
+*/
+NLC_INLINE void wait_turn_(struct well_sym *sym, size_t ticket)
+{
+	for (unsigned i=0; __atomic_load_n(&sym->serving, __ATOMIC_ACQUIRE) != ticket; i++) {
+		if (i >= 64)
+			sched_yield();
+	}
+}
 
-NOTE ON TIMING: will not wait; will not spin.
-	Caller decides whether to sleep(), yield() or whatever.
+
+/*	reserve_()
+well_reserve() without the probe.
+'fair': the caller holds the turn, so MTX/SPL wait for the lock rather
+	than fail spuriously.
 */
-size_t well_reserve(struct well_sym	*from,
-			size_t		*out_pos,
-			size_t		max_count)
+NLC_INLINE size_t reserve_(struct well_sym	*from,
+				size_t		*out_pos,
+				size_t		max_count,
+				int		fair)
 {
 #if (WELL_TECHNIQUE == WELL_DO_CAS)
 	/* fail early and cheaply */
@@ -166,25 +461,182 @@ size_t well_reserve(struct well_sym	*from,
 	return count;
 
 
+#elif (WELL_TECHNIQUE == WELL_DO_MTX || WELL_TECHNIQUE == WELL_DO_SPL)
+	size_t ret = 0;
+	if (fair) {
+		LOCK_(&from->lock);
+	} else if (TRYLOCK_(&from->lock)) {
+		return 0;
+	}
+	if (from->avail) {
+		if (from->avail < max_count) {
+			max_count = from->avail;
+			from->avail = 0;
+		} else {
+			from->avail -= max_count;
+		}
+		*out_pos = from->pos;
+		from->pos += max_count;
+		ret = max_count;
+	}
+	UNLOCK_(&from->lock);
+	return ret;
+
+
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	return fc_do_(from, FC_RESERVE, max_count, out_pos);
+
+
+#else
+#error "well technique not implemented"
+#endif
+}
+
+
+
+/*	well_reserve()
+Reserve up to 'max_count' buffer blocks;
+	single OR multiple producers/consumers.
+
+Returns number of slots reserved; writes an opaque
+	"position" variable into '*out_pos'.
+Use _access() with '*out_pos' to obtain valid pointers.
+
+On failure, returns 0 and '*out_pos' is garbage.
+
+NOTE ON TIMING: will not wait; will not spin.
+	Caller decides whether to sleep(), yield() or whatever.
+	Exception: in fair mode (well_fair()) it waits for its turn
+	behind earlier callers, never for blocks.
+*/
+size_t well_reserve(struct well_sym	*from,
+			size_t		*out_pos,
+			size_t		max_count)
+{
+	size_t res;
+	if (__atomic_load_n(&from->fair, __ATOMIC_RELAXED)) {
+		size_t ticket = __atomic_fetch_add(&from->ticket, 1, __ATOMIC_RELAXED);
+		wait_turn_(from, ticket);
+		res = reserve_(from, out_pos, max_count, 1);
+		__atomic_store_n(&from->serving, ticket + 1, __ATOMIC_RELEASE);
+	} else {
+		res = reserve_(from, out_pos, max_count, 0);
+	}
+	WELL_PROBE4(reserve, from, max_count, res, res ? *out_pos : 0);
+	return res;
+}
+
+
+
+/*	well_reserve_exact()
+Reserve exactly 'count' blocks, or none at all.
+E.g. reserving 'well_blk_count()' blocks from 'tx' succeeds only when the
+	well is empty and idle: no block is held by anyone else.
+
+returns 'count' on success; 0 otherwise ('*out_pos' is then garbage).
+*/
+size_t well_reserve_exact(struct well_sym	*from,
+				size_t		*out_pos,
+				size_t		count)
+{
+	if (!count)
+		return 0;
+
+#if (WELL_TECHNIQUE == WELL_DO_CAS)
+	size_t avail = __atomic_load_n(&from->avail, __ATOMIC_RELAXED);
+	do {
+		if (avail < count)
+			return 0;
+	} while (!(__atomic_compare_exchange_n(&from->avail, &avail, avail - count,
+						1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)));
+	*out_pos = __atomic_fetch_add(&from->pos, count, __ATOMIC_RELAXED);
+	return count;
+
+
+#elif (WELL_TECHNIQUE == WELL_DO_XCH)
+	size_t avail = __atomic_exchange_n(&from->avail, 0, __ATOMIC_ACQUIRE);
+	if (avail < count) {
+		if (avail)
+			__atomic_fetch_add(&from->avail, avail, __ATOMIC_RELAXED);
+		return 0;
+	}
+	if (avail > count)
+		__atomic_fetch_add(&from->avail, avail - count, __ATOMIC_RELAXED);
+	*out_pos = __atomic_fetch_add(&from->pos, count, __ATOMIC_RELAXED);
+	return count;
+
+
 #elif (WELL_TECHNIQUE == WELL_DO_MTX || WELL_TECHNIQUE == WELL_DO_SPL)
 	size_t ret = 0;
 	if (!TRYLOCK_(&from->lock)) {
-		if (from->avail) {
-			if (from->avail < max_count) {
-				max_count = from->avail;
-				from->avail = 0;
-			} else {
-				from->avail -= max_count;
-			}
+		if (from->avail >= count) {
+			from->avail -= count;
 			*out_pos = from->pos;
-			from->pos += max_count;
-			ret = max_count;
+			from->pos += count;
+			ret = count;
 		}
 		UNLOCK_(&from->lock);
 	}
 	return ret;
 
 
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	return fc_do_(from, FC_RESERVE_EXACT, count, out_pos);
+
+
+#else
+#error "well technique not implemented"
+#endif
+}
+
+
+
+/*	well_unreserve()
+Give back 'count' blocks starting at 'pos', which must be the tail end
+	of a reservation (e.g. 'pos' = reservation pos + blocks actually used),
+	without them ever being seen by the other side of the buffer.
+
+Only possible while no later reservation has been made on 'from':
+	i.e. the tail being returned is at the head of the buffer.
+
+returns 'count' on success, 0 if a later reservation exists
+	(caller must then release the blocks as usual).
+*/
+size_t well_unreserve(struct well_sym	*from,
+			size_t		pos,
+			size_t		count)
+{
+	if (!count)
+		return 0;
+	size_t end = pos + count;
+
+#if (WELL_TECHNIQUE == WELL_DO_CAS || WELL_TECHNIQUE == WELL_DO_XCH)
+	/* Any reserver which has already taken from 'avail' but not yet
+		advanced 'pos' will simply be handed the blocks we give back.
+	*/
+	if (!__atomic_compare_exchange_n(&from->pos, &end, pos,
+					0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return 0;
+	__atomic_add_fetch(&from->avail, count, __ATOMIC_RELEASE);
+	return count;
+
+
+#elif (WELL_TECHNIQUE == WELL_DO_MTX || WELL_TECHNIQUE == WELL_DO_SPL)
+	size_t ret = 0;
+	LOCK_(&from->lock);
+		if (from->pos == end) {
+			from->pos = pos;
+			from->avail += count;
+			ret = count;
+		}
+	UNLOCK_(&from->lock);
+	return ret;
+
+
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	return fc_do_(from, FC_UNRESERVE, count, &end);
+
+
 #else
 #error "well technique not implemented"
 #endif
@@ -200,18 +652,34 @@ WARNING: ONLY call from SINGLE producer/consumer.
 
 NOTE RE LOCKING: this function will always succeed;
 	this means we are obliged to mutex_wait or spinlock until we acquire a lock.
+
+returns number of blocks available on 'to' BEFORE the release:
+	0 means this release took 'to' from empty to non-empty (see well_set.h).
 */
-void well_release_single(struct well_sym	*to,
+size_t well_release_single(struct well_sym	*to,
 				size_t		count)
 {
 #if (WELL_TECHNIQUE == WELL_DO_CAS || WELL_TECHNIQUE == WELL_DO_XCH)
-	__atomic_add_fetch(&to->avail, count, __ATOMIC_RELEASE);
+	size_t prev = __atomic_fetch_add(&to->avail, count, __ATOMIC_RELEASE);
+	WELL_PROBE3(release_single, to, count, prev);
+	return prev;
 
 
 #elif (WELL_TECHNIQUE == WELL_DO_MTX || WELL_TECHNIQUE == WELL_DO_SPL)
+	size_t prev;
 	LOCK_(&to->lock);
+		prev = to->avail;
 		to->avail += count;
 	UNLOCK_(&to->lock);
+	WELL_PROBE3(release_single, to, count, prev);
+	return prev;
+
+
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	size_t pos = 0;
+	size_t prev = fc_do_(to, FC_RELEASE_SINGLE, count, &pos);
+	WELL_PROBE3(release_single, to, count, prev);
+	return prev;
 
 
 #else
@@ -221,18 +689,10 @@ void well_release_single(struct well_sym	*to,
 
 
 
-/*	well_release_multi()
-Release a reservation made under contention (multiple threads on RX or TX side).
-Requires 'res_pos' which is the 'pos' value written by an earlier successful
-	call to reserve().
-WARNINGS:
-	- nonsense values of 'count' or 'res_pos' can lock up the entire buffer.
-	- NEVER use both _release_single() and _release_multi()
-		on the same side of the buffer.
-
-returns 0 on failure, original value of 'count' on success.
+/*	release_multi_()
+well_release_multi() without the probe.
 */
-size_t	well_release_multi(struct well_sym	*to,
+NLC_INLINE size_t release_multi_(struct well_sym	*to,
 				size_t		count,
 				size_t		res_pos)
 {
@@ -258,7 +718,33 @@ size_t	well_release_multi(struct well_sym	*to,
 	return ret;
 
 
+#elif (WELL_TECHNIQUE == WELL_DO_FC)
+	return fc_do_(to, FC_RELEASE_MULTI, count, &res_pos);
+
+
 #else
 #error "well technique not implemented"
 #endif
 }
+
+
+
+/*	well_release_multi()
+Release a reservation made under contention (multiple threads on RX or TX side).
+Requires 'res_pos' which is the 'pos' value written by an earlier successful
+	call to reserve().
+WARNINGS:
+	- nonsense values of 'count' or 'res_pos' can lock up the entire buffer.
+	- NEVER use both _release_single() and _release_multi()
+		on the same side of the buffer.
+
+returns 0 on failure, original value of 'count' on success.
+*/
+size_t	well_release_multi(struct well_sym	*to,
+				size_t		count,
+				size_t		res_pos)
+{
+	size_t ret = release_multi_(to, count, res_pos);
+	WELL_PROBE4(release_multi, to, count, res_pos, ret);
+	return ret;
+}
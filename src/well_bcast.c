@@ -0,0 +1,84 @@
+#include <zed_dbg.h>
+#include <well_bcast.h>
+#include <stdlib.h> /* posix_memalign() */
+
+
+/*	well_bcast_init()
+As well_init() on '&bc->well' (which must have had well_params() called on it),
+	plus 'consumers' read cursors, all starting at the first block.
+
+returns 0 on success
+*/
+int well_bcast_init(struct well_bcast *bc, void *mem, size_t consumers)
+{
+	int err_cnt = 0;
+	Z_die_if(!bc, "");
+	Z_die_if(!consumers, "need at least one consumer");
+	bc->cursors = NULL;
+	bc->cnt = consumers;
+	bc->reclaimed = 0;
+
+	Z_die_if(posix_memalign((void **)&bc->cursors, _Alignof(struct well_cursor),
+			consumers * sizeof(struct well_cursor)), "");
+	for (size_t i=0; i < consumers; i++)
+		bc->cursors[i].pos = 0;
+
+	if (well_init(&bc->well, mem)) {
+		free(bc->cursors);
+		bc->cursors = NULL;
+		Z_die("");
+	}
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_bcast_deinit()
+*/
+void well_bcast_deinit(struct well_bcast *bc)
+{
+	if (!bc || !bc->cursors)
+		return;
+	well_deinit(&bc->well);
+	free(bc->cursors);
+	bc->cursors = NULL;
+}
+
+
+/*	well_bcast_reclaim()
+Return to 'tx' every slot which ALL consumers have finished with.
+Safe to call from any number of producers.
+
+returns number of slots reclaimed.
+*/
+size_t well_bcast_reclaim(struct well_bcast *bc)
+{
+	/* nothing unpublished can have been read */
+	size_t min = __atomic_load_n(&bc->well.rx.avail, __ATOMIC_ACQUIRE);
+	/* acquire: consumers are done reading before we let the slot be overwritten */
+	for (size_t i=0; i < bc->cnt; i++) {
+		size_t pos = __atomic_load_n(&bc->cursors[i].pos, __ATOMIC_ACQUIRE);
+		if (pos < min)
+			min = pos;
+	}
+
+	size_t old = __atomic_load_n(&bc->reclaimed, __ATOMIC_RELAXED);
+	while (old < min) {
+		if (__atomic_compare_exchange_n(&bc->reclaimed, &old, min,
+						1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			well_release_single(&bc->well.tx, min - old);
+			return min - old;
+		}
+	}
+	return 0;
+}
+
+
+/*	well_bcast_leave()
+Consumer 'id' will read no more: producers stop waiting for it.
+*/
+void well_bcast_leave(struct well_bcast *bc, size_t id)
+{
+	__atomic_store_n(&bc->cursors[id].pos, WELL_CURSOR_GONE, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,186 @@
+#include <zed_dbg.h>
+#include <well_chain.h>
+#include <stdlib.h>
+#include <string.h> /* memset() */
+
+
+/*	seg_header()
+Segment data starts on the first line after the header.
+*/
+static size_t seg_header()
+{
+	return (sizeof(struct well_seg) + WELL_LINE - 1) & ~((size_t)WELL_LINE - 1);
+}
+
+
+/*	seg_new()
+Take a spare segment or allocate one; either way, fresh and empty.
+*/
+static struct well_seg *seg_new(struct well_chain *chain)
+{
+	int err_cnt = 0;
+	struct well_seg *seg = NULL;
+	size_t pos;
+
+	if (well_reserve(&chain->spare.rx, &pos, 1)) {
+		seg = WELL_DEREF(struct well_seg *, pos, 0, &chain->spare);
+		well_release_single(&chain->spare.tx, 1);
+	} else {
+		Z_die_if(posix_memalign((void **)&seg, WELL_LINE,
+				seg_header() + chain->blk_size * chain->blk_cnt), "");
+		__atomic_add_fetch(&chain->grown, 1, __ATOMIC_RELAXED);
+	}
+
+	memset(seg, 0x0, sizeof(*seg));
+	Z_die_if(well_params(chain->blk_size, chain->blk_cnt, &seg->well), "");
+	Z_die_if(well_init(&seg->well, (char *)seg + seg_header()), "");
+
+out:
+	if (err_cnt && seg) {
+		free(seg);
+		__atomic_add_fetch(&chain->freed, 1, __ATOMIC_RELAXED);
+		seg = NULL;
+	}
+	return seg;
+}
+
+
+/*	seg_recycle()
+Keep a drained segment as a spare if there is room; else free it.
+*/
+static void seg_recycle(struct well_chain *chain, struct well_seg *seg)
+{
+	size_t pos;
+	well_deinit(&seg->well);
+	if (well_reserve(&chain->spare.tx, &pos, 1)) {
+		WELL_DEREF(struct well_seg *, pos, 0, &chain->spare) = seg;
+		well_release_single(&chain->spare.rx, 1);
+	} else {
+		free(seg);
+		__atomic_add_fetch(&chain->freed, 1, __ATOMIC_RELAXED);
+	}
+}
+
+
+/*	well_chain_init()
+Each segment holds 'blk_cnt' blocks of 'blk_size' (both rounded up as by
+	well_params()); at least 'keep' drained segments are kept as spares.
+
+returns 0 on success
+*/
+int well_chain_init(struct well_chain *chain, size_t blk_size, size_t blk_cnt, size_t keep)
+{
+	int err_cnt = 0;
+	Z_die_if(!chain, "");
+	Z_die_if(!keep, "keep at least 1 spare segment");
+	memset(chain, 0x0, sizeof(*chain));
+
+	/* validate once: segments are sized the same way */
+	struct well params = { {0} };
+	Z_die_if(well_params(blk_size, blk_cnt, &params), "");
+	chain->blk_size = well_blk_size(&params);
+	chain->blk_cnt = well_blk_count(&params);
+
+	Z_die_if(well_params(sizeof(struct well_seg *), keep, &chain->spare), "");
+	Z_die_if(well_init(&chain->spare, malloc(well_size(&chain->spare))), "");
+
+	Z_die_if(!(chain->tail = seg_new(chain)), "");
+	chain->head = chain->first = chain->tail;
+
+out:
+	if (err_cnt && chain) {
+		if (well_mem(&chain->spare)) {
+			well_deinit(&chain->spare);
+			free(well_mem(&chain->spare));
+		}
+		memset(chain, 0x0, sizeof(*chain));
+	}
+	return err_cnt;
+}
+
+
+/*	well_chain_deinit()
+Both producer and consumer must be finished.
+*/
+void well_chain_deinit(struct well_chain *chain)
+{
+	if (!chain || !chain->first)
+		return;
+
+	for (struct well_seg *seg = chain->first, *succ; seg; seg = succ) {
+		succ = seg->succ;
+		well_deinit(&seg->well);
+		free(seg);
+	}
+	size_t pos;
+	while (well_reserve(&chain->spare.rx, &pos, 1)) {
+		free(WELL_DEREF(struct well_seg *, pos, 0, &chain->spare));
+		well_release_single(&chain->spare.tx, 1);
+	}
+	well_deinit(&chain->spare);
+	free(well_mem(&chain->spare));
+	memset(chain, 0x0, sizeof(*chain));
+}
+
+
+/*	well_chain_grow()
+Producer, slow path: the tail segment is full; link a new one.
+The link is published to the consumer once every block reserved in the
+	old tail has been released (see well_chain_release()).
+
+returns the new tail; NULL if no segment could be allocated.
+*/
+struct well_seg *well_chain_grow(struct well_chain *chain)
+{
+	struct well_seg *seg = seg_new(chain);
+	if (!seg)
+		return NULL;
+
+	struct well_seg *old = chain->tail;
+	old->succ = seg;
+	chain->tail = seg;
+	if (!old->pending)
+		__atomic_store_n(&old->next, seg, __ATOMIC_RELEASE);
+	return seg;
+}
+
+
+/*	well_chain_advance()
+Consumer, slow path: nothing to take from the head segment.
+If the producer has moved on, and everything it released here has been taken,
+	move to the next segment.
+
+returns segment to take from next; NULL if the queue is empty.
+*/
+struct well_seg *well_chain_advance(struct well_chain *chain)
+{
+	struct well_seg *seg = chain->head;
+	struct well_seg *next = __atomic_load_n(&seg->next, __ATOMIC_ACQUIRE);
+	if (!next)
+		return NULL;
+
+	/* released before 'next' was published, but after our failed reserve */
+	if (__atomic_load_n(&seg->well.rx.avail, __ATOMIC_ACQUIRE))
+		return seg;
+
+	chain->head = next;
+	well_chain_retire(chain);
+	return next;
+}
+
+
+/*	well_chain_retire()
+Consumer: recycle segments behind the head once every block taken from them
+	is done with.
+*/
+void well_chain_retire(struct well_chain *chain)
+{
+	while (chain->first != chain->head
+		&& __atomic_load_n(&chain->first->well.tx.avail, __ATOMIC_ACQUIRE)
+			== chain->blk_cnt)
+	{
+		struct well_seg *seg = chain->first;
+		chain->first = seg->next;
+		seg_recycle(chain, seg);
+	}
+}
@@ -0,0 +1,225 @@
+#include <well_copy.h>
+#include <well_iov.h>
+#include <string.h> /* memcpy() */
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_STREAM_ 1
+#endif
+
+
+/* copies of this many bytes or more stream past the cache, by default */
+#define WELL_COPY_NT_MIN (256 * 1024)
+
+static size_t nt_min = WELL_COPY_NT_MIN;
+
+
+/*
+	kernels: 'len' a multiple of 64, 'dst' 64-byte aligned
+*/
+#ifdef HAVE_STREAM_
+__attribute__((target("avx512f")))
+static void stream_avx512(char *dst, const char *src, size_t len)
+{
+	for (size_t i=0; i < len; i += 64)
+		_mm512_stream_si512((__m512i *)(dst + i),
+					_mm512_loadu_si512((const void *)(src + i)));
+}
+
+__attribute__((target("avx2")))
+static void stream_avx2(char *dst, const char *src, size_t len)
+{
+	for (size_t i=0; i < len; i += 64) {
+		_mm256_stream_si256((__m256i *)(dst + i),
+				_mm256_loadu_si256((const __m256i *)(src + i)));
+		_mm256_stream_si256((__m256i *)(dst + i + 32),
+				_mm256_loadu_si256((const __m256i *)(src + i + 32)));
+	}
+}
+
+__attribute__((target("sse2")))
+static void stream_sse2(char *dst, const char *src, size_t len)
+{
+	for (size_t i=0; i < len; i += 64) {
+		for (size_t j=0; j < 64; j += 16)
+			_mm_stream_si128((__m128i *)(dst + i + j),
+					_mm_loadu_si128((const __m128i *)(src + i + j)));
+	}
+}
+#endif
+
+static void stream_memcpy(char *dst, const char *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+
+
+/*
+	runtime dispatch
+*/
+static void (*stream_)(char *dst, const char *src, size_t len) = stream_memcpy;
+static const char *isa_ = NULL;
+
+/*	pick()
+Choose a kernel for this CPU; idempotent, so racing callers are harmless.
+*/
+static void pick(void)
+{
+	const char *isa = "memcpy";
+	void (*fn)(char *, const char *, size_t) = stream_memcpy;
+#ifdef HAVE_STREAM_
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		isa = "avx512";
+		fn = stream_avx512;
+	} else if (__builtin_cpu_supports("avx2")) {
+		isa = "avx2";
+		fn = stream_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		isa = "sse2";
+		fn = stream_sse2;
+	}
+#endif
+	__atomic_store_n(&stream_, fn, __ATOMIC_RELAXED);
+	__atomic_store_n(&isa_, isa, __ATOMIC_RELEASE);
+}
+
+/*	well_copy_isa()
+returns the name of the streaming kernel in use:
+	"avx512", "avx2", "sse2" or "memcpy".
+*/
+const char *well_copy_isa(void)
+{
+	const char *isa = __atomic_load_n(&isa_, __ATOMIC_ACQUIRE);
+	if (!isa) {
+		pick();
+		isa = __atomic_load_n(&isa_, __ATOMIC_ACQUIRE);
+	}
+	return isa;
+}
+
+
+/*	well_copy_nt_min()
+returns the copy length (bytes) from which streaming stores are used.
+*/
+size_t well_copy_nt_min(void)
+{
+	return __atomic_load_n(&nt_min, __ATOMIC_RELAXED);
+}
+
+/*	well_copy_set_nt_min()
+Stream copies of at least 'bytes' bytes: 0 always, SIZE_MAX never.
+Process-wide.
+*/
+void well_copy_set_nt_min(size_t bytes)
+{
+	__atomic_store_n(&nt_min, bytes, __ATOMIC_RELAXED);
+}
+
+
+/*	copy_nt()
+*/
+static void copy_nt(char *dst, const char *src, size_t len)
+{
+	/* streaming stores want whole, aligned lines */
+	size_t head = -(uintptr_t)dst & 63;
+	if (head > len)
+		head = len;
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	len -= head;
+
+	size_t body = len & ~(size_t)63;
+	stream_(dst, src, body);
+	memcpy(dst + body, src + body, len - body);
+}
+
+/*	copy_segs()
+Copy 'len' bytes between 'mem' and the blocks from 'pos' on,
+	'in' being the direction.
+*/
+static void copy_segs(const struct well *buf, size_t pos, char *mem, size_t len, int in)
+{
+	if (!len)
+		return;
+	int nt = len >= well_copy_nt_min();
+	if (nt)
+		well_copy_isa(); /* pick a kernel */
+
+	size_t blks = (len + well_blk_size(buf) - 1) / well_blk_size(buf);
+	struct iovec iov[2];
+	int n = well_iov(buf, pos, blks, iov);
+	for (int i=0; i < n && len; i++) {
+		size_t seg = iov[i].iov_len < len ? iov[i].iov_len : len;
+		char *dst = in ? iov[i].iov_base : mem;
+		const char *src = in ? mem : iov[i].iov_base;
+		if (nt)
+			copy_nt(dst, src, seg);
+		else
+			memcpy(dst, src, seg);
+		mem += seg;
+		len -= seg;
+	}
+
+#ifdef HAVE_STREAM_
+	/* streaming stores are not ordered by a later release: fence them */
+	if (nt)
+		_mm_sfence();
+#endif
+}
+
+
+/*	well_copy_in()
+Copy 'len' bytes from 'src' into the blocks starting at 'pos'
+	(which the caller has reserved, as many as 'len' spans).
+*/
+void well_copy_in(struct well *buf, size_t pos, const void *src, size_t len)
+{
+	copy_segs(buf, pos, (char *)src, len, 1);
+}
+
+/*	well_copy_out()
+Copy 'len' bytes from the blocks starting at 'pos' into 'dst'.
+*/
+void well_copy_out(const struct well *buf, size_t pos, void *dst, size_t len)
+{
+	copy_segs(buf, pos, dst, len, 0);
+}
+
+
+/*	well_prefetch()
+Prefetch 'len' bytes of blocks starting at 'pos', to read or 'for_write'.
+*/
+void well_prefetch(const struct well *buf, size_t pos, size_t len, int for_write)
+{
+	if (!len)
+		return;
+	if (len > well_size(buf))
+		len = well_size(buf);
+	size_t blks = (len + well_blk_size(buf) - 1) / well_blk_size(buf);
+	struct iovec iov[2];
+	int n = well_iov(buf, pos, blks, iov);
+	for (int i=0; i < n && len; i++) {
+		size_t seg = iov[i].iov_len < len ? iov[i].iov_len : len;
+		const char *p = iov[i].iov_base;
+		for (size_t off=0; off < seg; off += WELL_LINE) {
+			if (for_write)
+				__builtin_prefetch(p + off, 1, 3);
+			else
+				__builtin_prefetch(p + off, 0, 3);
+		}
+		len -= seg;
+	}
+}
+
+/*	well_prefetch_next()
+Prefetch the first 'len' bytes of the next reservation from 'from'
+	(a side of 'buf'): its blocks start at 'from->pos'.
+With several threads on 'from' this is only a guess.
+*/
+void well_prefetch_next(const struct well *buf, struct well_sym *from,
+			size_t len, int for_write)
+{
+	well_prefetch(buf, __atomic_load_n(&from->pos, __ATOMIC_RELAXED), len, for_write);
+}
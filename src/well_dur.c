@@ -0,0 +1,311 @@
+#include <zed_dbg.h>
+#include <well_dur.h>
+#include <nmath.h>
+#include <string.h> /* strerror() */
+#include <errno.h>
+#include <time.h> /* nanosleep() */
+#include <sched.h> /* sched_yield() */
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*	data_offt()
+Buffer starts on the first page boundary after the header.
+*/
+static size_t data_offt()
+{
+	return nm_next_mult64(sizeof(struct well_dur_hdr), sysconf(_SC_PAGESIZE));
+}
+
+
+/*	rec_sum()
+FNV-1a over the fields of a record.
+*/
+static uint64_t rec_sum(const struct well_dur_rec *rec)
+{
+	uint64_t vals[3] = { rec->seq, rec->head, rec->tail };
+	const unsigned char *p = (const unsigned char *)vals;
+	uint64_t sum = 0xcbf29ce484222325;
+	for (size_t i=0; i < sizeof(vals); i++) {
+		sum ^= p[i];
+		sum *= 0x100000001b3;
+	}
+	return sum;
+}
+
+
+/*	sync_range()
+msync() bytes [start, end) of the mapping, widened to whole pages.
+
+returns 0 on success
+*/
+static int sync_range(struct well_dur *dw, size_t start, size_t end)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	start &= ~(page - 1);
+	end = nm_next_mult64(end, page);
+	if (msync((char *)dw->hdr + start, end - start, MS_SYNC)) {
+		Z_log(Z_err, "msync: %s", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+
+/*	sync_blocks()
+Sync 'count' blocks from 'pos', which may wrap around the end of the buffer.
+
+returns 0 on success
+*/
+static int sync_blocks(struct well_dur *dw, size_t pos, size_t count)
+{
+	struct well *buf = well_dur_well(dw);
+	size_t start = (pos << buf->ct.blk_shift) & buf->ct.overflow;
+	size_t len = count << buf->ct.blk_shift;
+	if (start + len <= well_size(buf))
+		return sync_range(dw, data_offt() + start, data_offt() + start + len);
+	return sync_range(dw, data_offt() + start, data_offt() + well_size(buf))
+		|| sync_range(dw, data_offt(), data_offt() + start + len - well_size(buf));
+}
+
+
+/*	recover()
+Pick the newest valid record in the header.
+
+returns 0 on success
+*/
+static int recover(struct well_dur *dw)
+{
+	int err_cnt = 0;
+	const struct well_dur_rec *best = NULL;
+	for (int i=0; i < 2; i++) {
+		const struct well_dur_rec *rec = &dw->hdr->rec[i];
+		if (!rec->seq || rec->sum != rec_sum(rec))
+			continue;
+		if (!best || rec->seq > best->seq)
+			best = rec;
+	}
+
+	dw->seq = dw->head = dw->tail = 0;
+	if (best) {
+		Z_die_if(best->head > best->tail || best->tail - best->head > dw->hdr->blk_count,
+			"record %zu: head %zu; tail %zu",
+			(size_t)best->seq, (size_t)best->head, (size_t)best->tail);
+		dw->seq = best->seq;
+		dw->head = best->head;
+		dw->tail = best->tail;
+	}
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_dur_open()
+Open the durable well in the file on 'fd'.
+An empty file is formatted for 'blk_cnt' blocks of 'blk_size'.
+Otherwise the well is recovered from the file: everything committed
+	and not yet consumed is there to be read again, in order.
+'blk_size' and 'blk_cnt' may then be 0; if not, they must match the file.
+
+returns 0 on success
+*/
+int well_dur_open(struct well_dur *dw, int fd, size_t blk_size, size_t blk_cnt)
+{
+	int err_cnt = 0;
+	Z_die_if(!dw, "");
+	*dw = (struct well_dur){ .fd = fd, .hdr = MAP_FAILED };
+	Z_die_if(fd < 0, "fd %d", fd);
+
+	struct stat st;
+	Z_die_if(fstat(fd, &st), "%s", strerror(errno));
+	int fresh = !st.st_size;
+
+	if (fresh) {
+		Z_die_if(well_params(blk_size, blk_cnt, &dw->pipe.well),
+			"blk_size %zu; blk_cnt %zu", blk_size, blk_cnt);
+		dw->map_size = data_offt() + well_size(&dw->pipe.well);
+		Z_die_if(ftruncate(fd, dw->map_size), "%s", strerror(errno));
+	} else {
+		Z_die_if((size_t)st.st_size < data_offt(), "file size %zu", (size_t)st.st_size);
+		dw->map_size = st.st_size;
+	}
+	dw->hdr = mmap(NULL, dw->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	Z_die_if(dw->hdr == MAP_FAILED, "%s", strerror(errno));
+
+	if (fresh) {
+		*dw->hdr = (struct well_dur_hdr){
+			.magic = WELL_DUR_MAGIC,
+			.version = WELL_DUR_VERSION,
+			.blk_size = well_blk_size(&dw->pipe.well),
+			.blk_count = well_blk_count(&dw->pipe.well)
+		};
+		Z_die_if(sync_range(dw, 0, data_offt()) || fsync(fd), "");
+	} else {
+		Z_die_if(dw->hdr->magic != WELL_DUR_MAGIC, "not a durable well: magic 0x%x",
+			dw->hdr->magic);
+		Z_die_if(dw->hdr->version != WELL_DUR_VERSION,
+			"version %u; expected %u", dw->hdr->version, WELL_DUR_VERSION);
+		Z_die_if(well_params(dw->hdr->blk_size, dw->hdr->blk_count, &dw->pipe.well), "");
+		Z_die_if(dw->map_size != data_offt() + well_size(&dw->pipe.well),
+			"file size %zu inconsistent with header", dw->map_size);
+		if (blk_size || blk_cnt) {
+			struct well want = { {0} };
+			Z_die_if(well_params(blk_size, blk_cnt, &want)
+				|| well_blk_size(&want) != dw->hdr->blk_size
+				|| well_blk_count(&want) != dw->hdr->blk_count,
+				"file holds %zu blocks of %zu",
+				(size_t)dw->hdr->blk_count, (size_t)dw->hdr->blk_size);
+		}
+	}
+	Z_die_if(recover(dw), "");
+
+	Z_die_if(well_pipe_init(&dw->pipe, (char *)dw->hdr + data_offt(), 4), "");
+	/* Rebuild every stage from 'head' and 'tail': [head, tail) is durable,
+		the rest is free.
+	*/
+	size_t count = well_blk_count(&dw->pipe.well);
+	struct well_sym *s[4];
+	for (int i=0; i < 4; i++)
+		s[i] = well_pipe_stage(&dw->pipe, i);
+	s[0]->pos = dw->tail;
+	s[0]->avail = count - (dw->tail - dw->head);
+	s[0]->release_pos = dw->head;
+	s[1]->pos = s[1]->release_pos = dw->tail;
+	s[1]->avail = 0;
+	s[2]->pos = dw->head;
+	s[2]->avail = dw->tail - dw->head;
+	s[2]->release_pos = dw->tail;
+	s[3]->pos = s[3]->release_pos = dw->head;
+	s[3]->avail = 0;
+
+out:
+	if (err_cnt && dw && dw->hdr != MAP_FAILED)
+		munmap(dw->hdr, dw->map_size);
+	if (err_cnt && dw)
+		dw->hdr = MAP_FAILED;
+	return err_cnt;
+}
+
+
+/*	well_dur_close()
+Stop the flusher if any, commit, and unmap.
+No other thread may be using the well.
+*/
+void well_dur_close(struct well_dur *dw)
+{
+	if (!dw || dw->hdr == MAP_FAILED)
+		return;
+	well_dur_stop(dw);
+	well_dur_commit(dw);
+	well_pipe_deinit(&dw->pipe);
+	munmap(dw->hdr, dw->map_size);
+	dw->hdr = MAP_FAILED;
+}
+
+
+/*	well_dur_commit()
+Group commit: sync every block written since the last commit, then record
+	the new 'head' and 'tail' in the header and sync that.
+Then show the written blocks to consumers and give consumed ones back.
+ONE committer at a time: a thread calling this, OR the flusher.
+
+returns number of blocks committed (written and consumed);
+	0 if there was nothing to commit or a sync failed (nothing is lost:
+	the next commit retries).
+*/
+size_t well_dur_commit(struct well_dur *dw)
+{
+	size_t wpos, dpos;
+	size_t wcnt = well_pipe_reserve(&dw->pipe, 1, &wpos, -1);
+	size_t dcnt = well_pipe_reserve(&dw->pipe, 3, &dpos, -1);
+	if (!wcnt && !dcnt)
+		return 0;
+
+	if (wcnt && sync_blocks(dw, wpos, wcnt))
+		goto fail;
+
+	struct well_dur_rec *rec = &dw->hdr->rec[(dw->seq + 1) & 0x1];
+	rec->seq = dw->seq + 1;
+	rec->head = dw->head + dcnt;
+	rec->tail = dw->tail + wcnt;
+	rec->sum = rec_sum(rec);
+	if (sync_range(dw, (char *)rec - (char *)dw->hdr,
+			(char *)rec - (char *)dw->hdr + sizeof(*rec))) {
+		/* never leave a record on disk we did not commit */
+		rec->seq = 0;
+		goto fail;
+	}
+
+	dw->seq++;
+	dw->head += dcnt;
+	__atomic_store_n(&dw->tail, dw->tail + wcnt, __ATOMIC_RELEASE);
+	dw->commits++;
+	if (wcnt)
+		well_pipe_release_single(&dw->pipe, 1, wcnt);
+	if (dcnt)
+		well_pipe_release_single(&dw->pipe, 3, dcnt);
+	return wcnt + dcnt;
+
+fail:
+	/* we are the only thread reserving on stages 1 and 3: cannot fail */
+	if (wcnt && !well_unreserve(well_pipe_stage(&dw->pipe, 1), wpos, wcnt))
+		Z_log(Z_err, "could not give back %zu written blocks", wcnt);
+	if (dcnt && !well_unreserve(well_pipe_stage(&dw->pipe, 3), dpos, dcnt))
+		Z_log(Z_err, "could not give back %zu consumed blocks", dcnt);
+	return 0;
+}
+
+
+/*	flusher()
+*/
+static void *flusher(void *arg)
+{
+	struct well_dur *dw = arg;
+	struct timespec ts = {
+		.tv_sec = dw->interval_us / 1000000,
+		.tv_nsec = (dw->interval_us % 1000000) * 1000
+	};
+	while (!__atomic_load_n(&dw->kill_flag, __ATOMIC_RELAXED)) {
+		if (dw->interval_us)
+			nanosleep(&ts, NULL);
+		if (!well_dur_commit(dw) && !dw->interval_us)
+			sched_yield();
+	}
+	return NULL;
+}
+
+
+/*	well_dur_start()
+Start a flusher thread committing every 'interval_us' (0: continuously).
+The flusher is then the committer: do not call well_dur_commit() meanwhile.
+
+returns 0 on success
+*/
+int well_dur_start(struct well_dur *dw, long interval_us)
+{
+	int err_cnt = 0;
+	Z_die_if(!dw || dw->hdr == MAP_FAILED || dw->running, "");
+	Z_die_if(interval_us < 0, "interval %ld", interval_us);
+	dw->interval_us = interval_us;
+	dw->kill_flag = 0;
+	Z_die_if(pthread_create(&dw->flusher, NULL, flusher, dw), "");
+	dw->running = 1;
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_dur_stop()
+Stop the flusher thread, if running.
+*/
+void well_dur_stop(struct well_dur *dw)
+{
+	if (!dw || !dw->running)
+		return;
+	__atomic_store_n(&dw->kill_flag, 1, __ATOMIC_RELAXED);
+	pthread_join(dw->flusher, NULL);
+	dw->running = 0;
+}
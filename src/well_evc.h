@@ -0,0 +1,124 @@
+#ifndef well_evc_h_
+#define well_evc_h_
+
+/*	well_evc.h
+
+INTERNAL: an eventcount on a futex, for modules which let a thread
+	sleep until another publishes something.
+Two words, kept wherever the caller likes (a shared segment, its own line):
+	- 'seq': the futex word, bumped by every notify which finds sleepers;
+	- 'waiters': threads between well_evc_prepare() and the end of the wait.
+
+Waiter:
+	uint32_t key = well_evc_prepare(&seq, &waiters);
+	if (!condition)
+		well_evc_park(&seq, &waiters, key, timeout_ns, pshared);
+	else
+		well_evc_cancel(&waiters);
+Notifier, after publishing what makes 'condition' true:
+	well_evc_notify(&seq, &waiters, count, pshared);
+
+No wakeup is lost: the waiter counts itself BEFORE checking the condition,
+	the notifier publishes BEFORE looking for waiters, with a full fence
+	on both sides; a notify landing in between bumps 'seq',
+	which the futex sees against 'key'.
+Notifying costs one fence and one load when nobody waits.
+Without futexes, parking yields instead of sleeping.
+*/
+
+#include <nonlibc.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h> /* sched_yield() */
+#include <limits.h> /* INT_MAX */
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+
+#ifdef __linux__
+/*	well_futex_()
+*/
+NLC_INLINE long well_futex_(uint32_t *uaddr, int op, uint32_t val,
+				const struct timespec *timeout)
+{
+	return syscall(SYS_futex, uaddr, op, val, timeout, NULL, 0);
+}
+#endif
+
+
+/*	well_evc_prepare()
+Announce a wait: check the condition after this, not before.
+
+returns the key to park with
+*/
+NLC_INLINE uint32_t well_evc_prepare(uint32_t *seq, uint32_t *waiters)
+{
+	uint32_t key = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+	__atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+	/* pairs with the fence in well_evc_notify() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return key;
+}
+
+
+/*	well_evc_cancel()
+The condition held after all: no wait.
+*/
+NLC_INLINE void well_evc_cancel(uint32_t *waiters)
+{
+	__atomic_sub_fetch(waiters, 1, __ATOMIC_RELAXED);
+}
+
+
+/*	well_evc_park()
+Sleep until a notify after well_evc_prepare(), or 'timeout_ns' elapses
+	(negative: no timeout); 'pshared' if notifiers may be other processes.
+Spurious returns are possible: check the condition again.
+
+returns 0; -1 on timeout (errno ETIMEDOUT)
+*/
+NLC_INLINE int well_evc_park(uint32_t *seq, uint32_t *waiters, uint32_t key,
+				long timeout_ns, int pshared)
+{
+	int ret = 0;
+#ifdef __linux__
+	struct timespec ts = {
+		.tv_sec = timeout_ns / 1000000000,
+		.tv_nsec = timeout_ns % 1000000000
+	};
+	if (well_futex_(seq, pshared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, key,
+			timeout_ns < 0 ? NULL : &ts)
+			&& errno == ETIMEDOUT)
+		ret = -1;
+#else
+	sched_yield();
+#endif
+	well_evc_cancel(waiters);
+	if (ret)
+		errno = ETIMEDOUT;
+	return ret;
+}
+
+
+/*	well_evc_notify()
+Wake up to 'count' parked threads (INT_MAX: all), if any.
+*/
+NLC_INLINE void well_evc_notify(uint32_t *seq, uint32_t *waiters, int count, int pshared)
+{
+	/* what was published must be visible before we look for waiters */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(waiters, __ATOMIC_RELAXED))
+		return;
+	__atomic_add_fetch(seq, 1, __ATOMIC_RELEASE);
+#ifdef __linux__
+	well_futex_(seq, pshared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, count, NULL);
+#endif
+}
+
+
+#endif /* well_evc_h_ */
@@ -0,0 +1,295 @@
+#include <zed_dbg.h>
+#include <well_exec.h>
+#include "well_evc.h"
+#include <stdlib.h>
+#include <string.h> /* memset() */
+#include <sched.h> /* sched_yield() */
+
+
+/* failed rounds of take and steal before parking */
+#define WELL_EXEC_SPINS 16
+
+
+/* lane of the worker running on this thread, if any */
+static __thread struct well_exec_lane *self_ = NULL;
+static __thread uint64_t rnd_ = 0;
+
+
+/*	rand_()
+xorshift64: lane sampling needs no quality, only no shared state.
+*/
+static size_t rand_()
+{
+	if (!rnd_)
+		rnd_ = (uintptr_t)&rnd_ | 1;
+	rnd_ ^= rnd_ << 13;
+	rnd_ ^= rnd_ >> 7;
+	rnd_ ^= rnd_ << 17;
+	return rnd_;
+}
+
+
+/*	pending_()
+Any task queued in any lane?
+*/
+static int pending_(struct well_exec *ex)
+{
+	for (size_t i=0; i < ex->lane_cnt; i++) {
+		if (__atomic_load_n(&ex->lanes[i].buf.rx.avail, __ATOMIC_ACQUIRE))
+			return 1;
+	}
+	return 0;
+}
+
+
+/*	wake_()
+Wake one parked worker, if any.
+*/
+static void wake_(struct well_exec *ex)
+{
+	well_evc_notify(&ex->seq, &ex->idle, 1, 0);
+}
+
+
+/*	park_()
+Sleep until a task is submitted or the pool stops.
+Without futexes, yields instead of sleeping.
+*/
+static void park_(struct well_exec *ex, struct well_exec_lane *l)
+{
+	uint32_t key = well_evc_prepare(&ex->seq, &ex->idle);
+	if (pending_(ex) || __atomic_load_n(&ex->stop, __ATOMIC_ACQUIRE)) {
+		well_evc_cancel(&ex->idle);
+		return;
+	}
+	l->parked++;
+	well_evc_park(&ex->seq, &ex->idle, key, -1, 0);
+}
+
+
+/*	push_()
+returns 1 if the task was queued in 'l'; 0 if it is full.
+*/
+static int push_(struct well_exec_lane *l, void (*fn)(void *arg), void *arg)
+{
+	size_t pos;
+	if (!well_reserve(&l->buf.tx, &pos, 1))
+		return 0;
+	WELL_DEREF(struct well_task, pos, 0, &l->buf) = (struct well_task){
+		.fn = fn,
+		.arg = arg
+	};
+	/* only waits on submitters which reserved just before us */
+	while (!well_release_multi(&l->buf.rx, 1, pos))
+		sched_yield();
+	return 1;
+}
+
+
+/*	take_()
+Copy up to 'max_count' tasks out of 'from' into 'out',
+	and give their blocks back at once.
+
+returns number of tasks taken
+*/
+static size_t take_(struct well_exec_lane *from, struct well_task *out, size_t max_count)
+{
+	size_t pos;
+	size_t res = well_reserve(&from->buf.rx, &pos, max_count);
+	for (size_t i=0; i < res; i++)
+		out[i] = WELL_DEREF(struct well_task, pos, i, &from->buf);
+	/* only waits on takers which reserved just before us: a few copies away */
+	while (res && !well_release_multi(&from->buf.tx, res, pos))
+		sched_yield();
+	return res;
+}
+
+
+/*	steal_()
+Take half of what some other lane holds, at most 'batch',
+	visiting lanes from a random one on.
+
+returns number of tasks taken
+*/
+static size_t steal_(struct well_exec *ex, struct well_exec_lane *l)
+{
+	size_t start = rand_();
+	for (size_t i=0; i < ex->lane_cnt; i++) {
+		struct well_exec_lane *victim = &ex->lanes[(start + i) % ex->lane_cnt];
+		if (victim == l)
+			continue;
+		size_t avail = __atomic_load_n(&victim->buf.rx.avail, __ATOMIC_RELAXED);
+		if (!avail)
+			continue;
+		size_t ask = (avail + 1) / 2;
+		if (ask > ex->batch)
+			ask = ex->batch;
+		size_t res = take_(victim, l->tasks, ask);
+		if (res) {
+			l->stolen += res;
+			return res;
+		}
+	}
+	return 0;
+}
+
+
+/*	worker()
+Runs tasks from its own lane, else stolen ones, else parks.
+Exits once the pool stops and no lane holds a task.
+*/
+static void *worker(void *arg)
+{
+	struct well_exec_lane *l = arg;
+	struct well_exec *ex = l->ex;
+	self_ = l;
+
+	for (unsigned idle=0; ; ) {
+		int stopping = __atomic_load_n(&ex->stop, __ATOMIC_ACQUIRE);
+		size_t res = take_(l, l->tasks, ex->batch);
+		if (res) {
+			/* more left than we took: worth a thief */
+			if (__atomic_load_n(&l->buf.rx.avail, __ATOMIC_RELAXED))
+				wake_(ex);
+		} else if (!(res = steal_(ex, l))) {
+			/* MTX and SPL may fail spuriously: exit only if truly empty */
+			if (stopping && !pending_(ex))
+				break;
+			/* a futex round trip costs more than a few fine-grained tasks */
+			if (++idle < WELL_EXEC_SPINS)
+				sched_yield();
+			else
+				park_(ex, l);
+			continue;
+		}
+		idle = 0;
+
+		for (size_t i=0; i < res; i++)
+			l->tasks[i].fn(l->tasks[i].arg);
+		__atomic_store_n(&l->run, l->run + res, __ATOMIC_RELAXED);
+	}
+
+	self_ = NULL;
+	return NULL;
+}
+
+
+/*	well_exec_init()
+Start 'threads' workers, each with a lane holding at least 'lane_tasks' tasks,
+	taking at most 'batch' tasks at a time.
+
+returns 0 on success
+*/
+int well_exec_init(struct well_exec *ex, size_t threads, size_t lane_tasks, size_t batch)
+{
+	int err_cnt = 0;
+	Z_die_if(!ex, "");
+	memset(ex, 0x0, sizeof(*ex));
+	Z_die_if(!threads || !lane_tasks || !batch,
+		"threads %zu; lane_tasks %zu; batch %zu", threads, lane_tasks, batch);
+	ex->batch = batch;
+
+	Z_die_if(posix_memalign((void **)&ex->lanes, _Alignof(struct well_exec_lane),
+			threads * sizeof(struct well_exec_lane)), "");
+	memset(ex->lanes, 0x0, threads * sizeof(struct well_exec_lane));
+	for (; ex->lane_cnt < threads; ex->lane_cnt++) {
+		struct well_exec_lane *l = &ex->lanes[ex->lane_cnt];
+		void *mem = NULL;
+		l->ex = ex;
+		l->id = ex->lane_cnt;
+		Z_die_if(well_params(sizeof(struct well_task), lane_tasks, &l->buf), "");
+		Z_die_if(!(l->tasks = malloc(batch * sizeof(struct well_task))), "");
+		Z_die_if(!(mem = malloc(well_size(&l->buf))), "");
+		if (well_init(&l->buf, mem)) {
+			free(mem);
+			Z_die("");
+		}
+	}
+
+	/* every lane exists before any worker goes stealing */
+	for (; ex->started < threads; ex->started++) {
+		struct well_exec_lane *l = &ex->lanes[ex->started];
+		Z_die_if(pthread_create(&l->thread, NULL, worker, l), "");
+	}
+
+out:
+	if (err_cnt && ex) {
+		/* the lane which failed half way through */
+		if (ex->lanes && ex->lane_cnt < threads)
+			free(ex->lanes[ex->lane_cnt].tasks);
+		well_exec_deinit(ex);
+	}
+	return err_cnt;
+}
+
+
+/*	well_exec_deinit()
+Stop the pool: every task already submitted is run first,
+	including any those tasks submit in turn.
+*/
+void well_exec_deinit(struct well_exec *ex)
+{
+	if (!ex || !ex->lanes)
+		return;
+
+	__atomic_store_n(&ex->stop, 1, __ATOMIC_RELEASE);
+	well_evc_notify(&ex->seq, &ex->idle, INT_MAX, 0);
+	while (ex->started)
+		pthread_join(ex->lanes[--ex->started].thread, NULL);
+
+	while (ex->lane_cnt) {
+		struct well_exec_lane *l = &ex->lanes[--ex->lane_cnt];
+		free(l->tasks);
+		well_deinit(&l->buf);
+		free(well_mem(&l->buf));
+	}
+	free(ex->lanes);
+	ex->lanes = NULL;
+}
+
+
+/*	well_exec_submit()
+Queue 'fn(arg)' to run on some worker.
+From a worker, goes to that worker's own lane;
+	otherwise to the less loaded of two lanes picked at random.
+Other lanes are tried in turn if that one is full.
+
+returns 0 on success; 1 if every lane was full (retry).
+*/
+int well_exec_submit(struct well_exec *ex, void (*fn)(void *arg), void *arg)
+{
+	struct well_exec_lane *l = self_;
+	if (!l || l->ex != ex) {
+		/* two choices: nearly as good as the least loaded of all,
+			without reading every lane's line
+		*/
+		struct well_exec_lane *a = &ex->lanes[rand_() % ex->lane_cnt];
+		struct well_exec_lane *b = &ex->lanes[rand_() % ex->lane_cnt];
+		if (__atomic_load_n(&b->buf.rx.avail, __ATOMIC_RELAXED)
+				< __atomic_load_n(&a->buf.rx.avail, __ATOMIC_RELAXED))
+			a = b;
+		l = a;
+	}
+
+	for (size_t i=0; i < ex->lane_cnt; i++) {
+		if (push_(l, fn, arg)) {
+			wake_(ex);
+			return 0;
+		}
+		l = &ex->lanes[(l->id + 1) % ex->lane_cnt];
+	}
+	return 1;
+}
+
+
+/*	well_exec_done()
+returns number of tasks run so far (by workers which have finished
+	running their current batch).
+*/
+size_t well_exec_done(struct well_exec *ex)
+{
+	size_t done = 0;
+	for (size_t i=0; i < ex->lane_cnt; i++)
+		done += __atomic_load_n(&ex->lanes[i].run, __ATOMIC_RELAXED);
+	return done;
+}
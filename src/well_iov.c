@@ -0,0 +1,169 @@
+#include <zed_dbg.h>
+#include <well_iov.h>
+#include <string.h> /* memset() */
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+
+
+/*	finish_blk()
+Complete a block which a short read/write left half-done:
+	transfer 'len' bytes at 'p', waiting out EINTR and EAGAIN.
+
+returns bytes transferred: less than 'len' only on EOF (read);
+	-1 on error.
+*/
+static ssize_t finish_blk(int fd, void *p, size_t len, int is_write)
+{
+	size_t done = 0;
+	while (done < len) {
+		ssize_t ret = is_write
+			? write(fd, p + done, len - done)
+			: read(fd, p + done, len - done);
+
+		if (ret > 0) {
+			done += ret;
+		} else if (!ret) {
+			break;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			struct pollfd pfd = { .fd = fd, .events = is_write ? POLLOUT : POLLIN };
+			poll(&pfd, 1, -1);
+		} else if (errno != EINTR) {
+			return -1;
+		}
+	}
+	return done;
+}
+
+
+/*	give_back()
+Return blocks [pos+done, pos+count) to 'from' unused.
+Should always succeed for a lone thread on 'from'; if not, the blocks
+	are zeroed and must be released along with the rest.
+
+returns number of blocks to release.
+*/
+static size_t give_back(struct well *buf, struct well_sym *from,
+			size_t pos, size_t done, size_t count)
+{
+	if (done == count || well_unreserve(from, pos + done, count - done))
+		return done;
+
+	for (size_t i=done; i < count; i++)
+		memset(well_access(pos, i, buf), 0x0, well_blk_size(buf));
+	return count;
+}
+
+
+/*	well_readv_into()
+Reserve up to 'max_count' blocks from 'tx', fill them with ONE readv() from 'fd',
+	release what was read to 'rx' and give the rest back to 'tx'.
+
+Blocks are the unit of transfer: a short read ending mid-block is completed
+	by reading the remainder of that block (waiting if 'fd' is nonblocking).
+At EOF, a final partial block is zero-padded and released.
+
+returns number of blocks released; 0 on EOF;
+	-1 on error (with errno set) - including EAGAIN if 'tx' has no free blocks
+	or nonblocking 'fd' has no data.
+*/
+ssize_t well_readv_into(struct well	*buf,
+			int		fd,
+			size_t		max_count)
+{
+	size_t pos;
+	size_t count = well_reserve(&buf->tx, &pos, max_count);
+	if (!count) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	struct iovec iov[2];
+	int iovcnt = well_iov(buf, pos, count, iov);
+	ssize_t ret;
+	while ((ret = readv(fd, iov, iovcnt)) < 0 && errno == EINTR)
+		;
+	if (ret < 0) {
+		int err = errno;
+		size_t done = give_back(buf, &buf->tx, pos, 0, count);
+		if (done)
+			well_release_single(&buf->rx, done);
+		errno = err;
+		return -1;
+	}
+
+	size_t done = (size_t)ret >> buf->ct.blk_shift;
+	size_t part = (size_t)ret & (well_blk_size(buf) - 1);
+	if (part) {
+		void *blk = well_access(pos, done, buf);
+		ssize_t more = finish_blk(fd, blk + part, well_blk_size(buf) - part, 0);
+		/* on error the partial block is dropped; error surfaces on next call */
+		if (more >= 0) {
+			memset(blk + part + more, 0x0, well_blk_size(buf) - part - more);
+			done++;
+		}
+	}
+
+	done = give_back(buf, &buf->tx, pos, done, count);
+	if (done)
+		well_release_single(&buf->rx, done);
+	return done;
+}
+
+
+/*	well_writev_from()
+Reserve up to 'max_count' blocks from 'rx', send them with ONE writev() to 'fd',
+	release what was written to 'tx' and give the rest back to 'rx'.
+
+A short write ending mid-block is completed by writing the remainder
+	of that block (waiting if 'fd' is nonblocking), so the peer never
+	sees a fraction of a block.
+
+returns number of blocks released;
+	-1 on error (with errno set) - including EAGAIN if 'rx' has no blocks
+	or nonblocking 'fd' has no room.
+*/
+ssize_t well_writev_from(struct well	*buf,
+			int		fd,
+			size_t		max_count)
+{
+	size_t pos;
+	size_t count = well_reserve(&buf->rx, &pos, max_count);
+	if (!count) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	struct iovec iov[2];
+	int iovcnt = well_iov(buf, pos, count, iov);
+	ssize_t ret;
+	while ((ret = writev(fd, iov, iovcnt)) < 0 && errno == EINTR)
+		;
+	int err = errno;
+
+	size_t done = 0;
+	if (ret > 0) {
+		done = (size_t)ret >> buf->ct.blk_shift;
+		size_t part = (size_t)ret & (well_blk_size(buf) - 1);
+		if (part) {
+			void *blk = well_access(pos, done, buf);
+			if (finish_blk(fd, blk + part, well_blk_size(buf) - part, 1) >= 0)
+				done++;
+		}
+	}
+
+	/* unsent data must go back to 'rx', NOT be dropped */
+	if (done < count && !well_unreserve(&buf->rx, pos + done, count - done)) {
+		Z_log(Z_err, "rx side has more than one thread: %zu blocks stranded",
+			count - done);
+		done = count;
+	}
+	if (done)
+		well_release_single(&buf->tx, done);
+
+	if (ret < 0) {
+		errno = err;
+		return -1;
+	}
+	return done;
+}
@@ -0,0 +1,216 @@
+#define _GNU_SOURCE /* SCHED_IDLE */
+#include <zed_dbg.h>
+#include <well_lazy.h>
+#include <stdlib.h>
+#include <string.h> /* strerror() */
+#include <errno.h>
+#include <time.h> /* nanosleep() */
+#include <sched.h>
+#include <unistd.h> /* sysconf() */
+#include <sys/mman.h>
+
+
+/*	well_lazy_init()
+Map address space for the memory of 'buf', committed only as it is touched,
+	and initialize it.
+'buf' must have been set up with well_params() but NOT well_init().
+
+returns 0 on success
+*/
+int well_lazy_init(struct well *buf)
+{
+	int err_cnt = 0;
+	Z_die_if(!buf, "");
+
+	void *mem = mmap(NULL, well_size(buf), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	Z_die_if(mem == MAP_FAILED, "%s", strerror(errno));
+	if (well_init(buf, mem)) {
+		munmap(mem, well_size(buf));
+		Z_die("");
+	}
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_lazy_deinit()
+Deinit the well and unmap its memory.
+No thread may be using it.
+*/
+void well_lazy_deinit(struct well *buf)
+{
+	if (!buf || !well_mem(buf))
+		return;
+	void *mem = well_mem(buf);
+	size_t size = well_size(buf);
+	well_deinit(buf);
+	munmap(mem, size);
+}
+
+
+/*	release_range()
+Release the whole pages inside bytes [start, end) of the buffer.
+
+returns bytes released
+*/
+static size_t release_range(char *mem, size_t start, size_t end, int flags)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	start = (start + page - 1) & ~(page - 1);
+	end &= ~(page - 1);
+	if (start >= end)
+		return 0;
+
+	int advice = MADV_DONTNEED;
+#ifdef MADV_FREE
+	if (flags & WELL_LAZY_FREE)
+		advice = MADV_FREE;
+#endif
+	if (madvise(mem + start, end - start, advice)) {
+		/* MADV_FREE needs a 4.5 kernel */
+		if (advice == MADV_DONTNEED || madvise(mem + start, end - start, MADV_DONTNEED)) {
+			Z_log(Z_err, "madvise: %s", strerror(errno));
+			return 0;
+		}
+	}
+	return end - start;
+}
+
+
+/*	well_lazy_trim()
+If the well is empty, release the pages of every block except the
+	'keep' blocks which producers will write next.
+Safe to call from any thread, at any time: see well_lazy.h.
+
+returns bytes released (committed or not); 0 if the well was not empty.
+*/
+size_t well_lazy_trim(struct well *buf, size_t keep, int flags)
+{
+	size_t count = well_blk_count(buf);
+	size_t pos;
+	if (!well_reserve_exact(&buf->tx, &pos, count))
+		return 0;
+
+	/* We now own every block: release those in [pos + keep, pos + count),
+		which may wrap around the end of the buffer.
+	*/
+	size_t ret = 0;
+	if (keep < count) {
+		char *mem = well_mem(buf);
+		size_t start = ((pos + keep) << buf->ct.blk_shift) & buf->ct.overflow;
+		size_t len = (count - keep) << buf->ct.blk_shift;
+		if (start + len <= well_size(buf)) {
+			ret += release_range(mem, start, start + len, flags);
+		} else {
+			ret += release_range(mem, start, well_size(buf), flags);
+			ret += release_range(mem, 0, start + len - well_size(buf), flags);
+		}
+	}
+
+	/* no one else can have reserved meanwhile: this cannot fail */
+	if (!well_unreserve(&buf->tx, pos, count))
+		Z_log(Z_err, "could not give back %zu blocks at %zu", count, pos);
+	return ret;
+}
+
+
+/*	well_lazy_resident()
+returns bytes of the buffer of 'buf' currently committed (resident).
+*/
+size_t well_lazy_resident(const struct well *buf)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t pages = (well_size(buf) + page - 1) / page;
+	size_t ret = 0;
+
+	unsigned char *vec = malloc(pages);
+	if (!vec)
+		return 0;
+	if (!mincore(well_mem(buf), well_size(buf), vec)) {
+		for (size_t i=0; i < pages; i++)
+			ret += vec[i] & 0x1;
+	}
+	free(vec);
+	return ret * page;
+}
+
+
+/*	helper()
+*/
+static void *helper(void *arg)
+{
+	struct well_lazy *lz = arg;
+
+	/* lowest priority there is; a hint only */
+	struct sched_param prm = { 0 };
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &prm);
+
+	struct timespec ts = {
+		.tv_sec = lz->interval_ms / 1000,
+		.tv_nsec = (lz->interval_ms % 1000) * 1000000
+	};
+	size_t last = __atomic_load_n(&lz->buf->tx.pos, __ATOMIC_RELAXED);
+	size_t trimmed = last - 1;
+
+	while (!__atomic_load_n(&lz->kill_flag, __ATOMIC_RELAXED)) {
+		nanosleep(&ts, NULL);
+		size_t pos = __atomic_load_n(&lz->buf->tx.pos, __ATOMIC_RELAXED);
+		/* idle for a whole interval, and not already trimmed as it stands */
+		if (pos == last && pos != trimmed) {
+			size_t bytes = well_lazy_trim(lz->buf, lz->keep, lz->flags);
+			if (bytes) {
+				__atomic_add_fetch(&lz->released, bytes, __ATOMIC_RELAXED);
+				__atomic_add_fetch(&lz->trims, 1, __ATOMIC_RELAXED);
+				trimmed = pos;
+			}
+		}
+		last = pos;
+	}
+	return NULL;
+}
+
+
+/*	well_lazy_start()
+Start a helper thread trimming 'buf' (a well set up with well_lazy_init())
+	whenever it stays idle for 'interval_ms'.
+See well_lazy_trim() for 'keep' and 'flags'.
+
+returns 0 on success
+*/
+int well_lazy_start(struct well_lazy	*lz,
+			struct well	*buf,
+			long		interval_ms,
+			size_t		keep,
+			int		flags)
+{
+	int err_cnt = 0;
+	Z_die_if(!lz || !buf || !well_mem(buf), "");
+	Z_die_if(interval_ms < 1, "interval %ld", interval_ms);
+
+	*lz = (struct well_lazy){
+		.buf = buf,
+		.keep = keep,
+		.flags = flags,
+		.interval_ms = interval_ms
+	};
+	Z_die_if(pthread_create(&lz->helper, NULL, helper, lz), "");
+	lz->running = 1;
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_lazy_stop()
+Stop the helper thread, if running.
+*/
+void well_lazy_stop(struct well_lazy *lz)
+{
+	if (!lz || !lz->running)
+		return;
+	__atomic_store_n(&lz->kill_flag, 1, __ATOMIC_RELAXED);
+	pthread_join(lz->helper, NULL);
+	lz->running = 0;
+}
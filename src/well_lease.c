@@ -0,0 +1,181 @@
+#include <zed_dbg.h>
+#include <well_lease.h>
+#include <stdlib.h>
+#include <string.h> /* memset() */
+#include <sched.h> /* sched_yield() */
+
+
+/*	well_leases_init()
+Track reservations made from 'from' and released to 'to' (two sides of 'buf'),
+	by up to 'max_threads' threads.
+A reservation holding up 'to' for 'ttl' calls to well_lease_watch()
+	is revoked.
+
+returns 0 on success
+*/
+int well_leases_init(struct well_leases *ls, struct well *buf,
+			struct well_sym *from, struct well_sym *to,
+			size_t max_threads, size_t ttl)
+{
+	int err_cnt = 0;
+	Z_die_if(!ls, "");
+	memset(ls, 0x0, sizeof(*ls));
+	Z_die_if(!buf || !from || !to, "");
+	Z_die_if(!max_threads, "");
+	Z_die_if(!ttl, "");
+
+	ls->buf = buf;
+	ls->from = from;
+	ls->to = to;
+	ls->ttl = ttl;
+	ls->lease_cnt = max_threads;
+	Z_die_if(posix_memalign((void **)&ls->leases, _Alignof(struct well_lease),
+			max_threads * sizeof(struct well_lease)), "");
+	memset(ls->leases, 0x0, max_threads * sizeof(struct well_lease));
+	ls->stuck_pos = __atomic_load_n(&to->release_pos, __ATOMIC_ACQUIRE);
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_leases_deinit()
+*/
+void well_leases_deinit(struct well_leases *ls)
+{
+	if (!ls)
+		return;
+	free(ls->leases);
+	memset(ls, 0x0, sizeof(*ls));
+}
+
+
+/*	well_leases_poison()
+Have the watchdog call 'poison' on the blocks of a revoked reservation
+	before releasing them (e.g. to mark them invalid for the other side).
+Not called for a reservation whose owner was already releasing it:
+	its blocks were complete.
+*/
+void well_leases_poison(struct well_leases *ls,
+			void (*poison)(struct well *buf, size_t pos, size_t count, void *ctx),
+			void *ctx)
+{
+	ls->poison = poison;
+	ls->ctx = ctx;
+}
+
+
+/*	well_lease_join()
+Claim the calling thread's lease.
+
+returns NULL if 'max_threads' have already joined.
+*/
+struct well_lease *well_lease_join(struct well_leases *ls)
+{
+	size_t i = __atomic_fetch_add(&ls->joined, 1, __ATOMIC_ACQ_REL);
+	if (i >= ls->lease_cnt)
+		return NULL;
+	return &ls->leases[i];
+}
+
+
+/*	force_()
+Release 'count' blocks at 'pos' ('release_pos') on the owner's behalf.
+Stops if someone else releases them first (an owner which was only slow).
+
+returns 'count' if released by us, 0 otherwise
+*/
+static size_t force_(struct well_leases *ls, size_t pos, size_t count, int poison)
+{
+	if (poison && ls->poison)
+		ls->poison(ls->buf, pos, count, ls->ctx);
+	/* MTX and SPL may fail spuriously */
+	while (__atomic_load_n(&ls->to->release_pos, __ATOMIC_ACQUIRE) == pos) {
+		if (well_release_multi(ls->to, count, pos)) {
+			ls->revoked++;
+			return count;
+		}
+		sched_yield();
+	}
+	return 0;
+}
+
+
+/*	well_lease_watch()
+One watchdog tick: call at a steady rate, from one thread.
+If 'release_pos' has not moved for 'ttl' ticks while blocks are outstanding,
+	release the reservation at its head:
+	- a lease HELD there is revoked, its blocks poisoned and released;
+	- a lease being RELEASED there (its owner died or stalled inside
+		well_lease_release()) is released as is, and its owner told
+		it succeeded;
+	- if no lease covers it, the blocks up to the next recorded reservation
+		(or the end of all reservations) are poisoned and released.
+
+returns number of blocks released
+*/
+size_t well_lease_watch(struct well_leases *ls)
+{
+	size_t tick = ++ls->tick;
+	size_t rp = __atomic_load_n(&ls->to->release_pos, __ATOMIC_ACQUIRE);
+	if (rp != ls->stuck_pos) {
+		ls->stuck_pos = rp;
+		ls->stuck_since = tick;
+		return 0;
+	}
+	if (tick - ls->stuck_since < ls->ttl)
+		return 0;
+
+	/* nothing outstanding: merely idle */
+	size_t next = __atomic_load_n(&ls->from->pos, __ATOMIC_ACQUIRE);
+	if (next == rp)
+		return 0;
+
+	struct well_lease *head = NULL;
+	size_t head_tag = 0, head_count = 0;
+	size_t joined = __atomic_load_n(&ls->joined, __ATOMIC_ACQUIRE);
+	if (joined > ls->lease_cnt)
+		joined = ls->lease_cnt;
+	for (size_t i=0; i < joined; i++) {
+		struct well_lease *l = &ls->leases[i];
+		size_t tag = __atomic_load_n(&l->tag, __ATOMIC_ACQUIRE);
+		int state = WELL_LEASE_STATE_(tag);
+		if (state != WELL_LEASE_HELD && state != WELL_LEASE_RELEASING)
+			continue;
+		size_t pos = __atomic_load_n(&l->pos, __ATOMIC_RELAXED);
+		size_t count = __atomic_load_n(&l->count, __ATOMIC_RELAXED);
+		/* moved on while we read: 'pos' and 'count' may be torn */
+		if (WELL_LEASE_SEQ_(__atomic_load_n(&l->tag, __ATOMIC_ACQUIRE)) != WELL_LEASE_SEQ_(tag))
+			continue;
+
+		if (pos == rp) {
+			head = l;
+			head_tag = tag;
+			head_count = count;
+		} else if ((ptrdiff_t)(pos - rp) > 0 && (ptrdiff_t)(pos - next) < 0) {
+			next = pos;
+		}
+	}
+
+	ls->stuck_since = tick;
+	if (!head)
+		return force_(ls, rp, next - rp, 1);
+
+	/* owner stalled inside well_lease_release(): its blocks are complete,
+		and a FREE tag tells it they were released
+	*/
+	if (WELL_LEASE_STATE_(head_tag) == WELL_LEASE_RELEASING) {
+		size_t done = WELL_LEASE_SEQ_(head_tag) + WELL_LEASE_FREE;
+		if (!__atomic_compare_exchange_n(&head->tag, &head_tag, done,
+						0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return 0;
+		return force_(ls, rp, head_count, 0);
+	}
+
+	/* the owner cannot release once this succeeds */
+	size_t gone = WELL_LEASE_SEQ_(head_tag) + WELL_LEASE_GONE;
+	if (!__atomic_compare_exchange_n(&head->tag, &head_tag, gone,
+					0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		return 0;
+	return force_(ls, rp, head_count, 1);
+}
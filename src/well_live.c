@@ -0,0 +1,238 @@
+#include <zed_dbg.h>
+#include <well_live.h>
+#include <stdlib.h>
+#include <string.h> /* memset() */
+#include <sched.h> /* sched_yield() */
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#endif
+
+
+/*	gen_header()
+Buffer starts on the first line after the header.
+*/
+static size_t gen_header()
+{
+	return (sizeof(struct well_gen) + WELL_LINE - 1) & ~((size_t)WELL_LINE - 1);
+}
+
+
+/*	gen_new()
+*/
+static struct well_gen *gen_new(size_t blk_size, size_t blk_cnt)
+{
+	int err_cnt = 0;
+	struct well_gen *gen = NULL;
+	struct well params = { {0} };
+
+	Z_die_if(well_params(blk_size, blk_cnt, &params), "");
+	Z_die_if(posix_memalign((void **)&gen, WELL_LINE, gen_header() + well_size(&params)), "");
+	memset(gen, 0x0, sizeof(*gen));
+	Z_die_if(well_params(blk_size, blk_cnt, &gen->well), "");
+	Z_die_if(well_init(&gen->well, (char *)gen + gen_header()), "");
+
+out:
+	if (err_cnt) {
+		free(gen);
+		gen = NULL;
+	}
+	return gen;
+}
+
+
+/*	gen_free()
+*/
+static void gen_free(struct well_gen *gen)
+{
+	well_deinit(&gen->well);
+	free(gen);
+}
+
+
+/*	barrier_all()
+Make every thread's announcements visible to us, and our stores to every thread
+	before its next announcement returns.
+*/
+static void barrier_all(struct well_live *lw)
+{
+#ifdef __linux__
+	if (!lw->fence) {
+		syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+		return;
+	}
+#endif
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+
+/*	wait_left()
+Wait until no thread announces 'gen' on side 'rx' (or 'tx' if !rx).
+*/
+static void wait_left(struct well_live *lw, struct well_gen *gen, int rx)
+{
+	barrier_all(lw);
+	size_t cnt = __atomic_load_n(&lw->joined, __ATOMIC_ACQUIRE);
+	if (cnt > lw->local_cnt)
+		cnt = lw->local_cnt;
+	for (size_t i=0; i < cnt; i++) {
+		struct well_gen **slot = rx ? &lw->locals[i].rx : &lw->locals[i].tx;
+		while (__atomic_load_n(slot, __ATOMIC_ACQUIRE) == gen)
+			sched_yield();
+	}
+}
+
+
+/*	well_live_init()
+A resizable well of 'blk_cnt' blocks of 'blk_size' (both rounded up as by
+	well_params()), usable by up to 'max_threads' threads.
+
+returns 0 on success
+*/
+int well_live_init(struct well_live *lw, size_t blk_size, size_t blk_cnt, size_t max_threads)
+{
+	int err_cnt = 0;
+	Z_die_if(!lw, "");
+	memset(lw, 0x0, sizeof(*lw));
+	Z_die_if(!max_threads, "");
+
+	lw->blk_size = blk_size;
+	lw->local_cnt = max_threads;
+	Z_die_if(posix_memalign((void **)&lw->locals, _Alignof(struct well_live_local),
+			max_threads * sizeof(struct well_live_local)), "");
+	memset(lw->locals, 0x0, max_threads * sizeof(struct well_live_local));
+
+	Z_die_if(!(lw->tx_gen = gen_new(blk_size, blk_cnt)), "");
+	lw->rx_gen = lw->tx_gen;
+	Z_die_if(pthread_mutex_init(&lw->resize_lock, NULL), "");
+
+	lw->fence = 1;
+#ifdef __linux__
+	if (!syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0))
+		lw->fence = 0;
+#endif
+
+out:
+	if (err_cnt && lw) {
+		if (lw->tx_gen)
+			gen_free(lw->tx_gen);
+		free(lw->locals);
+		memset(lw, 0x0, sizeof(*lw));
+	}
+	return err_cnt;
+}
+
+
+/*	well_live_deinit()
+All threads must be finished.
+*/
+void well_live_deinit(struct well_live *lw)
+{
+	if (!lw || !lw->locals)
+		return;
+	/* at most 2 generations: a resize does not return until the old one is gone */
+	if (lw->rx_gen != lw->tx_gen)
+		gen_free(lw->rx_gen);
+	gen_free(lw->tx_gen);
+	pthread_mutex_destroy(&lw->resize_lock);
+	free(lw->locals);
+	memset(lw, 0x0, sizeof(*lw));
+}
+
+
+/*	well_live_join()
+Claim the calling thread's announcement slot.
+
+returns NULL if 'max_threads' have already joined.
+*/
+struct well_live_local *well_live_join(struct well_live *lw)
+{
+	size_t i = __atomic_fetch_add(&lw->joined, 1, __ATOMIC_ACQ_REL);
+	if (i >= lw->local_cnt)
+		return NULL;
+	return &lw->locals[i];
+}
+
+
+/*	drained()
+No producer is left in 'gen' and every block published there has been taken.
+*/
+static int drained(struct well_gen *gen)
+{
+	if (!__atomic_load_n(&gen->tx_done, __ATOMIC_ACQUIRE))
+		return 0;
+	/* 'pos' only moves once a reservation is complete: never early */
+	return __atomic_load_n(&gen->well.rx.pos, __ATOMIC_ACQUIRE)
+		== __atomic_load_n(&gen->well.rx.release_pos, __ATOMIC_ACQUIRE);
+}
+
+
+/*	well_live_advance()
+Consumer, slow path: nothing to read in 'gen'.
+If 'gen' is drained, move every consumer on to its successor.
+
+returns the generation to read from next; NULL if there is nothing to read.
+*/
+struct well_gen *well_live_advance(struct well_live *lw, struct well_gen *gen)
+{
+	if (!drained(gen))
+		return NULL;
+	__atomic_compare_exchange_n(&lw->rx_gen, &gen, gen->next,
+				0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&lw->rx_gen, __ATOMIC_ACQUIRE);
+}
+
+
+/*	well_live_blk_count()
+Blocks in the current generation.
+Waits for a resize in progress to finish.
+*/
+size_t well_live_blk_count(struct well_live *lw)
+{
+	/* generations are only freed under the lock, and never the current one */
+	pthread_mutex_lock(&lw->resize_lock);
+		size_t ret = well_blk_count(&lw->tx_gen->well);
+	pthread_mutex_unlock(&lw->resize_lock);
+	return ret;
+}
+
+
+/*	well_resize()
+Replace the buffer with one of 'blk_cnt' blocks (rounded up to a power of 2),
+	without stopping producers or consumers.
+Returns once the old buffer is freed: i.e. once every block in it is read
+	and released (so consumers must keep consuming).
+Serialized: concurrent calls take turns.
+
+returns 0 on success
+*/
+int well_resize(struct well_live *lw, size_t blk_cnt)
+{
+	int err_cnt = 0;
+	struct well_gen *gen;
+	Z_die_if(!(gen = gen_new(lw->blk_size, blk_cnt)), "");
+
+	pthread_mutex_lock(&lw->resize_lock);
+		struct well_gen *old = lw->tx_gen;
+
+		/* producers: new reservations go to 'gen' */
+		__atomic_store_n(&old->next, gen, __ATOMIC_RELEASE);
+		__atomic_store_n(&lw->tx_gen, gen, __ATOMIC_RELEASE);
+		wait_left(lw, old, 0);
+		__atomic_store_n(&old->tx_done, 1, __ATOMIC_RELEASE);
+
+		/* consumers: move on once 'old' is drained, even if none are reading */
+		while (__atomic_load_n(&lw->rx_gen, __ATOMIC_ACQUIRE) == old) {
+			if (!well_live_advance(lw, old))
+				sched_yield();
+		}
+		wait_left(lw, old, 1);
+
+		gen_free(old);
+	pthread_mutex_unlock(&lw->resize_lock);
+
+out:
+	return err_cnt;
+}
@@ -0,0 +1,126 @@
+#include <zed_dbg.h>
+#include <well_mag.h>
+#include <string.h> /* memset() */
+#include <sched.h> /* sched_yield() */
+
+
+/*	well_mag_init()
+Prepare 'mag' to claim 'batch' blocks at a time from 'from'
+	and publish them to 'to'.
+'buf' must already be initialized.
+
+returns 0 on success
+*/
+int well_mag_init(struct well_mag	*mag,
+			struct well	*buf,
+			struct well_sym	*from,
+			struct well_sym	*to,
+			size_t		batch)
+{
+	int err_cnt = 0;
+	Z_die_if(!mag || !buf || !from || !to, "");
+	Z_die_if(!batch || batch > well_blk_count(buf),
+		"batch %zu; blk_count %zu", batch, well_blk_count(buf));
+
+	*mag = (struct well_mag){
+		.buf = buf,
+		.from = from,
+		.to = to,
+		.batch = batch
+	};
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_mag_deinit()
+Flush 'mag', waiting for earlier holders on the same side if necessary.
+Suitable for use as (or inside) a thread cleanup handler.
+*/
+void well_mag_deinit(struct well_mag *mag)
+{
+	while (well_mag_flush(mag))
+		sched_yield();
+}
+
+
+/*	well_mag_refill()
+Slow path of well_mag_reserve(): claim a new range from 'from'.
+
+returns number of blocks now available in the magazine;
+	0 if the previous range could not yet be retired
+	or 'from' has nothing available.
+*/
+size_t well_mag_refill(struct well_mag *mag)
+{
+	/* previous range must be fully released and published */
+	if (mag->done != mag->end)
+		return 0;
+	if (mag->base != mag->end && !well_mag_publish(mag))
+		return 0;
+
+	size_t pos;
+	size_t res = well_reserve(mag->from, &pos, mag->batch);
+	if (!res)
+		return 0;
+
+	mag->base = mag->done = mag->cur = pos;
+	mag->end = pos + res;
+	return res;
+}
+
+
+/*	well_mag_publish()
+Publish all locally released blocks to 'to'.
+
+returns number of blocks published;
+	0 if there was nothing to publish OR an earlier reservation
+	on this side has not been published yet (try again later).
+*/
+size_t well_mag_publish(struct well_mag *mag)
+{
+	size_t count = mag->done - mag->base;
+	if (!count || !well_release_multi(mag->to, count, mag->base))
+		return 0;
+	mag->base = mag->done;
+	return count;
+}
+
+
+/*	well_mag_flush()
+Publish all released blocks and give back all blocks not handed out.
+Unused blocks are returned to 'from' if possible; if a later reservation
+	makes that impossible they are padded (see 'pad') and published instead,
+	so as not to stall the other side.
+
+returns 0 once the magazine is empty;
+	1 if local reservations are still outstanding or publishing
+	must wait on an earlier reservation (try again later).
+*/
+int well_mag_flush(struct well_mag *mag)
+{
+	if (mag->done != mag->cur)
+		return 1;
+
+	size_t unused = mag->end - mag->cur;
+	if (unused) {
+		if (well_unreserve(mag->from, mag->cur, unused)) {
+			mag->end = mag->cur;
+		} else {
+			size_t blk_size = well_blk_size(mag->buf);
+			for (size_t i=0; i < unused; i++) {
+				void *blk = well_access(mag->cur, i, mag->buf);
+				if (mag->pad)
+					mag->pad(blk, blk_size);
+				else
+					memset(blk, 0x0, blk_size);
+			}
+			mag->done = mag->cur = mag->end;
+		}
+	}
+
+	if (mag->base != mag->done && !well_mag_publish(mag))
+		return 1;
+	return 0;
+}
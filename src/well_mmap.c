@@ -0,0 +1,170 @@
+#include <zed_dbg.h>
+#include <well_mmap.h>
+#include <nmath.h>
+#include <string.h> /* strerror() */
+#include <errno.h>
+#include <fcntl.h> /* posix_fadvise() */
+#include <unistd.h> /* sysconf() */
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*	well_mmap_init()
+Map a window of address space as the memory of 'buf' and prepare to feed
+	the file open on 'fd' through it.
+'buf' must have been set up with well_params() but NOT well_init():
+	well_mmap_init() initializes it.
+
+returns 0 on success
+*/
+int well_mmap_init(struct well_mmap	*wm,
+			struct well	*buf,
+			int		fd,
+			int		flags)
+{
+	int err_cnt = 0;
+	Z_die_if(!wm || !buf || fd < 0, "");
+
+	size_t page = sysconf(_SC_PAGESIZE);
+	Z_die_if(well_blk_size(buf) % page,
+		"blk_size %zu not a multiple of page size %zu", well_blk_size(buf), page);
+
+	struct stat st;
+	Z_die_if(fstat(fd, &st), "%s", strerror(errno));
+
+	*wm = (struct well_mmap){
+		.buf = buf,
+		.fd = fd,
+		.flags = flags,
+		.file_size = st.st_size,
+		.blk_total = nm_next_mult64(st.st_size, well_blk_size(buf))
+				>> buf->ct.blk_shift
+	};
+
+	/* address space only: every slot is mapped to the file before use */
+	void *mem = mmap(NULL, well_size(buf), PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	Z_die_if(mem == MAP_FAILED, "%s", strerror(errno));
+	if (well_init(buf, mem)) {
+		munmap(mem, well_size(buf));
+		Z_die("");
+	}
+
+	/* hint only: failure is harmless */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_mmap_deinit()
+Unmap the window and deinit the well.
+No thread may be using it.
+*/
+void well_mmap_deinit(struct well_mmap *wm)
+{
+	if (!wm || !wm->buf || !well_mem(wm->buf))
+		return;
+	void *mem = well_mem(wm->buf);
+	size_t size = well_size(wm->buf);
+	well_deinit(wm->buf);
+	munmap(mem, size);
+	wm->buf = NULL;
+}
+
+
+/*	map_run()
+Map 'count' file blocks starting at block 'pos' into their slots,
+	which must be contiguous in memory.
+Memory past the end of the file is zero-filled.
+
+returns 0 on success
+*/
+static int map_run(struct well_mmap *wm, size_t pos, size_t count)
+{
+	struct well *buf = wm->buf;
+	void *addr = well_access(pos, 0, buf);
+	size_t off = pos << buf->ct.blk_shift;
+	size_t len = count << buf->ct.blk_shift;
+	size_t blk_count = well_blk_count(buf);
+
+	/* map whole pages of file: the kernel zeroes the tail of the last one */
+	size_t file_len = wm->file_size - off;
+	if (file_len > len)
+		file_len = len;
+	size_t page = sysconf(_SC_PAGESIZE);
+	file_len = nm_next_mult64(file_len, page);
+
+	if (mmap(addr, file_len, PROT_READ, MAP_SHARED | MAP_FIXED, wm->fd, off) == MAP_FAILED)
+		return -1;
+	/* touching whole pages past EOF would SIGBUS: back them with zero pages */
+	if (file_len < len && mmap(addr + file_len, len - file_len, PROT_READ,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+		return -1;
+
+	/* the slots last held blocks [pos - blk_count, ...): consumed,
+		and unmapped just above, so the kernel can drop them */
+	if ((wm->flags & WELL_MMAP_DROP) && pos >= blk_count) {
+		posix_fadvise(wm->fd, (pos - blk_count) << buf->ct.blk_shift,
+			len, POSIX_FADV_DONTNEED);
+	}
+
+	/* start reading now, ahead of the workers */
+	madvise(addr, file_len, MADV_WILLNEED);
+	return 0;
+}
+
+
+/*	well_mmap_feed()
+Map up to 'max_count' more blocks of the file into free slots
+	and release them to 'rx'.
+Must only be called by ONE thread.
+
+returns number of blocks released; 0 once the whole file has been fed;
+	-1 with errno set: EAGAIN if no slots are free, otherwise a mmap() error.
+*/
+ssize_t well_mmap_feed(struct well_mmap *wm, size_t max_count)
+{
+	struct well *buf = wm->buf;
+	size_t left = wm->blk_total - wm->next;
+	if (!left)
+		return 0;
+	if (max_count > left)
+		max_count = left;
+
+	/* lone feeder: tx 'pos' runs in lockstep with the file (pos == next) */
+	size_t pos;
+	size_t count = well_reserve(&buf->tx, &pos, max_count);
+	if (!count) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	/* at most 2 runs: split where the window wraps */
+	size_t blk_count = well_blk_count(buf);
+	size_t first = blk_count - (pos & (blk_count - 1));
+	if (first > count)
+		first = count;
+
+	size_t done = 0;
+	if (!map_run(wm, pos, first)) {
+		done = first;
+		if (first < count && !map_run(wm, pos + first, count - first))
+			done = count;
+	}
+
+	int err = errno;
+	if (done < count && !well_unreserve(&buf->tx, pos + done, count - done))
+		Z_log(Z_err, "tx side has more than one thread: %zu slots stranded",
+			count - done);
+	if (!done) {
+		errno = err;
+		return -1;
+	}
+
+	/* release BEFORE advancing 'next': see well_mmap_done() */
+	well_release_single(&buf->rx, done);
+	__atomic_store_n(&wm->next, wm->next + done, __ATOMIC_RELEASE);
+	return done;
+}
@@ -0,0 +1,279 @@
+#include <zed_dbg.h>
+#include <well_part.h>
+#include <nmath.h>
+#include <stdlib.h>
+#include <string.h> /* memset(), memcpy() */
+#include <sched.h> /* sched_yield() */
+
+
+#define BUCKETS_PER_LANE	64
+#define CHUNK			256	/* blocks sorted at a time */
+
+
+/*	well_part_init()
+'lane_cnt' lanes of at least 'lane_blocks' blocks of 'blk_size' bytes,
+	keyed by the 'key_len' bytes at 'key_offt' in each block.
+Each lane gets a backlog as large as itself;
+	it sheds buckets once more than half full ('hot').
+
+returns 0 on success
+*/
+int well_part_init(struct well_part *part, size_t lane_cnt, size_t lane_blocks,
+			size_t blk_size, size_t key_offt, size_t key_len)
+{
+	int err_cnt = 0;
+	Z_die_if(!part, "");
+	memset(part, 0x0, sizeof(*part));
+	Z_die_if(!lane_cnt || lane_cnt > UINT32_MAX || !lane_blocks, "lanes %zu", lane_cnt);
+	Z_die_if(!key_len || key_offt + key_len > blk_size,
+		"key %zu bytes at %zu; block %zu bytes", key_len, key_offt, blk_size);
+
+	part->blk_size = blk_size;
+	part->key_offt = key_offt;
+	part->key_len = key_len;
+	part->backlog_cap = lane_blocks;
+	part->hot = lane_blocks / 2;
+	part->chunk = CHUNK;
+
+	size_t buckets = nm_next_pow2_64(lane_cnt * BUCKETS_PER_LANE);
+	part->bucket_mask = buckets - 1;
+	Z_die_if(!(part->map = malloc(buckets * sizeof(uint32_t))), "");
+	Z_die_if(!(part->last = calloc(buckets, sizeof(size_t))), "");
+	for (size_t b=0; b < buckets; b++)
+		part->map[b] = b % lane_cnt;
+	Z_die_if(!(part->lane_of = malloc(CHUNK * sizeof(uint32_t))), "");
+	Z_die_if(!(part->order = malloc(CHUNK * sizeof(uint32_t))), "");
+
+	Z_die_if(posix_memalign((void **)&part->lanes, _Alignof(struct well_part_lane),
+			lane_cnt * sizeof(struct well_part_lane)), "");
+	memset(part->lanes, 0x0, lane_cnt * sizeof(struct well_part_lane));
+	for (; part->lane_cnt < lane_cnt; part->lane_cnt++) {
+		struct well_part_lane *l = &part->lanes[part->lane_cnt];
+		void *mem = NULL;
+		Z_die_if(well_params(blk_size, lane_blocks, &l->buf), "");
+		Z_die_if(!(l->backlog = malloc(lane_blocks * blk_size)), "");
+		Z_die_if(!(mem = malloc(well_size(&l->buf))), "");
+		if (well_init(&l->buf, mem)) {
+			free(mem);
+			Z_die("");
+		}
+	}
+
+out:
+	if (err_cnt && part) {
+		/* the lane which failed half way through */
+		if (part->lanes && part->lane_cnt < lane_cnt)
+			free(part->lanes[part->lane_cnt].backlog);
+		well_part_deinit(part);
+	}
+	return err_cnt;
+}
+
+
+/*	well_part_deinit()
+Blocks still in lanes or backlogs are lost.
+*/
+void well_part_deinit(struct well_part *part)
+{
+	if (!part)
+		return;
+	while (part->lane_cnt) {
+		struct well_part_lane *l = &part->lanes[--part->lane_cnt];
+		free(l->backlog);
+		well_deinit(&l->buf);
+		free(well_mem(&l->buf));
+	}
+	free(part->lanes);
+	free(part->map);
+	free(part->last);
+	free(part->lane_of);
+	free(part->order);
+	memset(part, 0x0, sizeof(*part));
+}
+
+
+/*	hash_()
+FNV-1a over the key, then a finalizer: small keys (sequential ids)
+	must spread over every bucket.
+*/
+static size_t hash_(const struct well_part *part, const void *blk)
+{
+	const unsigned char *k = (const unsigned char *)blk + part->key_offt;
+	uint64_t h = 0xcbf29ce484222325;
+	for (size_t i=0; i < part->key_len; i++) {
+		h ^= k[i];
+		h *= 0x100000001b3;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccd;
+	h ^= h >> 33;
+	return h;
+}
+
+
+/*	depth_()
+Blocks routed to 'l' not yet released by its consumer.
+*/
+static size_t depth_(struct well_part_lane *l)
+{
+	return l->routed - __atomic_load_n(&l->done, __ATOMIC_ACQUIRE);
+}
+
+
+/*	backlog_blk_()
+*/
+static void *backlog_blk_(struct well_part *part, struct well_part_lane *l, size_t i)
+{
+	return (char *)l->backlog + ((l->bl_head + i) % part->backlog_cap) * part->blk_size;
+}
+
+
+/*	lane_reserve_()
+Reserve exactly 'count' blocks to write into 'l': they are free already.
+The router is the only producer on a lane, so room only ever grows.
+
+returns reservation position
+*/
+static size_t lane_reserve_(struct well_part_lane *l, size_t count)
+{
+	size_t pos;
+	/* MTX and SPL may fail spuriously */
+	while (!well_reserve_exact(&l->buf.tx, &pos, count))
+		sched_yield();
+	return pos;
+}
+
+
+/*	well_part_flush()
+Move as much of every backlog into its lane as fits.
+
+returns number of blocks still in backlogs
+*/
+size_t well_part_flush(struct well_part *part)
+{
+	size_t left = 0;
+	for (size_t i=0; i < part->lane_cnt; i++) {
+		struct well_part_lane *l = &part->lanes[i];
+		if (!l->bl_cnt)
+			continue;
+		size_t k = __atomic_load_n(&l->buf.tx.avail, __ATOMIC_ACQUIRE);
+		if (k > l->bl_cnt)
+			k = l->bl_cnt;
+		if (k) {
+			size_t pos = lane_reserve_(l, k);
+			for (size_t j=0; j < k; j++)
+				memcpy(well_access(pos, j, &l->buf), backlog_blk_(part, l, j), part->blk_size);
+			well_release_single(&l->buf.rx, k);
+			l->bl_head = (l->bl_head + k) % part->backlog_cap;
+			l->bl_cnt -= k;
+		}
+		left += l->bl_cnt;
+	}
+	return left;
+}
+
+
+/*	route_chunk_()
+Route blocks [pos, pos + count) of 'from', count <= 'chunk'.
+
+returns number of blocks routed: all of them unless some lane and
+	its backlog are full.
+*/
+static size_t route_chunk_(struct well_part *part, struct well *from, size_t pos, size_t count)
+{
+	/* room: in the lane if nothing is backlogged ahead, then in the backlog */
+	struct well_part_lane *coolest = part->lanes;
+	for (size_t i=0; i < part->lane_cnt; i++) {
+		struct well_part_lane *l = &part->lanes[i];
+		l->room = l->bl_cnt ? 0 : __atomic_load_n(&l->buf.tx.avail, __ATOMIC_ACQUIRE);
+		l->room += part->backlog_cap - l->bl_cnt;
+		l->n = 0;
+		if (depth_(l) < depth_(coolest))
+			coolest = l;
+	}
+
+	size_t i;
+	for (i=0; i < count; i++) {
+		size_t b = hash_(part, well_access(pos, i, from)) & part->bucket_mask;
+		struct well_part_lane *l = &part->lanes[part->map[b]];
+
+		/* a hot lane sheds buckets with nothing in flight: order holds */
+		struct well_part_lane *to = l;
+		if (l != coolest && depth_(l) > part->hot
+				&& (ptrdiff_t)(__atomic_load_n(&l->done, __ATOMIC_ACQUIRE) - part->last[b]) >= 0
+				&& depth_(coolest) * 2 < depth_(l))
+			to = coolest;
+
+		if (to->n == to->room)
+			break;
+		if (to != l) {
+			part->map[b] = to - part->lanes;
+			part->moved++;
+		}
+		to->n++;
+		part->last[b] = ++to->routed;
+		part->lane_of[i] = to - part->lanes;
+	}
+	size_t routed = i;
+
+	/* stable sort by lane: each lane's blocks stay in input order */
+	size_t off = 0;
+	for (size_t j=0; j < part->lane_cnt; j++) {
+		part->lanes[j].off = off;
+		off += part->lanes[j].n;
+	}
+	for (i=0; i < routed; i++)
+		part->order[part->lanes[part->lane_of[i]].off++] = i;
+
+	off = 0;
+	for (size_t j=0; j < part->lane_cnt; j++) {
+		struct well_part_lane *l = &part->lanes[j];
+		if (!l->n)
+			continue;
+		const uint32_t *idx = &part->order[off];
+		off += l->n;
+
+		size_t to_well = l->bl_cnt ? 0 : __atomic_load_n(&l->buf.tx.avail, __ATOMIC_ACQUIRE);
+		if (to_well > l->n)
+			to_well = l->n;
+		if (to_well) {
+			size_t at = lane_reserve_(l, to_well);
+			for (size_t k=0; k < to_well; k++)
+				memcpy(well_access(at, k, &l->buf), well_access(pos, idx[k], from),
+					part->blk_size);
+			well_release_single(&l->buf.rx, to_well);
+		}
+		/* the rest waits its turn */
+		for (size_t k=to_well; k < l->n; k++) {
+			memcpy(backlog_blk_(part, l, l->bl_cnt), well_access(pos, idx[k], from),
+				part->blk_size);
+			l->bl_cnt++;
+		}
+	}
+	return routed;
+}
+
+
+/*	well_part_route()
+Route blocks [pos, pos + count) of a reservation on 'from' to their lanes
+	(backlogs first).
+The router is the ONLY thread calling this, or well_part_flush().
+
+returns number of blocks routed, from the first on; fewer than 'count'
+	only if a lane and its backlog are full: route the rest later.
+*/
+size_t well_part_route(struct well_part *part, struct well *from, size_t pos, size_t count)
+{
+	well_part_flush(part);
+	size_t done = 0;
+	while (done < count) {
+		size_t n = count - done;
+		if (n > part->chunk)
+			n = part->chunk;
+		size_t res = route_chunk_(part, from, pos + done, n);
+		done += res;
+		if (res < n)
+			break;
+	}
+	return done;
+}
@@ -0,0 +1,57 @@
+#include <zed_dbg.h>
+#include <well_pipe.h>
+#include <stdlib.h> /* posix_memalign() */
+
+
+/*	well_pipe_init()
+As well_init() on '&wp->well' (which must have had well_params() called on it),
+	with 'stages' sides in total (at least 2).
+All blocks start out reservable by stage 0.
+
+returns 0 on success
+*/
+int well_pipe_init(struct well_pipe *wp, void *mem, size_t stages)
+{
+	int err_cnt = 0;
+	size_t i = 0;
+	Z_die_if(!wp, "");
+	Z_die_if(stages < 2, "need at least 2 stages");
+	wp->extra = NULL;
+	wp->cnt = stages;
+
+	if (stages > 2) {
+		Z_die_if(posix_memalign((void **)&wp->extra, _Alignof(struct well_stage),
+				(stages - 2) * sizeof(struct well_stage)), "");
+		for (; i < stages - 2; i++) {
+			wp->extra[i].sym.pos = wp->extra[i].sym.avail = 0;
+			Z_die_if(well_sym_init(&wp->extra[i].sym, 0), "");
+		}
+	}
+
+	Z_die_if(well_init(&wp->well, mem), "");
+
+out:
+	if (err_cnt && wp) {
+		while (i)
+			well_sym_deinit(&wp->extra[--i].sym);
+		free(wp->extra);
+		wp->extra = NULL;
+		wp->cnt = 0;
+	}
+	return err_cnt;
+}
+
+
+/*	well_pipe_deinit()
+*/
+void well_pipe_deinit(struct well_pipe *wp)
+{
+	if (!wp || !wp->cnt)
+		return;
+	well_deinit(&wp->well);
+	for (size_t i=0; i < wp->cnt - 2; i++)
+		well_sym_deinit(&wp->extra[i].sym);
+	free(wp->extra);
+	wp->extra = NULL;
+	wp->cnt = 0;
+}
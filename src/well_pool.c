@@ -0,0 +1,138 @@
+#include <zed_dbg.h>
+#include <well_pool.h>
+#include <nmath.h>
+#include <stddef.h> /* max_align_t */
+#include <stdlib.h>
+#include <sched.h> /* sched_yield() */
+
+
+/*	well_pool_init()
+Allocate 'obj_cnt' objects of at least 'obj_size' bytes,
+	each aligned for any type; all start out free.
+
+returns 0 on success
+*/
+int well_pool_init(struct well_pool *pool, size_t obj_size, size_t obj_cnt)
+{
+	int err_cnt = 0;
+	void *mem = NULL;
+	int ring_inited = 0;
+	Z_die_if(!pool, "");
+	pool->slab = NULL;
+	Z_die_if(!obj_size || !obj_cnt, "obj_size %zu; obj_cnt %zu", obj_size, obj_cnt);
+
+	pool->obj_size = nm_next_mult64(obj_size, _Alignof(max_align_t));
+	pool->obj_cnt = obj_cnt;
+	Z_die_if(well_params(sizeof(void *), obj_cnt, &pool->ring), "");
+	Z_die_if(posix_memalign(&pool->slab, NLC_CACHE_LINE, pool->obj_size * obj_cnt), "");
+	Z_die_if(!(mem = malloc(well_size(&pool->ring))), "");
+	Z_die_if(well_init(&pool->ring, mem), "");
+	ring_inited = 1;
+
+	/* every object is free: release them all, as the first reservation */
+	size_t pos, res;
+	res = well_reserve(&pool->ring.tx, &pos, obj_cnt);
+	Z_die_if(res != obj_cnt, "reserved %zu of %zu", res, obj_cnt);
+	for (size_t i=0; i < obj_cnt; i++)
+		WELL_DEREF(void *, pos, i, &pool->ring) = (char *)pool->slab + i * pool->obj_size;
+	Z_die_if(!well_release_multi(&pool->ring.rx, obj_cnt, pos), "");
+
+out:
+	if (err_cnt && pool) {
+		if (ring_inited)
+			well_deinit(&pool->ring);
+		free(mem);
+		free(pool->slab);
+		pool->slab = NULL;
+	}
+	return err_cnt;
+}
+
+
+/*	well_pool_deinit()
+Objects still in use become invalid.
+*/
+void well_pool_deinit(struct well_pool *pool)
+{
+	if (!pool || !pool->slab)
+		return;
+	well_deinit(&pool->ring);
+	free(well_mem(&pool->ring));
+	free(pool->slab);
+	pool->slab = NULL;
+}
+
+
+/*	well_pool_take()
+Take up to 'max_count' free objects into 'out'.
+
+returns number of objects taken; 0 if the pool is (momentarily) empty.
+*/
+size_t well_pool_take(struct well_pool *pool, void **out, size_t max_count)
+{
+	size_t pos;
+	size_t res = well_reserve(&pool->ring.rx, &pos, max_count);
+	for (size_t i=0; i < res; i++)
+		out[i] = WELL_DEREF(void *, pos, i, &pool->ring);
+	/* only waits on takers which reserved just before us: a few copies away */
+	while (res && !well_release_multi(&pool->ring.tx, res, pos))
+		sched_yield();
+	return res;
+}
+
+
+/*	well_pool_give()
+Return 'count' objects: any thread, any order.
+Never fails: the ring holds a slot for every object.
+*/
+void well_pool_give(struct well_pool *pool, void **objs, size_t count)
+{
+	while (count) {
+		size_t pos, res;
+		/* a slot is taken off 'tx' only by a give in progress: retry */
+		if (!(res = well_reserve(&pool->ring.tx, &pos, count))) {
+			sched_yield();
+			continue;
+		}
+		for (size_t i=0; i < res; i++)
+			WELL_DEREF(void *, pos, i, &pool->ring) = objs[i];
+		while (!well_release_multi(&pool->ring.rx, res, pos))
+			sched_yield();
+		objs += res;
+		count -= res;
+	}
+}
+
+
+/*	well_pool_cache_init()
+returns 0 on success
+*/
+int well_pool_cache_init(struct well_pool_cache *cache, struct well_pool *pool, size_t batch)
+{
+	int err_cnt = 0;
+	Z_die_if(!cache || !pool, "");
+	Z_die_if(!batch, "");
+	*cache = (struct well_pool_cache){
+		.pool = pool,
+		.batch = batch
+	};
+	Z_die_if(!(cache->objs = malloc(2 * batch * sizeof(void *))), "");
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_pool_cache_deinit()
+Return all cached objects to the pool.
+Suitable for use as (or inside) a thread cleanup handler.
+*/
+void well_pool_cache_deinit(struct well_pool_cache *cache)
+{
+	if (!cache || !cache->objs)
+		return;
+	well_pool_give(cache->pool, cache->objs, cache->cnt);
+	cache->cnt = 0;
+	free(cache->objs);
+	cache->objs = NULL;
+}
@@ -0,0 +1,42 @@
+#include <zed_dbg.h>
+#include <well_ptrq.h>
+#include <nmath.h>
+#include <stdlib.h> /* posix_memalign() */
+
+
+/*	well_ptrq_init()
+Set up 'q' with room for 'count' pointers (rounded up to a power of 2).
+
+returns 0 on success
+*/
+int well_ptrq_init(struct well_ptrq *q, size_t count)
+{
+	int err_cnt = 0;
+	Z_die_if(!q, "");
+	Z_die_if(!count, "");
+	q->ct.cells = NULL;
+
+	size_t want = count;
+	count = nm_next_pow2_64(count);
+	Z_die_if(count < want, "count %zu overflow", want);
+	Z_die_if(posix_memalign((void **)&q->ct.cells, WELL_LINE,
+			count * sizeof(struct well_ptr_cell)), "count %zu", count);
+	for (size_t i=0; i < count; i++)
+		q->ct.cells[i] = (struct well_ptr_cell){ .seq = i, .ptr = NULL };
+	q->ct.mask = count - 1;
+	q->tx.pos = q->rx.pos = 0;
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_ptrq_deinit()
+*/
+void well_ptrq_deinit(struct well_ptrq *q)
+{
+	if (!q)
+		return;
+	free(q->ct.cells);
+	q->ct.cells = NULL;
+}
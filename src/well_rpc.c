@@ -0,0 +1,134 @@
+#include <zed_dbg.h>
+#include <well_rpc.h>
+#include "well_evc.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+
+
+/*	well_rpc_init()
+As well_init() on '&rpc->well' (which must have had well_params() called on it),
+	plus one state word per block.
+
+returns 0 on success
+*/
+int well_rpc_init(struct well_rpc *rpc, void *mem)
+{
+	int err_cnt = 0;
+	Z_die_if(!rpc, "");
+	rpc->reclaimed = 0;
+	rpc->seq = rpc->waiters = 0;
+
+	/* 0 has no tag: not answered, not retired */
+	Z_die_if(!(rpc->state = calloc(well_blk_count(&rpc->well), sizeof(size_t))), "");
+
+	if (well_init(&rpc->well, mem)) {
+		free(rpc->state);
+		rpc->state = NULL;
+		Z_die("");
+	}
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_rpc_deinit()
+*/
+void well_rpc_deinit(struct well_rpc *rpc)
+{
+	if (!rpc || !rpc->state)
+		return;
+	well_deinit(&rpc->well);
+	free(rpc->state);
+	rpc->state = NULL;
+}
+
+
+/*	well_rpc_reclaim()
+Return to 'tx' the longest run of retired blocks at the tail of the ring.
+Safe to call from any number of clients.
+
+returns number of blocks reclaimed.
+*/
+size_t well_rpc_reclaim(struct well_rpc *rpc)
+{
+	size_t cnt = well_blk_count(&rpc->well);
+	size_t old = __atomic_load_n(&rpc->reclaimed, __ATOMIC_ACQUIRE);
+	for (;;) {
+		size_t n = 0;
+		/* acquire: clients are done reading before the block is reused */
+		while (n < cnt && __atomic_load_n(well_rpc_state_(rpc, old + n), __ATOMIC_ACQUIRE)
+					== (((old + n) << 2) | WELL_RPC_RETIRED))
+			n++;
+		if (!n)
+			return 0;
+		if (__atomic_compare_exchange_n(&rpc->reclaimed, &old, old + n,
+						0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			well_release_single(&rpc->well.tx, n);
+			return n;
+		}
+	}
+}
+
+
+/*	well_rpc_respond()
+Server: the responses for 'count' blocks from 'pos' are written.
+Wakes any client sleeping in well_rpc_wait().
+*/
+void well_rpc_respond(struct well_rpc *rpc, size_t pos, size_t count)
+{
+	for (size_t i=0; i < count; i++)
+		__atomic_store_n(well_rpc_state_(rpc, pos + i),
+				((pos + i) << 2) | WELL_RPC_DONE, __ATOMIC_RELEASE);
+
+	well_evc_notify(&rpc->seq, &rpc->waiters, INT_MAX, 0);
+}
+
+
+/*	well_rpc_finish()
+Client: done reading the responses in 'count' blocks from 'pos'.
+*/
+void well_rpc_finish(struct well_rpc *rpc, size_t pos, size_t count)
+{
+	for (size_t i=0; i < count; i++)
+		__atomic_store_n(well_rpc_state_(rpc, pos + i),
+				((pos + i) << 2) | WELL_RPC_RETIRED, __ATOMIC_RELEASE);
+	well_rpc_reclaim(rpc);
+}
+
+
+/*	well_rpc_wait()
+Client: sleep until all 'count' blocks from 'pos' are answered,
+	or 'timeout_ns' elapses (negative: no timeout).
+Without futexes, yields instead of sleeping.
+
+returns 0 once answered; -1 on timeout (errno ETIMEDOUT).
+*/
+int well_rpc_wait(struct well_rpc *rpc, size_t pos, size_t count, long timeout_ns)
+{
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!well_rpc_ready(rpc, pos, count)) {
+		long left = -1;
+		if (timeout_ns >= 0) {
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			left = timeout_ns - (now.tv_sec - start.tv_sec) * 1000000000L
+					- (now.tv_nsec - start.tv_nsec);
+			if (left <= 0) {
+				errno = ETIMEDOUT;
+				return -1;
+			}
+		}
+
+		/* a timeout is caught above, on the next round */
+		uint32_t key = well_evc_prepare(&rpc->seq, &rpc->waiters);
+		if (!well_rpc_ready(rpc, pos, count))
+			well_evc_park(&rpc->seq, &rpc->waiters, key, left, 0);
+		else
+			well_evc_cancel(&rpc->waiters);
+	}
+	return 0;
+}
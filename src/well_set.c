@@ -0,0 +1,184 @@
+#include <zed_dbg.h>
+#include <well_set.h>
+#include <nmath.h>
+#include "well_evc.h"
+#include <stdlib.h>
+#include <string.h> /* memset() */
+
+
+/*	well_set_init()
+Prepare 'set' for up to 'capacity' wells.
+
+returns 0 on success
+*/
+int well_set_init(struct well_set *set, size_t capacity)
+{
+	int err_cnt = 0;
+	Z_die_if(!set, "");
+	Z_die_if(!capacity, "");
+	set->bits = NULL;
+	set->members = NULL;
+
+	/* whole lines of bits: producers on different lines never share */
+	size_t words = nm_next_mult64(capacity, WELL_LINE * 8) / 64;
+	Z_die_if(posix_memalign((void **)&set->bits, WELL_LINE, words * sizeof(uint64_t)), "");
+	memset(set->bits, 0x0, words * sizeof(uint64_t));
+	Z_die_if(!(set->members = calloc(capacity, sizeof(struct well *))), "");
+	set->cap = capacity;
+	set->cnt = 0;
+	set->cursor = 0;
+	set->seq = set->waiters = 0;
+
+out:
+	if (err_cnt && set) {
+		free(set->bits);
+		set->bits = NULL;
+	}
+	return err_cnt;
+}
+
+
+/*	well_set_deinit()
+The wells themselves are untouched.
+*/
+void well_set_deinit(struct well_set *set)
+{
+	if (!set || !set->bits)
+		return;
+	free(set->bits);
+	free(set->members);
+	set->bits = NULL;
+	set->members = NULL;
+}
+
+
+/*	well_set_add()
+Register 'buf' (initialized) with 'set'; its id is written to '*out_id'.
+Safe while the set is in use.
+
+returns 0 on success
+*/
+int well_set_add(struct well_set *set, struct well *buf, size_t *out_id)
+{
+	int err_cnt = 0;
+	Z_die_if(!set || !buf || !well_mem(buf), "");
+
+	size_t id = __atomic_load_n(&set->cnt, __ATOMIC_RELAXED);
+	do {
+		Z_die_if(id >= set->cap, "set full: %zu wells", set->cap);
+	} while (!__atomic_compare_exchange_n(&set->cnt, &id, id + 1,
+						1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	/* a consumer only looks at a member once its bit is set, after this */
+	__atomic_store_n(&set->members[id], buf, __ATOMIC_RELEASE);
+	*out_id = id;
+
+	/* it may already hold blocks */
+	if (__atomic_load_n(&buf->rx.avail, __ATOMIC_ACQUIRE))
+		well_set_mark(set, id);
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_set_mark()
+Member 'id' is ready: set its bit and wake parked consumers.
+Producers using well_set_release() need not call this.
+*/
+void well_set_mark(struct well_set *set, size_t id)
+{
+	uint64_t bit = 1ULL << (id & 63);
+	if (__atomic_fetch_or(&set->bits[id >> 6], bit, __ATOMIC_SEQ_CST) & bit)
+		return;
+	well_evc_notify(&set->seq, &set->waiters, INT_MAX, 0);
+}
+
+
+/*	well_set_reserve()
+Reserve up to 'max_count' blocks from 'rx' of some ready member,
+	whose id is written to '*out_id'.
+Members are visited round-robin.
+
+returns number of blocks reserved; 0 if no member was ready.
+*/
+size_t well_set_reserve(struct well_set	*set,
+			size_t		*out_id,
+			size_t		*out_pos,
+			size_t		max_count)
+{
+	size_t cnt = __atomic_load_n(&set->cnt, __ATOMIC_ACQUIRE);
+	if (!cnt)
+		return 0;
+	size_t words = (cnt + 63) / 64;
+	size_t start = __atomic_load_n(&set->cursor, __ATOMIC_RELAXED);
+	if (start >= cnt)
+		start = 0;
+
+	/* 'words + 1' visits: the first word is seen twice, split at 'start' */
+	for (size_t i=0; i <= words; i++) {
+		size_t w = ((start >> 6) + i) % words;
+		uint64_t word = __atomic_load_n(&set->bits[w], __ATOMIC_RELAXED);
+		if (i == 0)
+			word &= ~0ULL << (start & 63);		/* from 'start' on */
+		else if (i == words)
+			word &= ~(~0ULL << (start & 63));	/* up to 'start' */
+
+		while (word) {
+			uint64_t bit = word & -word;
+			word &= ~bit;
+			size_t id = (w << 6) + __builtin_ctzll(bit);
+
+			/* someone else took it */
+			if (!(__atomic_fetch_and(&set->bits[w], ~bit, __ATOMIC_SEQ_CST) & bit))
+				continue;
+
+			struct well *buf = __atomic_load_n(&set->members[id], __ATOMIC_ACQUIRE);
+			size_t res = well_reserve(&buf->rx, out_pos, max_count);
+			if (!res) {
+				/* contended (e.g. a failed trylock), not empty: stay ready */
+				if (__atomic_load_n(&buf->rx.avail, __ATOMIC_ACQUIRE))
+					well_set_mark(set, id);
+				continue;
+			}
+			/* may have left blocks: stay ready */
+			if (res == max_count)
+				well_set_mark(set, id);
+			__atomic_store_n(&set->cursor, id + 1, __ATOMIC_RELAXED);
+			*out_id = id;
+			return res;
+		}
+	}
+	return 0;
+}
+
+
+/*	ready()
+Any bit set?
+*/
+static int ready(struct well_set *set)
+{
+	size_t words = (__atomic_load_n(&set->cnt, __ATOMIC_ACQUIRE) + 63) / 64;
+	for (size_t w=0; w < words; w++) {
+		if (__atomic_load_n(&set->bits[w], __ATOMIC_RELAXED))
+			return 1;
+	}
+	return 0;
+}
+
+
+/*	well_set_wait()
+Park until some member is marked ready, or 'timeout_ns' elapses
+	(negative: no timeout).
+Without futexes, yields instead of sleeping.
+Spurious returns are possible: always retry well_set_reserve().
+
+returns 0 if a member is (or may be) ready; -1 on timeout (errno ETIMEDOUT).
+*/
+int well_set_wait(struct well_set *set, long timeout_ns)
+{
+	uint32_t key = well_evc_prepare(&set->seq, &set->waiters);
+	if (!ready(set))
+		return well_evc_park(&set->seq, &set->waiters, key, timeout_ns, 0);
+	well_evc_cancel(&set->waiters);
+	return 0;
+}
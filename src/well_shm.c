@@ -0,0 +1,182 @@
+#include <zed_dbg.h>
+#include <well_shm.h>
+#include <nmath.h>
+#include "well_evc.h"
+#include <stddef.h> /* offsetof() */
+#include <string.h> /* strerror() */
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*	shm_of()
+Header of the segment containing 'buf'.
+*/
+static struct well_shm *shm_of(struct well *buf)
+{
+	return (struct well_shm *)((uintptr_t)buf - offsetof(struct well_shm, well));
+}
+
+
+/*	data_offt()
+Buffer starts on the first page boundary after the header.
+*/
+static size_t data_offt()
+{
+	return nm_next_mult64(sizeof(struct well_shm), sysconf(_SC_PAGESIZE));
+}
+
+
+/*	well_shm_size()
+Bytes needed for a segment holding 'blk_cnt' blocks of 'blk_size'.
+
+returns 0 if parameters are invalid
+*/
+size_t well_shm_size(size_t blk_size, size_t blk_cnt)
+{
+	struct well params = { {0} };
+	if (well_params(blk_size, blk_cnt, &params))
+		return 0;
+	return data_offt() + well_size(&params);
+}
+
+
+/*	well_shm_create()
+Size the segment open on 'fd' and build a well in it.
+The caller is responsible for calling well_deinit() once ALL processes
+	have detached, if the technique requires it (MTX).
+
+returns pointer to the well inside this process' mapping; NULL on error.
+*/
+struct well *well_shm_create(int fd, size_t blk_size, size_t blk_cnt)
+{
+	int err_cnt = 0;
+	struct well_shm *shm = MAP_FAILED;
+
+	size_t size = well_shm_size(blk_size, blk_cnt);
+	Z_die_if(!size, "blk_size %zu; blk_cnt %zu", blk_size, blk_cnt);
+	Z_die_if(ftruncate(fd, size), "%s", strerror(errno));
+	shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	Z_die_if(shm == MAP_FAILED, "%s", strerror(errno));
+
+	*shm = (struct well_shm){
+		.magic = WELL_SHM_MAGIC,
+		.version = WELL_SHM_VERSION,
+		.technique = WELL_TECHNIQUE,
+		.layout = WELL_LAYOUT,
+		.well_sz = sizeof(struct well),
+		.seg_size = size
+	};
+	Z_die_if(well_params(blk_size, blk_cnt, &shm->well), "");
+	shm->blk_size = well_blk_size(&shm->well);
+	shm->blk_count = well_blk_count(&shm->well);
+#if (WELL_TECHNIQUE == WELL_DO_FC)
+	well_sym_fc_place(&shm->well.tx, shm->fc[0]);
+	well_sym_fc_place(&shm->well.rx, shm->fc[1]);
+#endif
+	Z_die_if(well_init_pshared(&shm->well, (void *)shm + data_offt(), 1), "");
+
+	__atomic_store_n(&shm->ready, 1, __ATOMIC_RELEASE);
+	return &shm->well;
+
+out:
+	if (shm != MAP_FAILED)
+		munmap(shm, size);
+	return NULL;
+}
+
+
+/*	well_shm_attach()
+Map the segment open on 'fd', which another process built
+	with well_shm_create().
+
+returns pointer to the well inside this process' mapping;
+	NULL on error, including EAGAIN if the creator has not yet finished.
+*/
+struct well *well_shm_attach(int fd)
+{
+	int err_cnt = 0;
+	struct well_shm *shm = MAP_FAILED;
+	int err = EINVAL;
+
+	struct stat st;
+	Z_die_if(fstat(fd, &st), "%s", strerror(errno));
+	Z_die_if((size_t)st.st_size < data_offt(), "segment size %zu", (size_t)st.st_size);
+	shm = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	Z_die_if(shm == MAP_FAILED, "%s", strerror(errno));
+
+	if (!__atomic_load_n(&shm->ready, __ATOMIC_ACQUIRE)) {
+		err = EAGAIN;
+		goto out;
+	}
+	Z_die_if(shm->magic != WELL_SHM_MAGIC, "not a well: magic 0x%x", shm->magic);
+	Z_die_if(shm->version != WELL_SHM_VERSION,
+		"version %u; expected %u", shm->version, WELL_SHM_VERSION);
+	Z_die_if(shm->technique != WELL_TECHNIQUE,
+		"technique %u; expected %u", shm->technique, WELL_TECHNIQUE);
+	Z_die_if(shm->layout != WELL_LAYOUT,
+		"layout %u; expected %u", shm->layout, WELL_LAYOUT);
+	Z_die_if(shm->well_sz != sizeof(struct well),
+		"struct well is %u bytes; expected %zu", shm->well_sz, sizeof(struct well));
+	Z_die_if(shm->seg_size != (uint64_t)st.st_size
+		|| shm->blk_size != well_blk_size(&shm->well)
+		|| shm->blk_count != well_blk_count(&shm->well)
+		|| shm->seg_size != data_offt() + well_size(&shm->well),
+		"segment header inconsistent");
+	Z_die_if(well_mem(&shm->well) != (void *)shm + data_offt(), "buffer not in segment");
+
+	return &shm->well;
+
+out:
+	if (shm != MAP_FAILED)
+		munmap(shm, st.st_size);
+	errno = err;
+	return NULL;
+}
+
+
+/*	well_shm_detach()
+Unmap a well returned by well_shm_create() or well_shm_attach().
+*/
+void well_shm_detach(struct well *buf)
+{
+	if (!buf)
+		return;
+	struct well_shm *shm = shm_of(buf);
+	munmap(shm, shm->seg_size);
+}
+
+
+/*	well_shm_wait()
+Sleep until blocks are available on 'from', the other side calls
+	well_shm_wake(), or 'timeout_ns' elapses (negative: no timeout).
+Spurious returns are possible: always retry the reservation.
+
+returns 0 if 'from' has blocks available (or may have);
+	-1 on timeout (errno ETIMEDOUT).
+*/
+int well_shm_wait(struct well *buf, struct well_sym *from, long timeout_ns)
+{
+	struct well_shm *shm = shm_of(buf);
+	int i = from == &buf->rx;
+
+	/* other processes notify: not a private futex */
+	uint32_t key = well_evc_prepare(&shm->seq[i], &shm->waiters[i]);
+	if (!__atomic_load_n(&from->avail, __ATOMIC_ACQUIRE))
+		return well_evc_park(&shm->seq[i], &shm->waiters[i], key, timeout_ns, 1);
+	well_evc_cancel(&shm->waiters[i]);
+	return 0;
+}
+
+
+/*	well_shm_wake()
+Call after releasing to 'to': wake anyone sleeping in well_shm_wait() on it.
+*/
+void well_shm_wake(struct well *buf, struct well_sym *to)
+{
+	struct well_shm *shm = shm_of(buf);
+	int i = to == &buf->rx;
+
+	well_evc_notify(&shm->seq[i], &shm->waiters[i], INT_MAX, 1);
+}
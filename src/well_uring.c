@@ -0,0 +1,352 @@
+#include <zed_dbg.h>
+#include <well_uring.h>
+#include <stdlib.h> /* calloc() */
+#include <string.h> /* memset() */
+#include <errno.h>
+
+
+/* io_uring caps a single transfer well below SIZE_MAX */
+#define WELL_URING_MAX_LEN (1UL << 30)
+
+
+/*	uring_init()
+*/
+static int uring_init(struct well_uring	*wu,
+			struct well	*buf,
+			int		fd,
+			off_t		off,
+			unsigned int	depth,
+			size_t		chunk,
+			int		is_write)
+{
+	int err_cnt = 0;
+	Z_die_if(!wu || !buf || fd < 0, "");
+	Z_die_if(!depth, "depth must be at least 1");
+	/* default: enough operations to fill the buffer at full 'depth' */
+	if (!chunk)
+		chunk = well_blk_count(buf) / depth;
+	if (!chunk)
+		chunk = 1;
+	if (chunk > well_blk_count(buf))
+		chunk = well_blk_count(buf);
+	if ((chunk << buf->ct.blk_shift) > WELL_URING_MAX_LEN)
+		chunk = WELL_URING_MAX_LEN >> buf->ct.blk_shift;
+	Z_die_if(!chunk, "blk_size %zu too large", well_blk_size(buf));
+
+	*wu = (struct well_uring){
+		.buf = buf,
+		.from = is_write ? &buf->rx : &buf->tx,
+		.to = is_write ? &buf->tx : &buf->rx,
+		.fd = fd,
+		.is_write = is_write,
+		.off = off < 0 ? -1 : off,
+		.chunk = chunk,
+		.depth = depth
+	};
+
+	Z_die_if(!(wu->ops = calloc(depth, sizeof(*wu->ops))), "");
+	int ret = io_uring_queue_init(depth, &wu->ring, 0);
+	if (ret) {
+		free(wu->ops);
+		wu->ops = NULL;
+		Z_die("io_uring_queue_init: %s", strerror(-ret));
+	}
+
+	/* registration may fail (e.g. RLIMIT_MEMLOCK): plain read/write still work */
+	struct iovec iov = { .iov_base = well_mem(buf), .iov_len = well_size(buf) };
+	wu->fixed = well_size(buf) <= WELL_URING_MAX_LEN
+		&& !io_uring_register_buffers(&wu->ring, &iov, 1);
+
+out:
+	return err_cnt;
+}
+
+
+/*	well_uring_ingest_init()
+Prepare 'wu' to read from 'fd' into 'buf'.
+'off' is the file offset to start reading at, or -1 for a stream.
+'depth' is the max number of operations in flight;
+	'chunk' the max number of blocks per operation
+	(0 to split the buffer evenly across 'depth' operations).
+
+returns 0 on success
+*/
+int well_uring_ingest_init(struct well_uring	*wu,
+			struct well		*buf,
+			int			fd,
+			off_t			off,
+			unsigned int		depth,
+			size_t			chunk)
+{
+	return uring_init(wu, buf, fd, off, depth, chunk, 0);
+}
+
+
+/*	well_uring_drain_init()
+Prepare 'wu' to write from 'buf' to 'fd'.
+Parameters as for well_uring_ingest_init().
+
+returns 0 on success
+*/
+int well_uring_drain_init(struct well_uring	*wu,
+			struct well		*buf,
+			int			fd,
+			off_t			off,
+			unsigned int		depth,
+			size_t			chunk)
+{
+	return uring_init(wu, buf, fd, off, depth, chunk, 1);
+}
+
+
+/*	well_uring_deinit()
+Wait for any operations in flight, then tear down the ring.
+Blocks still reserved by 'wu' are NOT released.
+*/
+void well_uring_deinit(struct well_uring *wu)
+{
+	if (!wu || !wu->ops)
+		return;
+
+	struct io_uring_cqe *cqe;
+	for (size_t i = wu->head; i != wu->tail; i++) {
+		while (wu->ops[i % wu->depth].busy) {
+			if (io_uring_wait_cqe(&wu->ring, &cqe))
+				break;
+			struct well_uring_op *op = io_uring_cqe_get_data(cqe);
+			op->busy = 0;
+			io_uring_cqe_seen(&wu->ring, cqe);
+		}
+	}
+
+	io_uring_queue_exit(&wu->ring);
+	free(wu->ops);
+	wu->ops = NULL;
+}
+
+
+/*	queue_op()
+Prepare (but do not submit) the untransferred remainder of 'op'.
+*/
+static void queue_op(struct well_uring *wu, struct well_uring_op *op)
+{
+	struct io_uring_sqe *sqe;
+	while (!(sqe = io_uring_get_sqe(&wu->ring)))
+		io_uring_submit(&wu->ring);
+
+	void *addr = well_access(op->pos, 0, wu->buf) + op->done;
+	unsigned int len = op->len - op->done;
+	__u64 off = op->off < 0 ? (__u64)-1 : (__u64)(op->off + op->done);
+
+	if (wu->is_write && wu->fixed)
+		io_uring_prep_write_fixed(sqe, wu->fd, addr, len, off, 0);
+	else if (wu->is_write)
+		io_uring_prep_write(sqe, wu->fd, addr, len, off);
+	else if (wu->fixed)
+		io_uring_prep_read_fixed(sqe, wu->fd, addr, len, off, 0);
+	else
+		io_uring_prep_read(sqe, wu->fd, addr, len, off);
+
+	io_uring_sqe_set_data(sqe, op);
+	op->busy = 1;
+}
+
+
+/*	reap()
+Account for all available completions, queueing the remainder of short ones.
+
+returns number of operations re-queued.
+*/
+static unsigned int reap(struct well_uring *wu)
+{
+	unsigned int requeued = 0;
+	size_t blk_mask = well_blk_size(wu->buf) - 1;
+	struct io_uring_cqe *cqe;
+
+	while (!io_uring_peek_cqe(&wu->ring, &cqe)) {
+		struct well_uring_op *op = io_uring_cqe_get_data(cqe);
+		int res = cqe->res;
+		io_uring_cqe_seen(&wu->ring, cqe);
+		op->busy = 0;
+
+		if (res == -EAGAIN || res == -EINTR) {
+			/* retry as-is */
+		} else if (res < 0) {
+			if (!wu->err)
+				wu->err = -res;
+			continue;
+		} else if (!res) {
+			/* read: EOF; write: no progress is an error */
+			if (wu->is_write && !wu->err)
+				wu->err = EIO;
+			else
+				wu->eof = 1;
+			continue;
+		} else {
+			op->done += res;
+			if (op->done == op->len)
+				continue;
+			/* A short stream read which ends on a block boundary is
+				just what was available: hand it on now.
+			*/
+			if (!wu->is_write && op->off < 0 && !(op->done & blk_mask))
+				continue;
+		}
+
+		if (wu->err || (wu->eof && !wu->is_write))
+			continue;
+		queue_op(wu, op);
+		requeued++;
+	}
+
+	return requeued;
+}
+
+
+/*	settle()
+Nothing is in flight and the oldest operation is short: pad a partial
+	final block (reads) and release what it transferred.
+Everything reserved after that goes back to 'from' in one piece,
+	later operations which completed included: releasing those would
+	leave a hole. A drain pump stopped by an error so leaves every
+	block it did not write on 'rx'.
+
+returns number of blocks released.
+*/
+static size_t settle(struct well_uring *wu)
+{
+	size_t blk_size = well_blk_size(wu->buf);
+	struct well_uring_op *op = &wu->ops[wu->head % wu->depth];
+	size_t used = op->done >> wu->buf->ct.blk_shift;
+	size_t part = op->done & (blk_size - 1);
+	if (part && !wu->is_write) {
+		memset(well_access(op->pos, used, wu->buf) + part, 0x0, blk_size - part);
+		used++;
+	}
+
+	/* we are the only reserver on this side: what we hold ends at 'pos' */
+	size_t cut = op->pos + used;
+	size_t back = __atomic_load_n(&wu->from->pos, __ATOMIC_RELAXED) - cut;
+	if (back && !well_unreserve(wu->from, cut, back)) {
+		/* someone else reserved on our side: keep the blocks, stop */
+		Z_log(Z_err, "side shared with another thread: %zu blocks stranded", back);
+		if (!wu->err)
+			wu->err = EBUSY;
+	}
+	/* the next operation picks up where this one stopped */
+	if (wu->off >= 0)
+		wu->off = op->off + (used << wu->buf->ct.blk_shift);
+
+	wu->head = wu->tail;
+	if (used)
+		well_release_single(wu->to, used);
+	return used;
+}
+
+
+/*	retire()
+Release completed operations, in submission order.
+
+returns number of blocks released.
+*/
+static size_t retire(struct well_uring *wu)
+{
+	size_t total = 0;
+	while (wu->head != wu->tail) {
+		struct well_uring_op *op = &wu->ops[wu->head % wu->depth];
+		if (op->busy)
+			break;
+
+		if (op->done != op->len) {
+			for (size_t i = wu->head; i != wu->tail; i++) {
+				if (wu->ops[i % wu->depth].busy)
+					goto out;
+			}
+			if (total)
+				well_release_single(wu->to, total);
+			return total + settle(wu);
+		}
+
+		total += op->count;
+		wu->head++;
+	}
+out:
+	if (total)
+		well_release_single(wu->to, total);
+	return total;
+}
+
+
+/*	submit()
+Reserve and queue new operations until 'depth' are in flight.
+Each operation is contiguous in memory: it never wraps past the end of the buffer.
+
+returns number of operations queued.
+*/
+static unsigned int submit(struct well_uring *wu)
+{
+	unsigned int queued = 0;
+	unsigned int depth = wu->off < 0 ? 1 : wu->depth;
+	size_t blk_count = well_blk_count(wu->buf);
+
+	while (!wu->err && !(wu->eof && !wu->is_write) && well_uring_inflight(wu) < depth) {
+		/* we are the only reserver on this side: our next 'pos' is known */
+		size_t next = __atomic_load_n(&wu->from->pos, __ATOMIC_RELAXED);
+		size_t contig = blk_count - (next & (blk_count - 1));
+		size_t pos;
+		size_t res = well_reserve(wu->from, &pos, contig < wu->chunk ? contig : wu->chunk);
+		if (!res)
+			break;
+
+		struct well_uring_op *op = &wu->ops[wu->tail++ % wu->depth];
+		*op = (struct well_uring_op){
+			.pos = pos,
+			.count = res,
+			.len = res << wu->buf->ct.blk_shift,
+			.off = wu->off
+		};
+		if (wu->off >= 0)
+			wu->off += op->len;
+
+		queue_op(wu, op);
+		queued++;
+	}
+	return queued;
+}
+
+
+/*	well_uring_pump()
+Reap completions, release finished blocks in order and submit new operations.
+If 'wait' and nothing could be released, block until an operation completes.
+
+returns number of blocks released;
+	0 once an ingest pump has reached EOF and has nothing left in flight;
+	-1 with errno set: EAGAIN if nothing could be released (and, if 'wait',
+	nothing is in flight to wait on); or the error which stopped the pump.
+*/
+ssize_t well_uring_pump(struct well_uring *wu, int wait)
+{
+	struct io_uring_cqe *cqe;
+	for (;;) {
+		unsigned int queued = reap(wu);
+		size_t released = retire(wu);
+		queued += submit(wu);
+		if (queued)
+			io_uring_submit(&wu->ring);
+
+		if (released)
+			return released;
+
+		if (!well_uring_inflight(wu)) {
+			if (wu->eof && !wu->is_write && !wu->err)
+				return 0;
+			errno = wu->err ? wu->err : EAGAIN;
+			return -1;
+		}
+		if (!wait) {
+			errno = EAGAIN;
+			return -1;
+		}
+		io_uring_wait_cqe(&wu->ring, &cqe);
+	}
+}
@@ -0,0 +1,138 @@
+/*	well_bcast_test.c
+
+Every consumer of a broadcast well must see every block:
+	in order with a single producer; complete (by sum) with several.
+The last consumer leaves halfway: producers must not stall on it.
+*/
+
+#include <well_bcast.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+static size_t numiter = 1000000;
+static size_t blk_cnt = 256;
+static size_t tx_thread_cnt = 2;
+static size_t rx_thread_cnt = 3;
+
+static struct well_bcast bc;
+
+
+/*	tx_thread()
+Values written are 'i+1' for i in [0, numiter), split across producers.
+*/
+void *tx_thread(void *arg)
+{
+	size_t num = numiter / tx_thread_cnt;
+	size_t first = (size_t)arg * num;
+
+	for (size_t i=0, res=0; i < num; i += res) {
+		size_t pos;
+		while (!(res = well_bcast_reserve(&bc, &pos, num - i)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, &bc.well) = first + i + j + 1;
+
+		if (tx_thread_cnt == 1) {
+			well_bcast_publish(&bc, res);
+		} else {
+			while (!well_bcast_publish_multi(&bc, res, pos))
+				FAIL_DO();
+		}
+	}
+	return NULL;
+}
+
+
+/*	rx_thread()
+returns number of errors
+*/
+void *rx_thread(void *arg)
+{
+	size_t id = (size_t)arg;
+	size_t total = (numiter / tx_thread_cnt) * tx_thread_cnt;
+	size_t stop = id == rx_thread_cnt - 1 && rx_thread_cnt > 1 ? total / 2 : total;
+	size_t sum = 0, errs = 0;
+
+	for (size_t i=0, res=0; i < stop; i += res) {
+		size_t pos;
+		while (!(res = well_bcast_read(&bc, id, &pos, 7)))
+			FAIL_DO();
+		if (res > stop - i)
+			res = stop - i;
+		for (size_t j=0; j < res; j++) {
+			size_t val = WELL_DEREF(size_t, pos, j, &bc.well);
+			if (tx_thread_cnt == 1 && val != i + j + 1)
+				errs++;
+			sum += val;
+		}
+		well_bcast_done(&bc, id, res);
+	}
+
+	if (stop < total) {
+		well_bcast_leave(&bc, id);
+	} else if (sum != total * (total + 1) / 2) {
+		Z_log(Z_err, "consumer %zu: sum %zu != %zu", id, sum, total * (total + 1) / 2);
+		errs++;
+	}
+	return (void *)errs;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx[64], rx[64];
+	size_t tx_started = 0, rx_started = 0;
+
+	while ((opt = getopt(argc, argv, "n:c:t:x:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &blk_cnt) != 1, "-c");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &tx_thread_cnt) != 1
+				|| !tx_thread_cnt || tx_thread_cnt > 64, "-t");
+			break;
+		case 'x':
+			Z_die_if(sscanf(optarg, "%zu", &rx_thread_cnt) != 1
+				|| !rx_thread_cnt || rx_thread_cnt > 64, "-x");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_params(sizeof(size_t), blk_cnt, &bc.well), "");
+	Z_die_if(
+		well_bcast_init(&bc, malloc(well_size(&bc.well)), rx_thread_cnt)
+		, "size %zu", well_size(&bc.well));
+
+	for (; rx_started < rx_thread_cnt; rx_started++)
+		Z_die_if(pthread_create(&rx[rx_started], NULL, rx_thread, (void *)rx_started), "");
+	for (; tx_started < tx_thread_cnt; tx_started++)
+		Z_die_if(pthread_create(&tx[tx_started], NULL, tx_thread, (void *)tx_started), "");
+
+out:
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	while (rx_started) {
+		void *errs;
+		pthread_join(rx[--rx_started], &errs);
+		err_cnt += (size_t)errs;
+	}
+
+	well_bcast_deinit(&bc);
+	free(well_mem(&bc.well));
+	return err_cnt;
+}
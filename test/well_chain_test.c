@@ -0,0 +1,131 @@
+/*	well_chain_test.c
+
+A producer writes 'i' in bursts through a chain of small segments,
+	while the consumer stalls now and then so that the chain must grow.
+The consumer checks every value arrives once and in order;
+	once drained, the chain must have shrunk back to its spares.
+*/
+
+#include <well_chain.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <unistd.h> /* usleep() */
+
+
+static size_t numiter = 1000000;
+static size_t blk_cnt = 64;
+static size_t keep = 2;
+
+static struct well_chain chain;
+static size_t max_segs = 0;
+
+
+/*	producer()
+*/
+void *producer(void *arg)
+{
+	for (size_t i=0, res=0; i < numiter; i += res) {
+		struct well *buf;
+		size_t pos;
+		size_t want = 1 + i % 13;
+		if (want > numiter - i)
+			want = numiter - i;
+		while (!(res = well_chain_reserve(&chain, &buf, &pos, want)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, buf) = i + j;
+		well_chain_release(&chain, buf, res);
+
+		size_t segs = well_chain_segments(&chain);
+		if (segs > max_segs)
+			max_segs = segs;
+	}
+	return NULL;
+}
+
+
+/*	consumer()
+returns number of errors
+*/
+void *consumer(void *arg)
+{
+	size_t errs = 0;
+	for (size_t i=0, res=0; i < numiter; i += res) {
+		struct well *buf;
+		size_t pos;
+		while (!(res = well_chain_take(&chain, &buf, &pos, 7)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++) {
+			size_t val = WELL_DEREF(size_t, pos, j, buf);
+			if (val != i + j) {
+				if (!errs)
+					Z_log(Z_err, "block %zu: %zu", i + j, val);
+				errs++;
+			}
+		}
+		well_chain_done(&chain, buf, res);
+
+		/* stall: make the producer overrun */
+		if ((i / 7) % 20000 == 0)
+			usleep(2000);
+	}
+	return (void *)errs;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx, rx;
+	int tx_started = 0, rx_started = 0, inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:c:k:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &blk_cnt) != 1, "-c");
+			break;
+		case 'k':
+			Z_die_if(sscanf(optarg, "%zu", &keep) != 1, "-k");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_chain_init(&chain, sizeof(size_t), blk_cnt, keep), "");
+	inited = 1;
+
+	Z_die_if(pthread_create(&rx, NULL, consumer, NULL), "");
+	rx_started = 1;
+	Z_die_if(pthread_create(&tx, NULL, producer, NULL), "");
+	tx_started = 1;
+
+out:
+	if (tx_started)
+		pthread_join(tx, NULL);
+	if (rx_started) {
+		void *errs;
+		pthread_join(rx, &errs);
+		err_cnt += (size_t)errs;
+	}
+
+	if (inited) {
+		Z_log(Z_inf, "segments: at most %zu; %zu at end", max_segs, well_chain_segments(&chain));
+		Z_err_if(max_segs < 2, "chain never grew");
+		/* the tail, plus spares (rounded up to a power of 2) */
+		Z_err_if(well_chain_segments(&chain) > 1 + well_blk_count(&chain.spare),
+			"chain did not shrink: %zu segments", well_chain_segments(&chain));
+		well_chain_deinit(&chain);
+	}
+	return err_cnt;
+}
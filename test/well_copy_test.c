@@ -0,0 +1,185 @@
+/*	well_copy_test.c
+
+Copies into and out of reservations: every length and misalignment,
+	across the wrap, with streaming stores always and never;
+	then a producer and consumer passing blocks through streaming copies
+	(the fence must publish them).
+*/
+
+#include <well_copy.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+static size_t numiter = 20000;
+static struct well buf;
+
+
+/*	fill()
+A pattern which differs at every byte and for every 'seed'.
+*/
+static void fill(unsigned char *p, size_t len, size_t seed)
+{
+	for (size_t i=0; i < len; i++)
+		p[i] = (unsigned char)(seed * 131 + i * 7 + (i >> 8));
+}
+
+
+/*	check_sizes()
+returns number of errors
+*/
+static int check_sizes(size_t blk_size, size_t blk_cnt)
+{
+	int err_cnt = 0;
+	unsigned char *src = NULL, *dst = NULL;
+	struct well w = { { 0 } };
+	Z_die_if(well_params(blk_size, blk_cnt, &w), "");
+	Z_die_if(well_init(&w, malloc(well_size(&w))), "");
+	size_t size = well_size(&w);
+	Z_die_if(!(src = malloc(size + 64)), "");
+	Z_die_if(!(dst = malloc(size + 64)), "");
+
+	const size_t lens[] = { 1, 63, 64, 65, 1000, 4096 + 5, size / 2 + 17, size };
+	const size_t nts[] = { 0, SIZE_MAX };
+	for (size_t t=0; t < sizeof(nts) / sizeof(nts[0]); t++) {
+		well_copy_set_nt_min(nts[t]);
+		for (size_t l=0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+			size_t len = lens[l];
+			if (len > size)
+				continue;
+			/* start of the buffer, and straddling its end */
+			size_t starts[] = { 0, well_blk_count(&w) - 1, well_blk_count(&w) * 3 - 2 };
+			for (size_t s=0; s < 3; s++) {
+				for (size_t mis=0; mis < 4; mis += 3) {
+					size_t pos = starts[s];
+					fill(src + mis, len, len + pos);
+					memset(dst, 0, size + 64);
+					well_copy_in(&w, pos, src + mis, len);
+					well_copy_out(&w, pos, dst + mis, len);
+					Z_err_if(memcmp(src + mis, dst + mis, len),
+						"blk %zu len %zu pos %zu mis %zu nt %zu",
+						blk_size, len, pos, mis, nts[t]);
+
+					/* and where well_access() says it is */
+					size_t i = len - 1;
+					unsigned char *last = well_access(pos, i / blk_size, &w);
+					Z_err_if(last[i % blk_size] != src[mis + i],
+						"blk %zu len %zu pos %zu: last byte misplaced",
+						blk_size, len, pos);
+				}
+			}
+		}
+	}
+
+out:
+	well_copy_set_nt_min(SIZE_MAX);
+	free(src);
+	free(dst);
+	if (well_mem(&w)) {
+		well_deinit(&w);
+		free(well_mem(&w));
+	}
+	return err_cnt;
+}
+
+
+/*	tx_thread()
+*/
+void *tx_thread(void *arg)
+{
+	size_t blk = well_blk_size(&buf);
+	unsigned char *src = malloc(blk);
+	for (size_t i=0; src && i < numiter; i++) {
+		size_t pos;
+		while (!well_reserve(&buf.tx, &pos, 1))
+			FAIL_DO();
+		well_prefetch_next(&buf, &buf.tx, blk, 1);
+		fill(src, blk, i);
+		well_copy_in(&buf, pos, src, blk);
+		well_release_single(&buf.rx, 1);
+	}
+	free(src);
+	return NULL;
+}
+
+
+/*	rx_thread()
+returns number of wrong blocks
+*/
+void *rx_thread(void *arg)
+{
+	size_t blk = well_blk_size(&buf);
+	size_t errs = 0;
+	unsigned char *dst = malloc(blk), *want = malloc(blk);
+	for (size_t i=0; dst && want && i < numiter; i++) {
+		size_t pos;
+		while (!well_reserve(&buf.rx, &pos, 1))
+			FAIL_DO();
+		well_prefetch_next(&buf, &buf.rx, blk, 0);
+		well_copy_out(&buf, pos, dst, blk);
+		well_release_single(&buf.tx, 1);
+		fill(want, blk, i);
+		if (memcmp(dst, want, blk))
+			errs++;
+	}
+	if (!dst || !want)
+		errs = numiter;
+	free(dst);
+	free(want);
+	return (void *)errs;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx, rx;
+	int started = 0;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+	Z_log(Z_inf, "copy kernel: %s", well_copy_isa());
+
+	Z_die_if(check_sizes(64, 64), "");
+	Z_die_if(check_sizes(4096, 16), "");
+	Z_die_if(check_sizes(65536, 4), "");
+
+	/* every copy streamed */
+	well_copy_set_nt_min(0);
+	Z_die_if(well_params(4096, 8, &buf), "");
+	Z_die_if(well_init(&buf, malloc(well_size(&buf))), "");
+	Z_die_if(pthread_create(&rx, NULL, rx_thread, NULL), "");
+	started++;
+	Z_die_if(pthread_create(&tx, NULL, tx_thread, NULL), "");
+	started++;
+
+out:
+	if (started > 1)
+		pthread_join(tx, NULL);
+	if (started) {
+		void *errs;
+		pthread_join(rx, &errs);
+		Z_err_if((size_t)errs, "%zu blocks wrong", (size_t)errs);
+	}
+	if (well_mem(&buf)) {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	}
+	return err_cnt;
+}
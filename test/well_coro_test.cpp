@@ -0,0 +1,203 @@
+/*	well_coro_test.cpp
+
+Coroutine producers and consumers on a tiny well (8 blocks),
+	so that both sides run full and empty and every coroutine
+	keeps suspending, on reserve as well as on ordered release:
+	- all on one single-threaded loop;
+	- spread over a multi-threaded pool (-w threads);
+	- a plain thread producing for a coroutine consumer.
+Every value must arrive exactly once.
+*/
+
+extern "C" {
+#include <zed_dbg.h>
+}
+#include <well_coro.hpp>
+
+#include <stdlib.h>
+#include <getopt.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+static size_t numiter = 120000;	/* per producer: a multiple of 12 */
+static size_t pool_threads = 4;
+
+
+/*	state
+One run: 'prod_cnt * numiter' values through 'buf'.
+*/
+struct state {
+	struct well			buf {};	/* well_params() expects zeroes */
+	well_coro::channel		*ch = nullptr;
+	size_t				prod_cnt;
+	std::vector<std::atomic<unsigned char>>	seen;
+	std::atomic<size_t>		errs{0};
+
+	explicit state(size_t producers)
+		: prod_cnt(producers), seen(producers * numiter + 1) {}
+};
+
+
+/*	producer()
+Sends 'p * numiter + i + 1' for i in [0, numiter), a few at a time.
+*/
+well_coro::task producer(state &s, size_t p)
+{
+	for (size_t i=0; i < numiter; ) {
+		size_t ask = numiter - i < 3 ? numiter - i : 3;
+		well_coro::reservation r = co_await s.ch->tx.reserve(ask);
+		for (size_t j=0; j < r.count; j++)
+			WELL_DEREF(size_t, r.pos, j, &s.buf) = p * numiter + i + j + 1;
+		i += r.count;
+		co_await s.ch->rx.release(r);
+	}
+}
+
+
+/*	consumer()
+Takes exactly 'quota' values.
+*/
+well_coro::task consumer(state &s, size_t quota)
+{
+	while (quota) {
+		well_coro::reservation r = co_await s.ch->rx.reserve(quota < 4 ? quota : 4);
+		for (size_t j=0; j < r.count; j++) {
+			size_t val = WELL_DEREF(size_t, r.pos, j, &s.buf);
+			if (!val || val >= s.seen.size() || s.seen[val]++)
+				s.errs++;
+		}
+		quota -= r.count;
+		co_await s.ch->tx.release(r);
+	}
+}
+
+
+/*	check()
+returns number of errors
+*/
+static int check(state &s, const char *what)
+{
+	int err_cnt = s.errs;
+	for (size_t v=1; v < s.seen.size(); v++) {
+		if (s.seen[v] != 1)
+			err_cnt++;
+	}
+	if (err_cnt)
+		Z_log(Z_err, "%s: %d values bad, missing or repeated", what, err_cnt);
+	return err_cnt;
+}
+
+
+/*	run()
+'prod' producers and 'cons' consumers: on 'pool' if given, else on a loop.
+returns number of errors
+*/
+static int run(size_t prod, size_t cons, well_coro::pool *pool, const char *what)
+{
+	int err_cnt = 0;
+	state s(prod);
+	well_coro::loop loop;
+	well_coro::executor &ex = pool ? static_cast<well_coro::executor &>(*pool) : loop;
+
+	Z_die_if(well_params(sizeof(size_t), 8, &s.buf), "");
+	Z_die_if(well_init(&s.buf, malloc(well_size(&s.buf))), "");
+	s.ch = new well_coro::channel(&s.buf);
+
+	for (size_t p=0; p < prod; p++)
+		well_coro::spawn(ex, producer(s, p));
+	for (size_t c=0; c < cons; c++)
+		well_coro::spawn(ex, consumer(s, prod * numiter / cons));
+	if (pool)
+		pool->join();
+	else
+		loop.run();
+	err_cnt += check(s, what);
+
+out:
+	delete s.ch;
+	if (well_mem(&s.buf)) {
+		well_deinit(&s.buf);
+		free(well_mem(&s.buf));
+	}
+	return err_cnt;
+}
+
+
+/*	run_thread()
+A plain thread produces; one coroutine on a loop consumes.
+returns number of errors
+*/
+static int run_thread()
+{
+	int err_cnt = 0;
+	state s(1);
+	well_coro::loop loop;
+
+	Z_die_if(well_params(sizeof(size_t), 8, &s.buf), "");
+	Z_die_if(well_init(&s.buf, malloc(well_size(&s.buf))), "");
+	s.ch = new well_coro::channel(&s.buf);
+
+	well_coro::spawn(loop, consumer(s, numiter));
+	{
+		std::thread tx([&s]() {
+			for (size_t i=0; i < numiter; ) {
+				size_t pos, res;
+				if (!(res = well_reserve(&s.buf.tx, &pos, 4))) {
+					std::this_thread::yield();
+					continue;
+				}
+				for (size_t j=0; j < res; j++)
+					WELL_DEREF(size_t, pos, j, &s.buf) = i + j + 1;
+				i += res;
+				/* the only producer */
+				s.ch->rx.release_single(res);
+			}
+		});
+		loop.run();
+		tx.join();
+	}
+	err_cnt += check(s, "plain thread to coroutine");
+
+out:
+	delete s.ch;
+	if (well_mem(&s.buf)) {
+		well_deinit(&s.buf);
+		free(well_mem(&s.buf));
+	}
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	well_coro::pool pool;
+
+	while ((opt = getopt(argc, argv, "n:w:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1 || numiter % 12, "-n: multiple of 12");
+			break;
+		case 'w':
+			Z_die_if(sscanf(optarg, "%zu", &pool_threads) != 1 || !pool_threads, "-w");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	err_cnt += run(3, 2, NULL, "loop 3->2");
+	err_cnt += run(1, 1, NULL, "loop 1->1");
+	Z_die_if(pool.init(pool_threads), "");
+	err_cnt += run(4, 3, &pool, "pool 4->3");
+	err_cnt += run(2, 4, &pool, "pool 2->4");
+	err_cnt += run_thread();
+
+out:
+	return err_cnt;
+}
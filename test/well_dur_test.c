@@ -0,0 +1,233 @@
+/*	well_dur_test.c
+
+A durable well must come back from a crash with exactly what was committed:
+	- committed blocks not yet consumed are read again, in order
+	- blocks written or consumed after the last commit are as if never so
+Then a child process produces and consumes under a flusher
+	until it is killed; every block recovered must hold its own position.
+*/
+
+#include <well_dur.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+
+static size_t tx_thread_cnt = 2;
+static size_t rx_thread_cnt = 2;
+static long interval_us = 100;
+static size_t kill_ms = 50;
+
+static struct well_dur dw;
+
+
+/*	crash()
+Drop the well without committing, as a killed process would.
+*/
+static void crash(struct well_dur *d)
+{
+	well_dur_stop(d);
+	well_pipe_deinit(&d->pipe);
+	munmap(d->hdr, d->map_size);
+}
+
+
+/*	put()
+Write values 'pos+1' into up to 'count' blocks; single producer.
+*/
+static size_t put(size_t count)
+{
+	size_t pos, res = well_dur_reserve(&dw, &pos, count);
+	for (size_t j=0; j < res; j++)
+		WELL_DEREF(size_t, pos, j, well_dur_well(&dw)) = pos + j + 1;
+	well_dur_submit(&dw, res);
+	return res;
+}
+
+
+/*	get()
+Consume up to 'count' blocks; single consumer.
+
+returns number of blocks whose value is not 'pos+1'
+*/
+static size_t get(size_t count, size_t *out_first, size_t *out_res)
+{
+	size_t pos, errs = 0;
+	size_t res = well_dur_read(&dw, &pos, count);
+	for (size_t j=0; j < res; j++) {
+		if (WELL_DEREF(size_t, pos, j, well_dur_well(&dw)) != pos + j + 1)
+			errs++;
+	}
+	if (out_first)
+		*out_first = res ? WELL_DEREF(size_t, pos, 0, well_dur_well(&dw)) : 0;
+	well_dur_done(&dw, res);
+	*out_res = res;
+	return errs;
+}
+
+
+/*	tx_thread()
+*/
+void *tx_thread(void *arg)
+{
+	while (1) {
+		size_t pos, res;
+		while (!(res = well_dur_reserve(&dw, &pos, 16)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, well_dur_well(&dw)) = pos + j + 1;
+		if (tx_thread_cnt == 1) {
+			well_dur_submit(&dw, res);
+		} else {
+			while (!well_dur_submit_multi(&dw, res, pos))
+				FAIL_DO();
+		}
+	}
+	return NULL;
+}
+
+
+/*	rx_thread()
+Exits the process on a bad value: the parent sees it.
+*/
+void *rx_thread(void *arg)
+{
+	while (1) {
+		size_t pos, res;
+		while (!(res = well_dur_read(&dw, &pos, 16)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++) {
+			if (WELL_DEREF(size_t, pos, j, well_dur_well(&dw)) != pos + j + 1)
+				_exit(1);
+		}
+		if (rx_thread_cnt == 1) {
+			well_dur_done(&dw, res);
+		} else {
+			while (!well_dur_done_multi(&dw, res, pos))
+				FAIL_DO();
+		}
+	}
+	return NULL;
+}
+
+
+/*	child()
+Produce and consume until killed.
+*/
+static void child(int fd)
+{
+	pthread_t t;
+	if (well_dur_open(&dw, fd, 0, 0) || well_dur_start(&dw, interval_us))
+		_exit(1);
+	for (size_t i=0; i < rx_thread_cnt; i++)
+		pthread_create(&t, NULL, rx_thread, NULL);
+	for (size_t i=0; i < tx_thread_cnt; i++)
+		pthread_create(&t, NULL, tx_thread, NULL);
+	while (1)
+		pause();
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	int fd = -1, open = 0;
+	char path[] = "well_dur_test.XXXXXX";
+
+	while ((opt = getopt(argc, argv, "t:x:i:k:")) != -1) {
+		switch (opt) {
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &tx_thread_cnt) != 1 || !tx_thread_cnt, "-t");
+			break;
+		case 'x':
+			Z_die_if(sscanf(optarg, "%zu", &rx_thread_cnt) != 1 || !rx_thread_cnt, "-x");
+			break;
+		case 'i':
+			Z_die_if(sscanf(optarg, "%ld", &interval_us) != 1 || interval_us < 0, "-i");
+			break;
+		case 'k':
+			Z_die_if(sscanf(optarg, "%zu", &kill_ms) != 1, "-k");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if((fd = mkstemp(path)) == -1, "");
+	unlink(path);
+
+	/* commit 100, consume and commit 30; consume 10 and write 20 more, uncommitted */
+	Z_die_if(well_dur_open(&dw, fd, sizeof(size_t), 256), "");
+	open = 1;
+	size_t first, res;
+	Z_err_if(put(100) != 100, "");
+	Z_err_if(well_dur_read(&dw, &first, 1), "uncommitted block readable");
+	Z_err_if(well_dur_commit(&dw) != 100, "");
+	Z_err_if(get(30, &first, &res) || res != 30 || first != 1, "");
+	Z_err_if(well_dur_commit(&dw) != 30, "");
+	Z_err_if(get(10, &first, &res) || res != 10 || first != 31, "");
+	Z_err_if(put(20) != 20, "");
+	crash(&dw);
+	open = 0;
+
+	/* exactly 31..100 come back */
+	Z_die_if(well_dur_open(&dw, fd, sizeof(size_t), 256), "");
+	open = 1;
+	Z_err_if(get(1000, &first, &res) || res != 70 || first != 31,
+		"recovered %zu from %zu; expected 70 from 31", res, first);
+	Z_err_if(well_dur_read(&dw, &first, 1), "");
+	/* consumed slots are only free again once committed */
+	Z_err_if(well_dur_commit(&dw) != 70, "");
+	Z_err_if(put(200) != 200, "");
+	Z_err_if(well_dur_commit(&dw) != 200, "");
+	Z_err_if(get(1000, &first, &res) || res != 200 || first != 101,
+		"read %zu from %zu; expected 200 from 101", res, first);
+	well_dur_close(&dw);
+	open = 0;
+
+	/* kill a busy child at some point; twice, from where it was left */
+	Z_die_if(ftruncate(fd, 0), "");
+	Z_die_if(well_dur_open(&dw, fd, sizeof(size_t), 1024), "");
+	well_dur_close(&dw);
+	for (int round=0; round < 2; round++) {
+		pid_t pid;
+		Z_die_if((pid = fork()) < 0, "");
+		if (!pid)
+			child(fd);
+		usleep(kill_ms * 1000);
+		kill(pid, SIGKILL);
+		int status;
+		waitpid(pid, &status, 0);
+		Z_err_if(!WIFSIGNALED(status), "child failed: status %d", status);
+
+		Z_die_if(well_dur_open(&dw, fd, 0, 0), "");
+		open = 1;
+		Z_err_if(!dw.tail, "nothing committed in %zums", kill_ms);
+		size_t errs = 0, total = 0;
+		do {
+			errs += get(1000, &first, &res);
+			total += res;
+		} while (res);
+		Z_err_if(errs, "round %d: %zu of %zu recovered blocks wrong", round, errs, total);
+		Z_log(Z_inf, "round %d: %zu commits; recovered %zu", round, (size_t)dw.seq, total);
+		well_dur_close(&dw);
+		open = 0;
+	}
+
+out:
+	if (open)
+		well_dur_close(&dw);
+	if (fd != -1)
+		close(fd);
+	return err_cnt;
+}
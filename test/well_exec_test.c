@@ -0,0 +1,135 @@
+/*	well_exec_test.c
+
+Submitter threads push tasks into a work-stealing executor;
+	with -f each of those tasks submits more from inside the pool
+	(landing in its own worker's lane, for the others to steal).
+Once the executor is stopped, every task must have run exactly once.
+Tiny lanes (-c) force submitters onto other lanes and tasks to run
+	children inline when the pool is full.
+*/
+
+#include <well_exec.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+static size_t numiter = 100000;	/* tasks submitted from outside, in all */
+static size_t thread_cnt = 4;	/* workers */
+static size_t tx_thread_cnt = 2;	/* submitters */
+static size_t fanout = 0;	/* tasks each of those submits in turn */
+static size_t lane_tasks = 256;
+static size_t batch = 16;
+
+static struct well_exec ex;
+static size_t *ran = NULL;	/* times each task ran */
+static size_t inline_cnt = 0;	/* children run inline: pool full */
+
+
+/*	task()
+'arg' is the task number: [0, numiter) are roots,
+	child 'j' of root 'i' is 'numiter + i * fanout + j'.
+*/
+void task(void *arg)
+{
+	size_t id = (size_t)arg;
+	__atomic_add_fetch(&ran[id], 1, __ATOMIC_RELAXED);
+	if (id >= numiter)
+		return;
+	for (size_t j=0; j < fanout; j++) {
+		void *child = (void *)(numiter + id * fanout + j);
+		if (well_exec_submit(&ex, task, child)) {
+			__atomic_add_fetch(&inline_cnt, 1, __ATOMIC_RELAXED);
+			task(child);
+		}
+	}
+}
+
+
+/*	tx_thread()
+Submits roots 'p', 'p + tx_thread_cnt', ...
+*/
+void *tx_thread(void *arg)
+{
+	for (size_t i=(size_t)arg; i < numiter; i += tx_thread_cnt) {
+		while (well_exec_submit(&ex, task, (void *)i))
+			FAIL_DO();
+	}
+	return NULL;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx[64];
+	size_t tx_started = 0;
+	int ex_inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:t:x:f:c:b:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &thread_cnt) != 1 || !thread_cnt, "-t");
+			break;
+		case 'x':
+			Z_die_if(sscanf(optarg, "%zu", &tx_thread_cnt) != 1
+				|| !tx_thread_cnt || tx_thread_cnt > 64, "-x");
+			break;
+		case 'f':
+			Z_die_if(sscanf(optarg, "%zu", &fanout) != 1, "-f");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &lane_tasks) != 1, "-c");
+			break;
+		case 'b':
+			Z_die_if(sscanf(optarg, "%zu", &batch) != 1, "-b");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	size_t total = numiter * (1 + fanout);
+	Z_die_if(!(ran = calloc(total, sizeof(size_t))), "");
+	Z_die_if(well_exec_init(&ex, thread_cnt, lane_tasks, batch), "");
+	ex_inited = 1;
+
+	for (; tx_started < tx_thread_cnt; tx_started++)
+		Z_die_if(pthread_create(&tx[tx_started], NULL, tx_thread, (void *)tx_started), "");
+
+out:
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	if (ex_inited) {
+		size_t stolen = 0, parked = 0;
+		for (size_t i=0; i < ex.lane_cnt; i++) {
+			stolen += __atomic_load_n(&ex.lanes[i].stolen, __ATOMIC_RELAXED);
+			parked += __atomic_load_n(&ex.lanes[i].parked, __ATOMIC_RELAXED);
+		}
+		/* runs everything still queued */
+		well_exec_deinit(&ex);
+		Z_log(Z_inf, "tasks %zu; stolen at least %zu; parked %zu; inline %zu",
+			total, stolen, parked, inline_cnt);
+	}
+
+	if (!err_cnt) {
+		for (size_t i=0; i < total; i++) {
+			if (ran[i] != 1) {
+				Z_log(Z_err, "task %zu ran %zu times", i, ran[i]);
+				err_cnt++;
+				break;
+			}
+		}
+	}
+	free(ran);
+	return err_cnt;
+}
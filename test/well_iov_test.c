@@ -0,0 +1,155 @@
+/*	well_iov_test.c
+
+Verify iovec export of reservations and the readv/writev helpers.
+*/
+
+#include <well_iov.h>
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+
+/*	test_iov()
+A reservation is one segment unless it wraps.
+*/
+int test_iov(struct well *buf)
+{
+	int err_cnt = 0;
+	struct iovec iov[2] = { {0} };
+	size_t blk_size = well_blk_size(buf);
+	size_t blk_count = well_blk_count(buf);
+	void *mem = well_mem(buf);
+	int ret;
+
+	ret = well_iov(buf, 3, 0, iov);
+	Z_err_if(ret != 0, "empty reservation gave %d segments", ret);
+
+	/* fits: one segment */
+	ret = well_iov(buf, 3, blk_count - 3, iov);
+	Z_err_if(ret != 1, "%d segments", ret);
+	Z_err_if(iov[0].iov_base != mem + 3 * blk_size, "");
+	Z_err_if(iov[0].iov_len != (blk_count - 3) * blk_size, "");
+
+	/* wraps: two segments; also test 'pos' well past buffer size */
+	size_t pos = blk_count * 5 + blk_count - 2;
+	ret = well_iov(buf, pos, 5, iov);
+	Z_err_if(ret != 2, "%d segments", ret);
+	Z_err_if(iov[0].iov_base != mem + (blk_count - 2) * blk_size, "");
+	Z_err_if(iov[0].iov_len != 2 * blk_size, "len %zu", iov[0].iov_len);
+	Z_err_if(iov[1].iov_base != mem, "");
+	Z_err_if(iov[1].iov_len != 3 * blk_size, "len %zu", iov[1].iov_len);
+
+	/* segments must agree with well_access() */
+	for (size_t i=0; i < 5; i++) {
+		void *expect = i < 2
+			? iov[0].iov_base + i * blk_size
+			: iov[1].iov_base + (i - 2) * blk_size;
+		Z_err_if(well_access(pos, i, buf) != expect, "block %zu", i);
+	}
+
+	return err_cnt;
+}
+
+
+/*	test_pipe()
+Blocks written out of 'src' with writev arrive intact in 'dst' with readv,
+	including across the wrap and with a short final block.
+*/
+int test_pipe(struct well *src, struct well *dst)
+{
+	int err_cnt = 0;
+	int fds[2] = { -1, -1 };
+	Z_die_if(pipe(fds), "");
+	size_t blk_count = well_blk_count(src);
+	size_t blk_size = well_blk_size(src);
+	size_t pos, res;
+	ssize_t ret;
+
+	/* move both wells so the next reservation wraps */
+	for (struct well *w = src; w; w = (w == src ? dst : NULL)) {
+		Z_die_if(well_reserve(&w->tx, &pos, blk_count - 2) != blk_count - 2, "");
+		well_release_single(&w->rx, blk_count - 2);
+		Z_die_if(well_reserve(&w->rx, &pos, blk_count - 2) != blk_count - 2, "");
+		well_release_single(&w->tx, blk_count - 2);
+	}
+
+	/* fill src */
+	Z_die_if((res = well_reserve(&src->tx, &pos, 6)) != 6, "");
+	for (size_t i=0; i < res; i++)
+		memset(well_access(pos, i, src), 'a' + i, blk_size);
+	well_release_single(&src->rx, res);
+
+	/* out: one syscall for 6 blocks in 2 segments */
+	ret = well_writev_from(src, fds[1], 6);
+	Z_die_if(ret != 6, "writev_from returned %zd", ret);
+	Z_err_if(src->rx.avail, "rx should be drained");
+
+	/* nothing left: EAGAIN */
+	ret = well_writev_from(src, fds[1], 6);
+	Z_err_if(ret != -1 || errno != EAGAIN, "ret %zd errno %d", ret, errno);
+
+	/* half a block more, then EOF */
+	Z_die_if(write(fds[1], "zz", 2) != 2, "");
+	close(fds[1]);
+	fds[1] = -1;
+
+	/* in: everything in one go, final block padded */
+	ret = well_readv_into(dst, fds[0], 16);
+	Z_die_if(ret != 7, "readv_into returned %zd", ret);
+	Z_die_if((res = well_reserve(&dst->rx, &pos, 16)) != 7, "");
+	for (size_t i=0; i < 6; i++) {
+		char *blk = well_access(pos, i, dst);
+		Z_err_if(blk[0] != 'a' + (char)i || blk[blk_size-1] != 'a' + (char)i,
+			"block %zu corrupt", i);
+	}
+	char *last = well_access(pos, 6, dst);
+	Z_err_if(last[0] != 'z' || last[1] != 'z' || last[2] || last[blk_size-1],
+		"short block not padded");
+	well_release_single(&dst->tx, res);
+
+	/* unused blocks were given back */
+	Z_err_if(dst->tx.avail != blk_count, "tx avail %zu", dst->tx.avail);
+
+	/* EOF */
+	ret = well_readv_into(dst, fds[0], 16);
+	Z_err_if(ret != 0, "EOF returned %zd", ret);
+	Z_err_if(dst->tx.avail != blk_count, "tx avail %zu", dst->tx.avail);
+
+out:
+	if (fds[0] != -1)
+		close(fds[0]);
+	if (fds[1] != -1)
+		close(fds[1]);
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+	struct well src = { {0} };
+	struct well dst = { {0} };
+
+	Z_die_if(well_params(64, 16, &src), "");
+	Z_die_if(well_params(64, 16, &dst), "");
+	Z_die_if(
+		well_init(&src, malloc(well_size(&src)))
+		, "size %zu", well_size(&src));
+	Z_die_if(
+		well_init(&dst, malloc(well_size(&dst)))
+		, "size %zu", well_size(&dst));
+
+	err_cnt += test_iov(&src);
+	err_cnt += test_pipe(&src, &dst);
+
+out:
+	well_deinit(&src);
+	free(well_mem(&src));
+	well_deinit(&dst);
+	free(well_mem(&dst));
+	return err_cnt;
+}
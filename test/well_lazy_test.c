@@ -0,0 +1,153 @@
+/*	well_lazy_test.c
+
+A lazily committed well only costs the pages it has touched,
+	gives them back when trimmed while empty, and refuses to trim otherwise.
+Then: a producer and consumer pass bursts through it while the helper
+	trims between bursts; every value must arrive intact and in order.
+*/
+
+#include <well_lazy.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <unistd.h> /* usleep() */
+
+
+static size_t numiter = 200000;
+static size_t burst = 5000;
+static size_t blk_cnt = 16384;
+
+static struct well buf;
+
+
+/*	tx_thread()
+Values written are 'i+1'; pauses after each burst so the helper can trim.
+*/
+void *tx_thread(void *arg)
+{
+	for (size_t i=0, res=0; i < numiter; i += res) {
+		size_t pos;
+		size_t want = burst - i % burst;
+		if (want > numiter - i)
+			want = numiter - i;
+		while (!(res = well_reserve(&buf.tx, &pos, want)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, &buf) = i + j + 1;
+		well_release_single(&buf.rx, res);
+		if (!((i + res) % burst))
+			usleep(5000);
+	}
+	return NULL;
+}
+
+
+/*	rx_thread()
+returns number of errors
+*/
+void *rx_thread(void *arg)
+{
+	size_t errs = 0;
+	for (size_t i=0, res=0; i < numiter; i += res) {
+		size_t pos;
+		while (!(res = well_reserve(&buf.rx, &pos, 64)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++) {
+			if (WELL_DEREF(size_t, pos, j, &buf) != i + j + 1)
+				errs++;
+		}
+		well_release_single(&buf.tx, res);
+	}
+	return (void *)errs;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	struct well_lazy lz = { 0 };
+	pthread_t tx, rx;
+	int started = 0;
+
+	while ((opt = getopt(argc, argv, "n:b:c:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 'b':
+			Z_die_if(sscanf(optarg, "%zu", &burst) != 1 || !burst, "-b");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &blk_cnt) != 1, "-c");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	size_t page = sysconf(_SC_PAGESIZE);
+	Z_die_if(well_params(page, blk_cnt, &buf), "");
+	Z_die_if(well_lazy_init(&buf), "");
+
+	/* nothing touched: nothing committed */
+	Z_err_if(well_lazy_resident(&buf), "resident %zu before use", well_lazy_resident(&buf));
+
+	/* touch 100 blocks */
+	size_t pos;
+	Z_die_if(well_reserve(&buf.tx, &pos, 100) != 100, "");
+	for (size_t j=0; j < 100; j++)
+		WELL_DEREF(size_t, pos, j, &buf) = j;
+	Z_err_if(well_lazy_resident(&buf) != 100 * page,
+		"resident %zu != %zu", well_lazy_resident(&buf), 100 * page);
+
+	/* not empty: must not trim */
+	well_release_single(&buf.rx, 100);
+	Z_err_if(well_lazy_trim(&buf, 0, 0), "trimmed a non-empty well");
+	Z_err_if(well_lazy_resident(&buf) != 100 * page, "");
+
+	/* empty: keep 10 blocks ahead of 'tx', release the rest */
+	Z_die_if(well_reserve(&buf.rx, &pos, 100) != 100, "");
+	well_release_single(&buf.tx, 100);
+	Z_err_if(!well_lazy_trim(&buf, 10, 0), "empty well not trimmed");
+	Z_err_if(well_lazy_resident(&buf), "resident %zu after trim", well_lazy_resident(&buf));
+	Z_err_if(buf.tx.avail != blk_cnt || buf.tx.pos != 100, "tx not given back intact");
+
+	/* 'keep' covering the whole well releases nothing */
+	Z_die_if(well_reserve(&buf.tx, &pos, 10) != 10, "");
+	for (size_t j=0; j < 10; j++)
+		WELL_DEREF(size_t, pos, j, &buf) = j;
+	well_release_single(&buf.rx, 10);
+	Z_die_if(well_reserve(&buf.rx, &pos, 10) != 10, "");
+	well_release_single(&buf.tx, 10);
+	Z_err_if(well_lazy_trim(&buf, blk_cnt, 0), "released pages it should keep");
+	Z_err_if(well_lazy_resident(&buf) != 10 * page, "");
+	Z_err_if(!well_lazy_trim(&buf, 0, 0) || well_lazy_resident(&buf), "");
+
+	/* bursts, with the helper trimming between them */
+	Z_die_if(well_lazy_start(&lz, &buf, 1, 0, 0), "");
+	Z_die_if(pthread_create(&rx, NULL, rx_thread, NULL), "");
+	started++;
+	Z_die_if(pthread_create(&tx, NULL, tx_thread, NULL), "");
+	started++;
+
+out:
+	if (started > 1)
+		pthread_join(tx, NULL);
+	if (started) {
+		void *errs;
+		pthread_join(rx, &errs);
+		Z_err_if((size_t)errs, "%zu values wrong", (size_t)errs);
+		err_cnt += (size_t)errs;
+	}
+	well_lazy_stop(&lz);
+	if (started)
+		Z_log(Z_inf, "helper: %zu trims; %zu MiB released", lz.trims, lz.released >> 20);
+	well_lazy_deinit(&buf);
+	return err_cnt;
+}
@@ -0,0 +1,244 @@
+/*	well_lease_test.c
+
+Producers on a multi-release side, under a watchdog ticking every millisecond:
+	- one dies holding a reservation, after writing part of it;
+	- one hangs for a while holding a reservation, then finds it revoked
+		and sends its values again;
+	- with -r, one more dies between well_reserve() and recording a lease.
+Every other block must still reach the consumer, within the time limit:
+	each value sent exactly once, revoked blocks poisoned.
+*/
+
+#include <well_lease.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h> /* usleep() */
+
+
+#define POISON		SIZE_MAX
+#define TTL		50	/* ticks: a preempted thread must not look dead */
+#define TIME_LIMIT	20	/* seconds */
+#define DEAD		0	/* producer which dies */
+#define HUNG		1	/* producer which hangs */
+
+static size_t numiter = 100000;	/* per producer */
+static size_t tx_thread_cnt = 4;
+static int raw_death = 0;
+
+static struct well buf;
+static struct well_leases ls;
+static size_t *sent = NULL;	/* values published, per producer */
+static size_t producing = 0;
+static int stop = 0;
+static size_t poisoned = 0;
+static size_t revokes_seen = 0;	/* by owners which were alive */
+
+
+/*	poison()
+*/
+static void poison(struct well *b, size_t pos, size_t count, void *ctx)
+{
+	for (size_t i=0; i < count; i++)
+		WELL_DEREF(size_t, pos, i, b) = POISON;
+}
+
+
+/*	tx_thread()
+Producer 'p' sends 'p * numiter + i + 1' for i in [0, numiter).
+*/
+void *tx_thread(void *arg)
+{
+	size_t p = (size_t)arg;
+	int hung = 0;
+	struct well_lease *me = well_lease_join(&ls);
+	if (!me)
+		goto out;
+
+	for (size_t i=0, res=0; i < numiter; ) {
+		size_t pos;
+		size_t ask = numiter - i < 4 ? numiter - i : 4;
+
+		if (p == DEAD + 2 && raw_death && i >= numiter / 3) {
+			/* dies before its lease records anything */
+			while (!well_reserve(&buf.tx, &pos, ask))
+				FAIL_DO();
+			goto out;
+		}
+
+		while (!(res = well_lease_reserve(&ls, me, &pos, ask)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++) {
+			if (p == DEAD && i == numiter / 2 && j == res / 2)
+				goto out; /* dies half way through writing */
+			WELL_DEREF(size_t, pos, j, &buf) = p * numiter + i + j + 1;
+		}
+		if (p == HUNG && i == numiter / 2 && !hung++)
+			usleep(500 * 1000); /* 10 TTLs */
+
+		size_t ret;
+		while (!(ret = well_lease_release(&ls, me)))
+			FAIL_DO();
+		if (ret == WELL_LEASE_REVOKED) {
+			__atomic_add_fetch(&revokes_seen, 1, __ATOMIC_RELAXED);
+			continue; /* send them again */
+		}
+		i += res;
+		__atomic_store_n(&sent[p], i, __ATOMIC_RELEASE);
+	}
+
+out:
+	__atomic_sub_fetch(&producing, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+
+/*	rx_thread()
+Single consumer: counts every value.
+returns number of errors
+*/
+void *rx_thread(void *arg)
+{
+	unsigned char *seen = calloc(tx_thread_cnt * numiter + 1, 1);
+	size_t errs = 0, got = 0;
+	time_t start = time(NULL);
+	if (!seen)
+		return (void *)1;
+
+	for (;;) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, 16))) {
+			if (!__atomic_load_n(&producing, __ATOMIC_ACQUIRE)) {
+				/* every producer gone and everything they sent is in */
+				size_t total = 0;
+				for (size_t p=0; p < tx_thread_cnt; p++)
+					total += __atomic_load_n(&sent[p], __ATOMIC_ACQUIRE);
+				if (got >= total)
+					break;
+			}
+			if (time(NULL) - start > TIME_LIMIT) {
+				Z_log(Z_err, "stalled: %zu values received", got);
+				errs++;
+				break;
+			}
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			size_t val = WELL_DEREF(size_t, pos, j, &buf);
+			if (val == POISON) {
+				__atomic_add_fetch(&poisoned, 1, __ATOMIC_RELAXED);
+				continue;
+			}
+			if (!val || val > tx_thread_cnt * numiter || seen[val]++) {
+				Z_log(Z_err, "value %zu bad or repeated", val);
+				errs++;
+				continue;
+			}
+			got++;
+		}
+		well_release_single(&buf.tx, res);
+	}
+
+	/* nothing published may be missing */
+	for (size_t p=0; p < tx_thread_cnt; p++) {
+		for (size_t i=0; i < sent[p]; i++) {
+			if (!seen[p * numiter + i + 1]) {
+				Z_log(Z_err, "producer %zu value %zu missing", p, i);
+				errs++;
+				break;
+			}
+		}
+	}
+	free(seen);
+	return (void *)errs;
+}
+
+
+/*	watchdog()
+*/
+void *watchdog(void *arg)
+{
+	while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+		well_lease_watch(&ls);
+		usleep(1000);
+	}
+	return NULL;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx[64], rx, wd;
+	size_t tx_started = 0;
+	int rx_started = 0, wd_started = 0;
+
+	while ((opt = getopt(argc, argv, "n:t:r")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &tx_thread_cnt) != 1
+				|| tx_thread_cnt < 3 || tx_thread_cnt > 64, "-t");
+			break;
+		case 'r':
+			raw_death = 1;
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_params(sizeof(size_t), 64, &buf), "");
+	Z_die_if(well_init(&buf, malloc(well_size(&buf))), "");
+	Z_die_if(well_leases_init(&ls, &buf, &buf.tx, &buf.rx, tx_thread_cnt, TTL), "");
+	well_leases_poison(&ls, poison, NULL);
+	Z_die_if(!(sent = calloc(tx_thread_cnt, sizeof(size_t))), "");
+
+	producing = tx_thread_cnt;
+	Z_die_if(pthread_create(&wd, NULL, watchdog, NULL), "");
+	wd_started = 1;
+	Z_die_if(pthread_create(&rx, NULL, rx_thread, NULL), "");
+	rx_started = 1;
+	for (; tx_started < tx_thread_cnt; tx_started++)
+		Z_die_if(pthread_create(&tx[tx_started], NULL, tx_thread, (void *)tx_started), "");
+
+out:
+	if (err_cnt)
+		__atomic_store_n(&producing, 0, __ATOMIC_RELEASE);
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	if (rx_started) {
+		void *errs;
+		pthread_join(rx, &errs);
+		err_cnt += (size_t)errs;
+	}
+	__atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+	if (wd_started)
+		pthread_join(wd, NULL);
+
+	if (!err_cnt) {
+		Z_log(Z_inf, "revoked %zu; owner saw %zu; poisoned blocks %zu",
+			ls.revoked, revokes_seen, poisoned);
+		Z_err_if(!revokes_seen, "hung producer never saw its revoke");
+		Z_err_if(ls.revoked < 2 + raw_death, "revoked %zu", ls.revoked);
+		Z_err_if(!poisoned, "no blocks poisoned");
+		Z_err_if(sent[HUNG] != numiter, "hung producer sent %zu", sent[HUNG]);
+	}
+	well_leases_deinit(&ls);
+	free(sent);
+	if (well_mem(&buf)) {
+		well_deinit(&buf);
+		free(well_mem(&buf));
+	}
+	return err_cnt;
+}
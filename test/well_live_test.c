@@ -0,0 +1,167 @@
+/*	well_live_test.c
+
+Producers and consumers run flat out while another thread resizes the well
+	over and over, between a few blocks and a few thousand.
+Every value must be read exactly once (checked by count and sum);
+	with a single producer and consumer, also in order.
+*/
+
+#include <well_live.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+static size_t numiter = 1000000;
+static size_t tx_thread_cnt = 2;
+static size_t rx_thread_cnt = 2;
+
+static struct well_live lw;
+static size_t consumed = 0;
+static size_t resizes = 0;
+static size_t errors = 0;
+static size_t missized = 0;	/* resizes not reported by well_live_blk_count() */
+
+
+/*	tx_thread()
+Values written are 'i+1' for i in [0, numiter), split across producers.
+*/
+void *tx_thread(void *arg)
+{
+	struct well_live_local *me = well_live_join(&lw);
+	if (!me)
+		return NULL;
+	size_t num = numiter / tx_thread_cnt;
+	size_t first = (size_t)arg * num;
+
+	for (size_t i=0, res=0; i < num; i += res) {
+		struct well *buf;
+		size_t pos;
+		while (!(res = well_live_write(&lw, me, &buf, &pos, num - i < 5 ? num - i : 5)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, buf) = first + i + j + 1;
+		while (!well_live_publish(me, buf, res, pos))
+			FAIL_DO();
+	}
+	return NULL;
+}
+
+
+/*	rx_thread()
+returns sum of values read
+*/
+void *rx_thread(void *arg)
+{
+	struct well_live_local *me = well_live_join(&lw);
+	if (!me)
+		return NULL;
+	size_t total = (numiter / tx_thread_cnt) * tx_thread_cnt;
+	size_t sum = 0, expect = 1;
+
+	while (__atomic_load_n(&consumed, __ATOMIC_RELAXED) < total) {
+		struct well *buf;
+		size_t pos, res;
+		if (!(res = well_live_read(&lw, me, &buf, &pos, 3))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			size_t val = WELL_DEREF(size_t, pos, j, buf);
+			if (tx_thread_cnt == 1 && rx_thread_cnt == 1 && val != expect++)
+				__atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+			sum += val;
+		}
+		while (!well_live_done(me, buf, res, pos))
+			FAIL_DO();
+		__atomic_add_fetch(&consumed, res, __ATOMIC_RELAXED);
+	}
+	return (void *)sum;
+}
+
+
+/*	resizer()
+*/
+void *resizer(void *arg)
+{
+	size_t total = (numiter / tx_thread_cnt) * tx_thread_cnt;
+	unsigned seed = 42;
+	while (__atomic_load_n(&consumed, __ATOMIC_RELAXED) < total) {
+		/* 4 to 4096 blocks */
+		size_t cnt = (size_t)1 << (2 + rand_r(&seed) % 11);
+		if (well_resize(&lw, cnt))
+			break;
+		resizes++;
+		/* the only resizer: nothing replaces it under us */
+		if (well_live_blk_count(&lw) != cnt)
+			missized++;
+	}
+	return NULL;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx[64], rx[64], rs;
+	size_t tx_started = 0, rx_started = 0;
+	int rs_started = 0, inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:t:x:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &tx_thread_cnt) != 1
+				|| !tx_thread_cnt || tx_thread_cnt > 64, "-t");
+			break;
+		case 'x':
+			Z_die_if(sscanf(optarg, "%zu", &rx_thread_cnt) != 1
+				|| !rx_thread_cnt || rx_thread_cnt > 64, "-x");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_live_init(&lw, sizeof(size_t), 64, tx_thread_cnt + rx_thread_cnt), "");
+	inited = 1;
+
+	for (; rx_started < rx_thread_cnt; rx_started++)
+		Z_die_if(pthread_create(&rx[rx_started], NULL, rx_thread, NULL), "");
+	for (; tx_started < tx_thread_cnt; tx_started++)
+		Z_die_if(pthread_create(&tx[tx_started], NULL, tx_thread, (void *)tx_started), "");
+	Z_die_if(pthread_create(&rs, NULL, resizer, NULL), "");
+	rs_started = 1;
+
+out:
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	size_t sum = 0;
+	while (rx_started) {
+		void *ret;
+		pthread_join(rx[--rx_started], &ret);
+		sum += (size_t)ret;
+	}
+	if (rs_started)
+		pthread_join(rs, NULL);
+
+	if (inited) {
+		size_t total = (numiter / tx_thread_cnt) * tx_thread_cnt;
+		Z_log(Z_inf, "%zu resizes", resizes);
+		Z_err_if(consumed != total, "consumed %zu != %zu", consumed, total);
+		Z_err_if(sum != total * (total + 1) / 2, "sum %zu != %zu", sum, total * (total + 1) / 2);
+		Z_err_if(errors, "%zu values out of order", errors);
+		Z_err_if(!resizes, "never resized");
+		Z_err_if(missized, "%zu resizes misreported", missized);
+		well_live_deinit(&lw);
+	}
+	return err_cnt;
+}
@@ -0,0 +1,239 @@
+/*	well_mag_test.c
+
+Test that data passed through per-thread magazines arrives complete and correct,
+	with magazines on both sides of the buffer.
+
+Producers write 'i+1' into each block: blocks padded by a flushing magazine
+	are zero and are skipped by consumers.
+*/
+
+#include <well_mag.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <nonlibc.h> /* timing */
+
+
+static size_t numiter = 1000000;
+static size_t blk_cnt = 1024;
+static size_t batch = 32;
+
+static size_t tx_thread_cnt = 4;
+static pthread_t *tx = NULL;
+static size_t rx_thread_cnt = 2;
+static pthread_t *rx = NULL;
+
+static size_t consumed = 0; /* real (non-pad) blocks seen by all consumers */
+static size_t waits = 0;
+
+
+/*	tx_thread()
+*/
+void *tx_thread(void* arg)
+{
+	struct well *buf = arg;
+	size_t tally = 0;
+	size_t num = numiter / tx_thread_cnt;
+
+	struct well_mag mag;
+	if (well_mag_init(&mag, buf, &buf->tx, &buf->rx, batch))
+		return NULL;
+
+	for (size_t i=0, res=0; i < num; i += res) {
+		size_t pos;
+		while (!(res = well_mag_reserve(&mag, &pos, num - i)))
+			FAIL_DO();
+
+		for (size_t j=0; j < res; j++)
+			tally += WELL_DEREF(size_t, pos, j, buf) = i + j + 1;
+		well_mag_release(&mag, res);
+	}
+	well_mag_deinit(&mag);
+
+	__atomic_fetch_add(&waits, wait_count, __ATOMIC_RELAXED);
+	return (void *)tally;
+}
+
+
+/*	rx_thread()
+*/
+void *rx_thread(void* arg)
+{
+	struct well *buf = arg;
+	size_t tally = 0;
+
+	struct well_mag mag;
+	if (well_mag_init(&mag, buf, &buf->rx, &buf->tx, batch))
+		return NULL;
+
+	while (__atomic_load_n(&consumed, __ATOMIC_RELAXED) < numiter) {
+		size_t pos, res;
+		if (!(res = well_mag_reserve(&mag, &pos, 4))) {
+			FAIL_DO();
+			continue;
+		}
+
+		size_t real = 0;
+		for (size_t j=0; j < res; j++) {
+			size_t temp = WELL_DEREF(size_t, pos, j, buf);
+			if (temp) {
+				tally += temp;
+				real++;
+			}
+		}
+		well_mag_release(&mag, res);
+		__atomic_fetch_add(&consumed, real, __ATOMIC_RELAXED);
+	}
+	well_mag_deinit(&mag);
+
+	__atomic_fetch_add(&waits, wait_count, __ATOMIC_RELAXED);
+	return (void *)tally;
+}
+
+
+/*	usage()
+*/
+void usage(const char *pgm_name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\
+Test MemoryWell per-thread magazines.\n\
+\n\
+Options:\n\
+-n, --numiter <iter>	:	Push <iter> blocks through the buffer.\n\
+-c, --count <blk_count>	:	How many blocks in the circular buffer.\n\
+-b, --batch <blocks>	:	How many blocks a magazine claims at once.\n\
+-t, --tx-threads	:	Number of TX threads.\n\
+-x, --rx-threads	:	Number of RX threads.\n\
+-h, --help		:	Print this message and exit.\n",
+		pgm_name);
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int opt = 0;
+	static struct option long_options[] = {
+		{ "numiter",	required_argument,	0,	'n'},
+		{ "count",	required_argument,	0,	'c'},
+		{ "batch",	required_argument,	0,	'b'},
+		{ "tx-threads",	required_argument,	0,	't'},
+		{ "rx-threads",	required_argument,	0,	'x'},
+		{ "help",	no_argument,		0,	'h'}
+	};
+
+	while ((opt = getopt_long(argc, argv, "n:c:b:t:x:h", long_options, NULL)) != -1) {
+		switch(opt)
+		{
+			case 'n':
+				opt = sscanf(optarg, "%zu", &numiter);
+				Z_die_if(opt != 1, "invalid numiter '%s'", optarg);
+				break;
+
+			case 'c':
+				opt = sscanf(optarg, "%zu", &blk_cnt);
+				Z_die_if(opt != 1, "invalid blk_cnt '%s'", optarg);
+				break;
+
+			case 'b':
+				opt = sscanf(optarg, "%zu", &batch);
+				Z_die_if(opt != 1, "invalid batch '%s'", optarg);
+				break;
+
+			case 't':
+				opt = sscanf(optarg, "%zu", &tx_thread_cnt);
+				Z_die_if(opt != 1, "invalid tx_thread_cnt '%s'", optarg);
+				break;
+
+			case 'x':
+				opt = sscanf(optarg, "%zu", &rx_thread_cnt);
+				Z_die_if(opt != 1, "invalid rx_thread_cnt '%s'", optarg);
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				goto out;
+
+			default:
+				usage(argv[0]);
+				Z_die("option '%c' invalid", opt);
+		}
+	}
+	Z_die_if(!tx_thread_cnt || !rx_thread_cnt, "need at least 1 thread per side");
+	Z_die_if(numiter != nm_next_mult64(numiter, tx_thread_cnt),
+		"numiter %zu doesn't evenly divide into %zu tx threads",
+		numiter, tx_thread_cnt);
+	Z_die_if(batch * tx_thread_cnt > blk_cnt,
+		"%zu tx magazines of %zu would starve a %zu-block buffer",
+		tx_thread_cnt, batch, blk_cnt);
+
+	/* do MANY less iterations if running under Valgrind! */
+	const static size_t valgrind_max = 100000;
+	if (getenv("VALGRIND") && numiter > valgrind_max)
+		numiter = nm_next_mult64(valgrind_max, tx_thread_cnt);
+
+
+	/* create buffer */
+	struct well buf = { {0} };
+	Z_die_if(
+		well_params(sizeof(size_t), blk_cnt, &buf)
+		, "");
+	Z_die_if(
+		well_init(&buf, malloc(well_size(&buf)))
+		, "size %zu", well_size(&buf));
+
+	Z_die_if(!(
+		tx = malloc(sizeof(pthread_t) * tx_thread_cnt)
+		), "");
+	Z_die_if(!(
+		rx = malloc(sizeof(pthread_t) * rx_thread_cnt)
+		), "");
+
+	nlc_timing_start(t);
+		for (size_t i=0; i < tx_thread_cnt; i++)
+			pthread_create(&tx[i], NULL, tx_thread, &buf);
+		for (size_t i=0; i < rx_thread_cnt; i++)
+			pthread_create(&rx[i], NULL, rx_thread, &buf);
+
+		size_t tx_i_sum = 0, rx_i_sum = 0;
+		for (size_t i=0; i < tx_thread_cnt; i++) {
+			void *tmp;
+			pthread_join(tx[i], &tmp);
+			tx_i_sum += (size_t)tmp;
+		}
+		for (size_t i=0; i < rx_thread_cnt; i++) {
+			void *tmp;
+			pthread_join(rx[i], &tmp);
+			rx_i_sum += (size_t)tmp;
+		}
+	nlc_timing_stop(t);
+
+	/* verify */
+	Z_die_if(consumed != numiter, "consumed %zu != numiter %zu", consumed, numiter);
+	Z_die_if(tx_i_sum != rx_i_sum, "%zu != %zu", tx_i_sum, rx_i_sum);
+	size_t num = numiter / tx_thread_cnt;
+	size_t verif_i_sum = (num + 1) * num / 2 * tx_thread_cnt;
+	Z_die_if(verif_i_sum != tx_i_sum, "%zu != %zu", verif_i_sum, tx_i_sum);
+
+	/* nothing may be left stranded in flight (rx may still hold pads) */
+	Z_die_if(buf.tx.avail + buf.rx.avail != well_blk_count(&buf),
+		"tx avail %zu + rx avail %zu; blk_count %zu",
+		buf.tx.avail, buf.rx.avail, well_blk_count(&buf));
+
+	printf("numiter %zu; blk_count %zu; batch %zu\n", numiter, blk_cnt, batch);
+	printf("TX threads %zu; RX threads %zu\n", tx_thread_cnt, rx_thread_cnt);
+	printf("waits: %zu\n", waits);
+	printf("cpu time %.4lfs; wall time %.4lfs\n",
+		nlc_timing_cpu(t), nlc_timing_wall(t));
+
+out:
+	well_deinit(&buf);
+	free(well_mem(&buf));
+	free(tx);
+	free(rx);
+	return err_cnt;
+}
@@ -0,0 +1,186 @@
+/*	well_mmap_test.c
+
+Feed a file much larger than the window through a memory-mapped well
+	to several workers; check every block arrives exactly once,
+	with the right contents and a zero-padded tail.
+With WELL_MMAP_DROP, consumed blocks must have left the page cache
+	(where the filesystem lets fadvise drop pages at all).
+*/
+
+#include <well_mmap.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h> /* posix_fadvise() */
+#include <sys/mman.h> /* mincore() */
+
+
+static const size_t file_blocks = 37;
+static const size_t file_tail = 100;	/* bytes in partial final block */
+static const size_t window = 8;		/* blocks in the well */
+static const size_t worker_cnt = 3;
+
+static struct well buf = { {0} };
+static struct well_mmap wm;
+static unsigned char *seen = NULL;
+static size_t bad = 0;
+
+
+/*	word()
+Contents of the file: each 32-bit word holds its own offset.
+*/
+static uint32_t word(size_t off)
+{
+	return (uint32_t)(off / sizeof(uint32_t));
+}
+
+
+/*	check_blk()
+returns 0 if block 'i' of reservation 'pos' is correct.
+*/
+static int check_blk(size_t pos, size_t i)
+{
+	const uint32_t *w = well_access(pos, i, &buf);
+	size_t off = well_mmap_offset(&wm, pos, i);
+	size_t len = well_mmap_len(&wm, pos, i);
+
+	for (size_t j=0; j < well_blk_size(&buf) / sizeof(uint32_t); j++) {
+		size_t at = j * sizeof(uint32_t);
+		uint32_t expect = at < len ? word(off + at) : 0;
+		if (w[j] != expect)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*	cached()
+returns number of pages of file blocks [first, first + count) in the page cache;
+	SIZE_MAX on error
+*/
+static size_t cached(int fd, size_t first, size_t count)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t len = count * well_blk_size(&buf);
+	unsigned char vec[len / page];
+	size_t n = SIZE_MAX;
+
+	/* not touched: mapping alone reads nothing in */
+	void *p = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, first * well_blk_size(&buf));
+	if (p == MAP_FAILED)
+		return n;
+	if (!mincore(p, len, vec)) {
+		n = 0;
+		for (size_t i=0; i < len / page; i++)
+			n += vec[i] & 1;
+	}
+	munmap(p, len);
+	return n;
+}
+
+
+/*	worker()
+*/
+void *worker(void *arg)
+{
+	for (;;) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf.rx, &pos, 2))) {
+			if (well_mmap_done(&wm) && !__atomic_load_n(&buf.rx.avail, __ATOMIC_ACQUIRE))
+				break;
+			FAIL_DO();
+			continue;
+		}
+
+		for (size_t i=0; i < res; i++) {
+			if (check_blk(pos, i))
+				__atomic_add_fetch(&bad, 1, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&seen[pos + i], 1, __ATOMIC_RELAXED);
+		}
+
+		while (!well_release_multi(&buf.tx, res, pos))
+			FAIL_DO();
+	}
+	return NULL;
+}
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+	int fd = -1;
+	pthread_t threads[worker_cnt];
+	size_t started = 0;
+	size_t blk_size = sysconf(_SC_PAGESIZE);
+	size_t file_size = file_blocks * blk_size + file_tail;
+	size_t blk_total = file_blocks + 1;
+	int can_drop = 0;
+
+	/* test file */
+	char name[] = "/tmp/well_mmap_XXXXXX";
+	Z_die_if((fd = mkstemp(name)) == -1, "");
+	unlink(name);
+	for (size_t off=0; off < file_size; off += sizeof(uint32_t)) {
+		uint32_t w = word(off);
+		size_t len = file_size - off < sizeof(w) ? file_size - off : sizeof(w);
+		Z_die_if(write(fd, &w, len) != (ssize_t)len, "");
+	}
+	/* dirty pages are never dropped */
+	Z_die_if(fsync(fd), "");
+
+	Z_die_if(!(seen = calloc(blk_total, 1)), "");
+
+	/* blk_size must be page-aligned */
+	Z_die_if(well_params(100, window, &buf), "");
+	Z_err_if(!well_mmap_init(&wm, &buf, fd, 0), "accepted unaligned blk_size");
+
+	Z_die_if(well_params(blk_size, window, &buf), "");
+	Z_die_if(well_mmap_init(&wm, &buf, fd, WELL_MMAP_DROP), "");
+	Z_err_if(wm.blk_total != blk_total, "blk_total %zu", wm.blk_total);
+
+	/* some filesystems (tmpfs) cannot drop pages: nothing to check there */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	can_drop = !cached(fd, 0, file_blocks);
+	if (!can_drop)
+		Z_log(Z_inf, "fadvise does not drop pages here: WELL_MMAP_DROP not checked");
+
+	for (; started < worker_cnt; started++)
+		Z_die_if(pthread_create(&threads[started], NULL, worker, NULL), "");
+
+	ssize_t ret;
+	while ((ret = well_mmap_feed(&wm, 3))) {
+		Z_die_if(ret < 0 && errno != EAGAIN, "feed: %s", strerror(errno));
+		if (ret < 0)
+			FAIL_DO();
+	}
+
+out:
+	while (started)
+		pthread_join(threads[--started], NULL);
+
+	if (seen) {
+		for (size_t i=0; i < blk_total; i++)
+			Z_err_if(seen[i] != 1, "block %zu seen %d times", i, seen[i]);
+	}
+	Z_err_if(bad, "%zu corrupt blocks", bad);
+	Z_err_if(buf.tx.avail != window, "tx avail %zu", buf.tx.avail);
+
+	/* every slot was refilled but the last 'window': their blocks are gone */
+	if (can_drop) {
+		size_t n = cached(fd, 0, blk_total - window);
+		Z_err_if(n, "%zu pages of consumed blocks still cached", n);
+	}
+
+	well_mmap_deinit(&wm);
+	free(seen);
+	if (fd != -1)
+		close(fd);
+	return err_cnt;
+}
@@ -0,0 +1,207 @@
+/*	well_part_test.c
+
+Producer threads feed records into one input well; a router thread
+	partitions them by key into -x lanes, each drained by one consumer.
+Every producer owns its keys and numbers each key's records in turn:
+	consumers check that each key arrives complete, once, in order.
+With -H, producer 0 sends that percentage of its records on one key,
+	making its lane hot: buckets must move off it without breaking order.
+Tiny lanes (-c) keep backlogs full and the router waiting on consumers.
+*/
+
+#include <well_part.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <stddef.h> /* offsetof() */
+#include <pthread.h>
+#include <getopt.h>
+
+
+#define KEYS_PER_TX	64
+
+static size_t numiter = 100000;	/* records per producer */
+static size_t tx_thread_cnt = 2;	/* producers */
+static size_t lane_cnt = 4;	/* consumers */
+static size_t lane_blocks = 64;
+static size_t hot_pct = 0;
+
+struct record {
+	uint32_t	key;
+	uint32_t	pad;
+	size_t		seq;	/* of this key */
+};
+
+static struct well in;
+static struct well_part part;
+static size_t *sent = NULL;	/* per key: written by its producer */
+static size_t *expect = NULL;	/* per key: written by whichever consumer has it */
+static size_t consumed = 0;
+static size_t errs = 0;
+
+
+/*	tx_thread()
+*/
+void *tx_thread(void *arg)
+{
+	size_t p = (size_t)arg;
+	uint64_t rnd = p * 0x9e3779b97f4a7c15 + 1;
+	for (size_t i=0; i < numiter; ) {
+		size_t pos, res;
+		size_t ask = numiter - i < 16 ? numiter - i : 16;
+		if (!(res = well_reserve(&in.tx, &pos, ask))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			rnd ^= rnd << 13; rnd ^= rnd >> 7; rnd ^= rnd << 17;
+			uint32_t key = p * KEYS_PER_TX;
+			if (!(p == 0 && rnd % 100 < hot_pct))
+				key += rnd % KEYS_PER_TX;
+			struct record *r = well_access(pos, j, &in);
+			r->key = key;
+			r->seq = sent[key]++;
+		}
+		while (!well_release_multi(&in.rx, res, pos))
+			FAIL_DO();
+		i += res;
+	}
+	return NULL;
+}
+
+
+/*	router()
+Keeps its reservation on 'in' across calls to well_part_route(),
+	freeing only what was routed.
+*/
+void *router(void *arg)
+{
+	size_t total = tx_thread_cnt * numiter;
+	size_t pos = 0, held = 0;
+	for (size_t done = 0; done < total; ) {
+		if (!held && !(held = well_reserve(&in.rx, &pos, 256))) {
+			FAIL_DO();
+			continue;
+		}
+		size_t res = well_part_route(&part, &in, pos, held);
+		if (res) {
+			/* the only consumer of 'in' */
+			well_release_single(&in.tx, res);
+			pos += res;
+			held -= res;
+			done += res;
+		} else {
+			FAIL_DO();
+		}
+	}
+	while (well_part_flush(&part))
+		FAIL_DO();
+	return NULL;
+}
+
+
+/*	rx_thread()
+Drains lane 'arg'.
+*/
+void *rx_thread(void *arg)
+{
+	size_t lane = (size_t)arg;
+	struct well *buf = well_part_well(&part, lane);
+	size_t total = tx_thread_cnt * numiter;
+	while (__atomic_load_n(&consumed, __ATOMIC_RELAXED) < total) {
+		size_t pos, res;
+		if (!(res = well_part_reserve(&part, lane, &pos, 8))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			struct record *r = well_access(pos, j, buf);
+			if (r->seq != expect[r->key]++ && !__atomic_fetch_add(&errs, 1, __ATOMIC_RELAXED))
+				Z_log(Z_err, "lane %zu: key %u seq %zu out of order", lane, r->key, r->seq);
+		}
+		well_part_release(&part, lane, res);
+		__atomic_add_fetch(&consumed, res, __ATOMIC_RELAXED);
+	}
+	return NULL;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx[64], rx[64], rt;
+	size_t tx_started = 0, rx_started = 0;
+	int rt_started = 0, part_inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:t:x:c:H:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &tx_thread_cnt) != 1
+				|| !tx_thread_cnt || tx_thread_cnt > 64, "-t");
+			break;
+		case 'x':
+			Z_die_if(sscanf(optarg, "%zu", &lane_cnt) != 1
+				|| !lane_cnt || lane_cnt > 64, "-x");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &lane_blocks) != 1, "-c");
+			break;
+		case 'H':
+			Z_die_if(sscanf(optarg, "%zu", &hot_pct) != 1 || hot_pct > 100, "-H");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	size_t keys = tx_thread_cnt * KEYS_PER_TX;
+	Z_die_if(!(sent = calloc(keys, sizeof(size_t))), "");
+	Z_die_if(!(expect = calloc(keys, sizeof(size_t))), "");
+	Z_die_if(well_params(sizeof(struct record), 1024, &in), "");
+	Z_die_if(well_init(&in, malloc(well_size(&in))), "");
+	Z_die_if(well_part_init(&part, lane_cnt, lane_blocks, sizeof(struct record),
+			offsetof(struct record, key), sizeof(uint32_t)), "");
+	part_inited = 1;
+
+	for (; rx_started < lane_cnt; rx_started++)
+		Z_die_if(pthread_create(&rx[rx_started], NULL, rx_thread, (void *)rx_started), "");
+	Z_die_if(pthread_create(&rt, NULL, router, NULL), "");
+	rt_started = 1;
+	for (; tx_started < tx_thread_cnt; tx_started++)
+		Z_die_if(pthread_create(&tx[tx_started], NULL, tx_thread, (void *)tx_started), "");
+
+out:
+	/* a failed start leaves the others waiting forever: give up on them */
+	if (err_cnt)
+		return err_cnt;
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	if (rt_started)
+		pthread_join(rt, NULL);
+	while (rx_started)
+		pthread_join(rx[--rx_started], NULL);
+
+	err_cnt += errs;
+	for (size_t k=0; k < keys; k++) {
+		if (expect[k] != sent[k]) {
+			Z_log(Z_err, "key %zu: got %zu of %zu", k, expect[k], sent[k]);
+			err_cnt++;
+		}
+	}
+	if (part_inited) {
+		Z_log(Z_inf, "lanes %zu; buckets moved %zu", lane_cnt, part.moved);
+		well_part_deinit(&part);
+	}
+	well_deinit(&in);
+	free(well_mem(&in));
+	free(sent);
+	free(expect);
+	return err_cnt;
+}
@@ -0,0 +1,161 @@
+/*	well_pipe_test.c
+
+Push blocks through a K-stage pipe, in place:
+	- stage 0 (one thread) writes 'i'
+	- every middle stage 's' (one or several threads) adds 's'
+	- the last stage (one thread) checks every block arrives, in order,
+		with every middle stage applied exactly once.
+*/
+
+#include <well_pipe.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+static size_t numiter = 1000000;
+static size_t blk_cnt = 256;
+static size_t stage_cnt = 4;
+static size_t thread_cnt = 2;	/* per middle stage */
+
+static struct well_pipe wp;
+static int done = 0;
+
+
+/*	first_stage()
+*/
+void *first_stage(void *arg)
+{
+	for (size_t i=0, res=0; i < numiter; i += res) {
+		size_t pos;
+		while (!(res = well_pipe_reserve(&wp, 0, &pos, numiter - i)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, &wp.well) = i + j;
+		well_pipe_release_single(&wp, 0, res);
+	}
+	return NULL;
+}
+
+
+/*	mid_stage()
+*/
+void *mid_stage(void *arg)
+{
+	size_t stage = (size_t)arg;
+	while (!__atomic_load_n(&done, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_pipe_reserve(&wp, stage, &pos, 7))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, &wp.well) += stage;
+
+		if (thread_cnt == 1) {
+			well_pipe_release_single(&wp, stage, res);
+		} else {
+			while (!well_pipe_release_multi(&wp, stage, res, pos))
+				FAIL_DO();
+		}
+	}
+	return NULL;
+}
+
+
+/*	last_stage()
+returns number of errors
+*/
+void *last_stage(void *arg)
+{
+	size_t last = stage_cnt - 1;
+	size_t add = last * (last - 1) / 2; /* 1 + 2 + ... + last-1 */
+	size_t errs = 0;
+
+	for (size_t i=0, res=0; i < numiter; i += res) {
+		size_t pos;
+		while (!(res = well_pipe_reserve(&wp, last, &pos, numiter - i)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++) {
+			size_t val = WELL_DEREF(size_t, pos, j, &wp.well);
+			if (val != i + j + add) {
+				if (!errs)
+					Z_log(Z_err, "block %zu: %zu != %zu", i + j, val, i + j + add);
+				errs++;
+			}
+		}
+		well_pipe_release_single(&wp, last, res);
+	}
+
+	__atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+	return (void *)errs;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t first, last, *mid = NULL;
+	size_t mid_started = 0;
+	int first_started = 0, last_started = 0, inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:c:k:t:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &blk_cnt) != 1, "-c");
+			break;
+		case 'k':
+			Z_die_if(sscanf(optarg, "%zu", &stage_cnt) != 1 || stage_cnt < 2, "-k");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &thread_cnt) != 1 || !thread_cnt, "-t");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_params(sizeof(size_t), blk_cnt, &wp.well), "");
+	Z_die_if(
+		well_pipe_init(&wp, malloc(well_size(&wp.well)), stage_cnt)
+		, "size %zu", well_size(&wp.well));
+	inited = 1;
+
+	Z_die_if(!(mid = calloc((stage_cnt - 2) * thread_cnt + 1, sizeof(pthread_t))), "");
+	Z_die_if(pthread_create(&last, NULL, last_stage, NULL), "");
+	last_started = 1;
+	for (size_t s=1; s < stage_cnt - 1; s++) {
+		for (size_t t=0; t < thread_cnt; t++, mid_started++)
+			Z_die_if(pthread_create(&mid[mid_started], NULL, mid_stage, (void *)s), "");
+	}
+	Z_die_if(pthread_create(&first, NULL, first_stage, NULL), "");
+	first_started = 1;
+
+out:
+	if (first_started)
+		pthread_join(first, NULL);
+	if (last_started) {
+		void *errs;
+		pthread_join(last, &errs);
+		err_cnt += (size_t)errs;
+	}
+	__atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+	while (mid_started)
+		pthread_join(mid[--mid_started], NULL);
+	free(mid);
+
+	if (inited) {
+		well_pipe_deinit(&wp);
+		free(well_mem(&wp.well));
+	}
+	return err_cnt;
+}
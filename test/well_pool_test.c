@@ -0,0 +1,180 @@
+/*	well_pool_test.c
+
+Producers allocate objects from a pool and hand them to consumers
+	(through a plain well of pointers), which check and free them.
+No object may ever be handed out twice at once,
+	and every object must be back in the pool at the end.
+*/
+
+#include <well_pool.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+struct obj {
+	int	in_use;
+	size_t	val;
+};
+
+static size_t numiter = 1000000;
+static size_t obj_cnt = 100;	/* NOT a power of 2 */
+static size_t thread_cnt = 2;	/* producers; as many consumers */
+static size_t batch = 8;	/* 0: no per-thread cache */
+
+static struct well_pool pool;
+static struct well queue;
+
+
+/*	producer()
+returns number of errors
+*/
+void *producer(void *arg)
+{
+	size_t errs = 0;
+	struct well_pool_cache cache;
+	if (batch && well_pool_cache_init(&cache, &pool, batch))
+		return (void *)1;
+
+	for (size_t i=0; i < numiter; i++) {
+		struct obj *o;
+		while (!(o = batch ? well_pool_cache_get(&cache) : well_pool_get(&pool)))
+			FAIL_DO();
+		if (__atomic_exchange_n(&o->in_use, 1, __ATOMIC_RELAXED))
+			errs++;
+		o->val = i;
+
+		size_t pos;
+		while (!well_reserve(&queue.tx, &pos, 1))
+			FAIL_DO();
+		WELL_DEREF(struct obj *, pos, 0, &queue) = o;
+		while (!well_release_multi(&queue.rx, 1, pos))
+			FAIL_DO();
+	}
+
+	if (batch)
+		well_pool_cache_deinit(&cache);
+	return (void *)errs;
+}
+
+
+/*	consumer()
+returns number of errors
+*/
+void *consumer(void *arg)
+{
+	size_t errs = 0, sum = 0;
+	struct well_pool_cache cache;
+	if (batch && well_pool_cache_init(&cache, &pool, batch))
+		return (void *)1;
+
+	for (size_t i=0; i < numiter; i++) {
+		size_t pos;
+		while (!well_reserve(&queue.rx, &pos, 1))
+			FAIL_DO();
+		struct obj *o = WELL_DEREF(struct obj *, pos, 0, &queue);
+		while (!well_release_multi(&queue.tx, 1, pos))
+			FAIL_DO();
+
+		if (!__atomic_exchange_n(&o->in_use, 0, __ATOMIC_RELAXED))
+			errs++;
+		sum += o->val;
+		if (batch)
+			well_pool_cache_put(&cache, o);
+		else
+			well_pool_put(&pool, o);
+	}
+
+	if (batch)
+		well_pool_cache_deinit(&cache);
+	(void)sum;
+	return (void *)errs;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx[64], rx[64];
+	size_t tx_started = 0, rx_started = 0;
+	int pool_inited = 0, queue_inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:c:t:b:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &obj_cnt) != 1, "-c");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &thread_cnt) != 1
+				|| !thread_cnt || thread_cnt > 64, "-t");
+			break;
+		case 'b':
+			Z_die_if(sscanf(optarg, "%zu", &batch) != 1, "-b");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+	/* caches must not be able to hoard the whole pool */
+	Z_die_if(obj_cnt <= 4 * batch * thread_cnt, "obj_cnt %zu too small", obj_cnt);
+
+	Z_die_if(well_pool_init(&pool, sizeof(struct obj), obj_cnt), "");
+	pool_inited = 1;
+	Z_die_if(well_params(sizeof(struct obj *), 64, &queue), "");
+	Z_die_if(well_init(&queue, malloc(well_size(&queue))), "");
+	queue_inited = 1;
+
+	/* drain and refill: get() must fail exactly when empty */
+	void **all;
+	Z_die_if(!(all = malloc(obj_cnt * sizeof(void *))), "");
+	size_t got = 0;
+	while (got < obj_cnt && (all[got] = well_pool_get(&pool)))
+		got++;
+	Z_err_if(got != obj_cnt, "got %zu of %zu", got, obj_cnt);
+	Z_err_if(well_pool_get(&pool), "pool not empty");
+	for (size_t i=0; i < got; i++)
+		((struct obj *)all[i])->in_use = 0;
+	well_pool_give(&pool, all, got);
+	free(all);
+
+	for (; rx_started < thread_cnt; rx_started++)
+		Z_die_if(pthread_create(&rx[rx_started], NULL, consumer, NULL), "");
+	for (; tx_started < thread_cnt; tx_started++)
+		Z_die_if(pthread_create(&tx[tx_started], NULL, producer, NULL), "");
+
+out:
+	while (tx_started) {
+		void *errs;
+		pthread_join(tx[--tx_started], &errs);
+		err_cnt += (size_t)errs;
+	}
+	while (rx_started) {
+		void *errs;
+		pthread_join(rx[--rx_started], &errs);
+		err_cnt += (size_t)errs;
+	}
+
+	if (pool_inited) {
+		/* every object is back */
+		size_t back = 0, res;
+		void *objs[16];
+		while ((res = well_pool_take(&pool, objs, 16)))
+			back += res;
+		Z_err_if(back != obj_cnt, "%zu of %zu objects returned", back, obj_cnt);
+		well_pool_deinit(&pool);
+	}
+	if (queue_inited) {
+		well_deinit(&queue);
+		free(well_mem(&queue));
+	}
+	return err_cnt;
+}
@@ -0,0 +1,146 @@
+/*	well_ptrq_test.c
+
+Every pointer pushed into a pointer queue must be popped exactly once:
+	in order with one producer and one consumer; complete (by sum) otherwise.
+Pushes and pops are in batches of varying size.
+*/
+
+#include <well_ptrq.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+static size_t numiter = 1000000;
+static size_t count = 256;
+static size_t batch = 16;
+static size_t tx_thread_cnt = 2;
+static size_t rx_thread_cnt = 2;
+
+static struct well_ptrq q;
+static size_t popped = 0;
+
+
+/*	tx_thread()
+Pointers pushed are the values 'i+1' for i in [0, numiter), split across producers.
+*/
+void *tx_thread(void *arg)
+{
+	size_t num = numiter / tx_thread_cnt;
+	size_t first = (size_t)arg * num;
+	void *ptrs[batch];
+
+	for (size_t i=0, res=0; i < num; i += res) {
+		size_t n = 1 + (i % batch);
+		if (n > num - i)
+			n = num - i;
+		for (size_t j=0; j < n; j++)
+			ptrs[j] = (void *)(first + i + j + 1);
+		while (!(res = well_ptrq_push(&q, ptrs, n)))
+			FAIL_DO();
+	}
+	return NULL;
+}
+
+
+/*	rx_thread()
+returns sum of values popped; exits early on an out-of-order value.
+*/
+void *rx_thread(void *arg)
+{
+	size_t total = (numiter / tx_thread_cnt) * tx_thread_cnt;
+	size_t sum = 0, next = 1;
+	void *ptrs[batch];
+
+	while (__atomic_load_n(&popped, __ATOMIC_RELAXED) < total) {
+		size_t res = well_ptrq_pop(&q, ptrs, batch);
+		if (!res) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			size_t val = (size_t)ptrs[j];
+			if (tx_thread_cnt == 1 && rx_thread_cnt == 1 && val != next++) {
+				Z_log(Z_err, "got %zu; expected %zu", val, next - 1);
+				return (void *)0;
+			}
+			sum += val;
+		}
+		__atomic_add_fetch(&popped, res, __ATOMIC_RELAXED);
+	}
+	return (void *)sum;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx[64], rx[64];
+	size_t tx_started = 0, rx_started = 0;
+	int inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:c:b:t:x:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &count) != 1, "-c");
+			break;
+		case 'b':
+			Z_die_if(sscanf(optarg, "%zu", &batch) != 1 || !batch, "-b");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &tx_thread_cnt) != 1
+				|| !tx_thread_cnt || tx_thread_cnt > 64, "-t");
+			break;
+		case 'x':
+			Z_die_if(sscanf(optarg, "%zu", &rx_thread_cnt) != 1
+				|| !rx_thread_cnt || rx_thread_cnt > 64, "-x");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_ptrq_init(&q, count), "");
+	inited = 1;
+
+	/* a full queue refuses, an empty one gives nothing */
+	void *one = (void *)1, *out[1];
+	for (size_t i=0; i < well_ptrq_count(&q); i++)
+		Z_die_if(!well_ptrq_push(&q, &one, 1), "push %zu", i);
+	Z_err_if(well_ptrq_push(&q, &one, 1), "pushed into a full queue");
+	for (size_t i=0; i < well_ptrq_count(&q); i++)
+		Z_die_if(!well_ptrq_pop(&q, out, 1), "pop %zu", i);
+	Z_err_if(well_ptrq_pop(&q, out, 1), "popped from an empty queue");
+
+	for (; rx_started < rx_thread_cnt; rx_started++)
+		Z_die_if(pthread_create(&rx[rx_started], NULL, rx_thread, NULL), "");
+	for (; tx_started < tx_thread_cnt; tx_started++)
+		Z_die_if(pthread_create(&tx[tx_started], NULL, tx_thread, (void *)tx_started), "");
+
+out:
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	if (rx_started) {
+		size_t total = (numiter / tx_thread_cnt) * tx_thread_cnt;
+		size_t sum = 0;
+		while (rx_started) {
+			void *ret;
+			pthread_join(rx[--rx_started], &ret);
+			sum += (size_t)ret;
+		}
+		Z_err_if(sum != total * (total + 1) / 2,
+			"sum %zu != %zu", sum, total * (total + 1) / 2);
+	}
+	if (inited)
+		well_ptrq_deinit(&q);
+	return err_cnt;
+}
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+'''well_py_test.py
+
+Python bindings (python/memorywell.c): blocks written through a reservation's
+    memoryviews arrive in order, wrapping reservations come in 2 segments,
+    waits time out, waiting releases the GIL, and a forked process
+    attached to the same well sees the same blocks.
+Exits with the number of errors.
+'''
+
+import os
+import sys
+import time
+import threading
+import memorywell as mw
+
+err_cnt = 0
+
+def check(cond, what):
+    global err_cnt
+    if not cond:
+        print('ERROR: ' + what, file=sys.stderr)
+        err_cnt += 1
+
+
+def put(w, vals):
+    r = w.reserve(mw.TX, len(vals), timeout=None)
+    i = 0
+    for seg in r.segments:
+        seg = seg.cast('Q')
+        for j in range(len(seg)):
+            seg[j] = vals[i + j]
+        i += len(seg)
+    r.release()
+    return r.count
+
+
+def get(w, max_count):
+    r = w.reserve(mw.RX, max_count, timeout=None)
+    vals = []
+    for seg in r.segments:
+        vals += seg.cast('Q').tolist()
+    r.release()
+    return vals
+
+
+# in order, through the buffer protocol and segments alike
+w = mw.Well(8, 16)
+check(w.blk_size == 8 and w.blk_count == 16, 'geometry')
+check(w.reserve(mw.RX) is None, 'empty well gave blocks')
+with w.reserve(mw.TX, 4) as r:
+    check(r.count == 4, 'reserved %d of 4' % r.count)
+    memoryview(r).cast('Q')[:] = memoryview(bytes(range(32))).cast('Q')
+check(bytes(memoryview(w.reserve(mw.RX, 4))) == bytes(range(32)), 'buffer contents')
+
+# release twice
+r = w.reserve(mw.TX, 1)
+r.release()
+try:
+    r.release()
+    check(False, 'second release accepted')
+except ValueError:
+    pass
+
+# wraps: 2 segments, and no single buffer
+w = mw.Well(8, 16)
+check(put(w, list(range(12))) == 12, 'put 12')
+check(get(w, 12) == list(range(12)), 'got 12')
+r = w.reserve(mw.TX, 8)
+check(len(r.segments) == 2, 'wrapping reservation in %d segments' % len(r.segments))
+try:
+    memoryview(r)
+    check(False, 'wrapping reservation gave one buffer')
+except BufferError:
+    pass
+r.release()
+
+# timeout
+check(len(get(w, 8)) == 8, 'drain')
+start = time.monotonic()
+check(w.reserve(mw.RX, 1, timeout=0.05) is None, 'wait on empty well did not time out')
+check(time.monotonic() - start >= 0.04, 'timed out early')
+
+# waiting releases the GIL: the main thread keeps running Python meanwhile
+w = mw.Well(8, 16)
+got = []
+t = threading.Thread(target=lambda: got.extend(get(w, 1)))
+t.start()
+spins = 0
+deadline = time.monotonic() + 0.1
+while time.monotonic() < deadline:
+    spins += 1
+check(spins > 1000, 'main thread starved while another waited')
+put(w, [42])
+t.join(5)
+check(got == [42], 'waiter got %s' % got)
+
+# another process, attached to the same memfd
+w = mw.Well(8, 64)
+n = 100000
+pid = os.fork()
+if not pid:
+    child = mw.Well(fd=w.fd)
+    i = 0
+    while i < n:
+        i += put(child, list(range(i, min(i + 16, n))))
+    os._exit(0)
+vals = []
+while len(vals) < n:
+    vals += get(w, 32)
+os.waitpid(pid, 0)
+check(vals == list(range(n)), 'values across processes out of order')
+
+sys.exit(err_cnt)
@@ -0,0 +1,154 @@
+/*	well_rpc_test.c
+
+Several clients make calls of 1 to 3 blocks each to a pool of servers;
+	every client must get back exactly the response to its own request.
+Half the clients poll with well_rpc_ready(), half sleep in well_rpc_wait().
+*/
+
+#include <well_rpc.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+static size_t numiter = 100000;	/* calls per client */
+static size_t blk_cnt = 64;
+static size_t client_cnt = 3;
+static size_t server_cnt = 2;
+
+static struct well_rpc rpc;
+static int done = 0;
+
+
+/*	server()
+Response is 'request * 3 + 1'.
+*/
+void *server(void *arg)
+{
+	while (!__atomic_load_n(&done, __ATOMIC_RELAXED)) {
+		size_t pos, res;
+		if (!(res = well_rpc_serve(&rpc, &pos, 4))) {
+			FAIL_DO();
+			continue;
+		}
+		for (size_t j=0; j < res; j++) {
+			size_t *blk = well_access(pos, j, &rpc.well);
+			*blk = *blk * 3 + 1;
+		}
+		well_rpc_respond(&rpc, pos, res);
+	}
+	return NULL;
+}
+
+
+/*	client()
+returns number of errors
+*/
+void *client(void *arg)
+{
+	size_t id = (size_t)arg;
+	size_t errs = 0;
+
+	for (size_t i=0; i < numiter; i++) {
+		size_t pos, res, want = 1 + i % 3;
+		while (!(res = well_rpc_reserve(&rpc, &pos, want)))
+			FAIL_DO();
+		for (size_t j=0; j < res; j++)
+			WELL_DEREF(size_t, pos, j, &rpc.well) = (id << 32) | (i << 2) | j;
+
+		if (client_cnt == 1) {
+			well_rpc_submit(&rpc, res);
+		} else {
+			while (!well_rpc_submit_multi(&rpc, res, pos))
+				FAIL_DO();
+		}
+
+		if (id & 1) {
+			if (well_rpc_wait(&rpc, pos, res, -1))
+				errs++;
+		} else {
+			while (!well_rpc_ready(&rpc, pos, res))
+				FAIL_DO();
+		}
+
+		for (size_t j=0; j < res; j++) {
+			size_t expect = (((id << 32) | (i << 2) | j) * 3) + 1;
+			if (WELL_DEREF(size_t, pos, j, &rpc.well) != expect)
+				errs++;
+		}
+		well_rpc_finish(&rpc, pos, res);
+	}
+	if (errs)
+		Z_log(Z_err, "client %zu: %zu errors", id, errs);
+	return (void *)errs;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t cl[64], sv[64];
+	size_t cl_started = 0, sv_started = 0;
+	int inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:c:t:x:")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 'c':
+			Z_die_if(sscanf(optarg, "%zu", &blk_cnt) != 1, "-c");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &client_cnt) != 1
+				|| !client_cnt || client_cnt > 64, "-t");
+			break;
+		case 'x':
+			Z_die_if(sscanf(optarg, "%zu", &server_cnt) != 1
+				|| !server_cnt || server_cnt > 64, "-x");
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+
+	Z_die_if(well_params(sizeof(size_t), blk_cnt, &rpc.well), "");
+	Z_die_if(
+		well_rpc_init(&rpc, malloc(well_size(&rpc.well)))
+		, "size %zu", well_size(&rpc.well));
+	inited = 1;
+
+	/* nothing submitted yet: a short wait must time out */
+	Z_die_if(well_rpc_wait(&rpc, 0, 1, 1000000) != -1, "wait did not time out");
+
+	for (; sv_started < server_cnt; sv_started++)
+		Z_die_if(pthread_create(&sv[sv_started], NULL, server, NULL), "");
+	for (; cl_started < client_cnt; cl_started++)
+		Z_die_if(pthread_create(&cl[cl_started], NULL, client, (void *)cl_started), "");
+
+out:
+	while (cl_started) {
+		void *errs;
+		pthread_join(cl[--cl_started], &errs);
+		err_cnt += (size_t)errs;
+	}
+	__atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+	while (sv_started)
+		pthread_join(sv[--sv_started], NULL);
+
+	if (inited) {
+		/* every block made it back to 'tx' */
+		Z_err_if(well_rpc_reclaim(&rpc), "");
+		Z_err_if(rpc.well.tx.avail != well_blk_count(&rpc.well),
+			"tx avail %zu != %zu", rpc.well.tx.avail, well_blk_count(&rpc.well));
+		well_rpc_deinit(&rpc);
+		free(well_mem(&rpc.well));
+	}
+	return err_cnt;
+}
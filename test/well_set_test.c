@@ -0,0 +1,175 @@
+/*	well_set_test.c
+
+Consumers find every block released into any of many wells through a set,
+	parking when nothing is ready: nothing may be lost or stall.
+By default each well has one producer, and with one consumer every well
+	is checked for order; with -m every producer writes to every well
+	(well_set_release_multi()) and only the total is checked.
+*/
+
+#include <well_set.h>
+#include <well_fail.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <getopt.h>
+
+
+static size_t numiter = 200000;
+static size_t well_cnt = 1000;
+static size_t tx_thread_cnt = 2;
+static size_t rx_thread_cnt = 1;
+static int multi = 0;
+
+static struct well_set set;
+static struct well *wells = NULL;
+static size_t *ids = NULL;
+static size_t *sent = NULL;	/* per well, by its only producer */
+static size_t *got = NULL;	/* per well, by the only consumer */
+static size_t consumed = 0;
+
+
+/*	tx_thread()
+Without -m, producer 'p' owns wells p, p + tx_thread_cnt, ...
+	and writes each one's own running count.
+*/
+void *tx_thread(void *arg)
+{
+	size_t p = (size_t)arg;
+	size_t num = numiter / tx_thread_cnt;
+	size_t own = (well_cnt - p + tx_thread_cnt - 1) / tx_thread_cnt;
+
+	for (size_t i=0; i < num; i++) {
+		size_t w = multi ? (i * 7 + p) % well_cnt : p + (i % own) * tx_thread_cnt;
+		struct well *buf = &wells[w];
+		size_t pos;
+		while (!well_reserve(&buf->tx, &pos, 1))
+			FAIL_DO();
+		WELL_DEREF(size_t, pos, 0, buf) = multi ? 1 : ++sent[w];
+		if (!multi) {
+			well_set_release(&set, ids[w], 1);
+		} else {
+			while (!well_set_release_multi(&set, ids[w], 1, pos))
+				FAIL_DO();
+		}
+	}
+	return NULL;
+}
+
+
+/*	rx_thread()
+returns number of errors
+*/
+void *rx_thread(void *arg)
+{
+	size_t total = (numiter / tx_thread_cnt) * tx_thread_cnt;
+	size_t errs = 0;
+
+	while (__atomic_load_n(&consumed, __ATOMIC_RELAXED) < total) {
+		size_t id, pos, res;
+		if (!(res = well_set_reserve(&set, &id, &pos, 4))) {
+			well_set_wait(&set, 1000000);
+			continue;
+		}
+		struct well *buf = well_set_well(&set, id);
+		for (size_t j=0; j < res; j++) {
+			size_t val = WELL_DEREF(size_t, pos, j, buf);
+			if (multi && val != 1)
+				errs++;
+			if (!multi && rx_thread_cnt == 1 && val != ++got[id])
+				errs++;
+		}
+		if (rx_thread_cnt == 1) {
+			well_release_single(&buf->tx, res);
+		} else {
+			while (!well_release_multi(&buf->tx, res, pos))
+				FAIL_DO();
+		}
+		__atomic_add_fetch(&consumed, res, __ATOMIC_RELAXED);
+	}
+	return (void *)errs;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	pthread_t tx[64], rx[64];
+	size_t tx_started = 0, rx_started = 0, inited = 0;
+	int set_inited = 0;
+
+	while ((opt = getopt(argc, argv, "n:w:t:x:m")) != -1) {
+		switch (opt) {
+		case 'n':
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "-n");
+			break;
+		case 'w':
+			Z_die_if(sscanf(optarg, "%zu", &well_cnt) != 1 || !well_cnt, "-w");
+			break;
+		case 't':
+			Z_die_if(sscanf(optarg, "%zu", &tx_thread_cnt) != 1
+				|| !tx_thread_cnt || tx_thread_cnt > 64, "-t");
+			break;
+		case 'x':
+			Z_die_if(sscanf(optarg, "%zu", &rx_thread_cnt) != 1
+				|| !rx_thread_cnt || rx_thread_cnt > 64, "-x");
+			break;
+		case 'm':
+			multi = 1;
+			break;
+		default:
+			Z_die("option '%c' invalid", opt);
+		}
+	}
+	Z_die_if(!multi && tx_thread_cnt > well_cnt, "more producers than wells");
+
+	Z_die_if(posix_memalign((void **)&wells, _Alignof(struct well),
+			well_cnt * sizeof(struct well)), "");
+	Z_die_if(!(ids = calloc(well_cnt, sizeof(size_t))), "");
+	Z_die_if(!(sent = calloc(well_cnt, sizeof(size_t))), "");
+	Z_die_if(!(got = calloc(well_cnt, sizeof(size_t))), "");
+	Z_die_if(well_set_init(&set, well_cnt), "");
+	set_inited = 1;
+	for (; inited < well_cnt; inited++) {
+		Z_die_if(well_params(sizeof(size_t), 16, &wells[inited]), "");
+		Z_die_if(
+			well_init(&wells[inited], malloc(well_size(&wells[inited])))
+			, "");
+		Z_die_if(well_set_add(&set, &wells[inited], &ids[inited]), "");
+		Z_err_if(ids[inited] != inited, "id %zu for well %zu", ids[inited], inited);
+	}
+
+	/* nothing released: nothing ready, and a wait times out */
+	size_t id, pos;
+	Z_err_if(well_set_reserve(&set, &id, &pos, 1), "empty set gave blocks");
+	Z_err_if(!well_set_wait(&set, 1000), "wait on an empty set did not time out");
+
+	for (; rx_started < rx_thread_cnt; rx_started++)
+		Z_die_if(pthread_create(&rx[rx_started], NULL, rx_thread, NULL), "");
+	for (; tx_started < tx_thread_cnt; tx_started++)
+		Z_die_if(pthread_create(&tx[tx_started], NULL, tx_thread, (void *)tx_started), "");
+
+out:
+	while (tx_started)
+		pthread_join(tx[--tx_started], NULL);
+	while (rx_started) {
+		void *errs;
+		pthread_join(rx[--rx_started], &errs);
+		Z_err_if((size_t)errs, "%zu values wrong", (size_t)errs);
+	}
+	if (set_inited)
+		well_set_deinit(&set);
+	while (inited) {
+		well_deinit(&wells[--inited]);
+		free(well_mem(&wells[inited]));
+	}
+	free(wells);
+	free(ids);
+	free(sent);
+	free(got);
+	return err_cnt;
+}
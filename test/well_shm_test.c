@@ -0,0 +1,173 @@
+/*	well_shm_test.c
+
+Verify wells in shared memory:
+	- two mappings of one segment (at different addresses) see the same blocks
+	- attach refuses incompatible segments
+	- a child process consumes, in order, everything the parent produces,
+		sleeping in well_shm_wait() when there is nothing to do
+*/
+
+#define _GNU_SOURCE /* memfd_create() */
+#include <well_shm.h>
+
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h> /* memfd_create() */
+#include <sys/wait.h>
+#include <getopt.h>
+
+
+static size_t numiter = 100000;
+
+
+/*	test_views()
+*/
+int test_views(struct well *a, int fd)
+{
+	int err_cnt = 0;
+	struct well *b = well_shm_attach(fd);
+	Z_die_if(!b, "");
+	Z_err_if(a == b, "expected a second mapping");
+
+	size_t pos;
+	Z_die_if(well_reserve(&a->tx, &pos, 3) != 3, "");
+	for (size_t i=0; i < 3; i++)
+		WELL_DEREF(size_t, pos, i, a) = 0xbeef + i;
+	well_release_single(&a->rx, 3);
+
+	Z_die_if(well_reserve(&b->rx, &pos, 3) != 3, "second view sees no blocks");
+	for (size_t i=0; i < 3; i++)
+		Z_err_if(WELL_DEREF(size_t, pos, i, b) != 0xbeef + i, "block %zu", i);
+	well_release_single(&b->tx, 3);
+	Z_err_if(a->tx.avail != well_blk_count(a), "");
+
+out:
+	well_shm_detach(b);
+	return err_cnt;
+}
+
+
+/*	test_refuse()
+*/
+int test_refuse(struct well *buf, int fd)
+{
+	int err_cnt = 0;
+	struct well_shm *shm = (void *)buf - offsetof(struct well_shm, well);
+	struct well *b;
+
+	shm->version++;
+	Z_err_if((b = well_shm_attach(fd)), "attached wrong version");
+	well_shm_detach(b);
+	shm->version--;
+
+	shm->technique++;
+	Z_err_if((b = well_shm_attach(fd)), "attached wrong technique");
+	well_shm_detach(b);
+	shm->technique--;
+
+	shm->well_sz++;
+	Z_err_if((b = well_shm_attach(fd)), "attached wrong struct size");
+	well_shm_detach(b);
+	shm->well_sz--;
+
+	shm->ready = 0;
+	b = well_shm_attach(fd);
+	Z_err_if(b || errno != EAGAIN, "attached unfinished segment");
+	well_shm_detach(b);
+	shm->ready = 1;
+
+	return err_cnt;
+}
+
+
+/*	consumer()
+Runs in the child.
+*/
+int consumer(int fd)
+{
+	int err_cnt = 0;
+	struct well *buf = well_shm_attach(fd);
+	Z_die_if(!buf, "");
+
+	for (size_t i=0; i < numiter; ) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf->rx, &pos, -1))) {
+			well_shm_wait(buf, &buf->rx, 100000000);
+			continue;
+		}
+		for (size_t j=0; j < res; j++, i++)
+			Z_die_if(WELL_DEREF(size_t, pos, j, buf) != i, "expected %zu", i);
+		well_release_single(&buf->tx, res);
+		well_shm_wake(buf, &buf->tx);
+	}
+
+out:
+	well_shm_detach(buf);
+	return err_cnt;
+}
+
+
+/*	test_processes()
+*/
+int test_processes(struct well *buf, int fd)
+{
+	int err_cnt = 0;
+	pid_t pid = fork();
+	Z_die_if(pid < 0, "");
+	if (!pid)
+		_exit(consumer(fd));
+
+	for (size_t i=0; i < numiter; ) {
+		size_t pos, res;
+		if (!(res = well_reserve(&buf->tx, &pos, numiter - i))) {
+			well_shm_wait(buf, &buf->tx, 100000000);
+			continue;
+		}
+		for (size_t j=0; j < res; j++, i++)
+			WELL_DEREF(size_t, pos, j, buf) = i;
+		well_release_single(&buf->rx, res);
+		well_shm_wake(buf, &buf->rx);
+	}
+
+	int status;
+	Z_die_if(waitpid(pid, &status, 0) != pid, "");
+	Z_err_if(!WIFEXITED(status) || WEXITSTATUS(status), "consumer failed");
+	Z_err_if(buf->tx.avail != well_blk_count(buf), "tx avail %zu", buf->tx.avail);
+
+out:
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main(int argc, char **argv)
+{
+	int err_cnt = 0;
+	int opt;
+	struct well *buf = NULL;
+	int fd = -1;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1) {
+		if (opt == 'n')
+			Z_die_if(sscanf(optarg, "%zu", &numiter) != 1, "invalid -n");
+	}
+
+	Z_die_if((fd = memfd_create("well_shm_test", 0)) == -1, "");
+	Z_die_if(!(buf = well_shm_create(fd, sizeof(size_t), 64)), "");
+
+	err_cnt += test_views(buf, fd);
+	err_cnt += test_refuse(buf, fd);
+	err_cnt += test_processes(buf, fd);
+
+out:
+	if (buf) {
+		well_deinit(buf);
+		well_shm_detach(buf);
+	}
+	if (fd != -1)
+		close(fd);
+	return err_cnt;
+}
@@ -29,6 +29,7 @@ static size_t rx_thread_cnt = 1;
 static pthread_t *rx = NULL;
 
 static size_t reservation = 1; /* how many blocks to reserve at once */
+static int fair = 0; /* well_fair() */
 
 static size_t waits = 0; /* how many times did threads wait? */
 
@@ -153,6 +154,7 @@ Options:\n\
 -r, --reservation <res>	:	(Attempt to) reserve <res> blocks at once.\n\
 -t, --tx-threads	:	Number of TX threads.\n\
 -x, --rx-threads	:	Number of RX threads.\n\
+-f, --fair		:	Fair mode: reservers served in arrival order.\n\
 -h, --help		:	Print this message and exit.\n",
 		pgm_name);
 }
@@ -178,10 +180,11 @@ int main(int argc, char **argv)
 		{ "reservation",required_argument,	0,	'r'},
 		{ "tx-threads",	required_argument,	0,	't'},
 		{ "rx-threads",	required_argument,	0,	'x'},
+		{ "fair",	no_argument,		0,	'f'},
 		{ "help",	no_argument,		0,	'h'}
 	};
 
-	while ((opt = getopt_long(argc, argv, "n:c:r:t:x:h", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "n:c:r:t:x:fh", long_options, NULL)) != -1) {
 		switch(opt)
 		{
 			case 'n':
@@ -213,6 +216,10 @@ int main(int argc, char **argv)
 				Z_die_if(opt != 1, "invalid rx_thread_cnt '%s'", optarg);
 				break;
 
+			case 'f':
+				fair = 1;
+				break;
+
 			case 'h':
 				usage(argv[0]);
 				goto out;
@@ -255,6 +262,7 @@ int main(int argc, char **argv)
 	Z_die_if(
 		well_init(&buf, malloc(well_size(&buf)))
 		, "size %zu", well_size(&buf));
+	well_fair(&buf, fair);
 
 	void *(*tx_t)(void *) = tx_single;
 	if (tx_thread_cnt > 1)
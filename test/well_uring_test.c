@@ -0,0 +1,263 @@
+/*	well_uring_test.c
+
+Verify io_uring ingest and drain:
+	- copy a file (whose size is not a multiple of blk_size) through a well
+	- ingest a pipe written in odd-sized pieces
+	- drain into a file which stops growing part way: the pump must fail
+		and leave exactly the unwritten blocks on 'rx'
+
+Exits 77 (skip) where io_uring is unavailable.
+*/
+
+#include <well_uring.h>
+#include <zed_dbg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h> /* setrlimit() */
+
+
+static size_t file_len = (1 << 20) + 123;
+static size_t pipe_len = (1 << 18) + 45;
+
+static char pattern(size_t i)
+{
+	return (char)(i * 7 + (i >> 9));
+}
+
+
+/*	tmp_fd()
+An anonymous temporary file.
+*/
+static int tmp_fd()
+{
+	char name[] = "/tmp/well_uring_XXXXXX";
+	int fd = mkstemp(name);
+	if (fd != -1)
+		unlink(name);
+	return fd;
+}
+
+
+/*	test_copy()
+*/
+int test_copy(struct well *buf)
+{
+	int err_cnt = 0;
+	int src = -1, dst = -1;
+	char *data = NULL, *check = NULL;
+	struct well_uring in = { .ops = NULL };
+	struct well_uring out = { .ops = NULL };
+
+	Z_die_if((src = tmp_fd()) == -1, "");
+	Z_die_if((dst = tmp_fd()) == -1, "");
+	Z_die_if(!(data = malloc(file_len)), "");
+	Z_die_if(!(check = malloc(file_len)), "");
+	for (size_t i=0; i < file_len; i++)
+		data[i] = pattern(i);
+	Z_die_if(write(src, data, file_len) != (ssize_t)file_len, "");
+
+	Z_die_if(well_uring_ingest_init(&in, buf, src, 0, 4, 8), "");
+	Z_die_if(well_uring_drain_init(&out, buf, dst, 0, 4, 8), "");
+
+	int in_done = 0;
+	for (;;) {
+		ssize_t ret;
+		if (!in_done) {
+			ret = well_uring_pump(&in, 0);
+			Z_die_if(ret < 0 && errno != EAGAIN, "ingest: %s", strerror(errno));
+			in_done = !ret;
+		}
+		ret = well_uring_pump(&out, in_done);
+		Z_die_if(ret < 0 && errno != EAGAIN, "drain: %s", strerror(errno));
+		if (in_done && ret < 0 && buf->tx.avail == well_blk_count(buf))
+			break;
+	}
+
+	/* last block was padded: a copy is padded to a whole block */
+	size_t padded = nm_next_mult64(file_len, well_blk_size(buf));
+	Z_err_if(lseek(dst, 0, SEEK_END) != (off_t)padded, "dst size wrong");
+	Z_die_if(ftruncate(dst, file_len), "");
+	Z_die_if(pread(dst, check, file_len, 0) != (ssize_t)file_len, "");
+	Z_err_if(memcmp(data, check, file_len), "copy corrupt");
+
+out:
+	well_uring_deinit(&in);
+	well_uring_deinit(&out);
+	free(data);
+	free(check);
+	if (src != -1)
+		close(src);
+	if (dst != -1)
+		close(dst);
+	return err_cnt;
+}
+
+
+/*	pipe_writer()
+Write 'pipe_len' bytes in pieces which straddle block boundaries.
+*/
+static void *pipe_writer(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+	char piece[1000];
+	for (size_t i=0; i < pipe_len; ) {
+		size_t len = sizeof(piece);
+		if (len > pipe_len - i)
+			len = pipe_len - i;
+		for (size_t j=0; j < len; j++)
+			piece[j] = pattern(i + j);
+		ssize_t ret = write(fd, piece, len);
+		if (ret <= 0)
+			break;
+		i += ret;
+	}
+	close(fd);
+	return NULL;
+}
+
+
+/*	test_pipe()
+*/
+int test_pipe(struct well *buf)
+{
+	int err_cnt = 0;
+	int fds[2] = { -1, -1 };
+	pthread_t writer;
+	int writing = 0;
+	struct well_uring in = { .ops = NULL };
+	size_t blk_size = well_blk_size(buf);
+
+	Z_die_if(pipe(fds), "");
+	Z_die_if(well_uring_ingest_init(&in, buf, fds[0], -1, 4, 0), "");
+	Z_die_if(pthread_create(&writer, NULL, pipe_writer, (void *)(intptr_t)fds[1]), "");
+	writing = 1;
+
+	size_t got = 0;
+	ssize_t ret;
+	while ((ret = well_uring_pump(&in, 1))) {
+		Z_die_if(ret < 0 && errno != EAGAIN, "ingest: %s", strerror(errno));
+		size_t pos, res;
+		if (!(res = well_reserve(&buf->rx, &pos, -1)))
+			continue;
+		for (size_t i=0; i < res; i++) {
+			char *blk = well_access(pos, i, buf);
+			for (size_t j=0; j < blk_size; j++, got++) {
+				char expect = got < pipe_len ? pattern(got) : 0;
+				if (blk[j] != expect) {
+					Z_log(Z_err, "byte %zu: 0x%x != 0x%x", got, blk[j], expect);
+					err_cnt++;
+					goto out;
+				}
+			}
+		}
+		well_release_single(&buf->tx, res);
+	}
+	Z_err_if(got != nm_next_mult64(pipe_len, blk_size), "got %zu bytes", got);
+	Z_err_if(buf->tx.avail != well_blk_count(buf), "blocks lost");
+
+out:
+	well_uring_deinit(&in);
+	if (writing)
+		pthread_join(writer, NULL);
+	if (fds[0] != -1)
+		close(fds[0]);
+	return err_cnt;
+}
+
+
+/*	test_drain_error()
+RLIMIT_FSIZE fails writes past 'stop' bytes (EFBIG), with several
+	operations in flight and one of them straddling the limit.
+*/
+int test_drain_error(struct well *buf)
+{
+	int err_cnt = 0;
+	int dst = -1;
+	struct well_uring out = { .ops = NULL };
+	size_t blk_size = well_blk_size(buf);
+	size_t blocks = 32;
+	size_t stop = 10 * blk_size + blk_size / 2;
+	struct rlimit lim, old_lim;
+	int limited = 0;
+	void (*old_sig)(int) = SIG_DFL;
+
+	/* one number per block: its index */
+	size_t pos;
+	Z_die_if(well_reserve(&buf->tx, &pos, blocks) != blocks, "");
+	for (size_t i=0; i < blocks; i++)
+		memset(well_access(pos, i, buf), (int)i, blk_size);
+	well_release_single(&buf->rx, blocks);
+
+	Z_die_if((dst = tmp_fd()) == -1, "");
+	Z_die_if(getrlimit(RLIMIT_FSIZE, &old_lim), "");
+	lim = (struct rlimit){ .rlim_cur = stop, .rlim_max = old_lim.rlim_max };
+	old_sig = signal(SIGXFSZ, SIG_IGN);
+	Z_die_if(setrlimit(RLIMIT_FSIZE, &lim), "");
+	limited = 1;
+	Z_die_if(well_uring_drain_init(&out, buf, dst, 0, 4, 4), "");
+
+	size_t written = 0;
+	for (;;) {
+		ssize_t ret = well_uring_pump(&out, 1);
+		if (ret > 0)
+			written += ret;
+		else if (errno != EAGAIN || !buf->rx.avail)
+			break;
+	}
+	Z_err_if(errno != EFBIG, "drain failed with '%s', not EFBIG", strerror(errno));
+
+	/* whole blocks below the limit went out, everything else stayed behind */
+	Z_err_if(written != stop / blk_size, "released %zu blocks as written", written);
+	Z_err_if(buf->rx.avail != blocks - written, "%zu blocks on rx", buf->rx.avail);
+	size_t res = well_reserve(&buf->rx, &pos, -1);
+	for (size_t i=0; i < res; i++) {
+		unsigned char *blk = well_access(pos, i, buf);
+		Z_err_if(blk[0] != written + i, "rx block %zu holds block %d", i, blk[0]);
+	}
+	if (res)
+		well_release_single(&buf->tx, res);
+
+out:
+	well_uring_deinit(&out);
+	if (limited)
+		setrlimit(RLIMIT_FSIZE, &old_lim);
+	signal(SIGXFSZ, old_sig);
+	if (dst != -1)
+		close(dst);
+	return err_cnt;
+}
+
+
+/*	main()
+*/
+int main()
+{
+	int err_cnt = 0;
+	struct well buf = { {0} };
+	struct well_uring probe;
+
+	Z_die_if(well_params(4096, 64, &buf), "");
+	Z_die_if(
+		well_init(&buf, malloc(well_size(&buf)))
+		, "size %zu", well_size(&buf));
+
+	/* no io_uring (old kernel, seccomp, container): skip */
+	if (well_uring_ingest_init(&probe, &buf, STDIN_FILENO, -1, 1, 0)) {
+		err_cnt = 77;
+		goto out;
+	}
+	well_uring_deinit(&probe);
+
+	err_cnt += test_copy(&buf);
+	err_cnt += test_pipe(&buf);
+	err_cnt += test_drain_error(&buf);
+
+out:
+	well_deinit(&buf);
+	free(well_mem(&buf));
+	return err_cnt;
+}
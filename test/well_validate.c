@@ -1,6 +1,9 @@
 #include <well.h>
 #include <zed_dbg.h>
 #include <stdlib.h>
+#include <stddef.h> /* offsetof() */
+#include <pthread.h>
+#include <unistd.h> /* usleep() */
 
 
 /*	test_zero()
@@ -33,6 +36,126 @@ int test_zero(struct well *buf)
 }
 
 
+/*	test_unreserve()
+Only the tail of the newest reservation may be given back.
+*/
+int test_unreserve(struct well *buf)
+{
+	int err_cnt = 0;
+	size_t avail = buf->tx.avail;
+	size_t pos_a, pos_b, ret;
+
+	Z_die_if(well_reserve(&buf->tx, &pos_a, 4) != 4, "");
+	Z_die_if(well_reserve(&buf->tx, &pos_b, 4) != 4, "");
+
+	/* 'a' is no longer at the head */
+	ret = well_unreserve(&buf->tx, pos_a + 2, 2);
+	Z_err_if(ret, "unreserve behind a later reservation returned %zu", ret);
+
+	/* give back tail of 'b', then all of 'b' */
+	ret = well_unreserve(&buf->tx, pos_b + 1, 3);
+	Z_err_if(ret != 3, "unreserve tail returned %zu", ret);
+	ret = well_unreserve(&buf->tx, pos_b, 1);
+	Z_err_if(ret != 1, "unreserve remainder returned %zu", ret);
+
+	/* now 'a' is at the head again */
+	ret = well_unreserve(&buf->tx, pos_a, 4);
+	Z_err_if(ret != 4, "unreserve 'a' returned %zu", ret);
+	Z_err_if(buf->tx.avail != avail, "avail %zu != %zu", buf->tx.avail, avail);
+	Z_err_if(buf->tx.pos != pos_a, "pos %zu != %zu", buf->tx.pos, pos_a);
+
+out:
+	return err_cnt;
+}
+
+
+#if (WELL_TECHNIQUE == WELL_DO_MTX || WELL_TECHNIQUE == WELL_DO_SPL)
+static int held = 0;
+
+/*	hold_lock()
+Hold the lock of side 'arg' for a while, as a concurrent caller would.
+*/
+void *hold_lock(void *arg)
+{
+	struct well_sym *sym = arg;
+#if (WELL_TECHNIQUE == WELL_DO_MTX)
+	pthread_mutex_lock(&sym->lock);
+#else
+	while (__atomic_test_and_set(&sym->lock, __ATOMIC_ACQUIRE))
+		;
+#endif
+	__atomic_store_n(&held, 1, __ATOMIC_RELEASE);
+	usleep(20000);
+#if (WELL_TECHNIQUE == WELL_DO_MTX)
+	pthread_mutex_unlock(&sym->lock);
+#else
+	__atomic_clear(&sym->lock, __ATOMIC_RELEASE);
+#endif
+	return NULL;
+}
+#endif
+
+
+/*	test_fair_lock()
+In fair mode, a reserver whose turn it is must not fail on a taken lock
+	while blocks are available.
+*/
+int test_fair_lock(struct well *buf)
+{
+	int err_cnt = 0;
+#if (WELL_TECHNIQUE == WELL_DO_MTX || WELL_TECHNIQUE == WELL_DO_SPL)
+	pthread_t holder;
+	size_t pos, ret;
+
+	Z_die_if(pthread_create(&holder, NULL, hold_lock, &buf->tx), "");
+	while (!__atomic_load_n(&held, __ATOMIC_ACQUIRE))
+		;
+	well_fair(buf, 1);
+	ret = well_reserve(&buf->tx, &pos, 4);
+	well_fair(buf, 0);
+	pthread_join(holder, NULL);
+
+	Z_err_if(ret != 4, "fair reserve behind a held lock returned %zu", ret);
+	if (ret)
+		Z_err_if(well_unreserve(&buf->tx, pos, ret) != ret, "");
+out:
+#endif
+	return err_cnt;
+}
+
+
+/*	test_layout()
+Verify the control block is laid out as the build asked.
+*/
+int test_layout()
+{
+	int err_cnt = 0;
+
+#if (WELL_LAYOUT == WELL_LAYOUT_PACKED)
+	Z_err_if(sizeof(struct well) != sizeof(struct well_const) + 2 * sizeof(struct well_sym),
+		"packed layout %zu has padding", sizeof(struct well));
+#else
+	/* no two members may share a line */
+	size_t tx = offsetof(struct well, tx);
+	size_t rx = offsetof(struct well, rx);
+	Z_err_if(tx % WELL_LINE || rx % WELL_LINE,
+		"tx @%zu rx @%zu not aligned to %d", tx, rx, WELL_LINE);
+	Z_err_if(tx < sizeof(struct well_const) || rx - tx < sizeof(struct well_sym),
+		"members overlap: tx @%zu rx @%zu", tx, rx);
+	Z_err_if(sizeof(struct well) % WELL_LINE,
+		"size %zu: a neighbour could share the last line", sizeof(struct well));
+#endif
+
+#if (WELL_LAYOUT == WELL_LAYOUT_SPLIT)
+	Z_err_if(offsetof(struct well_sym, avail) / WELL_LINE
+			== offsetof(struct well_sym, pos) / WELL_LINE,
+		"'pos' and 'avail' share a line");
+#endif
+
+	return err_cnt;
+}
+
+
 /*	main()
 */
 int main()
@@ -56,6 +179,9 @@ int main()
 
 	/* run tests */
 	err_cnt += test_zero(&buf);
+	err_cnt += test_unreserve(&buf);
+	err_cnt += test_fair_lock(&buf);
+	err_cnt += test_layout();
 
 out:
 	well_deinit(&buf);